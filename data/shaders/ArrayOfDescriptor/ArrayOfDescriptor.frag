@@ -1,6 +1,7 @@
 #version 450
 
-layout (set = 0, binding = 1) uniform sampler2D textures[2];
+// Bindless texture table (vks::BindlessTextures), indexed by the instance texture ID
+layout (set = 1, binding = 0) uniform sampler2D textures[2];
 
 layout (location = 0) in vec2 inUV;
 layout (location = 1) flat in uint inTexID;
@@ -0,0 +1,3 @@
+C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V -DFORMAT=r32f downsampler.comp -o downsampler_r32f.comp.spv
+C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V -DFORMAT=rgba16f downsampler.comp -o downsampler_rgba16f.comp.spv
+pause
\ No newline at end of file
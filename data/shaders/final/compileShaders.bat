@@ -19,7 +19,7 @@ C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V composition.frag -o spirv\com
 C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V tonemapping.frag -o spirv\tonemapping.frag.spv
 
 C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V bloomPrefilter.comp -o spirv\bloomPrefilter.comp.spv
-C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V bloomDownsampleHorizontal.comp -o spirv\bloomDownsampleHorizontal.comp.spv
-C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V bloomDownsampleVertical.comp -o spirv\bloomDownsampleVertical.comp.spv
+C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V bloomBlurHorizontal.comp -o spirv\bloomBlurHorizontal.comp.spv
+C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V bloomBlurVertical.comp -o spirv\bloomBlurVertical.comp.spv
 C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V bloomUpsample.comp -o spirv\bloomUpsample.comp.spv
 pause
\ No newline at end of file
@@ -9,4 +9,5 @@ C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V deferredLighting.frag -o spir
 C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V frustumXY.comp -o spirv\frustumXY.comp.spv
 C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V frustumZ.comp -o spirv\frustumZ.comp.spv
 C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V lightCulling.comp -o spirv\lightCulling.comp.spv
+C:\VulkanSDK\1.2.148.0\Bin\glslangValidator.exe -V drawCulling.comp -o spirv\drawCulling.comp.spv
 pause
\ No newline at end of file
@@ -16,7 +16,7 @@ layout (location = 0) out vec4 outRT0; // (Normal.x, Normal.y, EmissiveFactor, R
 layout (location = 1) out vec4 outRT1; // (BaseColor.rgb/Diffuse.rgb, ShadingModelType)
 layout (location = 2) out vec4 outRT2;
 
-layout (set = 1, binding = 0) uniform sampler2D textures[TEXTURE_COUNT];
+layout (set = 1, binding = 0) uniform sampler2DArray textures[TEXTURE_COUNT];
 
 float encodeRoughnessMetallic(float r, float m){
 	return r * 100.0 + m / 256.0;
@@ -28,11 +28,16 @@ vec2 encodeNormal(vec3 n){
 	return n.xy / p;
 }
 
+// The texture index holds the table slot in the low 16 bits and the array layer above
+vec4 sampleTexture(uint index, vec2 uv){
+	return texture(textures[index & 0xFFFFu], vec3(uv, float(index >> 16)));
+}
+
 void main() 
 {
-	vec4 color = texture(textures[inTexIndex0], inUV0);
-	vec4 blend = texture(textures[inTexIndex1], inUV1);
-	vec4 vSunLight = texture(textures[inTexIndex2], inUV2);
+	vec4 color = sampleTexture(inTexIndex0, inUV0);
+	vec4 blend = sampleTexture(inTexIndex1, inUV1);
+	vec4 vSunLight = sampleTexture(inTexIndex2, inUV2);
 
 	if(color.a < 0.6) discard;
 
@@ -43,7 +48,7 @@ void main()
 	vec3 base1 = vec3(0.0);
 	/*
 	if(inTexIndex3 > 0) { //light_on
-		vec4 LightMask = texture(textures[inTexIndex3], inUV3);
+		vec4 LightMask = sampleTexture(inTexIndex3, inUV3);
 
 		base -= base0;
 		base1 = base * LightMask.r * 0.5; // Baked Light
@@ -8,7 +8,7 @@ layout (location = 3) in vec3 inUV1;
 layout (location = 4) in vec3 inUV2;
 layout (location = 5) in vec3 inUV3;
 // Per-Instance
-layout (location = 6) in vec3 inInstancePos;
+layout (location = 6) in mat4 inInstance;
 
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec2 outUV0;
@@ -28,10 +28,6 @@ layout (set = 0, binding = 0) uniform Camera {
 	vec3 position;
 } uCamera;
 
-layout(push_constant) uniform Model {
-	mat4 model;
-} uModel;
-
 void main() 
 {
 	outUV0 = inUV0.xy;
@@ -43,8 +39,8 @@ void main()
 	outTexIndex2 = uint(inUV2.z);
 	outTexIndex3 = uint(inUV3.z);
 
-	vec3 worldPos = (uModel.model * vec4(inPos, 1.0)).xyz + inInstancePos;
+	vec3 worldPos = (inInstance * vec4(inPos, 1.0)).xyz;
 	gl_Position = uCamera.projection * uCamera.view * vec4(worldPos, 1.0);
 
-	outNormal = mat3(inverse(transpose(uModel.model))) * inNormal;
+	outNormal = mat3(inverse(transpose(inInstance))) * inNormal;
 }
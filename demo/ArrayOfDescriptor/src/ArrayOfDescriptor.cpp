@@ -12,6 +12,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanBindlessTextures.h"
 
 // Set to "true" to enable Vulkan's validation layers (see vulkandebug.cpp for details)
 #define ENABLE_VALIDATION true
@@ -41,6 +42,11 @@ public:
 	vks::Buffer uniformBuffer;
 
 	std::vector<vks::Texture2D> textures;
+	// [poi] all textures live in one bindless table, instances refer to them by slot
+	vks::BindlessTextures textureTable;
+	std::vector<uint32_t> textureSlots;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+	bool descriptorIndexing = false;
 
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
@@ -61,6 +67,17 @@ public:
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		// Values not set here are initialized in the base class constructor
+
+		// Needed to query descriptor indexing support
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		descriptorIndexing = vks::BindlessTextures::enableDeviceSupport(instance, physicalDevice, enabledDeviceExtensions, descriptorIndexingFeatures);
+		if (descriptorIndexing) {
+			deviceCreatepNextChain = &descriptorIndexingFeatures;
+		}
 	}
 
 	// Clean up used Vulkan resources
@@ -70,6 +87,7 @@ public:
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		textureTable.destroy();
 		
 		vertexBuffer.destroy();
 		instanceBuffer.destroy();
@@ -152,7 +170,8 @@ public:
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 			// Bind descriptor sets describing shader binding points
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			std::array<VkDescriptorSet, 2> descriptorSets = { descriptorSet, textureTable.descriptorSet };
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
 
 			// Bind the rendering pipeline
 			// The pipeline (state object) contains all states of the rendering pipeline, binding it will set all the states specified at pipeline creation time
@@ -193,6 +212,12 @@ public:
 		textures.resize(2);
 		textures[0].loadFromFile(getAssetPath() + "textures/stonefloor01_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures[1].loadFromFile(getAssetPath() + "textures/metalplate01_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+
+		// [poi] the fragment shader array is sized 2, the table may not be smaller
+		textureTable.create(vulkanDevice, static_cast<uint32_t>(textures.size()), VK_SHADER_STAGE_FRAGMENT_BIT, descriptorIndexing);
+		for (auto& tex : textures) {
+			textureSlots.push_back(textureTable.add(tex.descriptor));
+		}
 	}
 
 	// Prepare vertex and index buffers
@@ -272,8 +297,8 @@ public:
 	void prepareInstanceData() {
 		// [poi] use instance buffer for specify model position and texture ID
 		std::vector<InstanceData> instances = { 
-			{ { -1.5f, 0.0f, 0.0f }, 0u },
-			{ {  1.5f, 0.0f, 0.0f }, 1u }
+			{ { -1.5f, 0.0f, 0.0f }, textureSlots[0] },
+			{ {  1.5f, 0.0f, 0.0f }, textureSlots[1] }
 		};
 		instanceCount = static_cast<uint32_t>(instances.size());
 		uint32_t instanceBufferSize = instanceCount * sizeof(InstanceData);
@@ -310,9 +335,7 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> typeCounts = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			// [poi] add requested descriptor type
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.size())
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
 		};
 		
 		// Create the global descriptor pool
@@ -330,9 +353,7 @@ public:
 
 		std::vector<VkDescriptorSetLayoutBinding> dsLayoutBindings = {
 			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
-			// [poi] Binding 1 : Fragment shader array of descriptor
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, textures.size())
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0)
 		};
 
 		VkDescriptorSetLayoutCreateInfo dsLayoutInfo = 
@@ -342,7 +363,9 @@ public:
 
 		// Create the pipeline layout that is used to generate the rendering pipelines that are based on this descriptor set layout
 		// In a more complex scenario you would have different pipeline layouts for different descriptor set layouts that could be reused
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		// [poi] Set 1 : Fragment shader array of descriptor (bindless texture table)
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, textureTable.layout };
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 	}
@@ -356,14 +379,9 @@ public:
 		// Update the descriptor set determining the shader binding points
 		// For every binding point used in a shader there needs to be one
 		// descriptor set matching that binding point
-		std::vector<VkDescriptorImageInfo> texDescriptors(textures.size());
-		for (int i = 0; i < texDescriptors.size(); ++i) {
-			texDescriptors[i] = textures[i].descriptor;
-		}
+		// Textures were written to the bindless table when they were added
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
-			// [poi] update descriptor
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, texDescriptors.data(), texDescriptors.size())
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
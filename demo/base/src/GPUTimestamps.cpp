@@ -57,6 +57,8 @@ void GPUTimestamps::GetQueryResult(std::vector<TimeStamp> *pTimestamps)
 			VkResult res = vkGetQueryPoolResults(m_pDevice->logicalDevice, m_QueryPool, 0, measurements, measurements * sizeof(UINT64), &TimingsInTicks, sizeof(UINT64), VK_QUERY_RESULT_64_BIT);
 			if (res == VK_SUCCESS)
 			{
+				m_frameBeginTicks = TimingsInTicks[0];
+
 				for (uint32_t i = 1; i < measurements; i++)
 				{
 					TimeStamp ts = { m_labels[i], float(microsecondsPerTick * (double)(TimingsInTicks[i] - TimingsInTicks[i - 1])) };
@@ -21,6 +21,8 @@ public:
 	void NextTimeStamp(VkCommandBuffer cmd_buf);
 	void OnBeginFrame(VkCommandBuffer cmd_buf);
 	void GetQueryResult(std::vector<TimeStamp> *pTimestamps);
+	// Raw timestamp of OnBeginFrame read by the last GetQueryResult, to place timestamps of other queues on the frame
+	uint64_t GetFrameBeginTicks() const { return m_frameBeginTicks; }
 
 private:
 	vks::VulkanDevice* m_pDevice;
@@ -33,4 +35,5 @@ private:
 	std::unordered_map<std::string, uint32_t> m_labelToOffset;
 
 	uint32_t m_curOffset;
+	uint64_t m_frameBeginTicks = 0;
 };
\ No newline at end of file
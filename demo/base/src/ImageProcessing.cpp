@@ -0,0 +1,716 @@
+/*
+* Image processing for texture import
+*
+* Builds mip chains on the CPU (gamma correct box or Kaiser filter) and encodes them to
+* BC1 / BC3 / BC7, so uncompressed images can be uploaded pre-mipped and block compressed
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ImageProcessing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "threadpool.hpp"
+
+namespace vks
+{
+	namespace image
+	{
+		// Rows and blocks are independent, spread them over the shared pool
+		static void parallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+		{
+			ThreadPool::shared().parallelFor(count, func);
+		}
+
+		std::vector<VkDeviceSize> MipChain::offsets() const
+		{
+			std::vector<VkDeviceSize> result(levels.size());
+			for (size_t i = 0; i < levels.size(); i++)
+			{
+				result[i] = levels[i].offset;
+			}
+			return result;
+		}
+
+		uint32_t mipLevelCount(uint32_t width, uint32_t height)
+		{
+			return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+		}
+
+		/*
+			Mip chain
+		*/
+
+		static float srgbToLinear(float c)
+		{
+			return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		static float linearToSrgb(float c)
+		{
+			return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+		}
+
+		static uint8_t toUnorm8(float c)
+		{
+			return static_cast<uint8_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+
+		static float besselI0(float x)
+		{
+			float sum = 1.0f;
+			float term = 1.0f;
+			for (int k = 1; k < 16; k++)
+			{
+				term *= (x * 0.5f / k) * (x * 0.5f / k);
+				sum += term;
+			}
+			return sum;
+		}
+
+		// Weights of the 8 source texels around an output texel when halving a dimension,
+		// a sinc low pass at half the source frequency windowed by a Kaiser window (alpha 4)
+		static const float* kaiserWeights()
+		{
+			static const struct Weights
+			{
+				float w[8];
+				Weights()
+				{
+					const float pi = 3.14159265358979f;
+					const float alpha = 4.0f;
+					float sum = 0.0f;
+					for (int i = 0; i < 8; i++)
+					{
+						float d = i - 3.5f;
+						float x = pi * d * 0.5f;
+						float sinc = std::sin(x) / x;
+						float t = d / 4.0f;
+						float window = besselI0(alpha * std::sqrt(1.0f - t * t)) / besselI0(alpha);
+						w[i] = sinc * window;
+						sum += w[i];
+					}
+					for (int i = 0; i < 8; i++)
+					{
+						w[i] /= sum;
+					}
+				}
+			} weights;
+			return weights.w;
+		}
+
+		// Halves one dimension of a float RGBA image, stride and count describe the filtered axis
+		static void downsampleKaiser(const glm::vec4* src, uint32_t srcSize, uint32_t srcStride, glm::vec4* dst, uint32_t dstSize, uint32_t dstStride)
+		{
+			const float* w = kaiserWeights();
+			for (uint32_t x = 0; x < dstSize; x++)
+			{
+				glm::vec4 sum(0.0f);
+				for (int i = 0; i < 8; i++)
+				{
+					int s = std::min(std::max(static_cast<int>(x * 2) - 3 + i, 0), static_cast<int>(srcSize) - 1);
+					sum += src[s * srcStride] * w[i];
+				}
+				dst[x * dstStride] = sum;
+			}
+		}
+
+		void buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, MipFilter filter, MipChain& out)
+		{
+			const uint32_t levelCount = mipLevelCount(width, height);
+			out.format = VK_FORMAT_R8G8B8A8_UNORM;
+			out.levels.resize(levelCount);
+			VkDeviceSize offset = 0;
+			for (uint32_t i = 0; i < levelCount; i++)
+			{
+				MipLevel& level = out.levels[i];
+				level.width = std::max(1u, width >> i);
+				level.height = std::max(1u, height >> i);
+				level.offset = offset;
+				level.size = (VkDeviceSize)level.width * level.height * 4;
+				offset += level.size;
+			}
+			out.data.resize(offset);
+			memcpy(out.data.data(), rgba, out.levels[0].size);
+
+			float toLinear[256];
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				toLinear[i] = srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+			}
+
+			// Every level is filtered from the unquantized previous level
+			std::vector<glm::vec4> current((size_t)width * height);
+			parallelFor(height, [&](uint32_t y) {
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const uint8_t* texel = rgba + ((size_t)y * width + x) * 4;
+					current[(size_t)y * width + x] = glm::vec4(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]], texel[3] / 255.0f);
+				}
+			});
+
+			std::vector<glm::vec4> next, rows;
+			for (uint32_t i = 1; i < levelCount; i++)
+			{
+				const MipLevel& src = out.levels[i - 1];
+				const MipLevel& dst = out.levels[i];
+				next.resize((size_t)dst.width * dst.height);
+
+				if (filter == MipFilter::Box)
+				{
+					parallelFor(dst.height, [&](uint32_t y) {
+						uint32_t y0 = std::min(y * 2, src.height - 1);
+						uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+						for (uint32_t x = 0; x < dst.width; x++)
+						{
+							uint32_t x0 = std::min(x * 2, src.width - 1);
+							uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+							next[(size_t)y * dst.width + x] = 0.25f * (
+								current[(size_t)y0 * src.width + x0] + current[(size_t)y0 * src.width + x1] +
+								current[(size_t)y1 * src.width + x0] + current[(size_t)y1 * src.width + x1]);
+						}
+					});
+				}
+				else
+				{
+					// Separable: rows first, then columns
+					rows.resize((size_t)dst.width * src.height);
+					parallelFor(src.height, [&](uint32_t y) {
+						downsampleKaiser(&current[(size_t)y * src.width], src.width, 1, &rows[(size_t)y * dst.width], dst.width, 1);
+					});
+					parallelFor(dst.width, [&](uint32_t x) {
+						downsampleKaiser(&rows[x], src.height, dst.width, &next[x], dst.height, dst.width);
+					});
+				}
+
+				uint8_t* texels = out.data.data() + dst.offset;
+				parallelFor(dst.height, [&](uint32_t y) {
+					for (uint32_t x = 0; x < dst.width; x++)
+					{
+						const glm::vec4& c = next[(size_t)y * dst.width + x];
+						uint8_t* texel = texels + ((size_t)y * dst.width + x) * 4;
+						for (int ch = 0; ch < 3; ch++)
+						{
+							float v = std::min(std::max(c[ch], 0.0f), 1.0f);
+							texel[ch] = toUnorm8(srgb ? linearToSrgb(v) : v);
+						}
+						texel[3] = toUnorm8(c.a);
+					}
+				});
+				std::swap(current, next);
+			}
+		}
+
+		/*
+			Block compression
+		*/
+
+		// Principal axis of the block colors (power iteration on the covariance), zero for uniform blocks
+		static glm::vec4 principalAxis(const glm::vec4* texels, const glm::vec4& mean, bool withAlpha)
+		{
+			glm::mat4 covariance(0.0f);
+			for (int i = 0; i < 16; i++)
+			{
+				glm::vec4 d = texels[i] - mean;
+				if (!withAlpha)
+				{
+					d.a = 0.0f;
+				}
+				covariance += glm::outerProduct(d, d);
+			}
+
+			glm::vec4 axis = withAlpha ? glm::vec4(1.0f) : glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+			for (int i = 0; i < 8; i++)
+			{
+				axis = covariance * axis;
+				float scale = std::max(std::max(std::abs(axis.r), std::abs(axis.g)), std::max(std::abs(axis.b), std::abs(axis.a)));
+				if (scale < 1e-6f)
+				{
+					return glm::vec4(0.0f);
+				}
+				axis /= scale;
+			}
+			return glm::normalize(axis);
+		}
+
+		static void blockMeanAndRange(const glm::vec4* texels, bool withAlpha, glm::vec4& low, glm::vec4& high)
+		{
+			glm::vec4 mean(0.0f);
+			for (int i = 0; i < 16; i++)
+			{
+				mean += texels[i];
+			}
+			mean /= 16.0f;
+
+			glm::vec4 axis = principalAxis(texels, mean, withAlpha);
+			float minT = 0.0f, maxT = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				float t = glm::dot(texels[i] - mean, axis);
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+			low = mean + axis * minT;
+			high = mean + axis * maxT;
+		}
+
+		// Endpoints minimizing the squared error for the given interpolation weights (weight of the second endpoint)
+		static bool leastSquaresEndpoints(const glm::vec4* texels, const float* weights, glm::vec4& e0, glm::vec4& e1)
+		{
+			float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+			glm::vec4 ax(0.0f), bx(0.0f);
+			for (int i = 0; i < 16; i++)
+			{
+				float b = weights[i];
+				float a = 1.0f - b;
+				aa += a * a;
+				bb += b * b;
+				ab += a * b;
+				ax += a * texels[i];
+				bx += b * texels[i];
+			}
+			float det = aa * bb - ab * ab;
+			if (std::abs(det) < 1e-6f)
+			{
+				return false;
+			}
+			e0 = glm::clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+			e1 = glm::clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+			return true;
+		}
+
+		static void loadBlock(const uint8_t* texels, glm::vec4* out)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				out[i] = glm::vec4(texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3]);
+			}
+		}
+
+		static float distance2(const glm::vec4& a, const glm::vec4& b)
+		{
+			glm::vec4 d = a - b;
+			return glm::dot(d, d);
+		}
+
+		// BC1
+
+		static uint16_t packRGB565(const glm::vec4& c)
+		{
+			uint32_t r = static_cast<uint32_t>(glm::clamp(c.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+			uint32_t g = static_cast<uint32_t>(glm::clamp(c.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+			uint32_t b = static_cast<uint32_t>(glm::clamp(c.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		static glm::vec4 unpackRGB565(uint16_t v)
+		{
+			uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			return glm::vec4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0.0f);
+		}
+
+		static float fitBC1Indices(const glm::vec4* texels, uint16_t c0, uint16_t c1, uint32_t& indices)
+		{
+			glm::vec4 palette[4];
+			palette[0] = unpackRGB565(c0);
+			palette[1] = unpackRGB565(c1);
+			palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+			palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+			float error = 0.0f;
+			indices = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				glm::vec4 c = glm::vec4(glm::vec3(texels[i]), 0.0f);
+				uint32_t best = 0;
+				float bestDistance = distance2(c, palette[0]);
+				for (uint32_t p = 1; p < 4; p++)
+				{
+					float d = distance2(c, palette[p]);
+					if (d < bestDistance)
+					{
+						bestDistance = d;
+						best = p;
+					}
+				}
+				indices |= best << (i * 2);
+				error += bestDistance;
+			}
+			return error;
+		}
+
+		static void encodeBC1Color(const glm::vec4* texels, uint8_t* block)
+		{
+			glm::vec4 low, high;
+			blockMeanAndRange(texels, false, low, high);
+			// Inset the endpoints, the extremes are usually better served by the interpolated colors
+			glm::vec4 inset = (high - low) / 16.0f;
+
+			uint16_t c0 = packRGB565(high - inset);
+			uint16_t c1 = packRGB565(low + inset);
+			uint32_t indices;
+			float error = fitBC1Indices(texels, c0, c1, indices);
+
+			// One least squares refinement with the selected indices
+			const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+			{
+				weights[i] = indexWeights[(indices >> (i * 2)) & 3];
+			}
+			glm::vec4 e0, e1;
+			if (leastSquaresEndpoints(texels, weights, e0, e1))
+			{
+				uint16_t r0 = packRGB565(e0);
+				uint16_t r1 = packRGB565(e1);
+				uint32_t refinedIndices;
+				float refinedError = fitBC1Indices(texels, r0, r1, refinedIndices);
+				if (refinedError < error)
+				{
+					c0 = r0;
+					c1 = r1;
+					indices = refinedIndices;
+				}
+			}
+
+			// c0 > c1 selects the four color mode, swapping the endpoints swaps indices 0 <-> 1 and 2 <-> 3
+			if (c0 < c1)
+			{
+				std::swap(c0, c1);
+				indices ^= 0x55555555u;
+			}
+			else if (c0 == c1)
+			{
+				indices = 0;
+			}
+
+			block[0] = static_cast<uint8_t>(c0 & 0xFF);
+			block[1] = static_cast<uint8_t>(c0 >> 8);
+			block[2] = static_cast<uint8_t>(c1 & 0xFF);
+			block[3] = static_cast<uint8_t>(c1 >> 8);
+			for (int i = 0; i < 4; i++)
+			{
+				block[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+			}
+		}
+
+		void encodeBC1(const uint8_t* texels, uint8_t* block)
+		{
+			glm::vec4 colors[16];
+			loadBlock(texels, colors);
+			encodeBC1Color(colors, block);
+		}
+
+		// BC3
+
+		static void encodeBC3Alpha(const glm::vec4* texels, uint8_t* block)
+		{
+			float minAlpha = 255.0f, maxAlpha = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				minAlpha = std::min(minAlpha, texels[i].a);
+				maxAlpha = std::max(maxAlpha, texels[i].a);
+			}
+			uint32_t a0 = static_cast<uint32_t>(maxAlpha);
+			uint32_t a1 = static_cast<uint32_t>(minAlpha);
+
+			// a0 > a1 selects eight interpolated values, index 0 is a0 and 1 is a1
+			float palette[8];
+			palette[0] = static_cast<float>(a0);
+			palette[1] = static_cast<float>(a1);
+			for (uint32_t i = 2; i < 8; i++)
+			{
+				palette[i] = static_cast<float>(((8 - i) * a0 + (i - 1) * a1) / 7);
+			}
+
+			uint64_t indices = 0;
+			if (a0 > a1)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					uint64_t best = 0;
+					float bestDistance = std::abs(texels[i].a - palette[0]);
+					for (uint32_t p = 1; p < 8; p++)
+					{
+						float d = std::abs(texels[i].a - palette[p]);
+						if (d < bestDistance)
+						{
+							bestDistance = d;
+							best = p;
+						}
+					}
+					indices |= best << (i * 3);
+				}
+			}
+
+			block[0] = static_cast<uint8_t>(a0);
+			block[1] = static_cast<uint8_t>(a1);
+			for (int i = 0; i < 6; i++)
+			{
+				block[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+			}
+		}
+
+		void encodeBC3(const uint8_t* texels, uint8_t* block)
+		{
+			glm::vec4 colors[16];
+			loadBlock(texels, colors);
+			encodeBC3Alpha(colors, block);
+			encodeBC1Color(colors, block + 8);
+		}
+
+		// BC7 (mode 6: one subset, RGBA endpoints with 7 bits + a shared p-bit per endpoint, 4 bit indices)
+
+		static const uint32_t bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct BC7Endpoint
+		{
+			uint32_t q[4];
+			uint32_t p;
+
+			glm::vec4 value() const
+			{
+				return glm::vec4((q[0] << 1) | p, (q[1] << 1) | p, (q[2] << 1) | p, (q[3] << 1) | p);
+			}
+		};
+
+		static BC7Endpoint quantizeBC7Endpoint(const glm::vec4& e)
+		{
+			BC7Endpoint best = {};
+			float bestError = -1.0f;
+			for (uint32_t p = 0; p < 2; p++)
+			{
+				BC7Endpoint candidate;
+				candidate.p = p;
+				for (int c = 0; c < 4; c++)
+				{
+					candidate.q[c] = static_cast<uint32_t>(glm::clamp((e[c] - p) * 0.5f + 0.5f, 0.0f, 127.0f));
+				}
+				float error = distance2(candidate.value(), e);
+				if (bestError < 0.0f || error < bestError)
+				{
+					best = candidate;
+					bestError = error;
+				}
+			}
+			return best;
+		}
+
+		static float fitBC7Indices(const glm::vec4* texels, const BC7Endpoint& e0, const BC7Endpoint& e1, uint32_t* indices)
+		{
+			glm::vec4 palette[16];
+			glm::vec4 v0 = e0.value(), v1 = e1.value();
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t w = bc7Weights4[i];
+				for (int c = 0; c < 4; c++)
+				{
+					palette[i][c] = static_cast<float>(((64 - w) * static_cast<uint32_t>(v0[c]) + w * static_cast<uint32_t>(v1[c]) + 32) >> 6);
+				}
+			}
+
+			float error = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				float bestDistance = distance2(texels[i], palette[0]);
+				for (uint32_t p = 1; p < 16; p++)
+				{
+					float d = distance2(texels[i], palette[p]);
+					if (d < bestDistance)
+					{
+						bestDistance = d;
+						best = p;
+					}
+				}
+				indices[i] = best;
+				error += bestDistance;
+			}
+			return error;
+		}
+
+		struct BitWriter
+		{
+			uint8_t* data;
+			uint32_t position;
+
+			void write(uint32_t value, uint32_t bitCount)
+			{
+				for (uint32_t i = 0; i < bitCount; i++, position++)
+				{
+					if ((value >> i) & 1)
+					{
+						data[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+					}
+				}
+			}
+		};
+
+		void encodeBC7(const uint8_t* texels, uint8_t* block)
+		{
+			glm::vec4 colors[16];
+			loadBlock(texels, colors);
+
+			glm::vec4 low, high;
+			blockMeanAndRange(colors, true, low, high);
+
+			BC7Endpoint e0 = quantizeBC7Endpoint(low);
+			BC7Endpoint e1 = quantizeBC7Endpoint(high);
+			uint32_t indices[16];
+			float error = fitBC7Indices(colors, e0, e1, indices);
+
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+			{
+				weights[i] = bc7Weights4[indices[i]] / 64.0f;
+			}
+			glm::vec4 r0, r1;
+			if (leastSquaresEndpoints(colors, weights, r0, r1))
+			{
+				BC7Endpoint q0 = quantizeBC7Endpoint(r0);
+				BC7Endpoint q1 = quantizeBC7Endpoint(r1);
+				uint32_t refinedIndices[16];
+				float refinedError = fitBC7Indices(colors, q0, q1, refinedIndices);
+				if (refinedError < error)
+				{
+					e0 = q0;
+					e1 = q1;
+					memcpy(indices, refinedIndices, sizeof(indices));
+				}
+			}
+
+			// The most significant bit of the first index is implicit zero
+			if (indices[0] >= 8)
+			{
+				std::swap(e0, e1);
+				for (int i = 0; i < 16; i++)
+				{
+					indices[i] = 15 - indices[i];
+				}
+			}
+
+			memset(block, 0, 16);
+			BitWriter writer = { block, 0 };
+			writer.write(1 << 6, 7);
+			for (int c = 0; c < 4; c++)
+			{
+				writer.write(e0.q[c], 7);
+				writer.write(e1.q[c], 7);
+			}
+			writer.write(e0.p, 1);
+			writer.write(e1.p, 1);
+			writer.write(indices[0], 3);
+			for (int i = 1; i < 16; i++)
+			{
+				writer.write(indices[i], 4);
+			}
+		}
+
+		typedef void (*BlockEncoder)(const uint8_t* texels, uint8_t* block);
+
+		static BlockEncoder blockEncoder(BlockFormat format)
+		{
+			switch (format)
+			{
+			case BlockFormat::BC1: return encodeBC1;
+			case BlockFormat::BC3: return encodeBC3;
+			default: return encodeBC7;
+			}
+		}
+
+		static uint32_t blockSize(BlockFormat format)
+		{
+			return format == BlockFormat::BC1 ? 8 : 16;
+		}
+
+		VkFormat blockFormat(BlockFormat format)
+		{
+			switch (format)
+			{
+			case BlockFormat::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+			case BlockFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+			default: return VK_FORMAT_BC7_UNORM_BLOCK;
+			}
+		}
+
+		VkDeviceSize compressedSize(uint32_t width, uint32_t height, BlockFormat format)
+		{
+			return (VkDeviceSize)((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+		}
+
+		// Encodes one row of blocks, partial blocks at the right / bottom edge repeat the last texel
+		static void encodeBlockRow(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t blockRow, BlockEncoder encode, uint32_t blockBytes, uint8_t* blocks)
+		{
+			uint8_t blockTexels[64];
+			for (uint32_t bx = 0; bx < (width + 3) / 4; bx++)
+			{
+				for (uint32_t y = 0; y < 4; y++)
+				{
+					uint32_t sy = std::min(blockRow * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; x++)
+					{
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+						memcpy(&blockTexels[(y * 4 + x) * 4], texels + ((size_t)sy * width + sx) * 4, 4);
+					}
+				}
+				encode(blockTexels, blocks + bx * blockBytes);
+			}
+		}
+
+		void compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* out)
+		{
+			const BlockEncoder encode = blockEncoder(format);
+			const uint32_t blockBytes = blockSize(format);
+			const VkDeviceSize rowSize = (VkDeviceSize)((width + 3) / 4) * blockBytes;
+			parallelFor((height + 3) / 4, [&](uint32_t y) {
+				encodeBlockRow(rgba, width, height, y, encode, blockBytes, out + y * rowSize);
+			});
+		}
+
+		void compress(const MipChain& rgba, BlockFormat format, MipChain& out)
+		{
+			assert(rgba.format == VK_FORMAT_R8G8B8A8_UNORM || rgba.format == VK_FORMAT_R8G8B8A8_SRGB);
+
+			const BlockEncoder encode = blockEncoder(format);
+			const uint32_t blockBytes = blockSize(format);
+			out.format = blockFormat(format);
+
+			// One job per row of blocks over all levels, so the small levels don't serialize
+			struct Job
+			{
+				uint32_t level;
+				uint32_t blockRow;
+			};
+			std::vector<Job> jobs;
+			out.levels.resize(rgba.levels.size());
+			VkDeviceSize offset = 0;
+			for (uint32_t i = 0; i < rgba.levels.size(); i++)
+			{
+				MipLevel& level = out.levels[i];
+				level.width = rgba.levels[i].width;
+				level.height = rgba.levels[i].height;
+				level.offset = offset;
+				level.size = compressedSize(level.width, level.height, format);
+				offset += level.size;
+				for (uint32_t y = 0; y < (level.height + 3) / 4; y++)
+				{
+					jobs.push_back({ i, y });
+				}
+			}
+			out.data.resize(offset);
+
+			parallelFor(static_cast<uint32_t>(jobs.size()), [&](uint32_t j) {
+				const MipLevel& src = rgba.levels[jobs[j].level];
+				const MipLevel& dst = out.levels[jobs[j].level];
+				uint8_t* blocks = out.data.data() + dst.offset + (VkDeviceSize)jobs[j].blockRow * ((dst.width + 3) / 4) * blockBytes;
+				encodeBlockRow(rgba.data.data() + src.offset, src.width, src.height, jobs[j].blockRow, encode, blockBytes, blocks);
+			});
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*
+* Image processing for texture import
+*
+* Builds mip chains on the CPU (gamma correct box or Kaiser filter) and encodes them to
+* BC1 / BC3 / BC7, so uncompressed images can be uploaded pre-mipped and block compressed
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	namespace image
+	{
+		enum class MipFilter
+		{
+			// 2x2 average
+			Box,
+			// 8 tap Kaiser windowed sinc, sharper distant mips at a higher cost
+			Kaiser
+		};
+
+		enum class BlockFormat
+		{
+			// RGB, 4 bits per texel
+			BC1,
+			// RGBA with interpolated alpha, 8 bits per texel
+			BC3,
+			// RGBA, 8 bits per texel, higher quality than BC3 (mode 6 blocks only)
+			BC7
+		};
+
+		struct MipLevel
+		{
+			uint32_t width;
+			uint32_t height;
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		/** @brief All mip levels of an image packed into one buffer, laid out for a staging copy */
+		struct MipChain
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			std::vector<MipLevel> levels;
+			std::vector<uint8_t> data;
+
+			std::vector<VkDeviceSize> offsets() const;
+		};
+
+		uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+		/**
+		* Builds the full mip chain (down to 1x1) of an RGBA8 image, levels are filtered in parallel
+		*
+		* @param rgba Top level texels, width * height * 4 bytes
+		* @param srgb Color channels are sRGB encoded, filtering is then done in linear space (alpha is always linear)
+		* @param out Receives the levels as VK_FORMAT_R8G8B8A8_UNORM, the caller decides whether the result is sampled as sRGB
+		*/
+		void buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, MipFilter filter, MipChain& out);
+
+		/** @brief Encodes every level of an RGBA8 mip chain to the _UNORM_BLOCK format, blocks are encoded in parallel */
+		void compress(const MipChain& rgba, BlockFormat format, MipChain& out);
+		/** @brief Encodes a single RGBA8 image, out must hold compressedSize(width, height, format) bytes */
+		void compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* out);
+
+		VkFormat blockFormat(BlockFormat format);
+		VkDeviceSize compressedSize(uint32_t width, uint32_t height, BlockFormat format);
+
+		// Single block encoders, input is a 4x4 block of RGBA8 texels in row order
+		void encodeBC1(const uint8_t* texels, uint8_t* block);
+		void encodeBC3(const uint8_t* texels, uint8_t* block);
+		void encodeBC7(const uint8_t* texels, uint8_t* block);
+	}
+}
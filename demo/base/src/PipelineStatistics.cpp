@@ -1,8 +1,20 @@
 #include "PipelineStatistics.h"
 
-void PipelineStatistics::init(vks::VulkanDevice* vkDevice)
+#include <iomanip>
+
+void PipelineStatistics::init(vks::VulkanDevice* vkDevice, std::vector<std::string>&& scopes, uint32_t frameCount)
 {
 	m_vkDevice = vkDevice;
+	m_scopes = scopes;
+	m_frameCount = frameCount;
+	m_activeQuery = UINT32_MAX;
+
+	for (uint32_t i = 0; i < m_scopes.size(); ++i) {
+		m_scopeToIndex.emplace(m_scopes[i], i);
+	}
+	m_pixelCounts.resize(m_scopes.size(), 0);
+	m_accumulated.resize(m_scopes.size(), std::vector<uint64_t>(PIPELINE_STAT_COUNT, 0));
+	m_sampleCounts.resize(m_scopes.size(), 0);
 
 	pipelineStatNames = {
 		"Input assembly vertex count        ",
@@ -10,10 +22,17 @@ void PipelineStatistics::init(vks::VulkanDevice* vkDevice)
 		"Vertex shader invocations          ",
 		"Clipping primitives processed",
 		"Clipping primitives output    ",
-		"Fragment shader invocations        "
+		"Fragment shader invocations        ",
+		"Compute shader invocations         "
 	};
 	pipelineStats.resize(pipelineStatNames.size());
 
+	passStats.resize(m_scopes.size());
+	for (uint32_t i = 0; i < m_scopes.size(); ++i) {
+		passStats[i] = {};
+		passStats[i].m_label = m_scopes[i];
+	}
+
 	VkQueryPoolCreateInfo queryPoolInfo = {};
 	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
 	// This query pool will store pipeline statistics
@@ -25,41 +44,172 @@ void PipelineStatistics::init(vks::VulkanDevice* vkDevice)
 		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
 		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
 		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
-		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
-	queryPoolInfo.queryCount = 6;
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	// One query per scope for every command buffer
+	queryPoolInfo.queryCount = static_cast<uint32_t>(m_scopes.size()) * m_frameCount;
 	VK_CHECK_RESULT(vkCreateQueryPool(m_vkDevice->logicalDevice, &queryPoolInfo, NULL, &m_queryPool));
 }
 
 void PipelineStatistics::destroy()
 {
 	vkDestroyQueryPool(m_vkDevice->logicalDevice, m_queryPool, nullptr);
+
+	m_scopes.clear();
+	m_scopeToIndex.clear();
 }
 
-void PipelineStatistics::begin(VkCommandBuffer cb)
+void PipelineStatistics::setTargetExtent(const std::string& scope, uint32_t width, uint32_t height, uint32_t layers)
 {
-	vkCmdBeginQuery(cb, m_queryPool, 0, 0);
+	auto it = m_scopeToIndex.find(scope);
+	assert(it != m_scopeToIndex.end());
+	m_pixelCounts[it->second] = (uint64_t)width * height * layers;
 }
 
-void PipelineStatistics::end(VkCommandBuffer cb)
+void PipelineStatistics::reset(VkCommandBuffer cb, uint32_t frameIndex)
+{
+	uint32_t scopeCount = static_cast<uint32_t>(m_scopes.size());
+	vkCmdResetQueryPool(cb, m_queryPool, frameIndex * scopeCount, scopeCount);
+}
+
+void PipelineStatistics::begin(VkCommandBuffer cb, const std::string& scope, uint32_t frameIndex)
 {
-	vkCmdEndQuery(cb, m_queryPool, 0);
+	auto it = m_scopeToIndex.find(scope);
+	assert(it != m_scopeToIndex.end());
+	assert(m_activeQuery == UINT32_MAX && "pipeline statistics scopes must not nest");
+
+	m_activeQuery = frameIndex * static_cast<uint32_t>(m_scopes.size()) + it->second;
+	vkCmdBeginQuery(cb, m_queryPool, m_activeQuery, 0);
 }
 
-void PipelineStatistics::reset(VkCommandBuffer cb)
+void PipelineStatistics::end(VkCommandBuffer cb)
 {
-	vkCmdResetQueryPool(cb, m_queryPool, 0, static_cast<uint32_t>(pipelineStats.size()));
+	vkCmdEndQuery(cb, m_queryPool, m_activeQuery);
+	m_activeQuery = UINT32_MAX;
 }
 
-void PipelineStatistics::getResult()
+void PipelineStatistics::getResult(uint32_t frameIndex)
 {
-	uint32_t count = static_cast<uint32_t>(pipelineStats.size());
-	vkGetQueryPoolResults(
+	uint32_t scopeCount = static_cast<uint32_t>(m_scopes.size());
+	if (scopeCount == 0)
+		return;
+
+	// Counters followed by the availability value for every query
+	const uint32_t stride = PIPELINE_STAT_COUNT + 1;
+	std::vector<uint64_t> results(scopeCount * stride, 0);
+
+	// No WAIT_BIT: scopes that are not finished (or not recorded) keep their previous values
+	VkResult res = vkGetQueryPoolResults(
 		m_vkDevice->logicalDevice,
 		m_queryPool,
-		0,
-		1,
-		count * sizeof(uint64_t),
-		pipelineStats.data(),
-		sizeof(uint64_t),
-		VK_QUERY_RESULT_64_BIT);
+		frameIndex * scopeCount,
+		scopeCount,
+		results.size() * sizeof(uint64_t),
+		results.data(),
+		stride * sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (res != VK_SUCCESS && res != VK_NOT_READY)
+		return;
+
+	for (uint32_t i = 0; i < scopeCount; ++i) {
+		const uint64_t* counters = &results[i * stride];
+		if (counters[PIPELINE_STAT_COUNT] == 0)
+			continue;
+
+		PassStatistics& pass = passStats[i];
+		for (uint32_t c = 0; c < PIPELINE_STAT_COUNT; ++c) {
+			pass.m_counters[c] = counters[c];
+			m_accumulated[i][c] += counters[c];
+		}
+		m_sampleCounts[i]++;
+		computeRatios(pass, m_pixelCounts[i]);
+	}
+
+	std::fill(pipelineStats.begin(), pipelineStats.end(), 0);
+	for (auto& pass : passStats) {
+		for (uint32_t c = 0; c < PIPELINE_STAT_COUNT; ++c) {
+			pipelineStats[c] += pass.m_counters[c];
+		}
+	}
+}
+
+void PipelineStatistics::computeRatios(PassStatistics& pass, uint64_t pixelCount) const
+{
+	const uint64_t* counters = pass.m_counters;
+
+	pass.m_overdraw = pixelCount > 0 ? float((double)counters[PIPELINE_STAT_FS_INVOCATIONS] / (double)pixelCount) : 0.0f;
+	pass.m_clippingRejection = counters[PIPELINE_STAT_CLIPPING_INVOCATIONS] > 0 ?
+		float(1.0 - (double)counters[PIPELINE_STAT_CLIPPING_PRIMITIVES] / (double)counters[PIPELINE_STAT_CLIPPING_INVOCATIONS]) : 0.0f;
+	pass.m_vertexReuse = counters[PIPELINE_STAT_IA_VERTICES] > 0 ?
+		float((double)counters[PIPELINE_STAT_VS_INVOCATIONS] / (double)counters[PIPELINE_STAT_IA_VERTICES]) : 0.0f;
+}
+
+void PipelineStatistics::report(std::ostream& os) const
+{
+	// Average every scope over the frames it was sampled in
+	std::vector<PassStatistics> average(m_scopes.size());
+	uint64_t totals[PIPELINE_STAT_COUNT] = {};
+	for (uint32_t i = 0; i < m_scopes.size(); ++i) {
+		average[i] = {};
+		average[i].m_label = m_scopes[i];
+		uint32_t samples = std::max(m_sampleCounts[i], 1u);
+		for (uint32_t c = 0; c < PIPELINE_STAT_COUNT; ++c) {
+			average[i].m_counters[c] = m_accumulated[i][c] / samples;
+			totals[c] += average[i].m_counters[c];
+		}
+		computeRatios(average[i], m_pixelCounts[i]);
+	}
+
+	std::ios::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+
+	os << "pipeline statistics (average per frame)" << "\n";
+	os << std::left << std::setw(20) << "pass" << std::right
+		<< std::setw(12) << "ia verts" << std::setw(12) << "vs inv" << std::setw(12) << "clip in" << std::setw(12) << "clip out"
+		<< std::setw(12) << "fs inv" << std::setw(12) << "cs inv"
+		<< std::setw(10) << "overdraw" << std::setw(10) << "clip rej" << std::setw(10) << "vs reuse" << "\n";
+	os << std::fixed << std::setprecision(2);
+	for (auto& pass : average) {
+		os << std::left << std::setw(20) << pass.m_label << std::right
+			<< std::setw(12) << pass.m_counters[PIPELINE_STAT_IA_VERTICES]
+			<< std::setw(12) << pass.m_counters[PIPELINE_STAT_VS_INVOCATIONS]
+			<< std::setw(12) << pass.m_counters[PIPELINE_STAT_CLIPPING_INVOCATIONS]
+			<< std::setw(12) << pass.m_counters[PIPELINE_STAT_CLIPPING_PRIMITIVES]
+			<< std::setw(12) << pass.m_counters[PIPELINE_STAT_FS_INVOCATIONS]
+			<< std::setw(12) << pass.m_counters[PIPELINE_STAT_CS_INVOCATIONS]
+			<< std::setw(10) << pass.m_overdraw
+			<< std::setw(10) << pass.m_clippingRejection
+			<< std::setw(10) << pass.m_vertexReuse << "\n";
+	}
+
+	// Bottleneck report: the pass holding the largest share of each kind of work
+	struct Hotspot {
+		const char* name;
+		PipelineStatistic counter;
+	};
+	const Hotspot hotspots[] = {
+		{ "vertex work  ", PIPELINE_STAT_VS_INVOCATIONS },
+		{ "raster work  ", PIPELINE_STAT_CLIPPING_PRIMITIVES },
+		{ "fragment work", PIPELINE_STAT_FS_INVOCATIONS },
+		{ "compute work ", PIPELINE_STAT_CS_INVOCATIONS },
+	};
+	os << "bottlenecks:" << "\n";
+	for (auto& hotspot : hotspots) {
+		if (totals[hotspot.counter] == 0 || average.empty())
+			continue;
+		auto top = std::max_element(average.begin(), average.end(), [&](const PassStatistics& a, const PassStatistics& b) {
+			return a.m_counters[hotspot.counter] < b.m_counters[hotspot.counter];
+		});
+		os << "  " << hotspot.name << ": " << top->m_label << " ("
+			<< 100.0 * (double)top->m_counters[hotspot.counter] / (double)totals[hotspot.counter] << "%)" << "\n";
+	}
+	auto overdraw = std::max_element(average.begin(), average.end(), [](const PassStatistics& a, const PassStatistics& b) {
+		return a.m_overdraw < b.m_overdraw;
+	});
+	if (overdraw != average.end() && overdraw->m_overdraw > 0.0f) {
+		os << "  overdraw     : " << overdraw->m_label << " (" << overdraw->m_overdraw << " fragments per pixel)" << "\n";
+	}
+
+	os.flags(flags);
+	os.precision(precision);
 }
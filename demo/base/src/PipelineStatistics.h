@@ -2,21 +2,76 @@
 
 #include "VulkanDevice.h"
 
+#include <ostream>
+#include <unordered_map>
+
+// Counters collected for every scope, in the order they are returned by the query pool
+enum PipelineStatistic {
+	PIPELINE_STAT_IA_VERTICES = 0,
+	PIPELINE_STAT_IA_PRIMITIVES,
+	PIPELINE_STAT_VS_INVOCATIONS,
+	PIPELINE_STAT_CLIPPING_INVOCATIONS,
+	PIPELINE_STAT_CLIPPING_PRIMITIVES,
+	PIPELINE_STAT_FS_INVOCATIONS,
+	PIPELINE_STAT_CS_INVOCATIONS,
+	PIPELINE_STAT_COUNT
+};
+
+struct PassStatistics
+{
+	std::string m_label;
+	uint64_t    m_counters[PIPELINE_STAT_COUNT];
+
+	// Derived ratios
+	float m_overdraw;           // fragment invocations per target pixel
+	float m_clippingRejection;  // share of primitives discarded by clipping/culling
+	float m_vertexReuse;        // vertex shader invocations per input vertex (post-transform cache efficiency)
+};
+
+/*
+	Pipeline statistics split into named scopes (one query per pass).
+	Scopes must not nest, Vulkan allows only one active query of a type per command buffer.
+	Every pre-recorded command buffer gets its own range of queries, so results are read
+	back with availability instead of waiting on the GPU.
+*/
 class PipelineStatistics {
 public:
-	void init(vks::VulkanDevice* vkDevice);
+	void init(vks::VulkanDevice* vkDevice, std::vector<std::string>&& scopes, uint32_t frameCount = 1);
 	void destroy();
 
-	void begin(VkCommandBuffer cb);
+	// Size of the render target of a scope, used to derive overdraw
+	void setTargetExtent(const std::string& scope, uint32_t width, uint32_t height, uint32_t layers = 1);
+
+	void reset(VkCommandBuffer cb, uint32_t frameIndex = 0);
+	void begin(VkCommandBuffer cb, const std::string& scope, uint32_t frameIndex = 0);
 	void end(VkCommandBuffer cb);
-	void reset(VkCommandBuffer cb);
 
-	void getResult();
+	void getResult(uint32_t frameIndex = 0);
+
+	// Per pass table + the passes dominating each counter, averaged over every frame read back so far
+	void report(std::ostream& os) const;
 public:
+	// Totals of the last frame over all scopes
 	std::vector<uint64_t> pipelineStats;
 	std::vector<std::string> pipelineStatNames;
+
+	// Per scope results of the last frame
+	std::vector<PassStatistics> passStats;
+private:
+	void computeRatios(PassStatistics& pass, uint64_t pixelCount) const;
 private:
 	vks::VulkanDevice* m_vkDevice;
 
 	VkQueryPool m_queryPool;
-};
\ No newline at end of file
+
+	uint32_t m_frameCount;
+	uint32_t m_activeQuery;
+
+	std::vector<std::string> m_scopes;
+	std::unordered_map<std::string, uint32_t> m_scopeToIndex;
+	std::vector<uint64_t> m_pixelCounts;
+
+	// Running sums for averaged reports (benchmark output)
+	std::vector<std::vector<uint64_t>> m_accumulated;
+	std::vector<uint32_t> m_sampleCounts;
+};
@@ -0,0 +1,510 @@
+/*
+* Pixel format conversion
+*
+* Converts uncompressed 8 / 16 bit per channel image data to RGBA8, using SSSE3 or AVX2
+* shuffle kernels when the CPU supports them (selected at runtime) and scalar code otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PixelConversion.h"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERSION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows intrinsics of any instruction set without enabling it for the whole translation unit
+#define PIXEL_TARGET_SSSE3
+#define PIXEL_TARGET_AVX2
+#else
+#define PIXEL_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define PIXEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace vks
+{
+	namespace pixel
+	{
+		namespace reference
+		{
+			void rgb8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				for (size_t i = 0; i < pixelCount; i++)
+				{
+					dst[i * 4 + 0] = src[i * 3 + 0];
+					dst[i * 4 + 1] = src[i * 3 + 1];
+					dst[i * 4 + 2] = src[i * 3 + 2];
+					dst[i * 4 + 3] = 255;
+				}
+			}
+
+			void bgr8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				for (size_t i = 0; i < pixelCount; i++)
+				{
+					dst[i * 4 + 0] = src[i * 3 + 2];
+					dst[i * 4 + 1] = src[i * 3 + 1];
+					dst[i * 4 + 2] = src[i * 3 + 0];
+					dst[i * 4 + 3] = 255;
+				}
+			}
+
+			void swizzleRB(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				for (size_t i = 0; i < pixelCount; i++)
+				{
+					uint8_t r = src[i * 4 + 0];
+					uint8_t b = src[i * 4 + 2];
+					dst[i * 4 + 0] = b;
+					dst[i * 4 + 1] = src[i * 4 + 1];
+					dst[i * 4 + 2] = r;
+					dst[i * 4 + 3] = src[i * 4 + 3];
+				}
+			}
+
+			// round(v * 255 / 65535), exact for all 16 bit values
+			static inline uint8_t unorm16ToUnorm8(uint16_t v)
+			{
+				return static_cast<uint8_t>((v * 255u + 32895u) >> 16);
+			}
+
+			void unorm16ToUnorm8(const uint16_t* src, uint8_t* dst, size_t valueCount)
+			{
+				for (size_t i = 0; i < valueCount; i++)
+				{
+					dst[i] = unorm16ToUnorm8(src[i]);
+				}
+			}
+
+			void rgb16ToRgba8(const uint16_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				for (size_t i = 0; i < pixelCount; i++)
+				{
+					dst[i * 4 + 0] = unorm16ToUnorm8(src[i * 3 + 0]);
+					dst[i * 4 + 1] = unorm16ToUnorm8(src[i * 3 + 1]);
+					dst[i * 4 + 2] = unorm16ToUnorm8(src[i * 3 + 2]);
+					dst[i * 4 + 3] = 255;
+				}
+			}
+		}
+
+#if defined(PIXEL_CONVERSION_X86)
+		namespace ssse3
+		{
+			// Expands 16 three channel pixels (48 bytes) per iteration, the shuffle mask selects the channel order
+			PIXEL_TARGET_SSSE3 static size_t expand3To4(const uint8_t* src, uint8_t* dst, size_t pixelCount, __m128i mask)
+			{
+				const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+				size_t i = 0;
+				for (; i + 16 <= pixelCount; i += 16)
+				{
+					const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+					const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 16));
+					const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 32));
+					__m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+					_mm_storeu_si128(out + 0, _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha));
+					_mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha));
+					_mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), alpha));
+					_mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), alpha));
+				}
+				return i;
+			}
+
+			PIXEL_TARGET_SSSE3 static void rgb8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				size_t i = expand3To4(src, dst, pixelCount, mask);
+				reference::rgb8ToRgba8(src + i * 3, dst + i * 4, pixelCount - i);
+			}
+
+			PIXEL_TARGET_SSSE3 static void bgr8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+				size_t i = expand3To4(src, dst, pixelCount, mask);
+				reference::bgr8ToRgba8(src + i * 3, dst + i * 4, pixelCount - i);
+			}
+
+			PIXEL_TARGET_SSSE3 static void swizzleRB(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+				size_t i = 0;
+				for (; i + 4 <= pixelCount; i += 4)
+				{
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(v, mask));
+				}
+				reference::swizzleRB(src + i * 4, dst + i * 4, pixelCount - i);
+			}
+
+			// (v * 255 + 32895) >> 16 on four 32 bit lanes
+			PIXEL_TARGET_SSSE3 static inline __m128i unorm16ToUnorm8(__m128i v)
+			{
+				const __m128i bias = _mm_set1_epi32(32895);
+				return _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(v, 8), v), bias), 16);
+			}
+
+			PIXEL_TARGET_SSSE3 static void unorm16ToUnorm8(const uint16_t* src, uint8_t* dst, size_t valueCount)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				size_t i = 0;
+				for (; i + 16 <= valueCount; i += 16)
+				{
+					const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+					const __m128i a16 = _mm_packs_epi32(unorm16ToUnorm8(_mm_unpacklo_epi16(a, zero)), unorm16ToUnorm8(_mm_unpackhi_epi16(a, zero)));
+					const __m128i b16 = _mm_packs_epi32(unorm16ToUnorm8(_mm_unpacklo_epi16(b, zero)), unorm16ToUnorm8(_mm_unpackhi_epi16(b, zero)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a16, b16));
+				}
+				reference::unorm16ToUnorm8(src + i, dst + i, valueCount - i);
+			}
+		}
+
+		namespace avx2
+		{
+			// Expands 16 three channel pixels per iteration, every 128 bit lane holds 12 source bytes
+			// (the last load reads 4 bytes past the 48 consumed, the loop leaves room for that)
+			PIXEL_TARGET_AVX2 static size_t expand3To4(const uint8_t* src, uint8_t* dst, size_t pixelCount, __m256i mask)
+			{
+				const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+				size_t i = 0;
+				for (; i + 18 <= pixelCount; i += 16)
+				{
+					const uint8_t* in = src + i * 3;
+					const __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+					const __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 24))),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 36)), 1);
+					__m256i* out = reinterpret_cast<__m256i*>(dst + i * 4);
+					_mm256_storeu_si256(out + 0, _mm256_or_si256(_mm256_shuffle_epi8(a, mask), alpha));
+					_mm256_storeu_si256(out + 1, _mm256_or_si256(_mm256_shuffle_epi8(b, mask), alpha));
+				}
+				return i;
+			}
+
+			PIXEL_TARGET_AVX2 static void rgb8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				const __m256i mask = _mm256_setr_epi8(
+					0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+					0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				size_t i = expand3To4(src, dst, pixelCount, mask);
+				ssse3::rgb8ToRgba8(src + i * 3, dst + i * 4, pixelCount - i);
+			}
+
+			PIXEL_TARGET_AVX2 static void bgr8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				const __m256i mask = _mm256_setr_epi8(
+					2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+					2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+				size_t i = expand3To4(src, dst, pixelCount, mask);
+				ssse3::bgr8ToRgba8(src + i * 3, dst + i * 4, pixelCount - i);
+			}
+
+			PIXEL_TARGET_AVX2 static void swizzleRB(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				const __m256i mask = _mm256_setr_epi8(
+					2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+					2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+				size_t i = 0;
+				for (; i + 8 <= pixelCount; i += 8)
+				{
+					const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+				}
+				ssse3::swizzleRB(src + i * 4, dst + i * 4, pixelCount - i);
+			}
+
+			PIXEL_TARGET_AVX2 static inline __m256i unorm16ToUnorm8(__m128i v)
+			{
+				const __m256i bias = _mm256_set1_epi32(32895);
+				const __m256i v32 = _mm256_cvtepu16_epi32(v);
+				return _mm256_srli_epi32(_mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(v32, 8), v32), bias), 16);
+			}
+
+			PIXEL_TARGET_AVX2 static void unorm16ToUnorm8(const uint16_t* src, uint8_t* dst, size_t valueCount)
+			{
+				size_t i = 0;
+				for (; i + 32 <= valueCount; i += 32)
+				{
+					const __m128i* in = reinterpret_cast<const __m128i*>(src + i);
+					// The packs work per 128 bit lane, permute restores the value order after each one
+					const __m256i a = _mm256_permute4x64_epi64(_mm256_packus_epi32(unorm16ToUnorm8(_mm_loadu_si128(in + 0)), unorm16ToUnorm8(_mm_loadu_si128(in + 1))), 0xD8);
+					const __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi32(unorm16ToUnorm8(_mm_loadu_si128(in + 2)), unorm16ToUnorm8(_mm_loadu_si128(in + 3))), 0xD8);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+				}
+				ssse3::unorm16ToUnorm8(src + i, dst + i, valueCount - i);
+			}
+		}
+
+		static InstructionSet detectInstructionSet()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+			__cpuid(info, 1);
+			const bool ssse3 = (info[2] & (1 << 9)) != 0;
+			// AVX state has to be enabled by the OS (OSXSAVE + XCR0)
+			const bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+			bool avx2 = false;
+			if (osAvx && maxLeaf >= 7)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			const bool ssse3 = __builtin_cpu_supports("ssse3") != 0;
+			const bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+			if (avx2)
+			{
+				return InstructionSet::AVX2;
+			}
+			return ssse3 ? InstructionSet::SSSE3 : InstructionSet::Scalar;
+		}
+#else
+		static InstructionSet detectInstructionSet()
+		{
+			return InstructionSet::Scalar;
+		}
+#endif
+
+		namespace
+		{
+			struct Kernels
+			{
+				void (*rgb8ToRgba8)(const uint8_t*, uint8_t*, size_t);
+				void (*bgr8ToRgba8)(const uint8_t*, uint8_t*, size_t);
+				void (*swizzleRB)(const uint8_t*, uint8_t*, size_t);
+				void (*unorm16ToUnorm8)(const uint16_t*, uint8_t*, size_t);
+			};
+
+			Kernels selectKernels(InstructionSet set)
+			{
+				switch (set)
+				{
+#if defined(PIXEL_CONVERSION_X86)
+				case InstructionSet::AVX2:
+					return { avx2::rgb8ToRgba8, avx2::bgr8ToRgba8, avx2::swizzleRB, avx2::unorm16ToUnorm8 };
+				case InstructionSet::SSSE3:
+					return { ssse3::rgb8ToRgba8, ssse3::bgr8ToRgba8, ssse3::swizzleRB, ssse3::unorm16ToUnorm8 };
+#endif
+				default:
+					return { reference::rgb8ToRgba8, reference::bgr8ToRgba8, reference::swizzleRB, reference::unorm16ToUnorm8 };
+				}
+			}
+
+			const Kernels& kernels()
+			{
+				static const Kernels selected = selectKernels(instructionSet());
+				return selected;
+			}
+
+			void convertRgb16(const Kernels& selected, const uint16_t* src, uint8_t* dst, size_t pixelCount)
+			{
+				// Narrow a block to RGB8 on the stack, then expand it into the destination
+				const size_t blockSize = 256;
+				uint8_t rgb[blockSize * 3];
+				for (size_t i = 0; i < pixelCount; i += blockSize)
+				{
+					size_t count = pixelCount - i < blockSize ? pixelCount - i : blockSize;
+					selected.unorm16ToUnorm8(src + i * 3, rgb, count * 3);
+					selected.rgb8ToRgba8(rgb, dst + i * 4, count);
+				}
+			}
+
+			template <typename Source>
+			using Kernel = std::function<void(const Source*, uint8_t*, size_t)>;
+
+			// Runs kernel and reference on count * scale units and compares the whole destination, including a guard band
+			// behind it that neither may touch. In place runs convert a copy of the source in the destination
+			template <typename Source>
+			bool matches(const Kernel<Source>& kernel, const Kernel<Source>& expected, const Source* src, size_t units, size_t srcStride, size_t dstStride, bool inPlace)
+			{
+				const size_t guard = 64;
+				std::vector<uint8_t> result(units * dstStride + guard, 0xCD);
+				std::vector<uint8_t> reference(result);
+				if (inPlace)
+				{
+					memcpy(result.data(), src, units * srcStride * sizeof(Source));
+					memcpy(reference.data(), src, units * srcStride * sizeof(Source));
+					kernel(reinterpret_cast<const Source*>(result.data()), result.data(), units);
+					expected(reinterpret_cast<const Source*>(reference.data()), reference.data(), units);
+				}
+				else
+				{
+					kernel(src, result.data(), units);
+					expected(src, reference.data(), units);
+				}
+				return result == reference;
+			}
+
+			template <typename Source>
+			double milliseconds(const Kernel<Source>& kernel, const Source* src, size_t units, size_t dstStride)
+			{
+				const uint32_t iterations = 16;
+				std::vector<uint8_t> dst(units * dstStride);
+				// The first run warms the caches (and the wide units with AVX2) up
+				kernel(src, dst.data(), units);
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					kernel(src, dst.data(), units);
+				}
+				return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+			}
+		}
+
+		InstructionSet instructionSet()
+		{
+			static const InstructionSet set = detectInstructionSet();
+			return set;
+		}
+
+		const char* instructionSetName(InstructionSet set)
+		{
+			switch (set)
+			{
+			case InstructionSet::AVX2: return "AVX2";
+			case InstructionSet::SSSE3: return "SSSE3";
+			default: return "scalar";
+			}
+		}
+
+		void rgb8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+		{
+			kernels().rgb8ToRgba8(src, dst, pixelCount);
+		}
+
+		void bgr8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+		{
+			kernels().bgr8ToRgba8(src, dst, pixelCount);
+		}
+
+		void swizzleRB(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+		{
+			kernels().swizzleRB(src, dst, pixelCount);
+		}
+
+		void unorm16ToUnorm8(const uint16_t* src, uint8_t* dst, size_t valueCount)
+		{
+			kernels().unorm16ToUnorm8(src, dst, valueCount);
+		}
+
+		void rgb16ToRgba8(const uint16_t* src, uint8_t* dst, size_t pixelCount)
+		{
+			convertRgb16(kernels(), src, dst, pixelCount);
+		}
+
+		void validate(std::ostream& os)
+		{
+			// Every tail length of the 4 to 32 pixel wide loops, then odd counts large enough for every channel to see
+			// all 256 byte values and for the 16 bit conversions to see all 65536 values
+			std::vector<size_t> counts;
+			for (size_t count = 0; count <= 70; count++)
+			{
+				counts.push_back(count);
+			}
+			counts.push_back(257);
+			counts.push_back(1021);
+			counts.push_back(21847);
+			const size_t maxCount = counts.back();
+
+			// Odd multipliers visit every value of the type once per period, small counts still get spread out values
+			std::vector<uint8_t> rgb8(maxCount * 3), rgba8(maxCount * 4);
+			std::vector<uint16_t> rgb16(maxCount * 3);
+			for (size_t p = 0; p < maxCount; p++)
+			{
+				for (size_t c = 0; c < 4; c++)
+				{
+					const uint8_t value = static_cast<uint8_t>(p * 167 + c * 85);
+					if (c < 3)
+					{
+						rgb8[p * 3 + c] = value;
+					}
+					rgba8[p * 4 + c] = value;
+				}
+			}
+			for (size_t i = 0; i < rgb16.size(); i++)
+			{
+				rgb16[i] = static_cast<uint16_t>(i * 40503u);
+			}
+
+			std::vector<InstructionSet> sets;
+			if (instructionSet() == InstructionSet::SSSE3 || instructionSet() == InstructionSet::AVX2)
+			{
+				sets.push_back(InstructionSet::SSSE3);
+			}
+			if (instructionSet() == InstructionSet::AVX2)
+			{
+				sets.push_back(InstructionSet::AVX2);
+			}
+
+			std::ios::fmtflags flags = os.flags();
+			std::streamsize precision = os.precision();
+
+			os << "pixel conversion (" << counts.size() << " counts up to " << maxCount << " pixels, " << instructionSetName(instructionSet()) << " selected)" << "\n";
+			if (sets.empty())
+			{
+				os << "no SIMD kernels on this CPU, only the reference is used" << "\n";
+				return;
+			}
+			os << std::left << std::setw(18) << "kernel" << std::setw(8) << "set" << std::right << std::setw(8) << "cases" << std::setw(12) << "mismatches"
+				<< std::setw(12) << "scalar ms" << std::setw(12) << "simd ms" << "\n";
+			os << std::fixed << std::setprecision(3);
+
+			const Kernels reference = selectKernels(InstructionSet::Scalar);
+			uint32_t failedRows = 0;
+			for (InstructionSet set : sets)
+			{
+				const Kernels simd = selectKernels(set);
+				auto report = [&](const char* name, uint32_t mismatches, double scalarTime, double simdTime, size_t cases)
+				{
+					os << std::left << std::setw(18) << name << std::setw(8) << instructionSetName(set) << std::right << std::setw(8) << cases
+						<< std::setw(12) << mismatches << std::setw(12) << scalarTime << std::setw(12) << simdTime << " " << (mismatches == 0 ? "match" : "MISMATCH") << "\n";
+					failedRows += mismatches != 0 ? 1 : 0;
+				};
+				auto check8 = [&](const char* name, const Kernel<uint8_t>& kernel, const Kernel<uint8_t>& expected, const std::vector<uint8_t>& src, size_t srcStride, bool inPlace)
+				{
+					uint32_t mismatches = 0;
+					for (size_t count : counts)
+					{
+						mismatches += matches(kernel, expected, src.data(), count, srcStride, 4, false) ? 0 : 1;
+						mismatches += !inPlace || matches(kernel, expected, src.data(), count, srcStride, 4, true) ? 0 : 1;
+					}
+					report(name, mismatches, milliseconds(expected, src.data(), maxCount, 4), milliseconds(kernel, src.data(), maxCount, 4), counts.size() * (inPlace ? 2 : 1));
+				};
+				auto check16 = [&](const char* name, const Kernel<uint16_t>& kernel, const Kernel<uint16_t>& expected, size_t scale, size_t srcStride, size_t dstStride)
+				{
+					uint32_t mismatches = 0;
+					for (size_t count : counts)
+					{
+						mismatches += matches(kernel, expected, rgb16.data(), count * scale, srcStride, dstStride, false) ? 0 : 1;
+					}
+					report(name, mismatches, milliseconds(expected, rgb16.data(), maxCount * scale, dstStride), milliseconds(kernel, rgb16.data(), maxCount * scale, dstStride), counts.size());
+				};
+
+				check8("rgb8ToRgba8", simd.rgb8ToRgba8, reference.rgb8ToRgba8, rgb8, 3, false);
+				check8("bgr8ToRgba8", simd.bgr8ToRgba8, reference.bgr8ToRgba8, rgb8, 3, false);
+				check8("swizzleRB", simd.swizzleRB, reference.swizzleRB, rgba8, 4, true);
+				// Three values per pixel, so the value counts hit every tail of the 16 and 32 wide loops as well
+				check16("unorm16ToUnorm8", simd.unorm16ToUnorm8, reference.unorm16ToUnorm8, 3, 1, 1);
+				check16("rgb16ToRgba8",
+					[&](const uint16_t* src, uint8_t* dst, size_t pixelCount) { convertRgb16(simd, src, dst, pixelCount); },
+					reference::rgb16ToRgba8, 1, 3, 4);
+			}
+			os << (failedRows == 0 ? "all kernels match the reference" : "kernels differ from the reference") << "\n";
+
+			os.flags(flags);
+			os.precision(precision);
+		}
+	}
+}
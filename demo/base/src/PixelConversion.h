@@ -0,0 +1,60 @@
+/*
+* Pixel format conversion
+*
+* Converts uncompressed 8 / 16 bit per channel image data to RGBA8, using SSSE3 or AVX2
+* shuffle kernels when the CPU supports them (selected at runtime) and scalar code otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace vks
+{
+	namespace pixel
+	{
+		enum class InstructionSet
+		{
+			Scalar = 0,
+			SSSE3,
+			AVX2
+		};
+
+		/** @brief Best instruction set supported by the CPU, used by the conversion functions below */
+		InstructionSet instructionSet();
+		const char* instructionSetName(InstructionSet set);
+
+		// All functions take a pixel count, source and destination must not overlap (except for swizzleRB, which may work in place)
+
+		/** @brief Expands RGB8 to RGBA8 with alpha 255 */
+		void rgb8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+		/** @brief Expands BGR8 to RGBA8 with alpha 255 */
+		void bgr8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+		/** @brief Swaps the first and third channel of four channel pixels (BGRA8 <-> RGBA8) */
+		void swizzleRB(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+		/** @brief Converts unorm16 to unorm8 with rounding to nearest, for valueCount channel values */
+		void unorm16ToUnorm8(const uint16_t* src, uint8_t* dst, size_t valueCount);
+		/** @brief Converts RGB16 to RGBA8 with alpha 255 */
+		void rgb16ToRgba8(const uint16_t* src, uint8_t* dst, size_t pixelCount);
+
+		/**
+		* Compares every SIMD kernel the CPU supports with the reference for all source values and every tail length,
+		* including in place swizzles and writes past the end, and writes the mismatches and timings to os
+		*/
+		void validate(std::ostream& os);
+
+		/** @brief Scalar reference implementations, the SIMD kernels produce bit identical results */
+		namespace reference
+		{
+			void rgb8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+			void bgr8ToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+			void swizzleRB(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+			void unorm16ToUnorm8(const uint16_t* src, uint8_t* dst, size_t valueCount);
+			void rgb16ToRgba8(const uint16_t* src, uint8_t* dst, size_t pixelCount);
+		}
+	}
+}
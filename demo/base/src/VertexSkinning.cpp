@@ -0,0 +1,274 @@
+/*
+* Linear blend skinning on the CPU
+*
+* Skins bind pose positions and normals stored as separate streams (structure of arrays) with up to four
+* joint influences per vertex, using an AVX2 kernel for eight vertices at a time when the CPU supports it
+* (selected at runtime) and scalar code otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VertexSkinning.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+// The instruction set detection is shared with the pixel conversion kernels
+#include "PixelConversion.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VERTEX_SKINNING_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+// MSVC allows intrinsics of any instruction set without enabling it for the whole translation unit
+#define SKINNING_TARGET_AVX2
+#else
+#define SKINNING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace vks
+{
+	namespace skinning
+	{
+		void VertexStreams::resize(size_t count)
+		{
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				positions[i].resize(count);
+				normals[i].resize(count);
+			}
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				joints[i].resize(count);
+				weights[i].resize(count);
+			}
+		}
+
+		namespace
+		{
+			typedef void (*LinearBlendKernel)(const VertexStreams&, size_t, size_t, const float*, float*, float*, size_t);
+
+			void writeVertex(size_t index, const float position[3], const float normal[3], float* positions, float* normals, size_t stride)
+			{
+				memcpy(reinterpret_cast<uint8_t*>(positions) + index * stride, position, sizeof(float) * 3);
+				memcpy(reinterpret_cast<uint8_t*>(normals) + index * stride, normal, sizeof(float) * 3);
+			}
+
+			void linearBlendScalar(const VertexStreams& streams, size_t first, size_t count, const float* palette, float* positions, float* normals, size_t stride)
+			{
+				for (size_t i = first; i < first + count; i++)
+				{
+					float m[paletteStride] = {};
+					for (uint32_t k = 0; k < 4; k++)
+					{
+						const float weight = streams.weights[k][i];
+						const float* joint = palette + streams.joints[k][i] * paletteStride;
+						for (uint32_t e = 0; e < paletteStride; e++)
+						{
+							m[e] += weight * joint[e];
+						}
+					}
+
+					const float px = streams.positions[0][i], py = streams.positions[1][i], pz = streams.positions[2][i];
+					const float nx = streams.normals[0][i], ny = streams.normals[1][i], nz = streams.normals[2][i];
+					float position[3], normal[3];
+					for (uint32_t r = 0; r < 3; r++)
+					{
+						const float* row = m + r * 4;
+						position[r] = row[0] * px + row[1] * py + row[2] * pz + row[3];
+						normal[r] = row[0] * nx + row[1] * ny + row[2] * nz;
+					}
+					// Degenerate normals stay zero instead of turning into NaNs
+					const float lengthSquared = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+					const float invLength = lengthSquared > 0.0f ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+					for (uint32_t r = 0; r < 3; r++)
+					{
+						normal[r] *= invLength;
+					}
+					writeVertex(i, position, normal, positions, normals, stride);
+				}
+			}
+
+#if defined(VERTEX_SKINNING_X86)
+			SKINNING_TARGET_AVX2 void linearBlendAVX2(const VertexStreams& streams, size_t first, size_t count, const float* palette, float* positions, float* normals, size_t stride)
+			{
+				const size_t end = first + count;
+				const __m256i jointStride = _mm256_set1_epi32(paletteStride);
+				size_t i = first;
+				for (; i + 8 <= end; i += 8)
+				{
+					// Blended joint matrix of eight vertices, gathered element by element
+					__m256 m[paletteStride];
+					for (uint32_t e = 0; e < paletteStride; e++)
+					{
+						m[e] = _mm256_setzero_ps();
+					}
+					for (uint32_t k = 0; k < 4; k++)
+					{
+						const __m256 weight = _mm256_loadu_ps(streams.weights[k].data() + i);
+						const __m256i joint = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(streams.joints[k].data() + i)), jointStride);
+						for (uint32_t e = 0; e < paletteStride; e++)
+						{
+							m[e] = _mm256_add_ps(m[e], _mm256_mul_ps(weight, _mm256_i32gather_ps(palette + e, joint, 4)));
+						}
+					}
+
+					const __m256 px = _mm256_loadu_ps(streams.positions[0].data() + i);
+					const __m256 py = _mm256_loadu_ps(streams.positions[1].data() + i);
+					const __m256 pz = _mm256_loadu_ps(streams.positions[2].data() + i);
+					const __m256 nx = _mm256_loadu_ps(streams.normals[0].data() + i);
+					const __m256 ny = _mm256_loadu_ps(streams.normals[1].data() + i);
+					const __m256 nz = _mm256_loadu_ps(streams.normals[2].data() + i);
+					__m256 position[3], normal[3];
+					for (uint32_t r = 0; r < 3; r++)
+					{
+						const __m256* row = m + r * 4;
+						position[r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(row[0], px), _mm256_mul_ps(row[1], py)), _mm256_mul_ps(row[2], pz)), row[3]);
+						normal[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(row[0], nx), _mm256_mul_ps(row[1], ny)), _mm256_mul_ps(row[2], nz));
+					}
+					const __m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal[0], normal[0]), _mm256_mul_ps(normal[1], normal[1])), _mm256_mul_ps(normal[2], normal[2]));
+					const __m256 nonZero = _mm256_cmp_ps(lengthSquared, _mm256_setzero_ps(), _CMP_GT_OQ);
+					const __m256 invLength = _mm256_and_ps(nonZero, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSquared)));
+
+					// The destination is interleaved, so the results are written vertex by vertex
+					alignas(32) float results[6][8];
+					for (uint32_t r = 0; r < 3; r++)
+					{
+						_mm256_store_ps(results[r], position[r]);
+						_mm256_store_ps(results[3 + r], _mm256_mul_ps(normal[r], invLength));
+					}
+					for (uint32_t v = 0; v < 8; v++)
+					{
+						const float skinnedPosition[3] = { results[0][v], results[1][v], results[2][v] };
+						const float skinnedNormal[3] = { results[3][v], results[4][v], results[5][v] };
+						writeVertex(i + v, skinnedPosition, skinnedNormal, positions, normals, stride);
+					}
+				}
+				linearBlendScalar(streams, i, end - i, palette, positions, normals, stride);
+			}
+#endif
+
+			LinearBlendKernel selectKernel(vks::pixel::InstructionSet set)
+			{
+#if defined(VERTEX_SKINNING_X86)
+				if (set == vks::pixel::InstructionSet::AVX2)
+				{
+					return linearBlendAVX2;
+				}
+#endif
+				return linearBlendScalar;
+			}
+		}
+
+		void linearBlend(const VertexStreams& streams, const float* palette, float* positions, float* normals, size_t stride)
+		{
+			static const LinearBlendKernel kernel = selectKernel(vks::pixel::instructionSet());
+			kernel(streams, 0, streams.size(), palette, positions, normals, stride);
+		}
+
+		namespace reference
+		{
+			void linearBlend(const VertexStreams& streams, const float* palette, float* positions, float* normals, size_t stride)
+			{
+				linearBlendScalar(streams, 0, streams.size(), palette, positions, normals, stride);
+			}
+		}
+
+		void benchmark(std::ostream& os, const std::vector<BenchmarkCase>& cases)
+		{
+			const uint32_t iterations = 16;
+			const LinearBlendKernel kernel = selectKernel(vks::pixel::instructionSet());
+			const bool simd = kernel != linearBlendScalar;
+
+			// Random bind pose and palette with a fixed seed, so runs stay comparable
+			const size_t syntheticVertexCount = 65536;
+			const uint32_t syntheticJointCount = 64;
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+			std::uniform_int_distribution<uint32_t> joint(0, syntheticJointCount - 1);
+			VertexStreams synthetic;
+			synthetic.resize(syntheticVertexCount);
+			for (size_t i = 0; i < syntheticVertexCount; i++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					synthetic.positions[c][i] = value(random);
+					synthetic.normals[c][i] = value(random);
+				}
+				float weightSum = 0.0f;
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					synthetic.joints[k][i] = joint(random);
+					synthetic.weights[k][i] = std::abs(value(random));
+					weightSum += synthetic.weights[k][i];
+				}
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					synthetic.weights[k][i] /= std::max(weightSum, 1e-6f);
+				}
+			}
+			std::vector<float> syntheticPalette(syntheticJointCount * paletteStride);
+			for (float& element : syntheticPalette)
+			{
+				element = value(random);
+			}
+
+			std::vector<BenchmarkCase> rows = { { "synthetic", &synthetic, syntheticPalette.data(), syntheticJointCount } };
+			rows.insert(rows.end(), cases.begin(), cases.end());
+
+			std::ios::fmtflags flags = os.flags();
+			std::streamsize precision = os.precision();
+
+			os << "cpu skinning (" << iterations << " iterations, " << (simd ? "avx2" : "scalar") << " kernel selected)" << "\n";
+			os << std::left << std::setw(24) << "mesh" << std::right << std::setw(10) << "vertices" << std::setw(8) << "joints"
+				<< std::setw(12) << "scalar ms" << std::setw(12) << "avx2 ms" << std::setw(16) << "max difference" << "\n";
+
+			for (const BenchmarkCase& row : rows)
+			{
+				// Interleaved like the model vertices: position and normal of a vertex next to each other
+				const size_t count = row.streams->size();
+				const size_t stride = 6 * sizeof(float);
+				std::vector<float> scalarOutput(count * 6), simdOutput(count * 6);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					linearBlendScalar(*row.streams, 0, count, row.palette, scalarOutput.data(), scalarOutput.data() + 3, stride);
+				}
+				const double scalarTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+				start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; simd && i < iterations; i++)
+				{
+					kernel(*row.streams, 0, count, row.palette, simdOutput.data(), simdOutput.data() + 3, stride);
+				}
+				const double simdTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+				float maxDifference = 0.0f;
+				for (size_t i = 0; simd && i < scalarOutput.size(); i++)
+				{
+					maxDifference = std::max(maxDifference, std::abs(scalarOutput[i] - simdOutput[i]));
+				}
+
+				os << std::left << std::setw(24) << row.name.substr(0, 23) << std::right << std::setw(10) << count << std::setw(8) << row.jointCount
+					<< std::fixed << std::setprecision(3) << std::setw(12) << scalarTime;
+				if (simd)
+				{
+					os << std::setw(12) << simdTime << std::setprecision(6) << std::setw(16) << maxDifference << "\n";
+				}
+				else
+				{
+					os << std::setw(12) << "-" << std::setw(16) << "-" << "\n";
+				}
+			}
+
+			os.flags(flags);
+			os.precision(precision);
+		}
+	}
+}
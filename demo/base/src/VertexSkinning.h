@@ -0,0 +1,70 @@
+/*
+* Linear blend skinning on the CPU
+*
+* Skins bind pose positions and normals stored as separate streams (structure of arrays) with up to four
+* joint influences per vertex, using an AVX2 kernel for eight vertices at a time when the CPU supports it
+* (selected at runtime) and scalar code otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vks
+{
+	namespace skinning
+	{
+		/** @brief Bind pose vertex attributes, one array per component */
+		struct VertexStreams
+		{
+			std::vector<float> positions[3];
+			std::vector<float> normals[3];
+			// Joint indices have to be smaller than the joint count of the palette the streams are skinned with
+			std::vector<uint32_t> joints[4];
+			std::vector<float> weights[4];
+
+			void resize(size_t count);
+			size_t size() const { return positions[0].size(); }
+		};
+
+		// Joint palettes hold 3x4 row major affine matrices, 12 floats per joint
+		const uint32_t paletteStride = 12;
+
+		/**
+		* @brief Transforms positions and normals by the weighted sum of the joint matrices of each vertex
+		*
+		* @param positions Receives the skinned positions (three floats each), one every stride bytes
+		* @param normals Receives the skinned and normalized normals (three floats each), one every stride bytes
+		*/
+		void linearBlend(const VertexStreams& streams, const float* palette, float* positions, float* normals, size_t stride);
+
+		/** @brief Scalar reference implementation, the SIMD kernel only differs by float rounding */
+		namespace reference
+		{
+			void linearBlend(const VertexStreams& streams, const float* palette, float* positions, float* normals, size_t stride);
+		}
+
+		/** @brief Streams and joint palette of one benchmark row */
+		struct BenchmarkCase
+		{
+			std::string name;
+			const VertexStreams* streams;
+			const float* palette;
+			uint32_t jointCount;
+		};
+
+		/**
+		* @brief Times the scalar and the runtime selected kernel and writes a table to os
+		*
+		* A synthetic mesh is always measured first, followed by the given cases. Both kernels skin the same
+		* streams, the largest difference of their outputs is reported and has to stay at float rounding
+		*/
+		void benchmark(std::ostream& os, const std::vector<BenchmarkCase>& cases);
+	}
+}
@@ -0,0 +1,200 @@
+/*
+* Bindless texture table
+*
+* One descriptor set holding a single array of combined image samplers that materials index into,
+* built on VK_EXT_descriptor_indexing (partially bound, update after bind, variable count) when available
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanBindlessTextures.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	bool BindlessTextures::enableDeviceSupport(VkInstance instance, VkPhysicalDevice physicalDevice, std::vector<const char*>& deviceExtensions, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features)
+	{
+		features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+		PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		if (!getFeatures2)
+		{
+			return false;
+		}
+
+		uint32_t extCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, extensions.data());
+		auto hasExtension = [&](const char* name)
+		{
+			return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& ext) { return strcmp(ext.extensionName, name) == 0; });
+		};
+		if (!hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) || !hasExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+		{
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+		supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &supported;
+		getFeatures2(physicalDevice, &features2);
+
+		if (!supported.runtimeDescriptorArray ||
+			!supported.descriptorBindingPartiallyBound ||
+			!supported.descriptorBindingSampledImageUpdateAfterBind ||
+			!supported.descriptorBindingVariableDescriptorCount ||
+			!supported.shaderSampledImageArrayNonUniformIndexing)
+		{
+			return false;
+		}
+
+		features.runtimeDescriptorArray = VK_TRUE;
+		features.descriptorBindingPartiallyBound = VK_TRUE;
+		features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+		deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		return true;
+	}
+
+	void BindlessTextures::create(VulkanDevice* device, uint32_t capacity, VkShaderStageFlags stageFlags, bool descriptorIndexing)
+	{
+		m_vkDevice = device;
+		m_capacity = capacity;
+		m_descriptorIndexing = descriptorIndexing;
+		m_slotCount = 0;
+		m_freeSlots.clear();
+		m_hasFallback = false;
+
+		VkDescriptorSetLayoutBinding binding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, stageFlags, 0, capacity);
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(&binding, 1);
+
+		VkDescriptorBindingFlagsEXT bindingFlags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = 1;
+		bindingFlagsInfo.pBindingFlags = &bindingFlags;
+		if (descriptorIndexing)
+		{
+			layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+			layoutInfo.pNext = &bindingFlagsInfo;
+		}
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &layoutInfo, nullptr, &layout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity)
+		};
+		VkDescriptorPoolCreateInfo poolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		if (descriptorIndexing)
+		{
+			poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		}
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &poolInfo, nullptr, &m_descriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &layout, 1);
+		VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo = {};
+		variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+		variableCountInfo.descriptorSetCount = 1;
+		variableCountInfo.pDescriptorCounts = &capacity;
+		if (descriptorIndexing)
+		{
+			allocInfo.pNext = &variableCountInfo;
+		}
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+	}
+
+	void BindlessTextures::destroy()
+	{
+		if (!m_vkDevice)
+		{
+			return;
+		}
+		vkDestroyDescriptorPool(m_vkDevice->logicalDevice, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(m_vkDevice->logicalDevice, layout, nullptr);
+		m_descriptorPool = VK_NULL_HANDLE;
+		layout = VK_NULL_HANDLE;
+		descriptorSet = VK_NULL_HANDLE;
+		m_vkDevice = nullptr;
+	}
+
+	uint32_t BindlessTextures::add(const VkDescriptorImageInfo& descriptor)
+	{
+		uint32_t slot;
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			if (m_slotCount == m_capacity)
+			{
+				vks::tools::exitFatal("Bindless texture table is full (capacity " + std::to_string(m_capacity) + ")", VK_ERROR_TOO_MANY_OBJECTS);
+			}
+			slot = m_slotCount++;
+		}
+
+		if (!m_descriptorIndexing && !m_hasFallback && descriptor.imageView != VK_NULL_HANDLE)
+		{
+			// Every element of a fully bound array must be valid, point the whole array at the first texture
+			m_fallback = descriptor;
+			m_hasFallback = true;
+			std::vector<VkDescriptorImageInfo> fallbacks(m_capacity, m_fallback);
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, fallbacks.data(), m_capacity);
+			vkUpdateDescriptorSets(m_vkDevice->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		write(slot, descriptor);
+		return slot;
+	}
+
+	void BindlessTextures::update(uint32_t slot, const VkDescriptorImageInfo& descriptor)
+	{
+		assert(slot < m_slotCount);
+		write(slot, descriptor);
+	}
+
+	void BindlessTextures::remove(uint32_t slot)
+	{
+		assert(slot < m_slotCount);
+		if (!m_descriptorIndexing)
+		{
+			write(slot, m_fallback);
+		}
+		m_freeSlots.push_back(slot);
+	}
+
+	void BindlessTextures::write(uint32_t slot, const VkDescriptorImageInfo& descriptor)
+	{
+		// Slots without an image stay unbound (partially bound) or keep the fallback
+		if (descriptor.imageView == VK_NULL_HANDLE)
+		{
+			if (!m_descriptorIndexing && m_hasFallback)
+			{
+				write(slot, m_fallback);
+			}
+			return;
+		}
+
+		VkDescriptorImageInfo imageInfo = descriptor;
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageInfo);
+		writeDescriptorSet.dstArrayElement = slot;
+		vkUpdateDescriptorSets(m_vkDevice->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+	}
+}
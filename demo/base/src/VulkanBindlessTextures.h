@@ -0,0 +1,70 @@
+/*
+* Bindless texture table
+*
+* One descriptor set holding a single array of combined image samplers that materials index into,
+* built on VK_EXT_descriptor_indexing (partially bound, update after bind, variable count) when available
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	class BindlessTextures
+	{
+	public:
+		/**
+		* Checks device support for the descriptor indexing features the table uses and requests them
+		*
+		* @param instance Instance, must have VK_KHR_get_physical_device_properties2 enabled
+		* @param deviceExtensions Receives the required device extensions if supported
+		* @param features Receives the features to enable, chain it into the device create info (e.g. deviceCreatepNextChain)
+		* @return True if the table can be created with descriptorIndexing = true
+		*/
+		static bool enableDeviceSupport(VkInstance instance, VkPhysicalDevice physicalDevice, std::vector<const char*>& deviceExtensions, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features);
+
+		/**
+		* @param capacity Size of the descriptor array, the shader array may not be larger
+		* @param descriptorIndexing The features from enableDeviceSupport were enabled. Without them the array is fully bound,
+		* unused slots point at the first texture added and slot writes must not happen while the set is in use
+		*/
+		void create(VulkanDevice* device, uint32_t capacity, VkShaderStageFlags stageFlags, bool descriptorIndexing);
+		void destroy();
+
+		/** @brief Stores the descriptor in a free slot and returns its index, a descriptor without image view only reserves the slot */
+		uint32_t add(const VkDescriptorImageInfo& descriptor);
+		/** @brief Points a slot at another image, e.g. a streamed texture that was recreated */
+		void update(uint32_t slot, const VkDescriptorImageInfo& descriptor);
+		/** @brief Returns the slot to the free list, the caller makes sure the GPU no longer samples it */
+		void remove(uint32_t slot);
+
+		/** @brief Slot writes are allowed while command buffers binding the set are recorded or pending */
+		bool updateAfterBind() const { return m_descriptorIndexing; }
+		uint32_t capacity() const { return m_capacity; }
+		uint32_t size() const { return m_slotCount - static_cast<uint32_t>(m_freeSlots.size()); }
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	private:
+		void write(uint32_t slot, const VkDescriptorImageInfo& descriptor);
+	private:
+		VulkanDevice* m_vkDevice = nullptr;
+		VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+		uint32_t m_capacity = 0;
+		bool m_descriptorIndexing = false;
+
+		// Slots [0, m_slotCount) were handed out at some point, freed ones are reused first
+		uint32_t m_slotCount = 0;
+		std::vector<uint32_t> m_freeSlots;
+
+		// Written to every unused slot when the array has to be fully bound
+		VkDescriptorImageInfo m_fallback = {};
+		bool m_hasFallback = false;
+	};
+}
@@ -9,6 +9,7 @@
 */
 
 #include "VulkanBuffer.h"
+#include "VulkanMemoryTracker.h"
 
 namespace vks
 {	
@@ -129,6 +130,10 @@ namespace vks
 		}
 		if (memory)
 		{
+			if (memoryTracker)
+			{
+				memoryTracker->onFree(memory);
+			}
 			vkFreeMemory(device, memory, nullptr);
 		}
 	}
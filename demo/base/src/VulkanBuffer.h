@@ -17,6 +17,8 @@
 
 namespace vks
 {	
+	class MemoryTracker;
+
 	/**
 	* @brief Encapsulates access to a Vulkan buffer backed up by device memory
 	* @note To be filled by an external source like the VulkanDevice
@@ -34,6 +36,8 @@ namespace vks
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
+		/** @brief Tracker the memory was accounted to (set by the VulkanDevice), released on destroy */
+		MemoryTracker* memoryTracker = nullptr;
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
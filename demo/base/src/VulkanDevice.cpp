@@ -37,6 +37,8 @@ namespace vks
 		queueFamilyProperties.resize(queueFamilyCount);
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
 
+		memoryTracker.init(physicalDevice, memoryProperties);
+
 		// Get list of supported extensions
 		uint32_t extCount = 0;
 		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
@@ -271,6 +273,13 @@ namespace vks
 			enableDebugMarkers = true;
 		}
 
+		// Enable the memory budget extension if it is present, so allocations can be reported against the heap budgets
+		if (extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+		{
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			enableMemoryBudget = true;
+		}
+
 		if (deviceExtensions.size() > 0)
 		{
 			for (const char* enabledExtension : deviceExtensions)
@@ -331,7 +340,7 @@ namespace vks
 			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
 			memAlloc.pNext = &allocFlagsInfo;
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
+		VK_CHECK_RESULT(allocateMemory(&memAlloc, memory, MemoryTracker::bufferCategory(usageFlags, memoryPropertyFlags)));
 			
 		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
 		if (data != nullptr)
@@ -365,15 +374,25 @@ namespace vks
 	* @param buffer Pointer to a vk::Vulkan buffer object
 	* @param size Size of the buffer in bytes
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param queueFamilies Queue families that access the buffer (optional, with more than one distinct family the buffer is created concurrent)
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data, const std::vector<uint32_t> &queueFamilies)
 	{
 		buffer->device = logicalDevice;
 
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		std::vector<uint32_t> sharedFamilies = queueFamilies;
+		std::sort(sharedFamilies.begin(), sharedFamilies.end());
+		sharedFamilies.erase(std::unique(sharedFamilies.begin(), sharedFamilies.end()), sharedFamilies.end());
+		if (sharedFamilies.size() > 1)
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+			bufferCreateInfo.pQueueFamilyIndices = sharedFamilies.data();
+		}
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
 		// Create the memory backing up the buffer handle
@@ -390,7 +409,8 @@ namespace vks
 			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
 			memAlloc.pNext = &allocFlagsInfo;
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		VK_CHECK_RESULT(allocateMemory(&memAlloc, &buffer->memory, MemoryTracker::bufferCategory(usageFlags, memoryPropertyFlags)));
+		buffer->memoryTracker = &memoryTracker;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -415,6 +435,34 @@ namespace vks
 		return buffer->bind();
 	}
 
+	/**
+	* Allocate device memory and account it to the memory tracker
+	*
+	* @param allocateInfo Allocation info (size and memory type)
+	* @param memory Pointer to the memory handle acquired by the function
+	* @param category Owner category the allocation is reported under
+	*
+	* @return VkResult of the allocation
+	*/
+	VkResult VulkanDevice::allocateMemory(const VkMemoryAllocateInfo *allocateInfo, VkDeviceMemory *memory, MemoryCategory category)
+	{
+		VkResult result = vkAllocateMemory(logicalDevice, allocateInfo, nullptr, memory);
+		if (result == VK_SUCCESS)
+		{
+			memoryTracker.onAllocate(*memory, allocateInfo->allocationSize, allocateInfo->memoryTypeIndex, category);
+		}
+		return result;
+	}
+
+	/**
+	* Free device memory allocated with allocateMemory
+	*/
+	void VulkanDevice::freeMemory(VkDeviceMemory memory)
+	{
+		memoryTracker.onFree(memory);
+		vkFreeMemory(logicalDevice, memory, nullptr);
+	}
+
 	/**
 	* Copy buffer data from src to dst using VkCmdCopyBuffer
 	* 
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanMemoryTracker.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
@@ -41,6 +42,10 @@ struct VulkanDevice
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	/** @brief Set to true when the debug marker extension is detected */
 	bool enableDebugMarkers = false;
+	/** @brief Set to true when the memory budget extension is detected and enabled */
+	bool enableMemoryBudget = false;
+	/** @brief Live and peak totals of all device memory allocated through this device */
+	MemoryTracker memoryTracker;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -58,7 +63,9 @@ struct VulkanDevice
 	uint32_t        getQueueFamilyIndex(VkQueueFlagBits queueFlags) const;
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr, const std::vector<uint32_t> &queueFamilies = {});
+	VkResult        allocateMemory(const VkMemoryAllocateInfo *allocateInfo, VkDeviceMemory *memory, MemoryCategory category);
+	void            freeMemory(VkDeviceMemory memory);
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
@@ -0,0 +1,437 @@
+/*
+* Single pass downsampler
+*
+* Builds a mip chain (min, max or average reduction) of an image in one compute dispatch, without barriers between
+* the levels. Workgroups reduce 64x64 tiles through shared memory, the last workgroup reduces the rest of the chain.
+* Includes a CPU reference of the reductions to check the results against
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDownsampler.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	Downsampler::Downsampler(vks::VulkanDevice* device, VkQueue queue, VkPipelineCache pipelineCache, const std::string& shadersPath, VkFormat format, Reduction reduction)
+		: m_device(device), m_queue(queue)
+	{
+		std::string shaderFile;
+		switch (format)
+		{
+		case VK_FORMAT_R32_SFLOAT:
+			shaderFile = shadersPath + "base/downsampler_r32f.comp.spv";
+			break;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			shaderFile = shadersPath + "base/downsampler_rgba16f.comp.spv";
+			break;
+		default:
+			vks::tools::exitFatal("Downsampler: unsupported level format", -1);
+			return;
+		}
+
+		// The levels are written through a fixed size array of storage images
+		if (device->properties.limits.maxPerStageDescriptorStorageImages < maxLevels)
+		{
+			vks::tools::exitFatal("Downsampler: the device supports too few storage images per stage", -1);
+			return;
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, maxLevels),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &m_descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&m_descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+		const uint32_t reductionConstant = static_cast<uint32_t>(reduction);
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &reductionConstant);
+
+		VkPipelineShaderStageCreateInfo shaderStage = {};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+		shaderStage.pName = "main";
+		shaderStage.pSpecializationInfo = &specializationInfo;
+		assert(shaderStage.module != VK_NULL_HANDLE);
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(m_pipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_pipeline));
+		vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxLevels),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &m_descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &m_descriptorSet));
+	}
+
+	Downsampler::~Downsampler()
+	{
+		VkDevice device = m_device->logicalDevice;
+		vkDestroyPipeline(device, m_pipeline, nullptr);
+		vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+		vkDestroyBuffer(device, m_tailBuffer, nullptr);
+		m_device->freeMemory(m_tailMemory);
+	}
+
+	void Downsampler::setChain(VkImageView source, VkSampler sampler, VkImageLayout sourceLayout, const VkImageView* levelViews, uint32_t levelCount, uint32_t width, uint32_t height, bool copySource)
+	{
+		assert(levelCount <= maxLevels && width < 8192 && height < 8192);
+		assert(!copySource || levelViews[0] != VK_NULL_HANDLE);
+
+		m_levelCount = levelCount;
+		m_pushConstants.size[0] = width;
+		m_pushConstants.size[1] = height;
+		m_pushConstants.levelCount = levelCount;
+		m_pushConstants.copySource = copySource ? 1 : 0;
+		m_pushConstants.tileCount[0] = levelSize(width, 6);
+		m_pushConstants.tileCount[1] = levelSize(height, 6);
+
+		// Counter padded to the alignment of the vec4 array
+		const VkDeviceSize tailSize = 16 + 16 * m_pushConstants.tileCount[0] * m_pushConstants.tileCount[1];
+		if (tailSize > m_tailSize)
+		{
+			vkDestroyBuffer(m_device->logicalDevice, m_tailBuffer, nullptr);
+			m_device->freeMemory(m_tailMemory);
+			VK_CHECK_RESULT(m_device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, tailSize, &m_tailBuffer, &m_tailMemory));
+			m_tailSize = tailSize;
+
+			// The shader resets the counter at the end of each dispatch, it only has to start at 0
+			VkCommandBuffer commandBuffer = m_device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vkCmdFillBuffer(commandBuffer, m_tailBuffer, 0, VK_WHOLE_SIZE, 0);
+			m_device->flushCommandBuffer(commandBuffer, m_queue, true);
+		}
+
+		// Unused array elements still need valid descriptors
+		VkImageView fallbackView = VK_NULL_HANDLE;
+		for (uint32_t i = 0; i < levelCount && fallbackView == VK_NULL_HANDLE; i++)
+		{
+			fallbackView = levelViews[i];
+		}
+		std::vector<VkDescriptorImageInfo> levelDescriptors(maxLevels);
+		for (uint32_t i = 0; i < maxLevels; i++)
+		{
+			const VkImageView view = (i < levelCount && levelViews[i] != VK_NULL_HANDLE) ? levelViews[i] : fallbackView;
+			levelDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+		VkDescriptorImageInfo sourceDescriptor = vks::initializers::descriptorImageInfo(sampler, source, sourceLayout);
+		VkDescriptorBufferInfo tailDescriptor = { m_tailBuffer, 0, VK_WHOLE_SIZE };
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, levelDescriptors.data(), maxLevels),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &tailDescriptor),
+		};
+		vkUpdateDescriptorSets(m_device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void Downsampler::record(VkCommandBuffer commandBuffer) const
+	{
+		if (m_levelCount < 2)
+		{
+			return;
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &m_pushConstants);
+		vkCmdDispatch(commandBuffer, m_pushConstants.tileCount[0], m_pushConstants.tileCount[1], 1);
+	}
+
+	void Downsampler::reduceLevel(Reduction reduction, const float* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t channels, float* dst)
+	{
+		const uint32_t width = levelSize(srcWidth, 1);
+		const uint32_t height = levelSize(srcHeight, 1);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint32_t endY = (y == height - 1) ? srcHeight - 1 : 2 * y + 1;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint32_t endX = (x == width - 1) ? srcWidth - 1 : 2 * x + 1;
+				float* texel = dst + (y * width + x) * channels;
+				for (uint32_t c = 0; c < channels; c++)
+				{
+					float value = (reduction == Reduction::Min) ? FLT_MAX : (reduction == Reduction::Max) ? -FLT_MAX : 0.0f;
+					for (uint32_t sy = 2 * y; sy <= endY; sy++)
+					{
+						for (uint32_t sx = 2 * x; sx <= endX; sx++)
+						{
+							const float s = src[(sy * srcWidth + sx) * channels + c];
+							switch (reduction)
+							{
+							case Reduction::Min:
+								value = std::min(value, s);
+								break;
+							case Reduction::Max:
+								value = std::max(value, s);
+								break;
+							default:
+								value += s;
+								break;
+							}
+						}
+					}
+					if (reduction == Reduction::Average)
+					{
+						value /= static_cast<float>((endX - 2 * x + 1) * (endY - 2 * y + 1));
+					}
+					texel[c] = value;
+				}
+			}
+		}
+	}
+
+	std::vector<std::vector<float>> Downsampler::reduceChain(Reduction reduction, const float* src, uint32_t width, uint32_t height, uint32_t channels, uint32_t levelCount)
+	{
+		std::vector<std::vector<float>> levels(levelCount);
+		levels[0].assign(src, src + width * height * channels);
+		for (uint32_t level = 1; level < levelCount; level++)
+		{
+			levels[level].resize(levelSize(width, level) * levelSize(height, level) * channels);
+			reduceLevel(reduction, levels[level - 1].data(), levelSize(width, level - 1), levelSize(height, level - 1), channels, levels[level].data());
+		}
+		return levels;
+	}
+	void Downsampler::validate(std::ostream& os, vks::VulkanDevice* device, VkQueue queue, VkPipelineCache pipelineCache, const std::string& shadersPath)
+	{
+		struct Size
+		{
+			uint32_t width;
+			uint32_t height;
+		};
+		// Power of two, odd, non power of two and one texel wide sources
+		const std::vector<Size> sizes = { { 64, 64 }, { 37, 23 }, { 1000, 600 }, { 1, 97 }, { 4097, 3 } };
+		const std::vector<Reduction> reductions = { Reduction::Min, Reduction::Max, Reduction::Average };
+		const char* reductionNames[] = { "average", "min", "max" };
+		// Min and max select texels, averages may only differ by the summation order
+		const float tolerance = 1e-3f;
+
+		VkDevice logicalDevice = device->logicalDevice;
+		const bool timestamps = device->properties.limits.timestampComputeAndGraphics == VK_TRUE;
+
+		// The shader fetches texels, the filter doesn't matter
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = 1.0f;
+		samplerInfo.maxAnisotropy = 1.0f;
+		VkSampler sampler;
+		VK_CHECK_RESULT(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &sampler));
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		VkQueryPool queryPool;
+		VK_CHECK_RESULT(vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &queryPool));
+
+		std::mt19937 generator(1);
+		std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+
+		std::ios::fmtflags flags = os.flags();
+		std::streamsize precision = os.precision();
+
+		os << "single pass downsampler (gpu chain vs reduceChain, r32f)" << "\n";
+		os << std::setw(10) << "reduction" << std::setw(12) << "size" << std::setw(8) << "levels" << std::setw(10) << "gpu ms"
+			<< std::setw(16) << "max difference" << std::setw(10) << "result" << "\n";
+
+		uint32_t failures = 0;
+		for (Reduction reduction : reductions)
+		{
+			Downsampler downsampler(device, queue, pipelineCache, shadersPath, VK_FORMAT_R32_SFLOAT, reduction);
+
+			for (const Size& size : sizes)
+			{
+				const uint32_t levelCount = std::min(maxLevels, static_cast<uint32_t>(std::log2(std::max(size.width, size.height))) + 1);
+
+				std::vector<float> source(size.width * size.height);
+				for (float& value : source)
+				{
+					value = distribution(generator);
+				}
+
+				VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.format = VK_FORMAT_R32_SFLOAT;
+				imageInfo.extent = { size.width, size.height, 1 };
+				imageInfo.mipLevels = levelCount;
+				imageInfo.arrayLayers = 1;
+				imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				VkImage image;
+				VK_CHECK_RESULT(vkCreateImage(logicalDevice, &imageInfo, nullptr, &image));
+
+				VkMemoryRequirements memReqs;
+				vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.allocationSize = memReqs.size;
+				memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VkDeviceMemory imageMemory;
+				VK_CHECK_RESULT(device->allocateMemory(&memAlloc, &imageMemory, MemoryCategory::Other));
+				VK_CHECK_RESULT(vkBindImageMemory(logicalDevice, image, imageMemory, 0));
+
+				std::vector<VkImageView> views(levelCount);
+				VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+				viewInfo.image = image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = VK_FORMAT_R32_SFLOAT;
+				viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				for (uint32_t level = 0; level < levelCount; level++)
+				{
+					viewInfo.subresourceRange.baseMipLevel = level;
+					VK_CHECK_RESULT(vkCreateImageView(logicalDevice, &viewInfo, nullptr, &views[level]));
+				}
+
+				// One host buffer for the upload of level 0 and the readback of all levels
+				std::vector<VkBufferImageCopy> regions(levelCount);
+				VkDeviceSize bufferSize = 0;
+				for (uint32_t level = 0; level < levelCount; level++)
+				{
+					regions[level] = {};
+					regions[level].bufferOffset = bufferSize;
+					regions[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+					regions[level].imageExtent = { levelSize(size.width, level), levelSize(size.height, level), 1 };
+					bufferSize += levelSize(size.width, level) * levelSize(size.height, level) * sizeof(float);
+				}
+				VkBuffer buffer;
+				VkDeviceMemory bufferMemory;
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					bufferSize, &buffer, &bufferMemory));
+				void* mapped;
+				VK_CHECK_RESULT(vkMapMemory(logicalDevice, bufferMemory, 0, VK_WHOLE_SIZE, 0, &mapped));
+				memcpy(mapped, source.data(), source.size() * sizeof(float));
+
+				downsampler.setChain(views[0], sampler, VK_IMAGE_LAYOUT_GENERAL, views.data(), levelCount, size.width, size.height);
+
+				VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+				VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+				imageBarrier.image = image;
+				imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+				imageBarrier.srcAccessMask = 0;
+				imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+				vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &regions[0]);
+
+				imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+				if (timestamps)
+				{
+					vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+				}
+				downsampler.record(commandBuffer);
+				if (timestamps)
+				{
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+				}
+
+				imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+				vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, levelCount, regions.data());
+
+				VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+				bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+				bufferBarrier.buffer = buffer;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+				device->flushCommandBuffer(commandBuffer, queue, true);
+
+				double gpuTime = 0.0;
+				if (timestamps)
+				{
+					uint64_t ticks[2];
+					VK_CHECK_RESULT(vkGetQueryPoolResults(logicalDevice, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+					gpuTime = (ticks[1] - ticks[0]) * device->properties.limits.timestampPeriod * 1e-6;
+				}
+
+				// Level 0 is the uploaded source
+				const std::vector<std::vector<float>> reference = reduceChain(reduction, source.data(), size.width, size.height, 1, levelCount);
+				float maxDifference = 0.0f;
+				for (uint32_t level = 1; level < levelCount; level++)
+				{
+					const float* texels = reinterpret_cast<const float*>(static_cast<const uint8_t*>(mapped) + regions[level].bufferOffset);
+					for (size_t i = 0; i < reference[level].size(); i++)
+					{
+						maxDifference = std::max(maxDifference, std::abs(texels[i] - reference[level][i]));
+					}
+				}
+				const bool match = maxDifference <= tolerance;
+				if (!match)
+				{
+					failures++;
+				}
+
+				const std::string sizeName = std::to_string(size.width) + "x" + std::to_string(size.height);
+				os << std::setw(10) << reductionNames[static_cast<uint32_t>(reduction)] << std::setw(12) << sizeName << std::setw(8) << levelCount;
+				if (timestamps)
+				{
+					os << std::fixed << std::setprecision(3) << std::setw(10) << gpuTime;
+				}
+				else
+				{
+					os << std::setw(10) << "-";
+				}
+				os << std::scientific << std::setprecision(2) << std::setw(16) << maxDifference << std::setw(10) << (match ? "match" : "MISMATCH") << "\n";
+
+				vkUnmapMemory(logicalDevice, bufferMemory);
+				vkDestroyBuffer(logicalDevice, buffer, nullptr);
+				device->freeMemory(bufferMemory);
+				for (VkImageView view : views)
+				{
+					vkDestroyImageView(logicalDevice, view, nullptr);
+				}
+				vkDestroyImage(logicalDevice, image, nullptr);
+				device->freeMemory(imageMemory);
+			}
+		}
+		os << (failures == 0 ? "all chains match the reference" : "chains differ from the reference") << "\n";
+
+		os.flags(flags);
+		os.precision(precision);
+
+		vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
+		vkDestroySampler(logicalDevice, sampler, nullptr);
+	}
+}
@@ -0,0 +1,100 @@
+/*
+* Single pass downsampler
+*
+* Builds a mip chain (min, max or average reduction) of an image in one compute dispatch, without barriers between
+* the levels. Workgroups reduce 64x64 tiles through shared memory, the last workgroup reduces the rest of the chain.
+* Includes a CPU reference of the reductions to check the results against
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	class Downsampler
+	{
+	public:
+		enum class Reduction : uint32_t
+		{
+			Average = 0,
+			Min = 1,
+			Max = 2
+		};
+
+		// Levels a chain may have including level 0, the size of level 0 has to be below 8192
+		static const uint32_t maxLevels = 13;
+		static const uint32_t tileSize = 64;
+
+		/**
+		* @param shadersPath Shaders root, the shader is loaded from base/
+		* @param format Format of the level views, VK_FORMAT_R32_SFLOAT or VK_FORMAT_R16G16B16A16_SFLOAT
+		*/
+		Downsampler(vks::VulkanDevice* device, VkQueue queue, VkPipelineCache pipelineCache, const std::string& shadersPath, VkFormat format, Reduction reduction);
+		~Downsampler();
+
+		/**
+		* Sets the chain to build, call again after the images were recreated
+		*
+		* @param source View of level 0 that is read, with the layout it has during the dispatch
+		* @param levelViews Storage views of the levels 0 to levelCount - 1, written in VK_IMAGE_LAYOUT_GENERAL, level 0 can be VK_NULL_HANDLE unless copySource is set
+		* @param copySource Also copies the source to level 0, e.g. when the source is a depth buffer that can't be a storage image
+		*/
+		void setChain(VkImageView source, VkSampler sampler, VkImageLayout sourceLayout, const VkImageView* levelViews, uint32_t levelCount, uint32_t width, uint32_t height, bool copySource = false);
+		/** @brief Records the dispatch, the caller synchronizes the reads of the source and the writes to the levels */
+		void record(VkCommandBuffer commandBuffer) const;
+
+		uint32_t levelCount() const { return m_levelCount; }
+
+		static uint32_t levelSize(uint32_t size, uint32_t level) { return std::max(size >> level, 1u); }
+		/**
+		* CPU reference of one level with the footprint the shader uses, texel p covers texels 2p and 2p + 1 of the
+		* level above and the last texel of an odd sized level above goes to the last texel
+		*
+		* @param src Texels of the level above, channels floats per texel in row order
+		* @param dst Receives levelSize(srcWidth, 1) * levelSize(srcHeight, 1) texels
+		*/
+		static void reduceLevel(Reduction reduction, const float* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t channels, float* dst);
+		/** @brief CPU reference of a whole chain, element 0 is a copy of the source */
+		static std::vector<std::vector<float>> reduceChain(Reduction reduction, const float* src, uint32_t width, uint32_t height, uint32_t channels, uint32_t levelCount);
+		/**
+		* Builds min, max and average chains of random R32_SFLOAT images on the GPU, including odd and non power of two
+		* sizes, reads all levels back and writes their difference to reduceChain and the dispatch time to os
+		*/
+		static void validate(std::ostream& os, vks::VulkanDevice* device, VkQueue queue, VkPipelineCache pipelineCache, const std::string& shadersPath);
+	private:
+		struct PushConstants
+		{
+			uint32_t size[2];
+			uint32_t levelCount;
+			uint32_t copySource;
+			uint32_t tileCount[2];
+		};
+
+		vks::VulkanDevice* m_device;
+		VkQueue m_queue;
+
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_pipeline = VK_NULL_HANDLE;
+		VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+		// Counter of finished workgroups and the level 6 texels of all tiles
+		VkBuffer m_tailBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_tailMemory = VK_NULL_HANDLE;
+		VkDeviceSize m_tailSize = 0;
+
+		PushConstants m_pushConstants = {};
+		uint32_t m_levelCount = 0;
+	};
+}
@@ -121,7 +121,7 @@ namespace vks
 				if (!attachment.weakRef) {
 					vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, nullptr);
 					vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
-					vkFreeMemory(vulkanDevice->logicalDevice, attachment.memory, nullptr);
+					vulkanDevice->freeMemory(attachment.memory);
 				}
 			}
 			vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
@@ -140,7 +140,7 @@ namespace vks
 				if (!attachment.weakRef) {
 					vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, nullptr);
 					vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
-					vkFreeMemory(vulkanDevice->logicalDevice, attachment.memory, nullptr);
+					vulkanDevice->freeMemory(attachment.memory);
 				}
 			}
 			attachments.clear();
@@ -208,7 +208,7 @@ namespace vks
 			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, attachment.image, &memReqs);
 			memAlloc.allocationSize = memReqs.size;
 			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &attachment.memory));
+			VK_CHECK_RESULT(vulkanDevice->allocateMemory(&memAlloc, &attachment.memory, vks::MemoryCategory::RenderTarget));
 			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, attachment.image, attachment.memory, 0));
 
 			attachment.subresourceRange = {};
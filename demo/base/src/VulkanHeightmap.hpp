@@ -251,9 +251,9 @@ namespace vks
 			device->flushCommandBuffer(copyCmd, copyQueue, true);
 
 			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
+			device->freeMemory(vertexStaging.memory);
 			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+			device->freeMemory(indexStaging.memory);
 		}
 	};
 }
@@ -0,0 +1,220 @@
+/*
+* Vulkan device memory tracker
+*
+* Tags device memory allocations with a category and keeps live / peak totals,
+* optionally reported against the heap budgets of VK_EXT_memory_budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryTracker.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace vks
+{
+	void MemoryTracker::init(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& memoryProperties)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_physicalDevice = physicalDevice;
+		m_memoryProperties = memoryProperties;
+
+		m_heaps.resize(memoryProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			m_heaps[i].size = memoryProperties.memoryHeaps[i].size;
+			m_heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		}
+	}
+
+	void MemoryTracker::enableBudget(PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2)
+	{
+		m_getMemoryProperties2 = getMemoryProperties2;
+		updateBudget();
+	}
+
+	void MemoryTracker::add(Usage& usage, VkDeviceSize size)
+	{
+		usage.live += size;
+		usage.peak = std::max(usage.peak, usage.live);
+		usage.allocationCount++;
+	}
+
+	void MemoryTracker::remove(Usage& usage, VkDeviceSize size)
+	{
+		usage.live -= size;
+		usage.allocationCount--;
+	}
+
+	/**
+	* Register a new device memory allocation
+	*
+	* @param memory Handle of the allocation
+	* @param size Size of the allocation in bytes
+	* @param memoryTypeIndex Memory type the allocation was made from (used to find the heap)
+	* @param category Owner category the allocation is accounted to
+	*/
+	void MemoryTracker::onAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Allocation allocation;
+		allocation.size = size;
+		allocation.heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		allocation.category = category;
+		m_allocations[memory] = allocation;
+
+		add(m_categories[static_cast<uint32_t>(category)], size);
+		add(m_total, size);
+		if (allocation.heapIndex < m_heaps.size())
+		{
+			add(m_heaps[allocation.heapIndex].tracked, size);
+		}
+	}
+
+	/**
+	* Unregister a device memory allocation, allocations not made through the tracker are ignored
+	*/
+	void MemoryTracker::onFree(VkDeviceMemory memory)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_allocations.find(memory);
+		if (it == m_allocations.end())
+		{
+			return;
+		}
+		const Allocation& allocation = it->second;
+		remove(m_categories[static_cast<uint32_t>(allocation.category)], allocation.size);
+		remove(m_total, allocation.size);
+		if (allocation.heapIndex < m_heaps.size())
+		{
+			remove(m_heaps[allocation.heapIndex].tracked, allocation.size);
+		}
+		m_allocations.erase(it);
+	}
+
+	void MemoryTracker::updateBudget()
+	{
+		if (!m_getMemoryProperties2)
+		{
+			return;
+		}
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		m_getMemoryProperties2(m_physicalDevice, &memoryProperties2);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (uint32_t i = 0; i < m_heaps.size(); i++)
+		{
+			m_heaps[i].budget = budgetProperties.heapBudget[i];
+			m_heaps[i].usage = budgetProperties.heapUsage[i];
+		}
+	}
+
+	MemoryTracker::Usage MemoryTracker::getUsage(MemoryCategory category) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_categories[static_cast<uint32_t>(category)];
+	}
+
+	MemoryTracker::Usage MemoryTracker::getTotal() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_total;
+	}
+
+	std::vector<MemoryTracker::Heap> MemoryTracker::getHeaps() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_heaps;
+	}
+
+	void MemoryTracker::report(std::ostream& os) const
+	{
+		const double MiB = 1.0 / (1024.0 * 1024.0);
+
+		std::ios::fmtflags flags = os.flags();
+		std::streamsize precision = os.precision();
+		os << std::fixed << std::setprecision(2);
+
+		os << "device memory (MiB)" << "\n";
+		os << std::left << std::setw(16) << "category" << std::right << std::setw(12) << "live" << std::setw(12) << "peak" << std::setw(10) << "allocs" << "\n";
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++)
+		{
+			Usage usage = getUsage(static_cast<MemoryCategory>(i));
+			os << std::left << std::setw(16) << categoryName(static_cast<MemoryCategory>(i)) << std::right
+				<< std::setw(12) << usage.live * MiB << std::setw(12) << usage.peak * MiB << std::setw(10) << usage.allocationCount << "\n";
+		}
+		Usage total = getTotal();
+		os << std::left << std::setw(16) << "total" << std::right
+			<< std::setw(12) << total.live * MiB << std::setw(12) << total.peak * MiB << std::setw(10) << total.allocationCount << "\n";
+
+		std::vector<Heap> heaps = getHeaps();
+		for (uint32_t i = 0; i < heaps.size(); i++)
+		{
+			os << "heap " << i << (heaps[i].deviceLocal ? " (device local)" : " (host)") << ": tracked " << heaps[i].tracked.live * MiB << " / peak " << heaps[i].tracked.peak * MiB;
+			if (budgetAvailable())
+			{
+				os << ", process usage " << heaps[i].usage * MiB << " of budget " << heaps[i].budget * MiB;
+			}
+			os << ", heap size " << heaps[i].size * MiB << "\n";
+		}
+
+		os.flags(flags);
+		os.precision(precision);
+	}
+
+	const char* MemoryTracker::categoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MemoryCategory::Geometry: return "geometry";
+		case MemoryCategory::Texture: return "texture";
+		case MemoryCategory::RenderTarget: return "render target";
+		case MemoryCategory::Staging: return "staging";
+		case MemoryCategory::Uniform: return "uniform";
+		case MemoryCategory::Storage: return "storage";
+		default: return "other";
+		}
+	}
+
+	/**
+	* Derive the category of a buffer allocation from its usage
+	*/
+	MemoryCategory MemoryTracker::bufferCategory(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags)
+	{
+		if (usageFlags & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT))
+		{
+			return MemoryCategory::Uniform;
+		}
+		if (usageFlags & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+		{
+			return MemoryCategory::Geometry;
+		}
+		if (usageFlags & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT))
+		{
+			return MemoryCategory::Storage;
+		}
+		if ((usageFlags & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		{
+			return MemoryCategory::Staging;
+		}
+		return MemoryCategory::Other;
+	}
+
+	/**
+	* Derive the category of an image allocation from its usage
+	*/
+	MemoryCategory MemoryTracker::imageCategory(VkImageUsageFlags usageFlags)
+	{
+		if (usageFlags & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT))
+		{
+			return MemoryCategory::RenderTarget;
+		}
+		return MemoryCategory::Texture;
+	}
+}
@@ -0,0 +1,96 @@
+/*
+* Vulkan device memory tracker
+*
+* Tags device memory allocations with a category and keeps live / peak totals,
+* optionally reported against the heap budgets of VK_EXT_memory_budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	enum class MemoryCategory
+	{
+		Geometry = 0,
+		Texture,
+		RenderTarget,
+		Staging,
+		Uniform,
+		Storage,
+		Other,
+		Count
+	};
+
+	class MemoryTracker
+	{
+	public:
+		struct Usage
+		{
+			VkDeviceSize live = 0;
+			VkDeviceSize peak = 0;
+			uint32_t allocationCount = 0;
+		};
+
+		struct Heap
+		{
+			VkDeviceSize size = 0;
+			bool deviceLocal = false;
+			/** @brief Allocations made through the tracker */
+			Usage tracked;
+			/** @brief Process wide usage and budget as reported by VK_EXT_memory_budget (0 if not available) */
+			VkDeviceSize budget = 0;
+			VkDeviceSize usage = 0;
+		};
+
+		void init(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& memoryProperties);
+		/** @brief Enables budget queries, requires VK_EXT_memory_budget on the device and vkGetPhysicalDeviceMemoryProperties2(KHR) */
+		void enableBudget(PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2);
+		bool budgetAvailable() const { return m_getMemoryProperties2 != nullptr; }
+
+		void onAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category);
+		void onFree(VkDeviceMemory memory);
+
+		/** @brief Refreshes the per heap budget and usage from VK_EXT_memory_budget */
+		void updateBudget();
+
+		Usage getUsage(MemoryCategory category) const;
+		Usage getTotal() const;
+		std::vector<Heap> getHeaps() const;
+
+		void report(std::ostream& os) const;
+
+		static const char* categoryName(MemoryCategory category);
+		static MemoryCategory bufferCategory(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags);
+		static MemoryCategory imageCategory(VkImageUsageFlags usageFlags);
+	private:
+		struct Allocation
+		{
+			VkDeviceSize size;
+			uint32_t heapIndex;
+			MemoryCategory category;
+		};
+
+		static void add(Usage& usage, VkDeviceSize size);
+		static void remove(Usage& usage, VkDeviceSize size);
+
+		VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_getMemoryProperties2 = nullptr;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+		Usage m_categories[static_cast<uint32_t>(MemoryCategory::Count)];
+		Usage m_total;
+		std::vector<Heap> m_heaps;
+	};
+}
@@ -0,0 +1,695 @@
+/*
+* Render graph
+*
+* Frame graph of render passes that declare the images they read and write. Compiling the graph culls passes
+* whose results are never used, creates the render passes and framebuffers, derives the layout transitions and
+* barriers between passes and places transient images with non overlapping lifetimes in the same memory
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vks
+{
+	namespace
+	{
+		const VkAccessFlags writeAccessMask =
+			VK_ACCESS_SHADER_WRITE_BIT |
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_TRANSFER_WRITE_BIT |
+			VK_ACCESS_HOST_WRITE_BIT |
+			VK_ACCESS_MEMORY_WRITE_BIT;
+
+		bool hasDepth(VkFormat format)
+		{
+			return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+				format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+		}
+
+		bool hasStencil(VkFormat format)
+		{
+			return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+				format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+		}
+
+		VkImageUsageFlags layoutUsage(VkImageLayout layout)
+		{
+			switch (layout)
+			{
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+				return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+				return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+				return VK_IMAGE_USAGE_SAMPLED_BIT;
+			case VK_IMAGE_LAYOUT_GENERAL:
+				return VK_IMAGE_USAGE_STORAGE_BIT;
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+				return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+				return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			default:
+				return 0;
+			}
+		}
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	RenderGraph::RenderGraph(vks::VulkanDevice* device, uint32_t width, uint32_t height)
+		: m_device(device), m_width(width), m_height(height)
+	{
+		assert(device);
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		destroyImages();
+		for (Pass& pass : m_passes)
+		{
+			if (pass.renderPass != VK_NULL_HANDLE)
+			{
+				vkDestroyRenderPass(m_device->logicalDevice, pass.renderPass, nullptr);
+			}
+		}
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+	{
+		assert(!m_compiled);
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		m_resources.push_back(resource);
+		return static_cast<ResourceHandle>(m_resources.size() - 1);
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, const ImageDesc& desc, VkImage image, VkImageView view)
+	{
+		const ResourceHandle handle = createImage(name, desc);
+		m_resources[handle].imported = true;
+		m_resources[handle].image = image;
+		m_resources[handle].view = view;
+		return handle;
+	}
+
+	void RenderGraph::updateImport(ResourceHandle resource, VkImage image, VkImageView view)
+	{
+		assert(m_resources[resource].imported);
+		m_resources[resource].image = image;
+		m_resources[resource].view = view;
+	}
+
+	RenderGraph::PassHandle RenderGraph::addPass(const std::string& name, RecordFunction record)
+	{
+		assert(!m_compiled);
+		Pass pass;
+		pass.name = name;
+		pass.record = record;
+		m_passes.push_back(pass);
+		return static_cast<PassHandle>(m_passes.size() - 1);
+	}
+
+	void RenderGraph::addUsage(PassHandle pass, const Usage& usage)
+	{
+		assert(!m_compiled);
+		assert(usage.resource < m_resources.size());
+		for (const Usage& other : m_passes[pass].usages)
+		{
+			// One usage per image and pass, combine the access instead
+			assert(other.resource != usage.resource);
+		}
+		m_passes[pass].usages.push_back(usage);
+	}
+
+	void RenderGraph::colorAttachment(PassHandle pass, ResourceHandle resource, const VkClearValue* clearValue)
+	{
+		Usage usage = {};
+		usage.resource = resource;
+		usage.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		usage.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		usage.accessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (clearValue ? 0 : static_cast<VkAccessFlags>(VK_ACCESS_COLOR_ATTACHMENT_READ_BIT));
+		usage.attachment = true;
+		usage.clear = clearValue != nullptr;
+		if (clearValue)
+		{
+			usage.clearValue = *clearValue;
+		}
+		addUsage(pass, usage);
+	}
+
+	void RenderGraph::depthAttachment(PassHandle pass, ResourceHandle resource, const VkClearValue* clearValue)
+	{
+		Usage usage = {};
+		usage.resource = resource;
+		usage.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		usage.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		usage.accessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		usage.attachment = true;
+		usage.clear = clearValue != nullptr;
+		if (clearValue)
+		{
+			usage.clearValue = *clearValue;
+		}
+		addUsage(pass, usage);
+	}
+
+	void RenderGraph::sampledRead(PassHandle pass, ResourceHandle resource, VkPipelineStageFlags stages)
+	{
+		const VkImageLayout layout = hasDepth(m_resources[resource].desc.format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		access(pass, resource, layout, stages, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	void RenderGraph::access(PassHandle pass, ResourceHandle resource, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags accessMask)
+	{
+		Usage usage = {};
+		usage.resource = resource;
+		usage.layout = layout;
+		usage.stages = stages;
+		usage.accessMask = accessMask;
+		addUsage(pass, usage);
+	}
+
+	void RenderGraph::setSideEffect(PassHandle pass)
+	{
+		m_passes[pass].sideEffect = true;
+	}
+
+	uint32_t RenderGraph::width(const Resource& resource) const
+	{
+		return resource.desc.width ? resource.desc.width : m_width;
+	}
+
+	uint32_t RenderGraph::height(const Resource& resource) const
+	{
+		return resource.desc.height ? resource.desc.height : m_height;
+	}
+
+	bool RenderGraph::aliases(const Resource& a, const Resource& b) const
+	{
+		if (a.imported || b.imported || a.firstUse == ~0u || b.firstUse == ~0u)
+		{
+			return false;
+		}
+		return a.heap == b.heap && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	}
+
+	void RenderGraph::compile()
+	{
+		assert(!m_compiled);
+		cull();
+		computeLifetimes();
+		createRenderPasses();
+		allocateImages();
+		deriveBarriers();
+		createFramebuffers();
+		m_compiled = true;
+	}
+
+	void RenderGraph::resize(uint32_t width, uint32_t height)
+	{
+		assert(m_compiled);
+		m_width = width;
+		m_height = height;
+		// The placement depends on the image sizes, so all images are placed again and the aliasing barriers follow it
+		destroyImages();
+		allocateImages();
+		deriveBarriers();
+		createFramebuffers();
+	}
+
+	void RenderGraph::cull()
+	{
+		// Walk back from the passes with side effects, a pass is kept if a kept pass reads something it writes
+		std::vector<bool> needed(m_resources.size(), false);
+		for (size_t i = m_passes.size(); i-- > 0;)
+		{
+			Pass& pass = m_passes[i];
+			bool used = pass.sideEffect;
+			for (const Usage& usage : pass.usages)
+			{
+				if ((usage.accessMask & writeAccessMask) && needed[usage.resource])
+				{
+					used = true;
+				}
+			}
+			pass.culled = !used;
+			if (!used)
+			{
+				continue;
+			}
+			// A cleared attachment replaces the contents, earlier writers are only needed by earlier readers
+			for (const Usage& usage : pass.usages)
+			{
+				if (usage.clear)
+				{
+					needed[usage.resource] = false;
+				}
+			}
+			for (const Usage& usage : pass.usages)
+			{
+				if (!usage.clear && (usage.accessMask & ~writeAccessMask))
+				{
+					needed[usage.resource] = true;
+				}
+			}
+		}
+
+		m_order.clear();
+		for (size_t i = 0; i < m_passes.size(); i++)
+		{
+			if (!m_passes[i].culled)
+			{
+				m_order.push_back(static_cast<PassHandle>(i));
+			}
+		}
+	}
+
+	void RenderGraph::computeLifetimes()
+	{
+		for (uint32_t i = 0; i < m_order.size(); i++)
+		{
+			for (const Usage& usage : m_passes[m_order[i]].usages)
+			{
+				Resource& resource = m_resources[usage.resource];
+				if (resource.firstUse == ~0u)
+				{
+					resource.firstUse = i;
+				}
+				resource.lastUse = i;
+				resource.lastStages = usage.stages;
+				resource.lastWriteAccess |= usage.accessMask & writeAccessMask;
+				resource.usage |= layoutUsage(usage.layout);
+			}
+		}
+
+		for (Resource& resource : m_resources)
+		{
+			if (hasDepth(resource.desc.format) || hasStencil(resource.desc.format))
+			{
+				resource.aspectMask =
+					(hasDepth(resource.desc.format) ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_DEPTH_BIT) : 0) |
+					(hasStencil(resource.desc.format) ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_STENCIL_BIT) : 0);
+			}
+			else
+			{
+				resource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+	}
+
+	void RenderGraph::createRenderPasses()
+	{
+		for (uint32_t i = 0; i < m_order.size(); i++)
+		{
+			Pass& pass = m_passes[m_order[i]];
+
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			std::vector<VkAttachmentReference> colorReferences;
+			VkAttachmentReference depthReference = {};
+			bool hasDepthAttachment = false;
+
+			for (const Usage& usage : pass.usages)
+			{
+				if (!usage.attachment)
+				{
+					continue;
+				}
+				const Resource& resource = m_resources[usage.resource];
+				assert(pass.width == 0 || (pass.width == width(resource) && pass.height == height(resource)));
+				pass.width = width(resource);
+				pass.height = height(resource);
+
+				VkAttachmentDescription description = {};
+				description.format = resource.desc.format;
+				description.samples = VK_SAMPLE_COUNT_1_BIT;
+				// Nothing wrote the image before this pass in the frame, so there is nothing to load
+				description.loadOp = usage.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (resource.firstUse < i ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+				// Imported images are read by the application after the graph, graph owned ones only by later passes
+				description.storeOp = (resource.imported || resource.lastUse > i) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				description.stencilLoadOp = hasStencil(resource.desc.format) ? description.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				description.stencilStoreOp = hasStencil(resource.desc.format) ? description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				// Layout transitions are done by the barriers recorded before the render pass
+				description.initialLayout = usage.layout;
+				description.finalLayout = usage.layout;
+
+				const VkAttachmentReference reference = { static_cast<uint32_t>(attachmentDescriptions.size()), usage.layout };
+				if (usage.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+				{
+					// Only one depth attachment allowed
+					assert(!hasDepthAttachment);
+					depthReference = reference;
+					hasDepthAttachment = true;
+				}
+				else
+				{
+					colorReferences.push_back(reference);
+				}
+				attachmentDescriptions.push_back(description);
+				pass.clearValues.push_back(usage.clearValue);
+			}
+
+			if (attachmentDescriptions.empty())
+			{
+				continue;
+			}
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpass.pColorAttachments = colorReferences.empty() ? nullptr : colorReferences.data();
+			subpass.pDepthStencilAttachment = hasDepthAttachment ? &depthReference : nullptr;
+
+			// No subpass dependencies, the barriers before and after the pass synchronize the attachments
+			VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+			renderPassInfo.pAttachments = attachmentDescriptions.data();
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			VK_CHECK_RESULT(vkCreateRenderPass(m_device->logicalDevice, &renderPassInfo, nullptr, &pass.renderPass));
+		}
+	}
+
+	void RenderGraph::deriveBarriers()
+	{
+		struct State
+		{
+			bool used = false;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// Last write (or layout transition) and the stages that have waited for it since
+			VkPipelineStageFlags writeStages = 0;
+			VkAccessFlags writeAccess = 0;
+			VkPipelineStageFlags readStages = 0;
+		};
+		std::vector<State> states(m_resources.size());
+
+		m_barrierCount = 0;
+		for (uint32_t i = 0; i < m_order.size(); i++)
+		{
+			Pass& pass = m_passes[m_order[i]];
+			pass.barriers.clear();
+			pass.srcStageMask = 0;
+			pass.dstStageMask = 0;
+
+			for (const Usage& usage : pass.usages)
+			{
+				const Resource& resource = m_resources[usage.resource];
+				State& state = states[usage.resource];
+				const bool write = (usage.accessMask & writeAccessMask) != 0;
+
+				Barrier barrier;
+				barrier.resource = usage.resource;
+				barrier.oldLayout = state.layout;
+				barrier.newLayout = usage.layout;
+				barrier.srcAccessMask = state.writeAccess;
+				barrier.dstAccessMask = usage.accessMask;
+
+				VkPipelineStageFlags srcStages = 0;
+				if (!state.used)
+				{
+					// The contents are undefined at the first use, but the memory may still be accessed by the
+					// previous frame or, for graph owned images, by the images that share it: the ones used earlier
+					// in this frame and the ones used later in the previous frame. Frames are submitted to one queue,
+					// so the barrier waits for the previous frame as well
+					barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					srcStages = resource.lastStages;
+					barrier.srcAccessMask = resource.lastWriteAccess;
+					for (const Resource& other : m_resources)
+					{
+						if (&other != &resource && aliases(resource, other))
+						{
+							srcStages |= other.lastStages;
+							barrier.srcAccessMask |= other.lastWriteAccess;
+						}
+					}
+				}
+				else if (state.layout != usage.layout || write)
+				{
+					srcStages = state.writeStages | state.readStages;
+				}
+				else if (usage.stages & ~state.readStages)
+				{
+					// Read after write, the write has not been made visible to these stages yet
+					srcStages = state.writeStages;
+				}
+				else
+				{
+					continue;
+				}
+
+				pass.barriers.push_back(barrier);
+				pass.srcStageMask |= srcStages ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+				pass.dstStageMask |= usage.stages;
+
+				if (!state.used || state.layout != usage.layout || write)
+				{
+					// Later accesses in other stages have to wait for this write or layout transition
+					state.writeStages = usage.stages;
+					state.writeAccess = usage.accessMask & writeAccessMask;
+					state.readStages = write ? 0 : usage.stages;
+				}
+				else
+				{
+					state.readStages |= usage.stages;
+				}
+				state.layout = usage.layout;
+				state.used = true;
+			}
+			m_barrierCount += static_cast<uint32_t>(pass.barriers.size());
+		}
+	}
+
+	void RenderGraph::allocateImages()
+	{
+		std::vector<ResourceHandle> transient;
+		std::vector<VkMemoryRequirements> memReqs(m_resources.size());
+		m_requestedBytes = 0;
+
+		for (ResourceHandle handle = 0; handle < m_resources.size(); handle++)
+		{
+			Resource& resource = m_resources[handle];
+			if (resource.imported || resource.firstUse == ~0u)
+			{
+				continue;
+			}
+
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = resource.desc.format;
+			imageCI.extent = { width(resource), height(resource), 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = resource.desc.layerCount;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = resource.usage | resource.desc.usage;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(m_device->logicalDevice, &imageCI, nullptr, &resource.image));
+			vkGetImageMemoryRequirements(m_device->logicalDevice, resource.image, &memReqs[handle]);
+
+			const uint32_t memoryType = m_device->getMemoryType(memReqs[handle].memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			resource.heap = 0;
+			while (resource.heap < m_heaps.size() && m_heaps[resource.heap].memoryType != memoryType)
+			{
+				resource.heap++;
+			}
+			if (resource.heap == m_heaps.size())
+			{
+				m_heaps.push_back({ memoryType, 0, VK_NULL_HANDLE });
+			}
+			resource.size = memReqs[handle].size;
+			m_requestedBytes += resource.size;
+			transient.push_back(handle);
+		}
+
+		// Place the largest images first, each at the lowest offset not used by an image that is alive at the same time
+		std::stable_sort(transient.begin(), transient.end(), [this](ResourceHandle a, ResourceHandle b) { return m_resources[a].size > m_resources[b].size; });
+		std::vector<ResourceHandle> placed;
+		for (ResourceHandle handle : transient)
+		{
+			Resource& resource = m_resources[handle];
+			const VkDeviceSize alignment = memReqs[handle].alignment;
+
+			std::vector<ResourceHandle> overlapping;
+			std::vector<VkDeviceSize> candidates(1, 0);
+			for (ResourceHandle other : placed)
+			{
+				const Resource& placedResource = m_resources[other];
+				if (placedResource.heap == resource.heap && placedResource.firstUse <= resource.lastUse && resource.firstUse <= placedResource.lastUse)
+				{
+					overlapping.push_back(other);
+					candidates.push_back(alignUp(placedResource.offset + placedResource.size, alignment));
+				}
+			}
+			std::sort(candidates.begin(), candidates.end());
+
+			for (VkDeviceSize offset : candidates)
+			{
+				bool fits = true;
+				for (ResourceHandle other : overlapping)
+				{
+					const Resource& placedResource = m_resources[other];
+					if (offset < placedResource.offset + placedResource.size && placedResource.offset < offset + resource.size)
+					{
+						fits = false;
+						break;
+					}
+				}
+				if (fits)
+				{
+					resource.offset = offset;
+					break;
+				}
+			}
+			m_heaps[resource.heap].size = std::max(m_heaps[resource.heap].size, resource.offset + resource.size);
+			placed.push_back(handle);
+		}
+
+		m_allocatedBytes = 0;
+		for (Heap& heap : m_heaps)
+		{
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = heap.size;
+			memAlloc.memoryTypeIndex = heap.memoryType;
+			VK_CHECK_RESULT(m_device->allocateMemory(&memAlloc, &heap.memory, vks::MemoryCategory::RenderTarget));
+			m_allocatedBytes += heap.size;
+		}
+
+		for (ResourceHandle handle : transient)
+		{
+			Resource& resource = m_resources[handle];
+			VK_CHECK_RESULT(vkBindImageMemory(m_device->logicalDevice, resource.image, m_heaps[resource.heap].memory, resource.offset));
+
+			VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+			imageView.viewType = (resource.desc.layerCount == 1) ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			imageView.format = resource.desc.format;
+			// Sampled depth stencil views may only have one aspect
+			imageView.subresourceRange = { hasDepth(resource.desc.format) ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_DEPTH_BIT) : resource.aspectMask, 0, 1, 0, resource.desc.layerCount };
+			imageView.image = resource.image;
+			VK_CHECK_RESULT(vkCreateImageView(m_device->logicalDevice, &imageView, nullptr, &resource.view));
+		}
+	}
+
+	void RenderGraph::createFramebuffers()
+	{
+		for (PassHandle handle : m_order)
+		{
+			Pass& pass = m_passes[handle];
+			if (pass.renderPass == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+
+			std::vector<VkImageView> attachments;
+			uint32_t layers = 1;
+			for (const Usage& usage : pass.usages)
+			{
+				if (usage.attachment)
+				{
+					const Resource& resource = m_resources[usage.resource];
+					attachments.push_back(resource.view);
+					layers = std::max(layers, resource.desc.layerCount);
+					pass.width = width(resource);
+					pass.height = height(resource);
+				}
+			}
+
+			VkFramebufferCreateInfo framebufferInfo = vks::initializers::framebufferCreateInfo();
+			framebufferInfo.renderPass = pass.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = pass.width;
+			framebufferInfo.height = pass.height;
+			framebufferInfo.layers = layers;
+			VK_CHECK_RESULT(vkCreateFramebuffer(m_device->logicalDevice, &framebufferInfo, nullptr, &pass.framebuffer));
+		}
+	}
+
+	void RenderGraph::destroyImages()
+	{
+		for (Pass& pass : m_passes)
+		{
+			if (pass.framebuffer != VK_NULL_HANDLE)
+			{
+				vkDestroyFramebuffer(m_device->logicalDevice, pass.framebuffer, nullptr);
+				pass.framebuffer = VK_NULL_HANDLE;
+			}
+		}
+		for (Resource& resource : m_resources)
+		{
+			if (!resource.imported && resource.image != VK_NULL_HANDLE)
+			{
+				vkDestroyImageView(m_device->logicalDevice, resource.view, nullptr);
+				vkDestroyImage(m_device->logicalDevice, resource.image, nullptr);
+				resource.view = VK_NULL_HANDLE;
+				resource.image = VK_NULL_HANDLE;
+			}
+		}
+		for (Heap& heap : m_heaps)
+		{
+			m_device->freeMemory(heap.memory);
+		}
+		m_heaps.clear();
+		m_allocatedBytes = 0;
+	}
+
+	void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t frame) const
+	{
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		for (PassHandle handle : m_order)
+		{
+			const Pass& pass = m_passes[handle];
+
+			if (!pass.barriers.empty())
+			{
+				imageBarriers.clear();
+				for (const Barrier& barrier : pass.barriers)
+				{
+					const Resource& resource = m_resources[barrier.resource];
+					VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+					imageBarrier.srcAccessMask = barrier.srcAccessMask;
+					imageBarrier.dstAccessMask = barrier.dstAccessMask;
+					imageBarrier.oldLayout = barrier.oldLayout;
+					imageBarrier.newLayout = barrier.newLayout;
+					imageBarrier.image = resource.image;
+					imageBarrier.subresourceRange = { resource.aspectMask, 0, 1, 0, resource.desc.layerCount };
+					imageBarriers.push_back(imageBarrier);
+				}
+				vkCmdPipelineBarrier(commandBuffer, pass.srcStageMask, pass.dstStageMask, 0, 0, nullptr, 0, nullptr,
+					static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+			}
+
+			if (pass.renderPass == VK_NULL_HANDLE)
+			{
+				pass.record(commandBuffer, frame);
+				continue;
+			}
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = pass.renderPass;
+			renderPassBeginInfo.framebuffer = pass.framebuffer;
+			renderPassBeginInfo.renderArea.extent.width = pass.width;
+			renderPassBeginInfo.renderArea.extent.height = pass.height;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+			renderPassBeginInfo.pClearValues = pass.clearValues.data();
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)pass.width, (float)pass.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(pass.width, pass.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			pass.record(commandBuffer, frame);
+
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+}
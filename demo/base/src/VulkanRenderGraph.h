@@ -0,0 +1,190 @@
+/*
+* Render graph
+*
+* Frame graph of render passes that declare the images they read and write. Compiling the graph culls passes
+* whose results are never used, creates the render passes and framebuffers, derives the layout transitions and
+* barriers between passes and places transient images with non overlapping lifetimes in the same memory
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	class RenderGraph
+	{
+	public:
+		typedef uint32_t ResourceHandle;
+		typedef uint32_t PassHandle;
+		/** @brief Records the commands of a pass, frame is passed through from execute (e.g. the swapchain image index) */
+		typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t frame)> RecordFunction;
+
+		struct ImageDesc
+		{
+			// A width and height of 0 follow the extent of the graph
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t layerCount = 1;
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			// Usage on top of the one derived from the passes, e.g. for images that are also accessed outside the graph
+			VkImageUsageFlags usage = 0;
+		};
+
+		RenderGraph(vks::VulkanDevice* device, uint32_t width, uint32_t height);
+		~RenderGraph();
+
+		/** @brief Adds an image owned by the graph, its contents are not kept across frames */
+		ResourceHandle createImage(const std::string& name, const ImageDesc& desc);
+		/** @brief Adds an image owned by the application, its contents at the start of a frame are discarded */
+		ResourceHandle importImage(const std::string& name, const ImageDesc& desc, VkImage image, VkImageView view);
+		/** @brief Replaces an imported image, e.g. after a resize, call before resize() */
+		void updateImport(ResourceHandle resource, VkImage image, VkImageView view);
+
+		/**
+		* Adds a pass, passes are executed in the order they were added
+		*
+		* Passes with color or depth attachments are recorded inside a render pass created by the graph,
+		* passes without attachments (compute, or passes that begin their own render pass) outside of it
+		*/
+		PassHandle addPass(const std::string& name, RecordFunction record);
+		/** @brief Renders to the image, clearValue == nullptr loads the previous contents */
+		void colorAttachment(PassHandle pass, ResourceHandle resource, const VkClearValue* clearValue = nullptr);
+		void depthAttachment(PassHandle pass, ResourceHandle resource, const VkClearValue* clearValue = nullptr);
+		/** @brief Samples the image in the given shader stages */
+		void sampledRead(PassHandle pass, ResourceHandle resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		/** @brief Any other access, writes are detected from the access mask */
+		void access(PassHandle pass, ResourceHandle resource, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags accessMask);
+		/** @brief Keeps the pass even if nothing reads its results, e.g. a pass that writes to the swapchain */
+		void setSideEffect(PassHandle pass);
+
+		/** @brief Culls unused passes, creates render passes, images and framebuffers and derives the barriers */
+		void compile();
+		/** @brief Recreates all graph owned images, the barriers and the framebuffers for a new graph extent, render passes are kept */
+		void resize(uint32_t width, uint32_t height);
+		/**
+		* Records the barriers and commands of all passes that were not culled
+		*
+		* All frames have to be submitted to the same queue: the first use of an image in a frame waits for the
+		* previous frame's accesses to its memory with a pipeline barrier, which doesn't reach other queues
+		*/
+		void execute(VkCommandBuffer commandBuffer, uint32_t frame) const;
+
+		/** @brief Render pass of a pass with attachments, VK_NULL_HANDLE for culled passes */
+		VkRenderPass renderPass(PassHandle pass) const { return m_passes[pass].renderPass; }
+		bool culled(PassHandle pass) const { return m_passes[pass].culled; }
+		VkImage image(ResourceHandle resource) const { return m_resources[resource].image; }
+		VkImageView view(ResourceHandle resource) const { return m_resources[resource].view; }
+
+		/** @brief Device memory bound to graph owned images */
+		VkDeviceSize allocatedBytes() const { return m_allocatedBytes; }
+		/** @brief Device memory graph owned images would need without aliasing */
+		VkDeviceSize requestedBytes() const { return m_requestedBytes; }
+		uint32_t barrierCount() const { return m_barrierCount; }
+	private:
+		struct Usage
+		{
+			ResourceHandle resource;
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags accessMask;
+			bool attachment;
+			// Cleared attachments don't depend on the previous contents
+			bool clear;
+			VkClearValue clearValue;
+		};
+
+		struct Barrier
+		{
+			ResourceHandle resource;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkAccessFlags srcAccessMask;
+			VkAccessFlags dstAccessMask;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			RecordFunction record;
+			std::vector<Usage> usages;
+			bool sideEffect = false;
+			bool culled = false;
+
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<VkClearValue> clearValues;
+
+			// Executed in one vkCmdPipelineBarrier before the pass
+			std::vector<Barrier> barriers;
+			VkPipelineStageFlags srcStageMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			ImageDesc desc;
+			bool imported = false;
+			VkImageUsageFlags usage = 0;
+			VkImageAspectFlags aspectMask = 0;
+
+			// Index into m_order of the first and last pass using the image
+			uint32_t firstUse = ~0u;
+			uint32_t lastUse = ~0u;
+			VkPipelineStageFlags lastStages = 0;
+			VkAccessFlags lastWriteAccess = 0;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			uint32_t heap = 0;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+		};
+
+		struct Heap
+		{
+			uint32_t memoryType;
+			VkDeviceSize size;
+			VkDeviceMemory memory;
+		};
+
+		uint32_t width(const Resource& resource) const;
+		uint32_t height(const Resource& resource) const;
+		/** @brief Both images are graph owned and placed in overlapping memory */
+		bool aliases(const Resource& a, const Resource& b) const;
+		void addUsage(PassHandle pass, const Usage& usage);
+		void cull();
+		void computeLifetimes();
+		void createRenderPasses();
+		void deriveBarriers();
+		void allocateImages();
+		void createFramebuffers();
+		void destroyImages();
+
+		vks::VulkanDevice* m_device;
+		uint32_t m_width;
+		uint32_t m_height;
+		bool m_compiled = false;
+
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		// Passes that survived culling in execution order
+		std::vector<PassHandle> m_order;
+		std::vector<Heap> m_heaps;
+
+		VkDeviceSize m_allocatedBytes = 0;
+		VkDeviceSize m_requestedBytes = 0;
+		uint32_t m_barrierCount = 0;
+	};
+}
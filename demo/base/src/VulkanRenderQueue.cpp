@@ -0,0 +1,240 @@
+/*
+* Render queue
+*
+* Collects indexed draw packets with 64 bit sort keys, radix sorts them and replays them into a command buffer,
+* skipping binds of pipelines, descriptor sets, buffers and push constants that are already bound
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRenderQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vks
+{
+	namespace
+	{
+		uint64_t field(uint32_t value, uint32_t bits)
+		{
+			assert(value < (1u << bits));
+			return static_cast<uint64_t>(value & ((1u << bits) - 1));
+		}
+
+		uint64_t depthBucket(float depth)
+		{
+			const float maxBucket = static_cast<float>((1u << RenderQueue::depthBits) - 1);
+			return static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * maxBucket);
+		}
+	}
+
+	RenderQueue::Stats& RenderQueue::Stats::operator+=(const Stats& other)
+	{
+		draws += other.draws;
+		binds += other.binds;
+		eliminatedBinds += other.eliminatedBinds;
+		return *this;
+	}
+
+	uint64_t RenderQueue::opaqueKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+	{
+		return (field(pass, passBits) << (pipelineBits + materialBits + depthBits)) |
+			(field(pipeline, pipelineBits) << (materialBits + depthBits)) |
+			(field(material, materialBits) << depthBits) |
+			depthBucket(depth);
+	}
+
+	uint64_t RenderQueue::blendedKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+	{
+		const uint64_t invertedDepth = ((1u << depthBits) - 1) - depthBucket(depth);
+		return (field(pass, passBits) << (depthBits + pipelineBits + materialBits)) |
+			(invertedDepth << (pipelineBits + materialBits)) |
+			(field(pipeline, pipelineBits) << materialBits) |
+			field(material, materialBits);
+	}
+
+	void RenderQueue::setView(const glm::mat4& view, float zNear, float zFar)
+	{
+		m_view = view;
+		m_zNear = zNear;
+		m_zFar = zFar;
+	}
+
+	float RenderQueue::depth(const glm::vec3& position) const
+	{
+		// The view looks down -z
+		const float viewDepth = -(m_view[0].z * position.x + m_view[1].z * position.y + m_view[2].z * position.z + m_view[3].z);
+		return std::min(std::max((viewDepth - m_zNear) / (m_zFar - m_zNear), 0.0f), 1.0f);
+	}
+
+	void RenderQueue::clear()
+	{
+		m_entries.clear();
+		m_packets.clear();
+		m_pushConstants.clear();
+		m_pushConstantData.clear();
+	}
+
+	void RenderQueue::add(uint64_t key, const Packet& packet, const void* pushConstants)
+	{
+		m_entries.push_back({ key, static_cast<uint32_t>(m_packets.size()) });
+		m_packets.push_back(packet);
+		m_pushConstantData.push_back(static_cast<uint32_t>(m_pushConstants.size()));
+		if (packet.pushConstantSize > 0)
+		{
+			assert(pushConstants);
+			const uint8_t* bytes = static_cast<const uint8_t*>(pushConstants);
+			m_pushConstants.insert(m_pushConstants.end(), bytes, bytes + packet.pushConstantSize);
+		}
+	}
+
+	void RenderQueue::sort()
+	{
+		// Least significant digit radix sort over the eight key bytes, stable so equal keys keep their order
+		const size_t count = m_entries.size();
+		uint32_t histograms[8][256] = {};
+		for (const Entry& entry : m_entries)
+		{
+			for (uint32_t digit = 0; digit < 8; digit++)
+			{
+				histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+			}
+		}
+
+		m_sortScratch.resize(count);
+		for (uint32_t digit = 0; digit < 8; digit++)
+		{
+			uint32_t* histogram = histograms[digit];
+			// Digits all packets share (unused key fields, single pass or pipeline) don't change the order
+			if (histogram[(m_entries.empty() ? 0 : m_entries[0].key >> (digit * 8)) & 0xFF] == count)
+			{
+				continue;
+			}
+			uint32_t offset = 0;
+			for (uint32_t bucket = 0; bucket < 256; bucket++)
+			{
+				const uint32_t bucketSize = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketSize;
+			}
+			for (const Entry& entry : m_entries)
+			{
+				m_sortScratch[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+			}
+			m_entries.swap(m_sortScratch);
+		}
+	}
+
+	RenderQueue::Stats RenderQueue::submit(VkCommandBuffer commandBuffer) const
+	{
+		Stats stats;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> descriptorSets;
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		const Packet* pushConstantPacket = nullptr;
+		const uint8_t* pushConstants = nullptr;
+
+		for (const Entry& entry : m_entries)
+		{
+			const Packet& packet = m_packets[entry.packet];
+
+			if (packet.pipeline != VK_NULL_HANDLE)
+			{
+				if (packet.pipeline != pipeline)
+				{
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+					pipeline = packet.pipeline;
+					stats.binds++;
+				}
+				else
+				{
+					stats.eliminatedBinds++;
+				}
+			}
+
+			// Sets and push constants of another layout may be disturbed, they are bound again
+			if (packet.pipelineLayout != pipelineLayout)
+			{
+				pipelineLayout = packet.pipelineLayout;
+				descriptorSets.clear();
+				pushConstantPacket = nullptr;
+			}
+
+			if (packet.descriptorSet != VK_NULL_HANDLE)
+			{
+				if (packet.descriptorSetIndex >= descriptorSets.size())
+				{
+					descriptorSets.resize(packet.descriptorSetIndex + 1, VK_NULL_HANDLE);
+				}
+				if (descriptorSets[packet.descriptorSetIndex] != packet.descriptorSet)
+				{
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipelineLayout, packet.descriptorSetIndex, 1, &packet.descriptorSet, 0, nullptr);
+					descriptorSets[packet.descriptorSetIndex] = packet.descriptorSet;
+					stats.binds++;
+				}
+				else
+				{
+					stats.eliminatedBinds++;
+				}
+			}
+
+			if (packet.vertexBuffer != VK_NULL_HANDLE)
+			{
+				if (packet.vertexBuffer != vertexBuffer)
+				{
+					const VkDeviceSize offsets[1] = { 0 };
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &packet.vertexBuffer, offsets);
+					vertexBuffer = packet.vertexBuffer;
+					stats.binds++;
+				}
+				else
+				{
+					stats.eliminatedBinds++;
+				}
+			}
+
+			if (packet.indexBuffer != VK_NULL_HANDLE)
+			{
+				if (packet.indexBuffer != indexBuffer)
+				{
+					vkCmdBindIndexBuffer(commandBuffer, packet.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+					indexBuffer = packet.indexBuffer;
+					stats.binds++;
+				}
+				else
+				{
+					stats.eliminatedBinds++;
+				}
+			}
+
+			if (packet.pushConstantSize > 0)
+			{
+				const uint8_t* data = m_pushConstants.data() + m_pushConstantData[entry.packet];
+				const bool pushed = pushConstantPacket &&
+					pushConstantPacket->pushConstantStages == packet.pushConstantStages &&
+					pushConstantPacket->pushConstantOffset == packet.pushConstantOffset &&
+					pushConstantPacket->pushConstantSize == packet.pushConstantSize &&
+					memcmp(pushConstants, data, packet.pushConstantSize) == 0;
+				if (!pushed)
+				{
+					vkCmdPushConstants(commandBuffer, packet.pipelineLayout, packet.pushConstantStages, packet.pushConstantOffset, packet.pushConstantSize, data);
+					pushConstantPacket = &packet;
+					pushConstants = data;
+					stats.binds++;
+				}
+				else
+				{
+					stats.eliminatedBinds++;
+				}
+			}
+
+			vkCmdDrawIndexed(commandBuffer, packet.indexCount, packet.instanceCount, packet.firstIndex, packet.vertexOffset, packet.firstInstance);
+			stats.draws++;
+		}
+		return stats;
+	}
+}
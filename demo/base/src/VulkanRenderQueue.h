@@ -0,0 +1,99 @@
+/*
+* Render queue
+*
+* Collects indexed draw packets with 64 bit sort keys, radix sorts them and replays them into a command buffer,
+* skipping binds of pipelines, descriptor sets, buffers and push constants that are already bound
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class RenderQueue
+	{
+	public:
+		/** @brief State and arguments of one indexed draw, null handles (and a push constant size of 0) leave the current state as is */
+		struct Packet
+		{
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			uint32_t descriptorSetIndex = 0;
+			VkBuffer vertexBuffer = VK_NULL_HANDLE;
+			VkBuffer indexBuffer = VK_NULL_HANDLE;
+			VkShaderStageFlags pushConstantStages = 0;
+			uint32_t pushConstantOffset = 0;
+			uint32_t pushConstantSize = 0;
+
+			uint32_t indexCount = 0;
+			uint32_t instanceCount = 1;
+			uint32_t firstIndex = 0;
+			int32_t vertexOffset = 0;
+			uint32_t firstInstance = 0;
+		};
+
+		struct Stats
+		{
+			uint32_t draws = 0;
+			uint32_t binds = 0;
+			// Binds requested by packets that were skipped because the state was already bound
+			uint32_t eliminatedBinds = 0;
+			Stats& operator+=(const Stats& other);
+		};
+
+		// Bits of the sort key fields, ids have to be smaller than 1 << bits
+		static const uint32_t passBits = 4;
+		static const uint32_t pipelineBits = 12;
+		static const uint32_t materialBits = 24;
+		static const uint32_t depthBits = 24;
+
+		/**
+		* Opaque key: pass | pipeline | material | depth, so state changes are minimized and each state's draws go front to back
+		*
+		* @param depth Normalized view depth, see depth()
+		*/
+		static uint64_t opaqueKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth);
+		/** @brief Blended key: pass | inverted depth | pipeline | material, the draws of a pass go back to front */
+		static uint64_t blendedKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth);
+
+		/** @brief View used by depth(), kept by clear */
+		void setView(const glm::mat4& view, float zNear, float zFar);
+		/** @brief Normalized linear view depth of a world space position, 0 at the near plane and 1 at the far plane (clamped) */
+		float depth(const glm::vec3& position) const;
+
+		void clear();
+		/** @brief Queues a packet, pushConstants has to point to packet.pushConstantSize bytes (copied) */
+		void add(uint64_t key, const Packet& packet, const void* pushConstants = nullptr);
+		/** @brief Orders the packets by key, packets with equal keys keep the order they were added in */
+		void sort();
+		/** @brief Records the packets in sorted order, the caller has set viewport, scissor and the state packets don't bind */
+		Stats submit(VkCommandBuffer commandBuffer) const;
+
+		size_t size() const { return m_entries.size(); }
+	private:
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t packet;
+		};
+		std::vector<Entry> m_entries;
+		std::vector<Entry> m_sortScratch;
+		std::vector<Packet> m_packets;
+		// Push constants of all packets, m_pushConstantData[i] is the byte offset of packet i
+		std::vector<uint8_t> m_pushConstants;
+		std::vector<uint32_t> m_pushConstantData;
+
+		glm::mat4 m_view = glm::mat4(1.0f);
+		float m_zNear = 0.1f;
+		float m_zFar = 1.0f;
+	};
+}
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <fstream>
+#include <functional>
 #include <stdlib.h>
 #include <string>
 #include <vector>
@@ -45,6 +46,23 @@ class Texture
 	void      updateDescriptor();
 	void      destroy();
 	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+
+  protected:
+	// Creates the image, sampler and view and copies the staging data, regionOffsets holds one byte offset per level and layer (level major)
+	void upload(
+	    const std::function<void(void *data)> &writeStaging,
+	    VkDeviceSize                           bufferSize,
+	    const std::vector<VkDeviceSize>       &regionOffsets,
+	    uint32_t                               layerCount,
+	    VkImageViewType                        viewType,
+	    VkFormat                               format,
+	    uint32_t                               texWidth,
+	    uint32_t                               texHeight,
+	    vks::VulkanDevice *                    device,
+	    VkQueue                                copyQueue,
+	    VkFilter                               filter,
+	    VkImageUsageFlags                      imageUsageFlags,
+	    VkImageLayout                          imageLayout);
 };
 
 class Texture2D : public Texture
@@ -69,6 +87,31 @@ class Texture2D : public Texture
 	    VkFilter           filter          = VK_FILTER_LINEAR,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Same as fromBuffer, but the texel data is written directly into the mapped staging memory by writeStaging (e.g. a format conversion)
+	void fromStagingWriter(
+	    const std::function<void(void *data)> &writeStaging,
+	    VkDeviceSize       bufferSize,
+	    VkFormat           format,
+	    uint32_t           texWidth,
+	    uint32_t           texHeight,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkFilter           filter          = VK_FILTER_LINEAR,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Uploads a complete mip chain from one buffer, mipOffsets holds the byte offset of every level (tightly packed texels / blocks)
+	void fromMipLevels(
+	    void *                           buffer,
+	    VkDeviceSize                     bufferSize,
+	    const std::vector<VkDeviceSize> &mipOffsets,
+	    VkFormat                         format,
+	    uint32_t                         texWidth,
+	    uint32_t                         texHeight,
+	    vks::VulkanDevice *              device,
+	    VkQueue                          copyQueue,
+	    VkFilter                         filter          = VK_FILTER_LINEAR,
+	    VkImageUsageFlags                imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout                    imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	void createEmpty(vks::VulkanDevice* device, VkQueue transferQueue, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageLayout layout);
 };
 
@@ -82,6 +125,33 @@ class Texture2DArray : public Texture
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Single level array whose layers are written back to back into the mapped staging memory by writeStaging
+	void fromStagingWriter(
+	    const std::function<void(void *data)> &writeStaging,
+	    VkDeviceSize       bufferSize,
+	    uint32_t           layerCount,
+	    VkFormat           format,
+	    uint32_t           texWidth,
+	    uint32_t           texHeight,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkFilter           filter          = VK_FILTER_LINEAR,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Uploads layerCount equally sized layers with complete mip chains from one buffer, layerOffsets holds the byte offset of every level and layer (level major)
+	void fromMipLevels(
+	    void *                           buffer,
+	    VkDeviceSize                     bufferSize,
+	    const std::vector<VkDeviceSize> &layerOffsets,
+	    uint32_t                         layerCount,
+	    VkFormat                         format,
+	    uint32_t                         texWidth,
+	    uint32_t                         texHeight,
+	    vks::VulkanDevice *              device,
+	    VkQueue                          copyQueue,
+	    VkFilter                         filter          = VK_FILTER_LINEAR,
+	    VkImageUsageFlags                imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout                    imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 };
 
 class TextureCubeMap : public Texture
@@ -99,7 +99,7 @@ namespace vks
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &fontMemory));
+		VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &fontMemory, vks::MemoryCategory::Texture));
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, fontImage, fontMemory, 0));
 
 		// Image view
@@ -289,7 +289,42 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
-	/** Update vertex and index buffer containing the imGui elements when required */
+	void UIOverlay::allocateGeometry()
+	{
+		// The ring may still be read by submitted command buffers, growing is rare so waiting for the queue is fine
+		if (geometryBuffer.buffer != VK_NULL_HANDLE) {
+			vkQueueWaitIdle(queue);
+			geometryBuffer.unmap();
+			geometryBuffer.destroy();
+			geometryBuffer.buffer = VK_NULL_HANDLE;
+			geometryBuffer.memory = VK_NULL_HANDLE;
+		}
+
+		// Align the start of every region, the index data follows power of two vertex capacities and stays aligned too
+		const VkDeviceSize alignment = 256;
+		regionSize = vertexCapacity * sizeof(ImDrawVert) + indexCapacity * sizeof(ImDrawIdx);
+		regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&geometryBuffer,
+			regionSize * frameCount));
+		VK_CHECK_RESULT(geometryBuffer.map());
+	}
+
+	void UIOverlay::setFrameCount(uint32_t count)
+	{
+		if (count == frameCount) {
+			return;
+		}
+		frameCount = std::max(count, 1u);
+		if (geometryBuffer.buffer != VK_NULL_HANDLE) {
+			allocateGeometry();
+		}
+	}
+
+	/** Grow the geometry ring to fit the imGui elements, the data itself is copied per frame in upload() */
 	bool UIOverlay::update()
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
@@ -297,40 +332,51 @@ namespace vks
 
 		if (!imDrawData) { return false; };
 
-		// Note: Alignment is done inside buffer creation
-		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
+		if ((imDrawData->TotalVtxCount == 0) || (imDrawData->TotalIdxCount == 0)) {
 			return false;
 		}
 
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
+		// Grow geometrically so the capacity settles after a few frames
+		if ((geometryBuffer.buffer == VK_NULL_HANDLE) || (imDrawData->TotalVtxCount > vertexCapacity) || (imDrawData->TotalIdxCount > indexCapacity)) {
+			vertexCapacity = std::max(vertexCapacity, 1024);
+			while (vertexCapacity < imDrawData->TotalVtxCount) {
+				vertexCapacity *= 2;
+			}
+			indexCapacity = std::max(indexCapacity, 1024);
+			while (indexCapacity < imDrawData->TotalIdxCount) {
+				indexCapacity *= 2;
+			}
+			allocateGeometry();
 			updateCmdBuffers = true;
 		}
 
-		// Index buffer
-		VkDeviceSize indexSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
+		// Draw calls are recorded into the command buffers, rebuild them if the geometry changed
+		if ((vertexCount != imDrawData->TotalVtxCount) || (indexCount != imDrawData->TotalIdxCount)) {
+			vertexCount = imDrawData->TotalVtxCount;
 			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
 			updateCmdBuffers = true;
 		}
 
-		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		return updateCmdBuffers;
+	}
+
+	void UIOverlay::upload(uint32_t frame)
+	{
+		ImDrawData* imDrawData = ImGui::GetDrawData();
+
+		if ((!imDrawData) || (geometryBuffer.mapped == nullptr)) {
+			return;
+		}
+		// Geometry that outgrew the ring is uploaded after the next update()
+		if ((imDrawData->TotalVtxCount > vertexCapacity) || (imDrawData->TotalIdxCount > indexCapacity)) {
+			return;
+		}
+		assert(frame < frameCount);
+
+		// Memory is host coherent, no flush required
+		char* region = static_cast<char*>(geometryBuffer.mapped) + frame * regionSize;
+		ImDrawVert* vtxDst = (ImDrawVert*)region;
+		ImDrawIdx* idxDst = (ImDrawIdx*)(region + vertexCapacity * sizeof(ImDrawVert));
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -339,21 +385,15 @@ namespace vks
 			vtxDst += cmd_list->VtxBuffer.Size;
 			idxDst += cmd_list->IdxBuffer.Size;
 		}
-
-		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
-
-		return updateCmdBuffers;
 	}
 
-	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
+	void UIOverlay::draw(const VkCommandBuffer commandBuffer, uint32_t frame)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 		int32_t vertexOffset = 0;
 		int32_t indexOffset = 0;
 
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || (geometryBuffer.buffer == VK_NULL_HANDLE)) {
 			return;
 		}
 
@@ -366,9 +406,10 @@ namespace vks
 		pushConstBlock.translate = glm::vec2(-1.0f);
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		assert(frame < frameCount);
+		VkDeviceSize offsets[1] = { frame * regionSize };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometryBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, geometryBuffer.buffer, offsets[0] + vertexCapacity * sizeof(ImDrawVert), VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -398,11 +439,10 @@ namespace vks
 	void UIOverlay::freeResources()
 	{
 		ImGui::DestroyContext();
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		geometryBuffer.destroy();
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
-		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
+		device->freeMemory(fontMemory);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
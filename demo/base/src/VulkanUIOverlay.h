@@ -39,8 +39,17 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
+		/**
+		* Persistently mapped geometry ring with one region per command buffer, vertices followed by indices. The
+		* region of a frame is written right before its command buffer is submitted, so frames in flight keep their
+		* geometry. The capacity only grows (doubling), in steady state nothing is reallocated
+		*/
+		vks::Buffer geometryBuffer;
+		uint32_t frameCount = 1;
+		int32_t vertexCapacity = 0;
+		int32_t indexCapacity = 0;
+		VkDeviceSize regionSize = 0;
+		/** @brief Counts the command buffers were recorded with */
 		int32_t vertexCount = 0;
 		int32_t indexCount = 0;
 
@@ -72,8 +81,15 @@ namespace vks
 		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass);
 		void prepareResources();
 
+		/** @brief (Re)creates the geometry ring for the current capacity and frame count */
+		void allocateGeometry();
+		/** @brief Sets the number of command buffers (frames) drawing the overlay */
+		void setFrameCount(uint32_t count);
+		/** @brief Grows the geometry ring for the current draw data, returns true if the command buffers need to be rebuilt */
 		bool update();
-		void draw(const VkCommandBuffer commandBuffer);
+		/** @brief Copies the current draw data into the region of the frame, the GPU must be done with the frame's last submit */
+		void upload(uint32_t frame);
+		void draw(const VkCommandBuffer commandBuffer, uint32_t frame);
 		void resize(uint32_t width, uint32_t height);
 
 		void freeResources();
@@ -0,0 +1,79 @@
+/*
+* Uniform arena
+*
+* Linear allocator for per frame constants over one persistently mapped buffer, bound through
+* VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptors. The buffer is split into a ring of frame regions, a frame
+* resets its region and allocates from the start again, so constants of frames still in flight are never overwritten
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUniformArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "VulkanTools.h"
+
+namespace vks
+{
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	UniformArena::UniformArena(vks::VulkanDevice* device, VkDeviceSize frameSize, uint32_t frameCount)
+		: m_device(device), m_frameCount(frameCount)
+	{
+		assert(frameCount > 0);
+
+		m_alignment = std::max<VkDeviceSize>(device->properties.limits.minUniformBufferOffsetAlignment, 1);
+		m_frameSize = alignUp(frameSize, m_alignment);
+		// Dynamic offsets are 32 bit
+		if (m_frameSize * frameCount > UINT32_MAX)
+		{
+			vks::tools::exitFatal("UniformArena: the frame regions exceed the range of dynamic offsets", -1);
+			return;
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&m_buffer,
+			m_frameSize * frameCount));
+		VK_CHECK_RESULT(m_buffer.map());
+	}
+
+	UniformArena::~UniformArena()
+	{
+		m_buffer.destroy();
+	}
+
+	void UniformArena::beginFrame(uint32_t frame)
+	{
+		assert(frame < m_frameCount);
+		m_frame = frame;
+		m_head = 0;
+	}
+
+	UniformArena::Allocation UniformArena::allocate(VkDeviceSize size)
+	{
+		const VkDeviceSize offset = m_head;
+		if (offset + size > m_frameSize)
+		{
+			vks::tools::exitFatal("UniformArena: out of space in the frame region", -1);
+		}
+		m_head = alignUp(offset + size, m_alignment);
+
+		Allocation allocation;
+		allocation.data = static_cast<char*>(m_buffer.mapped) + frameOffset(m_frame) + offset;
+		allocation.offset = static_cast<uint32_t>(offset);
+		return allocation;
+	}
+
+	uint32_t UniformArena::frameOffset(uint32_t frame) const
+	{
+		assert(frame < m_frameCount);
+		return static_cast<uint32_t>(m_frameSize * frame);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+* Uniform arena
+*
+* Linear allocator for per frame constants over one persistently mapped buffer, bound through
+* VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptors. The buffer is split into a ring of frame regions, a frame
+* resets its region and allocates from the start again, so constants of frames still in flight are never overwritten
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	class UniformArena
+	{
+	public:
+		struct Allocation
+		{
+			// Host pointer the constants are written to
+			void* data;
+			// Offset in the frame region, the dynamic offset of a bind is frameOffset(frame) + offset
+			uint32_t offset;
+		};
+
+		/**
+		* @param frameSize Bytes a frame may allocate, rounded up to the offset alignment
+		* @param frameCount Regions in the ring, e.g. one per command buffer recorded with the offsets of its region
+		*/
+		UniformArena(vks::VulkanDevice* device, VkDeviceSize frameSize, uint32_t frameCount);
+		~UniformArena();
+
+		/**
+		* Starts allocating from the region of the frame
+		*
+		* The GPU must be done with the previous use of the region, which holds when the command buffer of the frame
+		* may be reused (its fence was waited on or the queue is idle)
+		*/
+		void beginFrame(uint32_t frame);
+		/** @brief Allocates size bytes aligned to minUniformBufferOffsetAlignment in the region of the current frame */
+		Allocation allocate(VkDeviceSize size);
+		/** @brief Allocates and copies the constants, returns their offset in the frame region */
+		template <typename T>
+		uint32_t push(const T& constants)
+		{
+			Allocation allocation = allocate(sizeof(T));
+			memcpy(allocation.data, &constants, sizeof(T));
+			return allocation.offset;
+		}
+
+		/** @brief Descriptor of a dynamic uniform buffer binding, the bind adds the offset */
+		VkDescriptorBufferInfo descriptor(VkDeviceSize range) const { return { m_buffer.buffer, 0, range }; }
+		uint32_t frameOffset(uint32_t frame) const;
+		uint32_t frameCount() const { return m_frameCount; }
+		/** @brief Bytes allocated in the current frame including alignment padding */
+		VkDeviceSize used() const { return m_head; }
+	private:
+		vks::VulkanDevice* m_device;
+		vks::Buffer m_buffer;
+
+		VkDeviceSize m_alignment;
+		VkDeviceSize m_frameSize;
+		uint32_t m_frameCount;
+
+		uint32_t m_frame = 0;
+		VkDeviceSize m_head = 0;
+	};
+}
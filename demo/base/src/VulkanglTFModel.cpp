@@ -13,6 +13,28 @@
 
 #include "VulkanglTFModel.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
@@ -30,7 +52,10 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	// Decoding is deferred to Model::loadTextures, which decodes all images in parallel
+	image->as_is = true;
+	image->image.assign(bytes, bytes + size);
+	return true;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -40,6 +65,270 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 }
 
 
+#if !defined(__ANDROID__)
+/*
+	Read only memory mapping of a whole file
+*/
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& filename)
+	{
+		close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) {
+				data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				size = static_cast<size_t>(fileSize.QuadPart);
+				// The view keeps the mapping alive
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+#else
+		int file = ::open(filename.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat fileStat;
+		if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+			void* mapped = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped != MAP_FAILED) {
+				data = static_cast<const unsigned char*>(mapped);
+				size = static_cast<size_t>(fileStat.st_size);
+			}
+		}
+		::close(file);
+#endif
+		if (!data) {
+			size = 0;
+		}
+		return data != nullptr;
+	}
+
+	void close()
+	{
+		if (data) {
+#if defined(_WIN32)
+			UnmapViewOfFile(data);
+#else
+			munmap(const_cast<unsigned char*>(data), size);
+#endif
+		}
+		data = nullptr;
+		size = 0;
+	}
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+};
+
+/*
+	Memory mapped glTF buffers
+	tinygltf reads every buffer into a std::vector, for large models that doubles the memory needed while loading.
+	Instead the buffer files (or the binary chunk of a .glb) are mapped and the JSON passed to tinygltf only holds
+	a one byte placeholder for them. Images stored in mapped buffers are handed to tinygltf through the file system
+	callbacks under a placeholder uri.
+*/
+struct MappedglTF
+{
+	std::vector<std::unique_ptr<MappedFile>> files;
+	// Per glTF buffer, nullptr for buffers that tinygltf loaded (data uris)
+	std::vector<const unsigned char*> buffers;
+	// Files the model was read from
+	std::vector<std::string> filenames;
+	// Encoded images in mapped buffers, keyed by placeholder uri
+	std::map<std::string, std::pair<const unsigned char*, size_t>> images;
+
+	const std::pair<const unsigned char*, size_t>* findImage(const std::string& path) const
+	{
+		for (auto& image : images) {
+			if (path.size() >= image.first.size() && path.compare(path.size() - image.first.size(), image.first.size(), image.first) == 0) {
+				return &image.second;
+			}
+		}
+		return nullptr;
+	}
+};
+
+bool mappedFileExists(const std::string& absFilename, void* userData)
+{
+	return static_cast<MappedglTF*>(userData)->findImage(absFilename) || tinygltf::FileExists(absFilename, nullptr);
+}
+
+bool mappedReadWholeFile(std::vector<unsigned char>* out, std::string* err, const std::string& filepath, void* userData)
+{
+	const std::pair<const unsigned char*, size_t>* image = static_cast<MappedglTF*>(userData)->findImage(filepath);
+	if (image) {
+		out->assign(image->first, image->first + image->second);
+		return true;
+	}
+	return tinygltf::ReadWholeFile(out, err, filepath, nullptr);
+}
+
+std::string mappedExpandFilePath(const std::string& filepath, void* userData)
+{
+	return tinygltf::ExpandFilePath(filepath, nullptr);
+}
+
+bool mappedWriteWholeFile(std::string* err, const std::string& filepath, const std::vector<unsigned char>& contents, void* userData)
+{
+	return tinygltf::WriteWholeFile(err, filepath, contents, nullptr);
+}
+
+/*
+	Loads a .gltf or .glb file with its buffers memory mapped, see MappedglTF
+*/
+bool loadMappedglTF(tinygltf::TinyGLTF& gltfContext, tinygltf::Model& gltfModel, const std::string& filename, const std::string& basedir, bool binary, MappedglTF& mapped, std::string* error, std::string* warning)
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->open(filename)) {
+		*error = "File not found";
+		return false;
+	}
+
+	const unsigned char* json = file->data;
+	size_t jsonSize = file->size;
+	const unsigned char* binChunk = nullptr;
+	size_t binChunkSize = 0;
+	if (binary) {
+		// 12 byte header (magic, version, length) followed by the JSON chunk and an optional binary chunk
+		uint32_t header[5];
+		if (file->size < sizeof(header) || memcmp(file->data, "glTF", 4) != 0) {
+			*error = "Invalid .glb header";
+			return false;
+		}
+		memcpy(header, file->data, sizeof(header));
+		const size_t length = std::min<size_t>(header[2], file->size);
+		if (header[1] != 2 || header[4] != 0x4E4F534A /* JSON */ || sizeof(header) + header[3] > length) {
+			*error = "Invalid .glb JSON chunk";
+			return false;
+		}
+		json = file->data + sizeof(header);
+		jsonSize = header[3];
+		size_t binOffset = sizeof(header) + header[3];
+		uint32_t chunk[2];
+		if (binOffset + sizeof(chunk) <= length) {
+			memcpy(chunk, file->data + binOffset, sizeof(chunk));
+			if (chunk[1] == 0x004E4942 /* BIN */ && binOffset + sizeof(chunk) + chunk[0] <= length) {
+				binChunk = file->data + binOffset + sizeof(chunk);
+				binChunkSize = chunk[0];
+			}
+		}
+	}
+
+	nlohmann::json document = nlohmann::json::parse(json, json + jsonSize, nullptr, false);
+	if (document.is_discarded() || !document.is_object()) {
+		*error = "Invalid JSON";
+		return false;
+	}
+
+	const std::string placeholder = "data:application/octet-stream;base64,AA==";
+	auto buffers = document.find("buffers");
+	if (buffers != document.end() && buffers->is_array()) {
+		mapped.buffers.resize(buffers->size(), nullptr);
+		for (size_t i = 0; i < buffers->size(); i++) {
+			nlohmann::json& buffer = (*buffers)[i];
+			auto uri = buffer.find("uri");
+			auto byteLength = buffer.find("byteLength");
+			const size_t length = (byteLength != buffer.end() && byteLength->is_number_unsigned()) ? byteLength->get<size_t>() : 0;
+			if (uri == buffer.end() || !uri->is_string()) {
+				// The first buffer of a .glb without uri refers to the binary chunk
+				if (!binary || i != 0 || !binChunk || length > binChunkSize) {
+					continue;
+				}
+				mapped.buffers[i] = binChunk;
+			}
+			else {
+				const std::string path = uri->get<std::string>();
+				if (path.compare(0, 5, "data:") == 0) {
+					continue;
+				}
+				std::unique_ptr<MappedFile> bin(new MappedFile());
+				if (!bin->open(basedir + "/" + tinygltf::dlib::urldecode(path)) || bin->size < length) {
+					*error = "Could not map buffer \"" + path + "\"";
+					return false;
+				}
+				mapped.buffers[i] = bin->data;
+				mapped.files.push_back(std::move(bin));
+				mapped.filenames.push_back(basedir + "/" + tinygltf::dlib::urldecode(path));
+			}
+			buffer["uri"] = placeholder;
+			buffer["byteLength"] = 1;
+		}
+	}
+
+	auto images = document.find("images");
+	auto bufferViews = document.find("bufferViews");
+	if (images != document.end() && images->is_array() && bufferViews != document.end() && bufferViews->is_array()) {
+		for (size_t i = 0; i < images->size(); i++) {
+			nlohmann::json& image = (*images)[i];
+			auto viewIndex = image.find("bufferView");
+			if (viewIndex == image.end() || !viewIndex->is_number_unsigned() || viewIndex->get<size_t>() >= bufferViews->size()) {
+				continue;
+			}
+			const nlohmann::json& view = (*bufferViews)[viewIndex->get<size_t>()];
+			const size_t bufferIndex = view.value("buffer", size_t(0));
+			if (bufferIndex >= mapped.buffers.size() || !mapped.buffers[bufferIndex]) {
+				continue;
+			}
+			const std::string name = "vkgltf-mapped-image-" + std::to_string(i);
+			mapped.images[name] = std::make_pair(mapped.buffers[bufferIndex] + view.value("byteOffset", size_t(0)), view.value("byteLength", size_t(0)));
+			image.erase("bufferView");
+			image["uri"] = name;
+		}
+	}
+
+	const std::string text = document.dump();
+	mapped.files.push_back(std::move(file));
+	mapped.filenames.insert(mapped.filenames.begin(), filename);
+
+	tinygltf::FsCallbacks callbacks = { mappedFileExists, mappedExpandFilePath, mappedReadWholeFile, mappedWriteWholeFile, &mapped };
+	gltfContext.SetFsCallbacks(callbacks);
+	const bool loaded = gltfContext.LoadASCIIFromString(&gltfModel, error, warning, text.c_str(), static_cast<unsigned int>(text.size()), basedir);
+
+	mapped.buffers.resize(gltfModel.buffers.size(), nullptr);
+	for (size_t i = 0; i < gltfModel.buffers.size(); i++) {
+		if (!mapped.buffers[i]) {
+			mapped.buffers[i] = gltfModel.buffers[i].data.data();
+		}
+	}
+	return loaded;
+}
+#endif
+
+/*
+	Decodes an image stored as-is by loadImageDataFunc to RGBA8
+*/
+bool decodeglTfImage(tinygltf::Image& image)
+{
+	int width, height, components;
+	unsigned char* pixels = stbi_load_from_memory(image.image.data(), static_cast<int>(image.image.size()), &width, &height, &components, STBI_rgb_alpha);
+	if (!pixels) {
+		return false;
+	}
+	image.width = width;
+	image.height = height;
+	image.component = 4;
+	image.bits = 8;
+	image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+	image.image.assign(pixels, pixels + (size_t)width * height * 4);
+	image.as_is = false;
+	stbi_image_free(pixels);
+	return true;
+}
+
 /*
 	glTF texture loading class
 */
@@ -57,7 +346,7 @@ void vkglTF::Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->freeMemory(deviceMemory);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
@@ -78,6 +367,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 
 	if (!isKtx) {
 		// Texture was loaded using STB_Image
+		if (gltfimage.as_is && !decodeglTfImage(gltfimage)) {
+			vks::tools::exitFatal("Could not decode image \"" + gltfimage.uri + "\"", -1);
+		}
 
 		unsigned char* buffer = nullptr;
 		VkDeviceSize bufferSize = 0;
@@ -131,7 +423,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+		VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &stagingMemory, vks::MemoryCategory::Staging));
 		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 		uint8_t* data;
@@ -156,7 +448,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &deviceMemory, vks::MemoryTracker::imageCategory(imageCreateInfo.usage)));
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
 		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
@@ -203,7 +495,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 
 		device->flushCommandBuffer(copyCmd, copyQueue, true);
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		device->freeMemory(stagingMemory);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
 		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
@@ -332,7 +624,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+		VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &stagingMemory, vks::MemoryCategory::Staging));
 		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 		uint8_t* data;
@@ -375,7 +667,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &deviceMemory, vks::MemoryTracker::imageCategory(imageCreateInfo.usage)));
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
 		VkImageSubresourceRange subresourceRange = {};
@@ -390,12 +682,17 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		device->flushCommandBuffer(copyCmd, copyQueue);
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		device->freeMemory(stagingMemory);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
 		ktxTexture_Destroy(ktxTexture);
 	}
 
+	createSamplerAndView(textureSampler, format);
+}
+
+void vkglTF::Texture::createSamplerAndView(TextureSampler textureSampler, VkFormat format)
+{
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = textureSampler.magFilter;
@@ -479,67 +776,68 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 }
 
 /*
-	glTF mesh
+	glTF node transforms
 */
-vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
-	this->device = device;
-	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
-};
+uint32_t vkglTF::NodeTransforms::add(int32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& matrix)
+{
+	assert(parent < static_cast<int32_t>(size()));
+	parents.push_back(parent);
+	translations.push_back(translation);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	matrices.push_back(matrix);
+	worldMatrices.push_back(glm::mat4(1.0f));
+	dirty.push_back(1);
+	changed.push_back(0);
+	return size() - 1;
+}
 
-vkglTF::Mesh::~Mesh() {
-	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
+glm::mat4 vkglTF::NodeTransforms::localMatrix(uint32_t index) const
+{
+	return glm::translate(glm::mat4(1.0f), translations[index]) * glm::mat4_cast(rotations[index]) * glm::scale(glm::mat4(1.0f), scales[index]) * matrices[index];
+}
+
+bool vkglTF::NodeTransforms::update()
+{
+	bool anyChanged = false;
+	for (uint32_t i = 0; i < size(); i++) {
+		const int32_t parent = parents[i];
+		// The parent was visited before, a changed parent moves the whole subtree
+		changed[i] = dirty[i] || (parent >= 0 && changed[parent]);
+		if (changed[i]) {
+			worldMatrices[i] = parent >= 0 ? worldMatrices[parent] * localMatrix(i) : localMatrix(i);
+			dirty[i] = 0;
+			anyChanged = true;
+		}
+	}
+	return anyChanged;
 }
 
 /*
 	glTF node
 */
 glm::mat4 vkglTF::Node::localMatrix() {
-	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+	return transforms->localMatrix(transform);
 }
 
 glm::mat4 vkglTF::Node::getMatrix() {
-	glm::mat4 m = localMatrix();
-	vkglTF::Node *p = parent;
-	while (p) {
-		m = p->localMatrix() * m;
-		p = p->parent;
-	}
-	return m;
+	return transforms->worldMatrices[transform];
 }
 
 void vkglTF::Node::update() {
-	if (mesh) {
-		glm::mat4 m = getMatrix();
+	if (mesh && mesh->storageBuffer.mapped) {
+		const glm::mat4 &m = getMatrix();
+		// The palette is written in place, only the joints of the skin are touched
+		uint8_t* mapped = static_cast<uint8_t*>(mesh->storageBuffer.mapped);
+		memcpy(mapped, &m, sizeof(glm::mat4));
 		if (skin) {
-			mesh->uniformBlock.matrix = m;
-			// Update join matrices
+			glm::mat4* jointMatrices = reinterpret_cast<glm::mat4*>(mapped + Mesh::jointMatricesOffset);
 			glm::mat4 inverseTransform = glm::inverse(m);
 			for (size_t i = 0; i < skin->joints.size(); i++) {
-				vkglTF::Node *jointNode = skin->joints[i];
-				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
+				jointMatrices[i] = inverseTransform * transforms->worldMatrices[skin->joints[i]->transform] * skin->inverseBindMatrices[i];
 			}
-			mesh->uniformBlock.jointcount = (float)skin->joints.size();
-			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-		} else {
-			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
 		}
 	}
-
-	for (auto& child : children) {
-		child->update();
-	}
 }
 
 vkglTF::Node::~Node() {
@@ -551,6 +849,60 @@ vkglTF::Node::~Node() {
 	}
 }
 
+/*
+	glTF animation sampler
+*/
+
+uint32_t vkglTF::AnimationSampler::findKeyframe(float time, uint32_t cursor) const
+{
+	const uint32_t lastInterval = static_cast<uint32_t>(inputs.size()) - 2;
+	cursor = std::min(cursor, lastInterval);
+	// Playback advances by a few keyframes per frame at most, seeks and loops fall back to a binary search
+	for (uint32_t step = 0; step < 4 && time >= inputs[cursor]; step++) {
+		if (time <= inputs[cursor + 1] || cursor == lastInterval) {
+			return cursor;
+		}
+		cursor++;
+	}
+	const uint32_t next = static_cast<uint32_t>(std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin());
+	return next == 0 ? 0 : std::min(next - 1, lastInterval);
+}
+
+glm::vec4 vkglTF::AnimationSampler::sample(uint32_t keyframe, float time, bool rotation) const
+{
+	const float duration = inputs[keyframe + 1] - inputs[keyframe];
+	// Times outside of the keyframes clamp to the first or last value
+	const float u = duration > 0.0f ? glm::clamp((time - inputs[keyframe]) / duration, 0.0f, 1.0f) : 0.0f;
+	const glm::vec4 &v0 = outputsVec4[keyframe];
+	const glm::vec4 &v1 = outputsVec4[keyframe + 1];
+
+	switch (interpolation) {
+	case InterpolationType::STEP:
+		return u < 1.0f ? v0 : v1;
+	case InterpolationType::CUBICSPLINE:
+		if (outTangents.size() > keyframe && inTangents.size() > keyframe + 1) {
+			// Hermite spline, tangents are scaled by the duration of the interval
+			const float u2 = u * u;
+			const float u3 = u2 * u;
+			glm::vec4 value =
+				(2.0f * u3 - 3.0f * u2 + 1.0f) * v0 +
+				(u3 - 2.0f * u2 + u) * duration * outTangents[keyframe] +
+				(-2.0f * u3 + 3.0f * u2) * v1 +
+				(u3 - u2) * duration * inTangents[keyframe + 1];
+			return rotation ? glm::normalize(value) : value;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (rotation) {
+		const glm::quat q = glm::normalize(glm::slerp(glm::quat(v0.w, v0.x, v0.y, v0.z), glm::quat(v1.w, v1.x, v1.y, v1.z), u));
+		return glm::vec4(q.x, q.y, q.z, q.w);
+	}
+	return glm::mix(v0, v1, u);
+}
+
 /*
 	glTF default vertex layout with easy Vulkan mapping functions
 */
@@ -632,7 +984,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
 	memAllocInfo.allocationSize = memReqs.size;
 	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+	VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &stagingMemory, vks::MemoryCategory::Staging));
 	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 	// Copy texture data into staging buffer
@@ -665,7 +1017,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
 	memAllocInfo.allocationSize = memReqs.size;
 	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
+	VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &emptyTexture.deviceMemory, vks::MemoryTracker::imageCategory(imageCreateInfo.usage)));
 	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
 
 	VkImageSubresourceRange subresourceRange{};
@@ -682,7 +1034,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+	device->freeMemory(stagingMemory);
 	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -716,9 +1068,11 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 vkglTF::Model::~Model()
 {
 	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
+	device->freeMemory(vertices.memory);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	device->freeMemory(indices.memory);
+	jointPalette.destroy();
+	instances.destroy();
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -737,6 +1091,12 @@ vkglTF::Model::~Model()
 	emptyTexture.destroy();
 }
 
+const unsigned char* vkglTF::Model::accessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor) const
+{
+	const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+	return bufferData[bufferView.buffer] + bufferView.byteOffset + accessor.byteOffset;
+}
+
 void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
 {
 	vkglTF::Node *newNode = new Node{};
@@ -744,30 +1104,30 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	newNode->parent = parent;
 	newNode->name = node.name;
 	newNode->skinIndex = node.skin;
-	newNode->matrix = glm::mat4(1.0f);
 
 	// Generate local node matrix
 	glm::vec3 translation = glm::vec3(0.0f);
 	if (node.translation.size() == 3) {
 		translation = glm::make_vec3(node.translation.data());
-		newNode->translation = translation;
 	}
-	glm::mat4 rotation = glm::mat4(1.0f);
+	glm::quat rotation = glm::quat();
 	if (node.rotation.size() == 4) {
-		glm::quat q = glm::make_quat(node.rotation.data());
-		newNode->rotation = glm::mat4(q);
+		rotation = glm::make_quat(node.rotation.data());
 	}
 	glm::vec3 scale = glm::vec3(1.0f);
 	if (node.scale.size() == 3) {
 		scale = glm::make_vec3(node.scale.data());
-		newNode->scale = scale;
 	}
+	glm::mat4 matrix = glm::mat4(1.0f);
 	if (node.matrix.size() == 16) {
-		newNode->matrix = glm::make_mat4x4(node.matrix.data());
+		matrix = glm::make_mat4x4(node.matrix.data());
 		if (globalscale != 1.0f) {
-			//newNode->matrix = glm::scale(newNode->matrix, glm::vec3(globalscale));
+			//matrix = glm::scale(matrix, glm::vec3(globalscale));
 		}
 	};
+	// Added before the children, so parents precede their children in the transform store
+	newNode->transforms = &transforms;
+	newNode->transform = transforms.add(parent ? static_cast<int32_t>(parent->transform) : -1, translation, rotation, scale, matrix);
 
 	// Node with children
 	if (node.children.size() > 0) {
@@ -776,10 +1136,20 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 		}
 	}
 
+	// Node instancing a mesh that was loaded for another node
+	const auto loadedMesh = shareMeshes ? loadedMeshes.find(node.mesh) : loadedMeshes.end();
+	if (node.mesh > -1 && loadedMesh != loadedMeshes.end()) {
+		Mesh *newMesh = new Mesh(device);
+		newMesh->name = loadedMesh->second->name;
+		for (const Primitive* primitive : loadedMesh->second->primitives) {
+			newMesh->primitives.push_back(new Primitive(*primitive));
+		}
+		newNode->mesh = newMesh;
+	}
 	// Node contains mesh data
-	if (node.mesh > -1) {
+	else if (node.mesh > -1) {
 		const tinygltf::Mesh mesh = model.meshes[node.mesh];
-		Mesh *newMesh = new Mesh(device, newNode->matrix);
+		Mesh *newMesh = new Mesh(device);
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
 			const tinygltf::Primitive &primitive = mesh.primitives[j];
@@ -804,25 +1174,37 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 				const uint16_t *bufferJoints = nullptr;
 				const float *bufferWeights = nullptr;
 
+				// Strides in components, attributes may be interleaved
+				int posStride;
+				int normStride;
+				int uv0Stride;
+				int colorStride;
+				int tangentStride;
+				int jointStride;
+				int weightStride;
+
 				// Position attribute is required
 				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
 
 				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
 				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
+				bufferPos = reinterpret_cast<const float *>(accessorData(model, posAccessor));
+				posStride = posAccessor.ByteStride(posView) / sizeof(float);
 				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
 				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
 
 				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
 					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
 					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+					bufferNormals = reinterpret_cast<const float *>(accessorData(model, normAccessor));
+					normStride = normAccessor.ByteStride(normView) / sizeof(float);
 				}
 
 				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
 					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
 					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+					bufferTexCoords = reinterpret_cast<const float *>(accessorData(model, uvAccessor));
+					uv0Stride = uvAccessor.ByteStride(uvView) / sizeof(float);
 				}
 
 				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
@@ -831,14 +1213,16 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
 					// Color buffer are either of type vec3 or vec4
 					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
+					bufferColors = reinterpret_cast<const float*>(accessorData(model, colorAccessor));
+					colorStride = colorAccessor.ByteStride(colorView) / sizeof(float);
 				}
 
 				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
 				{
 					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
 					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+					bufferTangents = reinterpret_cast<const float *>(accessorData(model, tangentAccessor));
+					tangentStride = tangentAccessor.ByteStride(tangentView) / sizeof(float);
 				}
 
 				// Skinning
@@ -846,13 +1230,15 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
 					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
 					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
+					bufferJoints = reinterpret_cast<const uint16_t *>(accessorData(model, jointAccessor));
+					jointStride = jointAccessor.ByteStride(jointView) / sizeof(uint16_t);
 				}
 
 				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
 					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
 					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+					bufferWeights = reinterpret_cast<const float *>(accessorData(model, uvAccessor));
+					weightStride = uvAccessor.ByteStride(uvView) / sizeof(float);
 				}
 
 				hasSkin = (bufferJoints && bufferWeights);
@@ -861,54 +1247,58 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 
 				for (size_t v = 0; v < posAccessor.count; v++) {
 					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
+					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * posStride]), 1.0f);
+					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * normStride]) : glm::vec3(0.0f)));
+					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * uv0Stride]) : glm::vec3(0.0f);
 					if (bufferColors) {
 						switch (numColorComponents) {
 							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
+								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * colorStride]), 1.0f);
+								break;
 							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
+								vert.color = glm::make_vec4(&bufferColors[v * colorStride]);
+								break;
 						}
 					}
 					else {
 						vert.color = glm::vec4(1.0f);
 					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
+					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * tangentStride])) : glm::vec4(0.0f);
+					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * jointStride])) : glm::vec4(0.0f);
+					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightStride]) : glm::vec4(0.0f);
 					vertexBuffer.push_back(vert);
 				}
 			}
 			// Indices
 			{
 				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+				const void *dataPtr = accessorData(model, accessor);
 
 				indexCount = static_cast<uint32_t>(accessor.count);
+				indexBuffer.reserve(indexBuffer.size() + accessor.count);
 
+				// Index buffer views are tightly packed, read them straight from the (mapped) buffer
 				switch (accessor.componentType) {
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
+					const uint32_t *buf = static_cast<const uint32_t*>(dataPtr);
+					if (vertexStart == 0) {
+						indexBuffer.insert(indexBuffer.end(), buf, buf + accessor.count);
+						break;
+					}
 					for (size_t index = 0; index < accessor.count; index++) {
 						indexBuffer.push_back(buf[index] + vertexStart);
 					}
 					break;
 				}
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
+					const uint16_t *buf = static_cast<const uint16_t*>(dataPtr);
 					for (size_t index = 0; index < accessor.count; index++) {
 						indexBuffer.push_back(buf[index] + vertexStart);
 					}
 					break;
 				}
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
+					const uint8_t *buf = static_cast<const uint8_t*>(dataPtr);
 					for (size_t index = 0; index < accessor.count; index++) {
 						indexBuffer.push_back(buf[index] + vertexStart);
 					}
@@ -926,6 +1316,7 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			newMesh->primitives.push_back(newPrimitive);
 		}
 		newNode->mesh = newMesh;
+		loadedMeshes[node.mesh] = newMesh;
 	}
 	if (parent) {
 		parent->children.push_back(newNode);
@@ -957,22 +1348,241 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 		// Get inverse bind matrices from buffer
 		if (source.inverseBindMatrices > -1) {
 			const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
-			const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-			const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
 			newSkin->inverseBindMatrices.resize(accessor.count);
-			memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+			memcpy(newSkin->inverseBindMatrices.data(), accessorData(gltfModel, accessor), accessor.count * sizeof(glm::mat4));
 		}
 
 		skins.push_back(newSkin);
 	}
 }
 
-void vkglTF::Model::loadTextures(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+/*
+	Pipelined upload of decoded glTF images
+	Each batch owns one segment of a persistently mapped staging ring and records the copies and mip blits of the
+	images that fit into it. Batches are submitted with their own fence, so the GPU works on one batch while the
+	next one is filled. A segment is only reused after the fence of its previous batch signaled.
+*/
+class ImageUploadPipeline
 {
-	for (tinygltf::Texture &tex : gltfModel.textures) {
-		tinygltf::Image image = gltfModel.images[tex.source];
+public:
+	ImageUploadPipeline(vks::VulkanDevice* device, VkQueue queue) : device(device), queue(queue)
+	{
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, segmentSize * segmentCount));
+		VK_CHECK_RESULT(staging.map());
+		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo();
+		for (Batch& batch : batches) {
+			batch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &batch.fence));
+		}
+		copyAlignment = std::max<VkDeviceSize>(16, device->properties.limits.optimalBufferCopyOffsetAlignment);
+	}
+
+	~ImageUploadPipeline()
+	{
+		finish();
+		for (Batch& batch : batches) {
+			vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+		}
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		staging.destroy();
+	}
+
+	// Creates the image, view and sampler and records the upload of the RGBA8 texels, the texture is ready after finish()
+	void upload(vkglTF::Texture& texture, const unsigned char* rgba, uint32_t width, uint32_t height, vkglTF::TextureSampler textureSampler)
+	{
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		const VkDeviceSize size = (VkDeviceSize)width * height * 4;
+
+		texture.device = device;
+		texture.width = width;
+		texture.height = height;
+		texture.mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+		texture.layerCount = 1;
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = texture.mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, texture.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, &texture.deviceMemory, vks::MemoryTracker::imageCategory(imageCreateInfo.usage)));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, texture.image, texture.deviceMemory, 0));
+
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		texture.createSamplerAndView(textureSampler, format);
+
+		// Images larger than a segment get their own staging buffer, released with the batch
+		Batch* batch = &batches[current];
+		VkDeviceSize offset = (batch->used + copyAlignment - 1) / copyAlignment * copyAlignment;
+		if (batch->recording && size <= segmentSize && offset + size > segmentSize) {
+			flush();
+			batch = &batches[current];
+			offset = 0;
+		}
+		if (!batch->recording) {
+			begin();
+			offset = 0;
+		}
+		VkBuffer srcBuffer;
+		VkDeviceSize srcOffset;
+		if (size <= segmentSize) {
+			srcBuffer = staging.buffer;
+			srcOffset = current * segmentSize + offset;
+			memcpy(static_cast<unsigned char*>(staging.mapped) + srcOffset, rgba, size);
+			batch->used = offset + size;
+		}
+		else {
+			vks::Buffer dedicated;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &dedicated, size, (void*)rgba));
+			batch->dedicatedStaging.push_back(dedicated);
+			srcBuffer = dedicated.buffer;
+			srcOffset = 0;
+		}
+
+		VkCommandBuffer cmd = batch->commandBuffer;
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = texture.mipLevels;
+		subresourceRange.layerCount = 1;
+		vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.bufferOffset = srcOffset;
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent = { width, height, 1 };
+		vkCmdCopyBufferToImage(cmd, srcBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+
+		// Generate the mip chain, every level is blitted from the previous one
+		VkImageSubresourceRange mipSubRange = subresourceRange;
+		mipSubRange.levelCount = 1;
+		for (uint32_t i = 1; i < texture.mipLevels; i++) {
+			mipSubRange.baseMipLevel = i - 1;
+			vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipSubRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			VkImageBlit imageBlit{};
+			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageBlit.srcSubresource.layerCount = 1;
+			imageBlit.srcSubresource.mipLevel = i - 1;
+			imageBlit.srcOffsets[1].x = int32_t(std::max(width >> (i - 1), 1u));
+			imageBlit.srcOffsets[1].y = int32_t(std::max(height >> (i - 1), 1u));
+			imageBlit.srcOffsets[1].z = 1;
+			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageBlit.dstSubresource.layerCount = 1;
+			imageBlit.dstSubresource.mipLevel = i;
+			imageBlit.dstOffsets[1].x = int32_t(std::max(width >> i, 1u));
+			imageBlit.dstOffsets[1].y = int32_t(std::max(height >> i, 1u));
+			imageBlit.dstOffsets[1].z = 1;
+			vkCmdBlitImage(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+		}
+
+		// All levels but the last one were blit sources
+		if (texture.mipLevels > 1) {
+			mipSubRange.baseMipLevel = 0;
+			mipSubRange.levelCount = texture.mipLevels - 1;
+			vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipSubRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		}
+		mipSubRange.baseMipLevel = texture.mipLevels - 1;
+		mipSubRange.levelCount = 1;
+		vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipSubRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
 
-		vkglTF::TextureSampler textureSampler;
+	// Submits the batch being recorded, e.g. so the GPU can start on it while the next images are decoded
+	void flush()
+	{
+		Batch& batch = batches[current];
+		if (!batch.recording) {
+			return;
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, batch.fence));
+		batch.recording = false;
+		batch.pending = true;
+		current = (current + 1) % segmentCount;
+	}
+
+	// Submits outstanding work and waits for all batches
+	void finish()
+	{
+		flush();
+		for (Batch& batch : batches) {
+			wait(batch);
+		}
+	}
+
+private:
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		VkDeviceSize used = 0;
+		bool recording = false;
+		bool pending = false;
+		std::vector<vks::Buffer> dedicatedStaging;
+	};
+
+	static const uint32_t segmentCount = 3;
+	static const VkDeviceSize segmentSize = 16 * 1024 * 1024;
+
+	vks::VulkanDevice* device;
+	VkQueue queue;
+	VkCommandPool commandPool;
+	vks::Buffer staging;
+	VkDeviceSize copyAlignment;
+	Batch batches[segmentCount];
+	uint32_t current = 0;
+
+	void wait(Batch& batch)
+	{
+		if (!batch.pending) {
+			return;
+		}
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+		for (vks::Buffer& buffer : batch.dedicatedStaging) {
+			buffer.destroy();
+		}
+		batch.dedicatedStaging.clear();
+		batch.pending = false;
+	}
+
+	void begin()
+	{
+		Batch& batch = batches[current];
+		// The segment may still be read by the previous batch using it
+		wait(batch);
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch.commandBuffer, &cmdBufInfo));
+		batch.used = 0;
+		batch.recording = true;
+	}
+};
+
+void vkglTF::Model::loadTextures(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+{
+	textures.resize(gltfModel.textures.size());
+
+	// Images decoded by stb_image are shared by all textures referencing them, ktx files are loaded by fromglTfImage
+	std::vector<std::vector<uint32_t>> imageTextures(gltfModel.images.size());
+	std::vector<uint32_t> ktxTextures;
+	std::vector<vkglTF::TextureSampler> samplers(gltfModel.textures.size());
+	for (uint32_t i = 0; i < gltfModel.textures.size(); i++) {
+		tinygltf::Texture &tex = gltfModel.textures[i];
+		vkglTF::TextureSampler &textureSampler = samplers[i];
 		if (tex.sampler == -1) {
 			// No sampler specified, use a default one
 			textureSampler.magFilter = VK_FILTER_LINEAR;
@@ -985,10 +1595,103 @@ void vkglTF::Model::loadTextures(tinygltf::Model &gltfModel, vks::VulkanDevice *
 			textureSampler = textureSamplers[tex.sampler];
 		}
 
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, textureSampler, device, transferQueue);
-		textures.push_back(texture);
+		const tinygltf::Image &image = gltfModel.images[tex.source];
+		if (image.as_is) {
+			imageTextures[tex.source].push_back(i);
+		}
+		else {
+			ktxTextures.push_back(i);
+		}
+	}
+	std::vector<uint32_t> decodeList;
+	for (uint32_t i = 0; i < imageTextures.size(); i++) {
+		if (!imageTextures[i].empty()) {
+			decodeList.push_back(i);
+		}
+	}
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(device->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+	assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+	assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+
+	// Decode on worker threads, the number of decoded images waiting for upload is limited to bound memory use
+	const uint32_t threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<uint32_t>(decodeList.size())));
+	const uint32_t maxDecodedImages = threadCount * 2;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<uint32_t> decoded;
+	uint32_t imagesInFlight = 0;
+	uint32_t nextImage = 0;
+	std::vector<std::thread> workers;
+	for (uint32_t t = 0; t < threadCount && !decodeList.empty(); t++) {
+		workers.push_back(std::thread([&]() {
+			while (true) {
+				uint32_t imageIndex;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [&] { return imagesInFlight < maxDecodedImages || nextImage == decodeList.size(); });
+					if (nextImage == decodeList.size()) {
+						return;
+					}
+					imageIndex = decodeList[nextImage++];
+					imagesInFlight++;
+				}
+				// A failed decode leaves the image as-is and is reported by the main thread
+				decodeglTfImage(gltfModel.images[imageIndex]);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					decoded.push_back(imageIndex);
+				}
+				condition.notify_all();
+			}
+		}));
+	}
+
+	// External ktx files are loaded while the workers decode
+	for (uint32_t i : ktxTextures) {
+		tinygltf::Image image = gltfModel.images[gltfModel.textures[i].source];
+		textures[i].fromglTfImage(image, path, samplers[i], device, transferQueue);
+	}
+
+	{
+		ImageUploadPipeline uploadPipeline(device, transferQueue);
+		for (size_t uploaded = 0; uploaded < decodeList.size(); uploaded++) {
+			uint32_t imageIndex;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (decoded.empty()) {
+					// Let the GPU work on the recorded uploads while waiting for the next image
+					lock.unlock();
+					uploadPipeline.flush();
+					lock.lock();
+					condition.wait(lock, [&] { return !decoded.empty(); });
+				}
+				imageIndex = decoded.front();
+				decoded.pop_front();
+			}
+
+			tinygltf::Image &image = gltfModel.images[imageIndex];
+			if (image.as_is) {
+				vks::tools::exitFatal("Could not decode image \"" + image.uri + "\"", -1);
+			}
+			for (uint32_t i : imageTextures[imageIndex]) {
+				uploadPipeline.upload(textures[i], image.image.data(), image.width, image.height, samplers[i]);
+			}
+			std::vector<unsigned char>().swap(image.image);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				imagesInFlight--;
+			}
+			condition.notify_all();
+		}
+		uploadPipeline.finish();
 	}
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
 }
@@ -1125,16 +1828,11 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 			// Read sampler input time values
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
 
 				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-				float *buf = new float[accessor.count];
-				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
-				for (size_t index = 0; index < accessor.count; index++) {
-					sampler.inputs.push_back(buf[index]);
-				}
+				const float *buf = reinterpret_cast<const float*>(accessorData(gltfModel, accessor));
+				sampler.inputs.assign(buf, buf + accessor.count);
 
 				for (auto input : sampler.inputs) {
 					if (input < animation.start) {
@@ -1149,26 +1847,21 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 			// Read sampler output T/R/S values 
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
+				const unsigned char *dataPtr = accessorData(gltfModel, accessor);
 
 				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
 				switch (accessor.type) {
 				case TINYGLTF_TYPE_VEC3: {
-					glm::vec3 *buf = new glm::vec3[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
+					const float *buf = reinterpret_cast<const float*>(dataPtr);
 					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
+						sampler.outputsVec4.push_back(glm::vec4(glm::make_vec3(&buf[index * 3]), 0.0f));
 					}
 					break;
 				}
 				case TINYGLTF_TYPE_VEC4: {
-					glm::vec4 *buf = new glm::vec4[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
-					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(buf[index]);
-					}
+					const glm::vec4 *buf = reinterpret_cast<const glm::vec4*>(dataPtr);
+					sampler.outputsVec4.insert(sampler.outputsVec4.end(), buf, buf + accessor.count);
 					break;
 				}
 				default: {
@@ -1178,6 +1871,17 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 				}
 			}
 
+			// Cubic spline outputs hold an in-tangent, the value and an out-tangent per keyframe
+			if (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE && sampler.outputsVec4.size() == sampler.inputs.size() * 3) {
+				std::vector<glm::vec4> outputs;
+				outputs.swap(sampler.outputsVec4);
+				for (size_t index = 0; index < sampler.inputs.size(); index++) {
+					sampler.inTangents.push_back(outputs[index * 3]);
+					sampler.outputsVec4.push_back(outputs[index * 3 + 1]);
+					sampler.outTangents.push_back(outputs[index * 3 + 2]);
+				}
+			}
+
 			animation.samplers.push_back(sampler);
 		}
 
@@ -1213,6 +1917,8 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
 {
+	const auto loadStart = std::chrono::high_resolution_clock::now();
+
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
@@ -1237,82 +1943,131 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
-
 	std::vector<uint32_t> indexBuffer;
 	std::vector<Vertex> vertexBuffer;
 
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadTextureSamplers(gltfModel);
-			loadTextures(gltfModel, device, transferQueue);
-		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+	// The processed model is cached next to the glTF file, a valid cache skips parsing the glTF file
+#if defined(__ANDROID__)
+	const std::string cacheFile;
+#else
+	const std::string cacheFile = (fileLoadingFlags & FileLoadingFlags::DontUseCache) ? std::string() : filename + ".cache";
+#endif
+	loadedFromCache = !cacheFile.empty() && loadFromCache(cacheFile, fileLoadingFlags, scale, transferQueue, indexBuffer, vertexBuffer);
+
+	if (!loadedFromCache) {
+		const bool binary = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".glb") == 0;
+		std::vector<std::string> dependencies;
+#if defined(__ANDROID__)
+		bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, filename) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+		bufferData.clear();
+		for (tinygltf::Buffer &buffer : gltfModel.buffers) {
+			bufferData.push_back(buffer.data.data());
 		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
+#else
+		// Buffers stay memory mapped until the model data has been read
+		MappedglTF mapped;
+		bool fileLoaded = loadMappedglTF(gltfContext, gltfModel, filename, path, binary, mapped, &error, &warning);
+		bufferData = mapped.buffers;
+		dependencies = mapped.filenames;
+#endif
+
+		// Images are decoded in place by loadTextures, the cache keeps the encoded ones
+		std::vector<tinygltf::Image> encodedImages;
+		if (fileLoaded && !cacheFile.empty()) {
+			encodedImages = gltfModel.images;
 		}
-		loadSkins(gltfModel);
 
-		for (auto node : linearNodes) {
+		if (fileLoaded) {
+			if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+				loadTextureSamplers(gltfModel);
+				loadTextures(gltfModel, device, transferQueue);
+			}
+			loadMaterials(gltfModel);
+			const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+			// Pre-transformed and CPU skinned vertices differ per node, so nodes can't share them
+			shareMeshes = !(fileLoadingFlags & (FileLoadingFlags::PreTransformVertices | FileLoadingFlags::CpuSkinning));
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+				loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			}
+			loadedMeshes.clear();
+			if (gltfModel.animations.size() > 0) {
+				loadAnimations(gltfModel);
+			}
+			loadSkins(gltfModel);
+			// Mapped buffers are released when leaving loadFromFile
+			bufferData.clear();
+
 			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
+			for (auto node : linearNodes) {
+				if (node->skinIndex > -1) {
+					node->skin = skins[node->skinIndex];
+				}
 			}
+			createJointPalette();
 			// Initial pose
-			if (node->mesh) {
-				node->update();
-			}
+			updateNodes();
+		}
+		else {
+			// TODO: throw
+			vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
+			return;
 		}
-	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
-		return;
-	}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
+		// Pre-Calculations for requested features
+		if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
+			const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+			const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+			const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+			// Vertices shared by several nodes are only processed once
+			std::set<uint32_t> processedVertices;
+			for (Node* node : linearNodes) {
+				if (node->mesh) {
+					const glm::mat4 localMatrix = node->getMatrix();
+					for (Primitive* primitive : node->mesh->primitives) {
+						if (!processedVertices.insert(primitive->firstVertex).second) {
+							continue;
 						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
+						for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+							Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
+							// Pre-transform vertex positions by node-hierarchy
+							if (preTransform) {
+								vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
+								vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
+							}
+							// Flip Y-Axis of vertex positions
+							if (flipY) {
+								vertex.pos.y *= -1.0f;
+								vertex.normal.y *= -1.0f;
+							}
+							// Pre-Multiply vertex colors with material base color
+							if (preMultiplyColor) {
+								vertex.color = primitive->material.baseColorFactor * vertex.color;
+							}
 						}
 					}
 				}
 			}
 		}
-	}
 
-	for (auto extension : gltfModel.extensionsUsed) {
-		if (extension == "KHR_materials_pbrSpecularGlossiness") {
-			std::cout << "Required extension: " << extension;
-			metallicRoughnessWorkflow = false;
+		for (auto extension : gltfModel.extensionsUsed) {
+			if (extension == "KHR_materials_pbrSpecularGlossiness") {
+				std::cout << "Required extension: " << extension;
+				metallicRoughnessWorkflow = false;
+			}
+		}
+
+		if (!cacheFile.empty()) {
+			writeCache(cacheFile, fileLoadingFlags, scale, dependencies, gltfModel, encodedImages, indexBuffer, vertexBuffer);
 		}
 	}
 
+	if (fileLoadingFlags & FileLoadingFlags::CpuSkinning) {
+		prepareCpuSkinning(vertexBuffer);
+	}
+	// Skinned vertices are rewritten by the CPU, so the vertex buffer has to stay host visible
+	const bool hostVisibleVertices = !cpuSkinnedMeshes.empty();
+
 	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
 	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 	indices.count = static_cast<uint32_t>(indexBuffer.size());
@@ -1327,13 +2082,15 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 
 	// Create staging buffers
 	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
+	if (!hostVisibleVertices) {
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			vertexBufferSize,
+			&vertexStaging.buffer,
+			&vertexStaging.memory,
+			vertexBuffer.data()));
+	}
 	// Index data
 	VK_CHECK_RESULT(device->createBuffer(
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -1345,12 +2102,28 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 
 	// Create device local buffers
 	// Vertex buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
-		&vertices.buffer,
-		&vertices.memory));
+	if (hostVisibleVertices) {
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			vertexBufferSize,
+			&vertices.buffer,
+			&vertices.memory,
+			vertexBuffer.data()));
+		void* mapped;
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, vertices.memory, 0, vertexBufferSize, 0, &mapped));
+		mappedVertices = static_cast<Vertex*>(mapped);
+		for (auto& skinnedMesh : cpuSkinnedMeshes) {
+			skinVertices(skinnedMesh);
+		}
+	} else {
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vertexBufferSize,
+			&vertices.buffer,
+			&vertices.memory));
+	}
 	// Index buffer
 	VK_CHECK_RESULT(device->createBuffer(
 	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
@@ -1364,20 +2137,25 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 
 	VkBufferCopy copyRegion = {};
 
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+	if (!hostVisibleVertices) {
+		copyRegion.size = vertexBufferSize;
+		vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+	}
 
 	copyRegion.size = indexBufferSize;
 	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
 
 	device->flushCommandBuffer(copyCmd, transferQueue, true);
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
+	if (!hostVisibleVertices) {
+		vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
+		device->freeMemory(vertexStaging.memory);
+	}
 	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	device->freeMemory(indexStaging.memory);
 
 	getSceneDimensions();
+	prepareInstances();
 
 	// Setup descriptors
 	uint32_t meshCount = 0;
@@ -1403,7 +2181,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		imageCount += maxImageCountPerMaterial;
 	}
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, meshCount },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshCount },
 		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount }
 	};
 
@@ -1414,12 +2192,12 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	descriptorPoolCI.maxSets = meshCount + materialCount;
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
-	// Descriptors for per-node uniform buffers
+	// Descriptors for the per-node ranges of the joint palette
 	{
 		// Layout is global, so only create if it hasn't already been created before
 		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
 			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1459,6 +2237,8 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			material.createDescriptorSet(descriptorPool, descriptorSetLayoutImage, descriptorBindingFlags, &emptyTexture);
 		}
 	}
+
+	loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
 }
 
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
@@ -1469,9 +2249,35 @@ void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 	buffersBound = true;
 }
 
+void vkglTF::Model::bindInstances(VkCommandBuffer commandBuffer, uint32_t binding)
+{
+	const VkDeviceSize offsets[1] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, binding, 1, &instances.buffer, offsets);
+}
+
+static vkglTF::PushConstBlockMaterial materialPushConstants(const vkglTF::Material& material)
+{
+	vkglTF::PushConstBlockMaterial pushConstBlockMaterial{};
+	// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
+	pushConstBlockMaterial.colorTextureSet = material.baseColorTexture != nullptr ? material.texCoordSets.baseColor : -1;
+	pushConstBlockMaterial.normalTextureSet = material.normalTexture != nullptr ? material.texCoordSets.normal : -1;
+	pushConstBlockMaterial.alphaMask = static_cast<float>(material.alphaMode == vkglTF::Material::ALPHAMODE_MASK);
+	pushConstBlockMaterial.alphaMaskCutoff = material.alphaCutoff;
+
+	// Metallic roughness workflow
+	pushConstBlockMaterial.physicalDescriptorTextureSet = material.metallicRoughnessTexture != nullptr ? material.texCoordSets.metallicRoughness : -1;
+	pushConstBlockMaterial.baseColorFactor = material.baseColorFactor;
+	pushConstBlockMaterial.metallicFactor = material.metallicFactor;
+	pushConstBlockMaterial.roughnessFactor = material.roughnessFactor;
+
+	pushConstBlockMaterial.emissiveTextureSet = material.emissiveTexture != nullptr ? material.texCoordSets.emissive : -1;
+	pushConstBlockMaterial.emissiveFactor = material.emissiveFactor;
+	return pushConstBlockMaterial;
+}
+
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t pushConstantOffset)
 {
-	if (node->mesh) {
+	if (node->mesh && node->mesh->instanceCount > 0) {
 		for (Primitive* primitive : node->mesh->primitives) {
 			bool skip = false;
 			const vkglTF::Material& material = primitive->material;
@@ -1491,26 +2297,11 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 
 				if (renderFlags & RenderFlags::BindPBRMaterial) {
 					// Pass material parameters as push constants
-					PushConstBlockMaterial pushConstBlockMaterial{};
-					// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
-					pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-					pushConstBlockMaterial.normalTextureSet = primitive->material.normalTexture != nullptr ? primitive->material.texCoordSets.normal : -1;
-					pushConstBlockMaterial.alphaMask = static_cast<float>(primitive->material.alphaMode == vkglTF::Material::ALPHAMODE_MASK);
-					pushConstBlockMaterial.alphaMaskCutoff = primitive->material.alphaCutoff;
-
-					// Metallic roughness workflow
-					pushConstBlockMaterial.physicalDescriptorTextureSet = primitive->material.metallicRoughnessTexture != nullptr ? primitive->material.texCoordSets.metallicRoughness : -1;
-					pushConstBlockMaterial.baseColorFactor = primitive->material.baseColorFactor;
-					pushConstBlockMaterial.metallicFactor = primitive->material.metallicFactor;
-					pushConstBlockMaterial.roughnessFactor = primitive->material.roughnessFactor;
-
-					pushConstBlockMaterial.emissiveTextureSet = primitive->material.emissiveTexture != nullptr ? primitive->material.texCoordSets.emissive : -1;
-					pushConstBlockMaterial.emissiveFactor = primitive->material.emissiveFactor;
-
+					PushConstBlockMaterial pushConstBlockMaterial = materialPushConstants(material);
 					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, pushConstantOffset, sizeof(PushConstBlockMaterial), &pushConstBlockMaterial);
 				}
 
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, node->mesh->instanceCount, primitive->firstIndex, 0, node->mesh->firstInstance);
 			}
 		}
 	}
@@ -1531,6 +2322,65 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 	}
 }
 
+void vkglTF::Model::enqueue(vks::RenderQueue& queue, uint32_t pass, VkPipeline pipeline, uint32_t pipelineId, const glm::mat4& matrix, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t pushConstantOffset)
+{
+	// Unlike drawNode the alpha mode flags combine, without any of them all primitives are queued
+	const uint32_t alphaModeFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
+	for (Node* node : linearNodes) {
+		if (!node->mesh || node->mesh->instanceCount == 0) {
+			continue;
+		}
+		const Mesh& mesh = *node->mesh;
+		for (Primitive* primitive : mesh.primitives) {
+			const vkglTF::Material& material = primitive->material;
+			uint32_t alphaModeFlag = RenderFlags::RenderOpaqueNodes;
+			if (material.alphaMode == Material::ALPHAMODE_MASK) {
+				alphaModeFlag = RenderFlags::RenderAlphaMaskedNodes;
+			}
+			if (material.alphaMode == Material::ALPHAMODE_BLEND) {
+				alphaModeFlag = RenderFlags::RenderAlphaBlendedNodes;
+			}
+			if (alphaModeFlags != 0 && !(alphaModeFlags & alphaModeFlag)) {
+				continue;
+			}
+
+			vks::RenderQueue::Packet packet;
+			packet.pipeline = pipeline;
+			packet.pipelineLayout = pipelineLayout;
+			packet.vertexBuffer = vertices.buffer;
+			packet.indexBuffer = indices.buffer;
+			if (renderFlags & RenderFlags::BindImages) {
+				packet.descriptorSet = material.descriptorSet;
+				packet.descriptorSetIndex = bindImageSet;
+			}
+			PushConstBlockMaterial pushConstBlockMaterial{};
+			if (renderFlags & RenderFlags::BindPBRMaterial) {
+				pushConstBlockMaterial = materialPushConstants(material);
+				packet.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+				packet.pushConstantOffset = pushConstantOffset;
+				packet.pushConstantSize = sizeof(PushConstBlockMaterial);
+			}
+			packet.indexCount = primitive->indexCount;
+			packet.instanceCount = mesh.instanceCount;
+			packet.firstIndex = primitive->firstIndex;
+			packet.firstInstance = mesh.firstInstance;
+
+			// Materials share the index of the model's material list, so primitives of one material are drawn together
+			const uint32_t materialId = static_cast<uint32_t>(&material - materials.data());
+			// The nearest instance decides
+			float depth = 1.0f;
+			for (uint32_t i = 0; i < mesh.instanceCount; i++) {
+				const glm::mat4 nodeMatrix = matrix * instanceNodes[mesh.firstInstance + i]->getMatrix();
+				depth = std::min(depth, queue.depth(glm::vec3(nodeMatrix * glm::vec4(primitive->dimensions.center, 1.0f))));
+			}
+			const uint64_t key = material.alphaMode == Material::ALPHAMODE_BLEND ?
+				vks::RenderQueue::blendedKey(pass, pipelineId, materialId, depth) :
+				vks::RenderQueue::opaqueKey(pass, pipelineId, materialId, depth);
+			queue.add(key, packet, &pushConstBlockMaterial);
+		}
+	}
+}
+
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 {
 	if (node->mesh) {
@@ -1564,59 +2414,342 @@ void vkglTF::Model::getSceneDimensions()
 
 void vkglTF::Model::updateAnimation(uint32_t index, float time)
 {
-	if (index > static_cast<uint32_t>(animations.size()) - 1) {
-		std::cout << "No animation with index " << index << std::endl;
-		return;
-	}
-	Animation &animation = animations[index];
+	updateAnimations({ index }, { time });
+}
 
+void vkglTF::Model::updateAnimations(const std::vector<uint32_t>& indices, const std::vector<float>& times)
+{
+	assert(indices.size() == times.size());
 	bool updated = false;
-	for (auto& channel : animation.channels) {
-		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] >= animations.size()) {
+			std::cout << "No animation with index " << indices[i] << std::endl;
 			continue;
 		}
+		Animation &animation = animations[indices[i]];
+		const float time = times[i];
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
-				}
+		for (auto& channel : animation.channels) {
+			const vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
+			if (sampler.inputs.empty() || sampler.inputs.size() > sampler.outputsVec4.size()) {
+				continue;
+			}
+
+			const bool rotation = channel.path == vkglTF::AnimationChannel::PathType::ROTATION;
+			glm::vec4 value = sampler.outputsVec4[0];
+			if (sampler.inputs.size() > 1) {
+				channel.keyframe = sampler.findKeyframe(time, channel.keyframe);
+				value = sampler.sample(channel.keyframe, time, rotation);
+			}
+			switch (channel.path) {
+			case vkglTF::AnimationChannel::PathType::TRANSLATION:
+				transforms.setTranslation(channel.node->transform, glm::vec3(value));
+				break;
+			case vkglTF::AnimationChannel::PathType::SCALE:
+				transforms.setScale(channel.node->transform, glm::vec3(value));
+				break;
+			case vkglTF::AnimationChannel::PathType::ROTATION:
+				transforms.setRotation(channel.node->transform, glm::quat(value.w, value.x, value.y, value.z));
+				break;
 			}
+			updated = true;
 		}
 	}
+	// The hierarchy is updated once for all sampled animations
 	if (updated) {
-		for (auto &node : nodes) {
+		updateNodes();
+	}
+}
+
+// Keyframe search of the previous animation update, kept as the reference of benchmarkAnimationSampling
+static uint32_t findKeyframeLinear(const vkglTF::AnimationSampler& sampler, float time)
+{
+	for (uint32_t i = 0; i < sampler.inputs.size() - 1; i++) {
+		if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
+			return i;
+		}
+	}
+	return time < sampler.inputs[0] ? 0 : static_cast<uint32_t>(sampler.inputs.size()) - 2;
+}
+
+void vkglTF::Model::benchmarkAnimationSampling(std::ostream& os)
+{
+	// Playback at 60 frames per second, each animation is looped so the cursors also see the seek back to the start
+	const float frameTime = 1.0f / 60.0f;
+	const uint32_t loops = 8;
+
+	std::ios::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+
+	os << "animation sampling (" << loops << " loops at 60 fps)" << "\n";
+	if (animations.empty()) {
+		os << "  no animations" << "\n";
+		return;
+	}
+	os << std::left << std::setw(24) << "animation" << std::right << std::setw(10) << "channels" << std::setw(10) << "samples"
+		<< std::setw(12) << "cursor ms" << std::setw(12) << "linear ms" << std::setw(14) << "max difference" << "\n";
+	os << std::fixed;
+
+	for (size_t index = 0; index < animations.size(); index++) {
+		const Animation& animation = animations[index];
+		std::vector<float> times;
+		for (uint32_t loop = 0; loop < loops; loop++) {
+			for (float time = animation.start; time <= animation.end; time += frameTime) {
+				times.push_back(time);
+			}
+		}
+
+		std::vector<const AnimationSampler*> samplers;
+		std::vector<bool> rotations;
+		for (const AnimationChannel& channel : animation.channels) {
+			const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+			if (sampler.inputs.size() > 1 && sampler.inputs.size() <= sampler.outputsVec4.size()) {
+				samplers.push_back(&sampler);
+				rotations.push_back(channel.path == AnimationChannel::PathType::ROTATION);
+			}
+		}
+
+		// Values of both searches are kept, so neither loop can be optimized away and the results can be compared
+		std::vector<glm::vec4> cursorValues(times.size() * samplers.size());
+		std::vector<glm::vec4> linearValues(cursorValues.size());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<uint32_t> cursors(samplers.size(), 0);
+		for (size_t t = 0; t < times.size(); t++) {
+			for (size_t c = 0; c < samplers.size(); c++) {
+				cursors[c] = samplers[c]->findKeyframe(times[t], cursors[c]);
+				cursorValues[t * samplers.size() + c] = samplers[c]->sample(cursors[c], times[t], rotations[c]);
+			}
+		}
+		const double cursorTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (size_t t = 0; t < times.size(); t++) {
+			for (size_t c = 0; c < samplers.size(); c++) {
+				linearValues[t * samplers.size() + c] = samplers[c]->sample(findKeyframeLinear(*samplers[c], times[t]), times[t], rotations[c]);
+			}
+		}
+		const double linearTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// Both searches may pick the neighbouring interval exactly at a keyframe, the values still have to match
+		float maxDifference = 0.0f;
+		for (size_t i = 0; i < cursorValues.size(); i++) {
+			const glm::vec4 difference = glm::abs(cursorValues[i] - linearValues[i]);
+			maxDifference = std::max(maxDifference, std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)));
+		}
+
+		const std::string name = animation.name.empty() ? "#" + std::to_string(index) : animation.name.substr(0, 23);
+		os << std::left << std::setw(24) << name << std::right << std::setw(10) << samplers.size() << std::setw(10) << times.size() * samplers.size()
+			<< std::setprecision(3) << std::setw(12) << cursorTime << std::setw(12) << linearTime
+			<< std::setprecision(6) << std::setw(14) << maxDifference << "\n";
+	}
+
+	os.flags(flags);
+	os.precision(precision);
+}
+
+bool vkglTF::Model::meshTransformChanged(const Node* node) const
+{
+	bool changed = transforms.changed[node->transform] != 0;
+	if (node->skin) {
+		for (size_t i = 0; i < node->skin->joints.size() && !changed; i++) {
+			changed = transforms.changed[node->skin->joints[i]->transform] != 0;
+		}
+	}
+	return changed;
+}
+
+void vkglTF::Model::updateNodes()
+{
+	if (!transforms.update()) {
+		return;
+	}
+	for (auto node : linearNodes) {
+		if (node->mesh && meshTransformChanged(node)) {
 			node->update();
 		}
 	}
+	if (mappedVertices) {
+		for (auto& skinnedMesh : cpuSkinnedMeshes) {
+			if (meshTransformChanged(skinnedMesh.node)) {
+				skinVertices(skinnedMesh);
+			}
+		}
+	}
+	if (instances.mapped) {
+		glm::mat4* matrices = static_cast<glm::mat4*>(instances.mapped);
+		for (size_t i = 0; i < instanceNodes.size(); i++) {
+			if (meshTransformChanged(instanceNodes[i])) {
+				matrices[i] = instanceNodes[i]->getMatrix();
+			}
+		}
+	}
+}
+
+void vkglTF::Model::prepareInstances()
+{
+	// Meshes are grouped by their primitive ranges and materials, which only match for nodes that share a glTF mesh
+	// Skinned nodes keep their own draws, each of them has its own joint matrices
+	typedef std::vector<std::tuple<uint32_t, uint32_t, const Material*>> PrimitiveKey;
+	std::map<PrimitiveKey, size_t> drawnMeshes;
+	std::vector<std::vector<Node*>> groups;
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		PrimitiveKey key;
+		for (const Primitive* primitive : node->mesh->primitives) {
+			key.emplace_back(primitive->firstIndex, primitive->indexCount, &primitive->material);
+		}
+		const bool shareable = !node->skin && !key.empty();
+		auto drawn = shareable ? drawnMeshes.find(key) : drawnMeshes.end();
+		if (drawn != drawnMeshes.end()) {
+			groups[drawn->second].push_back(node);
+			continue;
+		}
+		if (shareable) {
+			drawnMeshes[key] = groups.size();
+		}
+		groups.push_back({ node });
+	}
+
+	instanceNodes.clear();
+	for (const std::vector<Node*>& group : groups) {
+		const uint32_t firstInstance = static_cast<uint32_t>(instanceNodes.size());
+		for (size_t i = 0; i < group.size(); i++) {
+			group[i]->mesh->firstInstance = firstInstance + static_cast<uint32_t>(i);
+			group[i]->mesh->instanceCount = 0;
+		}
+		group[0]->mesh->instanceCount = static_cast<uint32_t>(group.size());
+		instanceNodes.insert(instanceNodes.end(), group.begin(), group.end());
+	}
+	if (instanceNodes.empty()) {
+		return;
+	}
+
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&instances,
+		instanceNodes.size() * sizeof(glm::mat4)));
+	VK_CHECK_RESULT(instances.map());
+	glm::mat4* matrices = static_cast<glm::mat4*>(instances.mapped);
+	for (size_t i = 0; i < instanceNodes.size(); i++) {
+		matrices[i] = instanceNodes[i]->getMatrix();
+	}
+}
+
+void vkglTF::Model::createJointPalette()
+{
+	// Every range starts at an offset the storage buffer descriptor accepts
+	const uint32_t alignment = std::max(static_cast<uint32_t>(device->properties.limits.minStorageBufferOffsetAlignment), 16u);
+	VkDeviceSize size = 0;
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			const uint32_t jointCount = node->skin ? static_cast<uint32_t>(node->skin->joints.size()) : 0;
+			const uint32_t range = static_cast<uint32_t>(Mesh::jointMatricesOffset + jointCount * sizeof(glm::mat4));
+			node->mesh->storageBuffer.descriptor = { VK_NULL_HANDLE, size, range };
+			size += vks::tools::alignedSize(range, alignment);
+		}
+	}
+	if (size == 0) {
+		return;
+	}
+
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&jointPalette,
+		size));
+	VK_CHECK_RESULT(jointPalette.map());
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			Mesh::StorageBuffer& storageBuffer = node->mesh->storageBuffer;
+			storageBuffer.descriptor.buffer = jointPalette.buffer;
+			storageBuffer.mapped = static_cast<uint8_t*>(jointPalette.mapped) + storageBuffer.descriptor.offset;
+			// The joint count never changes, the matrices are written by Node::update
+			const glm::vec4 jointCount(node->skin ? static_cast<float>(node->skin->joints.size()) : 0.0f, 0.0f, 0.0f, 0.0f);
+			memcpy(static_cast<uint8_t*>(storageBuffer.mapped) + Mesh::jointCountOffset, &jointCount, sizeof(glm::vec4));
+		}
+	}
+}
+
+void vkglTF::Model::prepareCpuSkinning(const std::vector<Vertex>& vertexBuffer)
+{
+	for (auto node : linearNodes) {
+		if (!node->mesh || !node->skin || node->skin->joints.empty()) {
+			continue;
+		}
+		// The primitives of a mesh are stored back to back in the vertex buffer
+		uint32_t firstVertex = std::numeric_limits<uint32_t>::max();
+		uint32_t endVertex = 0;
+		for (Primitive* primitive : node->mesh->primitives) {
+			firstVertex = std::min(firstVertex, primitive->firstVertex);
+			endVertex = std::max(endVertex, primitive->firstVertex + primitive->vertexCount);
+		}
+		if (endVertex <= firstVertex) {
+			continue;
+		}
+
+		CpuSkinnedMesh skinnedMesh;
+		skinnedMesh.node = node;
+		skinnedMesh.firstVertex = firstVertex;
+		vks::skinning::VertexStreams& streams = skinnedMesh.streams;
+		streams.resize(endVertex - firstVertex);
+		const uint32_t jointCount = static_cast<uint32_t>(node->skin->joints.size());
+		for (uint32_t i = 0; i < endVertex - firstVertex; i++) {
+			const Vertex& vertex = vertexBuffer[firstVertex + i];
+			for (uint32_t c = 0; c < 3; c++) {
+				streams.positions[c][i] = vertex.pos[c];
+				streams.normals[c][i] = vertex.normal[c];
+			}
+			for (uint32_t k = 0; k < 4; k++) {
+				// Out of range joints would read past the palette, they don't contribute instead
+				const uint32_t joint = static_cast<uint32_t>(vertex.joint0[k]);
+				streams.joints[k][i] = joint < jointCount ? joint : 0;
+				streams.weights[k][i] = joint < jointCount ? vertex.weight0[k] : 0.0f;
+			}
+		}
+		cpuSkinnedMeshes.push_back(std::move(skinnedMesh));
+	}
+}
+
+void vkglTF::Model::buildSkinningPalette(const CpuSkinnedMesh& skinnedMesh, std::vector<float>& palette) const
+{
+	// Same joint matrices as the ones in the joint palette, stored as 3x4 rows
+	const Skin* skin = skinnedMesh.node->skin;
+	const glm::mat4 inverseTransform = glm::inverse(transforms.worldMatrices[skinnedMesh.node->transform]);
+	palette.resize(skin->joints.size() * vks::skinning::paletteStride);
+	for (size_t i = 0; i < skin->joints.size(); i++) {
+		const glm::mat4 jointMat = inverseTransform * transforms.worldMatrices[skin->joints[i]->transform] * skin->inverseBindMatrices[i];
+		float* rows = &palette[i * vks::skinning::paletteStride];
+		for (uint32_t r = 0; r < 3; r++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				rows[r * 4 + c] = jointMat[c][r];
+			}
+		}
+	}
+}
+
+void vkglTF::Model::skinVertices(CpuSkinnedMesh& skinnedMesh)
+{
+	buildSkinningPalette(skinnedMesh, cpuSkinningPalette);
+	Vertex* first = mappedVertices + skinnedMesh.firstVertex;
+	vks::skinning::linearBlend(skinnedMesh.streams, cpuSkinningPalette.data(), &first->pos.x, &first->normal.x, sizeof(Vertex));
+}
+
+void vkglTF::Model::benchmarkSkinning(std::ostream& os)
+{
+	// Each CPU skinned mesh is measured with the joint palette of its current pose
+	std::vector<std::vector<float>> palettes(cpuSkinnedMeshes.size());
+	std::vector<vks::skinning::BenchmarkCase> cases;
+	for (size_t i = 0; i < cpuSkinnedMeshes.size(); i++) {
+		const CpuSkinnedMesh& skinnedMesh = cpuSkinnedMeshes[i];
+		buildSkinningPalette(skinnedMesh, palettes[i]);
+		const std::string name = skinnedMesh.node->mesh && !skinnedMesh.node->mesh->name.empty() ? skinnedMesh.node->mesh->name : skinnedMesh.node->name;
+		cases.push_back({ name, &skinnedMesh.streams, palettes[i].data(), static_cast<uint32_t>(skinnedMesh.node->skin->joints.size()) });
+	}
+	vks::skinning::benchmark(os, cases);
 }
 
 /*
@@ -1654,15 +2787,15 @@ void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLay
 		descriptorSetAllocInfo.descriptorPool = descriptorPool;
 		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
 		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->storageBuffer.descriptorSet));
 
 		VkWriteDescriptorSet writeDescriptorSet{};
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
+		writeDescriptorSet.dstSet = node->mesh->storageBuffer.descriptorSet;
 		writeDescriptorSet.dstBinding = 0;
-		writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
+		writeDescriptorSet.pBufferInfo = &node->mesh->storageBuffer.descriptor;
 
 		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
 	}
@@ -11,10 +11,13 @@
 #include <stdlib.h>
 #include <string>
 #include <fstream>
+#include <map>
 #include <vector>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VertexSkinning.h"
+#include "VulkanRenderQueue.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -77,6 +80,8 @@ namespace vkglTF
 		void updateDescriptor();
 		void destroy();
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, TextureSampler textureSampler, vks::VulkanDevice* device, VkQueue copyQueue);
+		// Creates the sampler and the view for an image that ends up in imageLayout with mipLevels levels
+		void createSamplerAndView(TextureSampler textureSampler, VkFormat format);
 	};
 
 	/*
@@ -148,22 +153,23 @@ namespace vkglTF
 		std::vector<Primitive*> primitives;
 		std::string name;
 
-		struct UniformBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+		/*
+			Range of the joint palette buffer of the model, sized for the joints the mesh's skin actually uses
+			std430 layout: mat4 matrix, vec4 jointCount (x), mat4 jointMatrix[jointCount]
+		*/
+		struct StorageBuffer {
 			VkDescriptorBufferInfo descriptor;
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-			void* mapped;
-		} uniformBuffer;
+			void* mapped = nullptr;
+		} storageBuffer;
+		static const VkDeviceSize jointCountOffset = sizeof(glm::mat4);
+		static const VkDeviceSize jointMatricesOffset = sizeof(glm::mat4) + sizeof(glm::vec4);
 
-		struct UniformBlock {
-			glm::mat4 matrix;
-			glm::mat4 jointMatrix[64]{};
-			float jointcount{ 0 };
-		} uniformBlock;
+		// Range of Model::instanceNodes drawn with the primitives of this mesh, zero instances for meshes repeating the primitives of an earlier one
+		uint32_t firstInstance = 0;
+		uint32_t instanceCount = 1;
 
-		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
-		~Mesh();
+		Mesh(vks::VulkanDevice* device) : device(device) {};
 	};
 
 	/*
@@ -176,6 +182,35 @@ namespace vkglTF
 		std::vector<Node*> joints;
 	};
 
+	/*
+		Flat transform store of the nodes of a model
+		Parents are stored before their children, so one linear pass computes all world matrices and only
+		recomputes the nodes that changed and their descendants
+	*/
+	struct NodeTransforms {
+		std::vector<int32_t> parents;
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		// Node matrix of the glTF file, glTF nodes either use it or translation, rotation and scale
+		std::vector<glm::mat4> matrices;
+		std::vector<glm::mat4> worldMatrices;
+		// Local transform changed since the last update
+		std::vector<uint8_t> dirty;
+		// World matrix was recomputed by the last update
+		std::vector<uint8_t> changed;
+
+		/** @brief Adds a node, the parent has to be added before (-1 for root nodes) */
+		uint32_t add(int32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& matrix);
+		void setTranslation(uint32_t index, const glm::vec3& translation) { translations[index] = translation; dirty[index] = 1; }
+		void setRotation(uint32_t index, const glm::quat& rotation) { rotations[index] = rotation; dirty[index] = 1; }
+		void setScale(uint32_t index, const glm::vec3& scale) { scales[index] = scale; dirty[index] = 1; }
+		glm::mat4 localMatrix(uint32_t index) const;
+		/** @brief Recomputes the world matrices of the dirty nodes and their descendants, returns true if any changed */
+		bool update();
+		uint32_t size() const { return static_cast<uint32_t>(parents.size()); }
+	};
+
 	/*
 		glTF node
 	*/
@@ -183,16 +218,17 @@ namespace vkglTF
 		Node* parent;
 		uint32_t index;
 		std::vector<Node*> children;
-		glm::mat4 matrix;
 		std::string name;
 		Mesh* mesh;
 		Skin* skin;
 		int32_t skinIndex = -1;
-		glm::vec3 translation{};
-		glm::vec3 scale{ 1.0f };
-		glm::quat rotation{};
+		// Local and world transform of the node are kept in the transform store of the model
+		NodeTransforms* transforms;
+		uint32_t transform;
 		glm::mat4 localMatrix();
+		/** @brief World matrix as of the last NodeTransforms::update */
 		glm::mat4 getMatrix();
+		/** @brief Writes the world matrix and the joint matrices of the node's mesh to its range of the joint palette */
 		void update();
 		~Node();
 	};
@@ -205,6 +241,8 @@ namespace vkglTF
 		PathType path;
 		Node* node;
 		uint32_t samplerIndex;
+		// Keyframe interval of the last update, playback stays in it or moves on to one of the next intervals
+		uint32_t keyframe = 0;
 	};
 
 	/*
@@ -213,8 +251,16 @@ namespace vkglTF
 	struct AnimationSampler {
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
+		// Keyframe times and values are kept in separate arrays, so the keyframe search only touches the times
 		std::vector<float> inputs;
 		std::vector<glm::vec4> outputsVec4;
+		// Cubic spline tangents per keyframe, empty for the other interpolation types
+		std::vector<glm::vec4> inTangents;
+		std::vector<glm::vec4> outTangents;
+		/** @brief Returns the keyframe interval containing time, starting the search at the interval of the last update */
+		uint32_t findKeyframe(float time, uint32_t cursor) const;
+		/** @brief Interpolates the value of the keyframe interval at time, rotations are returned as normalized quaternions (x, y, z, w) */
+		glm::vec4 sample(uint32_t keyframe, float time, bool rotation) const;
 	};
 
 	/*
@@ -256,7 +302,12 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Always load from the glTF file and don't write the binary model cache
+		DontUseCache = 0x00000010,
+		// Skin the vertices of skinned meshes on the CPU and write them to a host visible vertex buffer, for pipelines
+		// without a skinning vertex shader (not meant to be combined with PreTransformVertices)
+		CpuSkinning = 0x00000020
 	};
 
 	enum RenderFlags {
@@ -288,6 +339,7 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		bool meshTransformChanged(const Node* node) const;
 	public:
 		vks::VulkanDevice* device;
 		VkDescriptorPool descriptorPool;
@@ -305,9 +357,35 @@ namespace vkglTF
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		NodeTransforms transforms;
 
 		std::vector<Skin*> skins;
 
+		// World and joint matrices of all meshes in one host visible storage buffer, see Mesh::storageBuffer
+		vks::Buffer jointPalette;
+
+		/*
+			Nodes whose meshes have the same primitives (nodes sharing a glTF mesh) are drawn with one instanced draw
+			instanceNodes lists the nodes of every draw back to back, the instance buffer holds their world matrices
+			(host visible, one mat4 per instance) for pipelines that place the instances with a per instance attribute
+		*/
+		std::vector<Node*> instanceNodes;
+		vks::Buffer instances;
+
+		/*
+			Skinned meshes of a model loaded with FileLoadingFlags::CpuSkinning
+			The bind pose is kept as separate streams, the skinned positions and normals are written to the vertex
+			buffer, which is host visible and stays mapped for this
+		*/
+		struct CpuSkinnedMesh {
+			Node* node;
+			uint32_t firstVertex;
+			vks::skinning::VertexStreams streams;
+		};
+		std::vector<CpuSkinnedMesh> cpuSkinnedMeshes;
+		std::vector<float> cpuSkinningPalette;
+		Vertex* mappedVertices = nullptr;
+
 		std::vector<Texture> textures;
 		std::vector<TextureSampler> textureSamplers;
 		std::vector<Material> materials;
@@ -325,6 +403,17 @@ namespace vkglTF
 		bool buffersBound = false;
 		std::string path;
 
+		// Duration of loadFromFile in milliseconds and whether the model came from the binary model cache
+		double loadTime = 0.0;
+		bool loadedFromCache = false;
+
+		// Contents of the glTF buffers while loading, memory mapped where possible
+		std::vector<const unsigned char*> bufferData;
+		// glTF meshes loaded so far, further nodes using the same mesh share its vertices and indices (unless vertices are processed per node)
+		std::map<int, const Mesh*> loadedMeshes;
+		bool shareMeshes = true;
+		const unsigned char* accessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor) const;
+
 		Model() {};
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
@@ -335,13 +424,45 @@ namespace vkglTF
 		void loadTextureSamplers(tinygltf::Model& gltfModel);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
+		/** @brief Creates the model from a cache file written by writeCache, returns false without side effects if it is missing or stale */
+		bool loadFromCache(const std::string& cacheFile, uint32_t fileLoadingFlags, float scale, VkQueue transferQueue, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+		/** @brief Stores the processed model, images holds the still encoded images of gltfModel and dependencies the files it was loaded from */
+		void writeCache(const std::string& cacheFile, uint32_t fileLoadingFlags, float scale, const std::vector<std::string>& dependencies, const tinygltf::Model& gltfModel, const std::vector<tinygltf::Image>& images, const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
 		void bindBuffers(VkCommandBuffer commandBuffer);
+		/** @brief Binds the instance buffer (mat4 world matrix per instance) to binding, for pipelines reading it with VK_VERTEX_INPUT_RATE_INSTANCE */
+		void bindInstances(VkCommandBuffer commandBuffer, uint32_t binding);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t pushConstantOffset = 0);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/**
+		* Adds a draw packet for every primitive to a render queue in a single walk over the nodes, alpha blended primitives get back to front keys
+		*
+		* @param pipelineId Sort key id of pipeline, see vks::RenderQueue
+		* @param matrix Model matrix the nodes are drawn with, used for the depth of the primitives
+		* @param renderFlags Same flags as drawNode, but the alpha mode flags select every mode they name
+		*/
+		void enqueue(vks::RenderQueue& queue, uint32_t pass, VkPipeline pipeline, uint32_t pipelineId, const glm::mat4& matrix, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t pushConstantOffset = 0);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
+		/** @brief Allocates the joint palette and assigns each mesh its range, skins have to be assigned before */
+		void createJointPalette();
+		/** @brief Groups the nodes drawing the same primitives into instances and creates the instance buffer */
+		void prepareInstances();
+		/** @brief Copies the bind pose of the skinned meshes into skinning streams for FileLoadingFlags::CpuSkinning */
+		void prepareCpuSkinning(const std::vector<Vertex>& vertexBuffer);
+		/** @brief Writes the current joint matrices of a skinned mesh as 3x4 rows, the palette layout of vks::skinning */
+		void buildSkinningPalette(const CpuSkinnedMesh& skinnedMesh, std::vector<float>& palette) const;
+		/** @brief Skins the vertices of a mesh with the current joint matrices into the mapped vertex buffer */
+		void skinVertices(CpuSkinnedMesh& skinnedMesh);
+		/** @brief Updates the world matrices after node transforms changed and uploads the mesh matrices that depend on them */
+		void updateNodes();
 		void updateAnimation(uint32_t index, float time);
+		/** @brief Samples several animations at their own times and updates the node hierarchy once for all of them */
+		void updateAnimations(const std::vector<uint32_t>& indices, const std::vector<float>& times);
+		/** @brief Times sampling every animation with the keyframe cursors against a linear keyframe search and writes the table to os */
+		void benchmarkAnimationSampling(std::ostream& os);
+		/** @brief Times the scalar and SIMD CPU skinning kernels on the skinned meshes and a synthetic mesh and checks that their outputs match */
+		void benchmarkSkinning(std::ostream& os);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
@@ -0,0 +1,686 @@
+/*
+* Binary cache of processed glTF models
+*
+* After a model was loaded from its glTF file, the processed vertex and index streams, the node hierarchy, materials,
+* skins, animations and the texture sources are written to a versioned binary file next to the asset.
+* Later loads read that file into memory and create the model from it without parsing the glTF file.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFModel.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sys/stat.h>
+
+namespace
+{
+	// Bump whenever the layout below or the meaning of the processed data changes
+	const uint32_t cacheVersion = 3;
+	const char cacheMagic[8] = { 'V', 'K', 'G', 'L', 'T', 'F', 'C', '\0' };
+
+	// Source files are compared by size and modification time, the content hash only decides if the times differ
+	struct CacheDependency
+	{
+		std::string filename;
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		uint64_t hash = 0;
+	};
+
+	bool readFile(const std::string& filename, std::vector<unsigned char>& data)
+	{
+		std::ifstream is(filename, std::ios::binary | std::ios::ate);
+		if (!is.is_open()) {
+			return false;
+		}
+		const std::streamoff size = is.tellg();
+		if (size < 0) {
+			return false;
+		}
+		data.resize(static_cast<size_t>(size));
+		is.seekg(0, std::ios::beg);
+		is.read(reinterpret_cast<char*>(data.data()), size);
+		return !is.fail();
+	}
+
+	bool fileStat(const std::string& filename, uint64_t& size, int64_t& mtime)
+	{
+		struct stat st;
+		if (stat(filename.c_str(), &st) != 0) {
+			return false;
+		}
+		size = static_cast<uint64_t>(st.st_size);
+		mtime = static_cast<int64_t>(st.st_mtime);
+		return true;
+	}
+
+	// FNV-1a
+	bool fileHash(const std::string& filename, uint64_t& hash)
+	{
+		std::ifstream is(filename, std::ios::binary);
+		if (!is.is_open()) {
+			return false;
+		}
+		hash = 14695981039346656037ull;
+		std::vector<char> chunk(1 << 20);
+		while (is) {
+			is.read(chunk.data(), chunk.size());
+			const std::streamsize count = is.gcount();
+			for (std::streamsize i = 0; i < count; i++) {
+				hash = (hash ^ static_cast<unsigned char>(chunk[i])) * 1099511628211ull;
+			}
+		}
+		return true;
+	}
+
+	// Same as the percent decoding tinygltf applies to image uris
+	std::string decodeUri(const std::string& uri)
+	{
+		auto hex = [](char c) -> int {
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return 0;
+		};
+		std::string result;
+		for (size_t i = 0; i < uri.size(); i++) {
+			if (uri[i] == '+') {
+				result += ' ';
+			}
+			else if (uri[i] == '%' && uri.size() > i + 2) {
+				result += static_cast<char>((hex(uri[i + 1]) << 4) | hex(uri[i + 2]));
+				i += 2;
+			}
+			else {
+				result += uri[i];
+			}
+		}
+		return result;
+	}
+
+	bool isKtx(const std::string& uri)
+	{
+		return uri.size() > 4 && uri.compare(uri.size() - 4, 4, ".ktx") == 0;
+	}
+
+	// Images that tinygltf read from a file of their own, mapped and embedded images are stored in the cache
+	bool isExternalImage(const tinygltf::Image& image)
+	{
+		return !image.uri.empty() && image.uri.compare(0, 5, "data:") != 0 && image.uri.compare(0, 20, "vkgltf-mapped-image-") != 0;
+	}
+
+	class CacheWriter
+	{
+	public:
+		std::vector<unsigned char> data;
+
+		template<typename T> void pod(const T& value)
+		{
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+			data.insert(data.end(), bytes, bytes + sizeof(T));
+		}
+		template<typename T> void array(const std::vector<T>& values)
+		{
+			pod(static_cast<uint64_t>(values.size()));
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+			data.insert(data.end(), bytes, bytes + values.size() * sizeof(T));
+		}
+		void string(const std::string& value)
+		{
+			pod(static_cast<uint64_t>(value.size()));
+			data.insert(data.end(), value.begin(), value.end());
+		}
+	};
+
+	// Reads past the end leave the reader in a failed state and return zeroed values
+	class CacheReader
+	{
+	public:
+		CacheReader(const std::vector<unsigned char>& data) : pos(data.data()), end(data.data() + data.size()) {}
+
+		bool ok = true;
+
+		template<typename T> T pod()
+		{
+			T value{};
+			if (take(sizeof(T))) {
+				memcpy(&value, pos - sizeof(T), sizeof(T));
+			}
+			return value;
+		}
+		template<typename T> void array(std::vector<T>& values)
+		{
+			const uint64_t count = pod<uint64_t>();
+			if (!ok || count > static_cast<uint64_t>(end - pos) / sizeof(T)) {
+				ok = false;
+				return;
+			}
+			values.resize(static_cast<size_t>(count));
+			memcpy(values.data(), pos, values.size() * sizeof(T));
+			pos += values.size() * sizeof(T);
+		}
+		std::string string()
+		{
+			const uint64_t size = pod<uint64_t>();
+			if (!ok || !take(static_cast<size_t>(size))) {
+				return std::string();
+			}
+			return std::string(reinterpret_cast<const char*>(pos - size), static_cast<size_t>(size));
+		}
+		// Count of elements that each take at least minSize bytes, guards the resizes against corrupted files
+		uint32_t count(size_t minSize)
+		{
+			const uint32_t value = pod<uint32_t>();
+			if (static_cast<uint64_t>(value) * minSize > static_cast<uint64_t>(end - pos)) {
+				ok = false;
+				return 0;
+			}
+			return value;
+		}
+		bool take(size_t size)
+		{
+			if (!ok || size > static_cast<size_t>(end - pos)) {
+				ok = false;
+				return false;
+			}
+			pos += size;
+			return true;
+		}
+	private:
+		const unsigned char* pos;
+		const unsigned char* end;
+	};
+
+	struct CachedMaterial
+	{
+		uint32_t alphaMode;
+		float alphaCutoff;
+		glm::vec4 baseColorFactor;
+		float metallicFactor;
+		float roughnessFactor;
+		glm::vec4 emissiveFactor;
+		// Base color, normal, metallic roughness, emissive
+		int32_t textures[4];
+		uint8_t texCoordSets[4];
+	};
+
+	struct CachedPrimitive
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t material;
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// Nodes are stored in the order of Model::linearNodes, which lists children before their parents
+	struct CachedNode
+	{
+		int32_t parent;
+		uint32_t index;
+		std::string name;
+		glm::mat4 matrix;
+		glm::vec3 translation;
+		glm::vec3 scale;
+		glm::quat rotation;
+		int32_t skinIndex;
+		bool hasMesh;
+		std::string meshName;
+		std::vector<CachedPrimitive> primitives;
+	};
+
+	struct CachedSkin
+	{
+		std::string name;
+		int32_t skeletonRoot;
+		std::vector<glm::mat4> inverseBindMatrices;
+		std::vector<uint32_t> joints;
+	};
+
+	struct CachedChannel
+	{
+		uint32_t path;
+		uint32_t node;
+		uint32_t samplerIndex;
+	};
+
+	struct CachedAnimation
+	{
+		std::string name;
+		float start;
+		float end;
+		std::vector<vkglTF::AnimationSampler> samplers;
+		std::vector<CachedChannel> channels;
+	};
+
+	void writeHeader(CacheWriter& writer, uint32_t fileLoadingFlags, float scale)
+	{
+		writer.data.insert(writer.data.end(), cacheMagic, cacheMagic + sizeof(cacheMagic));
+		writer.pod(cacheVersion);
+		writer.pod(static_cast<uint32_t>(sizeof(vkglTF::Vertex)));
+		// CPU skinning only changes how the cached vertices are uploaded
+		writer.pod(fileLoadingFlags & ~static_cast<uint32_t>(vkglTF::FileLoadingFlags::CpuSkinning));
+		writer.pod(scale);
+	}
+
+	int32_t textureIndex(const std::vector<vkglTF::Texture>& textures, const vkglTF::Texture* texture)
+	{
+		return texture ? static_cast<int32_t>(texture - textures.data()) : -1;
+	}
+}
+
+
+bool vkglTF::Model::loadFromCache(const std::string& cacheFile, uint32_t fileLoadingFlags, float scale, VkQueue transferQueue, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer)
+{
+	std::vector<unsigned char> data;
+	CacheWriter header;
+	writeHeader(header, fileLoadingFlags, scale);
+	if (!readFile(cacheFile, data) || data.size() < header.data.size() || memcmp(data.data(), header.data.data(), header.data.size()) != 0) {
+		return false;
+	}
+	CacheReader reader(data);
+	reader.take(header.data.size());
+
+	// Source files
+	const uint32_t dependencyCount = reader.count(32);
+	for (uint32_t i = 0; i < dependencyCount; i++) {
+		CacheDependency dependency;
+		dependency.filename = reader.string();
+		dependency.size = reader.pod<uint64_t>();
+		dependency.mtime = reader.pod<int64_t>();
+		dependency.hash = reader.pod<uint64_t>();
+		uint64_t size, hash;
+		int64_t mtime;
+		if (!reader.ok || !fileStat(dependency.filename, size, mtime) || size != dependency.size) {
+			return false;
+		}
+		if (mtime != dependency.mtime && (!fileHash(dependency.filename, hash) || hash != dependency.hash)) {
+			return false;
+		}
+	}
+
+	// Everything is read and validated before the first Vulkan object is created, a rejected cache falls back to the glTF file
+	// Images and textures go into a tinygltf model that holds nothing else, so decoding and upload share loadTextures
+	tinygltf::Model gltfModel;
+	std::vector<TextureSampler> samplers;
+	reader.array(samplers);
+	gltfModel.images.resize(reader.count(9));
+	for (tinygltf::Image& image : gltfModel.images) {
+		const bool external = reader.pod<uint8_t>() != 0;
+		image.uri = reader.string();
+		if (!external) {
+			reader.array(image.image);
+			image.as_is = true;
+		}
+		else if (!isKtx(image.uri)) {
+			if (!readFile(path + "/" + decodeUri(image.uri), image.image)) {
+				return false;
+			}
+			image.as_is = true;
+		}
+	}
+	gltfModel.textures.resize(reader.count(8));
+	for (tinygltf::Texture& texture : gltfModel.textures) {
+		texture.source = reader.pod<int32_t>();
+		texture.sampler = reader.pod<int32_t>();
+		if (texture.source < 0 || texture.source >= static_cast<int32_t>(gltfModel.images.size()) || texture.sampler >= static_cast<int32_t>(samplers.size())) {
+			return false;
+		}
+	}
+
+	std::vector<CachedMaterial> cachedMaterials;
+	reader.array(cachedMaterials);
+	for (const CachedMaterial& material : cachedMaterials) {
+		for (int32_t texture : material.textures) {
+			if (texture >= static_cast<int32_t>(gltfModel.textures.size())) {
+				return false;
+			}
+		}
+	}
+	// The default material is always last
+	if (cachedMaterials.empty()) {
+		return false;
+	}
+
+	reader.array(vertexBuffer);
+	reader.array(indexBuffer);
+
+	std::vector<CachedNode> cachedNodes(reader.count(16));
+	for (uint32_t i = 0; i < cachedNodes.size(); i++) {
+		CachedNode& node = cachedNodes[i];
+		node.parent = reader.pod<int32_t>();
+		node.index = reader.pod<uint32_t>();
+		node.name = reader.string();
+		node.matrix = reader.pod<glm::mat4>();
+		node.translation = reader.pod<glm::vec3>();
+		node.scale = reader.pod<glm::vec3>();
+		node.rotation = reader.pod<glm::quat>();
+		node.skinIndex = reader.pod<int32_t>();
+		node.hasMesh = reader.pod<uint8_t>() != 0;
+		if (node.hasMesh) {
+			node.meshName = reader.string();
+			reader.array(node.primitives);
+		}
+		if (node.parent != -1 && (node.parent <= static_cast<int32_t>(i) || node.parent >= static_cast<int32_t>(cachedNodes.size()))) {
+			return false;
+		}
+		for (const CachedPrimitive& primitive : node.primitives) {
+			if (primitive.material >= cachedMaterials.size() ||
+				static_cast<uint64_t>(primitive.firstIndex) + primitive.indexCount > indexBuffer.size() ||
+				static_cast<uint64_t>(primitive.firstVertex) + primitive.vertexCount > vertexBuffer.size()) {
+				return false;
+			}
+		}
+	}
+
+	std::vector<CachedSkin> cachedSkins(reader.count(28));
+	for (CachedSkin& skin : cachedSkins) {
+		skin.name = reader.string();
+		skin.skeletonRoot = reader.pod<int32_t>();
+		reader.array(skin.inverseBindMatrices);
+		reader.array(skin.joints);
+	}
+
+	std::vector<CachedAnimation> cachedAnimations(reader.count(28));
+	for (CachedAnimation& animation : cachedAnimations) {
+		animation.name = reader.string();
+		animation.start = reader.pod<float>();
+		animation.end = reader.pod<float>();
+		animation.samplers.resize(reader.count(36));
+		for (AnimationSampler& sampler : animation.samplers) {
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(reader.pod<uint32_t>());
+			reader.array(sampler.inputs);
+			reader.array(sampler.outputsVec4);
+			reader.array(sampler.inTangents);
+			reader.array(sampler.outTangents);
+		}
+		reader.array(animation.channels);
+		for (const CachedChannel& channel : animation.channels) {
+			if (channel.samplerIndex >= animation.samplers.size()) {
+				return false;
+			}
+		}
+	}
+
+	const bool workflow = reader.pod<uint8_t>() != 0;
+	if (!reader.ok) {
+		return false;
+	}
+
+	// Create the model
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		textureSamplers = samplers;
+		loadTextures(gltfModel, device, transferQueue);
+	}
+
+	for (const CachedMaterial& cached : cachedMaterials) {
+		Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(cached.alphaMode);
+		material.alphaCutoff = cached.alphaCutoff;
+		material.baseColorFactor = cached.baseColorFactor;
+		material.metallicFactor = cached.metallicFactor;
+		material.roughnessFactor = cached.roughnessFactor;
+		material.emissiveFactor = cached.emissiveFactor;
+		Texture* materialTextures[4] = {};
+		for (uint32_t i = 0; i < 4; i++) {
+			if (cached.textures[i] >= 0 && cached.textures[i] < static_cast<int32_t>(textures.size())) {
+				materialTextures[i] = &textures[cached.textures[i]];
+			}
+		}
+		material.baseColorTexture = materialTextures[0];
+		material.normalTexture = materialTextures[1];
+		material.metallicRoughnessTexture = materialTextures[2];
+		material.emissiveTexture = materialTextures[3];
+		material.texCoordSets.baseColor = cached.texCoordSets[0];
+		material.texCoordSets.normal = cached.texCoordSets[1];
+		material.texCoordSets.metallicRoughness = cached.texCoordSets[2];
+		material.texCoordSets.emissive = cached.texCoordSets[3];
+		materials.push_back(material);
+	}
+
+	std::map<uint32_t, Node*> nodeIndices;
+	for (const CachedNode& cached : cachedNodes) {
+		Node* node = new Node{};
+		node->index = cached.index;
+		node->name = cached.name;
+		node->skinIndex = cached.skinIndex;
+		if (cached.hasMesh) {
+			node->mesh = new Mesh(device);
+			node->mesh->name = cached.meshName;
+			for (const CachedPrimitive& primitive : cached.primitives) {
+				Primitive* newPrimitive = new Primitive(primitive.firstIndex, primitive.indexCount, materials[primitive.material]);
+				newPrimitive->firstVertex = primitive.firstVertex;
+				newPrimitive->vertexCount = primitive.vertexCount;
+				newPrimitive->setDimensions(primitive.min, primitive.max);
+				node->mesh->primitives.push_back(newPrimitive);
+			}
+		}
+		linearNodes.push_back(node);
+		nodeIndices.insert(std::make_pair(node->index, node));
+	}
+	// Children were added to their parent in the order they appear in linearNodes
+	for (uint32_t i = 0; i < cachedNodes.size(); i++) {
+		Node* node = linearNodes[i];
+		if (cachedNodes[i].parent == -1) {
+			nodes.push_back(node);
+		}
+		else {
+			node->parent = linearNodes[cachedNodes[i].parent];
+			node->parent->children.push_back(node);
+		}
+	}
+	// Parents come after their children in linearNodes, so the transform store is filled back to front
+	for (uint32_t i = static_cast<uint32_t>(cachedNodes.size()); i-- > 0;) {
+		const CachedNode& cached = cachedNodes[i];
+		Node* node = linearNodes[i];
+		node->transforms = &transforms;
+		node->transform = transforms.add(node->parent ? static_cast<int32_t>(node->parent->transform) : -1, cached.translation, cached.rotation, cached.scale, cached.matrix);
+	}
+	auto findNode = [&nodeIndices](uint32_t index) -> Node* {
+		auto node = nodeIndices.find(index);
+		return node != nodeIndices.end() ? node->second : nullptr;
+	};
+
+	for (const CachedSkin& cached : cachedSkins) {
+		Skin* skin = new Skin{};
+		skin->name = cached.name;
+		if (cached.skeletonRoot > -1) {
+			skin->skeletonRoot = findNode(static_cast<uint32_t>(cached.skeletonRoot));
+		}
+		for (uint32_t joint : cached.joints) {
+			if (Node* node = findNode(joint)) {
+				skin->joints.push_back(node);
+			}
+		}
+		skin->inverseBindMatrices = cached.inverseBindMatrices;
+		skins.push_back(skin);
+	}
+
+	for (CachedAnimation& cached : cachedAnimations) {
+		Animation animation{};
+		animation.name = cached.name;
+		animation.start = cached.start;
+		animation.end = cached.end;
+		animation.samplers.swap(cached.samplers);
+		for (const CachedChannel& source : cached.channels) {
+			AnimationChannel channel{};
+			channel.path = static_cast<AnimationChannel::PathType>(source.path);
+			channel.samplerIndex = source.samplerIndex;
+			channel.node = findNode(source.node);
+			if (channel.node) {
+				animation.channels.push_back(channel);
+			}
+		}
+		animations.push_back(animation);
+	}
+
+	for (auto node : linearNodes) {
+		if (node->skinIndex > -1 && node->skinIndex < static_cast<int32_t>(skins.size())) {
+			node->skin = skins[node->skinIndex];
+		}
+	}
+	createJointPalette();
+	updateNodes();
+	metallicRoughnessWorkflow = workflow;
+	return true;
+}
+
+void vkglTF::Model::writeCache(const std::string& cacheFile, uint32_t fileLoadingFlags, float scale, const std::vector<std::string>& dependencies, const tinygltf::Model& gltfModel, const std::vector<tinygltf::Image>& images, const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	CacheWriter writer;
+	writeHeader(writer, fileLoadingFlags, scale);
+
+	// External image files are sources as well
+	std::vector<std::string> filenames = dependencies;
+	for (const tinygltf::Image& image : images) {
+		if (isExternalImage(image)) {
+			filenames.push_back(path + "/" + decodeUri(image.uri));
+		}
+	}
+	writer.pod(static_cast<uint32_t>(filenames.size()));
+	for (const std::string& filename : filenames) {
+		CacheDependency dependency;
+		if (!fileStat(filename, dependency.size, dependency.mtime) || !fileHash(filename, dependency.hash)) {
+			return;
+		}
+		writer.string(filename);
+		writer.pod(dependency.size);
+		writer.pod(dependency.mtime);
+		writer.pod(dependency.hash);
+	}
+
+	// Texture sources, encoded images that don't have a file of their own are copied into the cache
+	const bool storeImages = !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+	writer.array(storeImages ? textureSamplers : std::vector<TextureSampler>());
+	writer.pod(static_cast<uint32_t>(storeImages ? images.size() : 0));
+	for (size_t i = 0; storeImages && i < images.size(); i++) {
+		const tinygltf::Image& image = images[i];
+		const bool external = isExternalImage(image);
+		writer.pod(static_cast<uint8_t>(external ? 1 : 0));
+		writer.string(external ? image.uri : std::string());
+		if (!external) {
+			writer.array(image.image);
+		}
+	}
+	writer.pod(static_cast<uint32_t>(storeImages ? gltfModel.textures.size() : 0));
+	for (size_t i = 0; storeImages && i < gltfModel.textures.size(); i++) {
+		writer.pod(static_cast<int32_t>(gltfModel.textures[i].source));
+		writer.pod(static_cast<int32_t>(gltfModel.textures[i].sampler));
+	}
+
+	std::vector<CachedMaterial> cachedMaterials;
+	cachedMaterials.reserve(materials.size());
+	for (const Material& material : materials) {
+		CachedMaterial cached{};
+		cached.alphaMode = material.alphaMode;
+		cached.alphaCutoff = material.alphaCutoff;
+		cached.baseColorFactor = material.baseColorFactor;
+		cached.metallicFactor = material.metallicFactor;
+		cached.roughnessFactor = material.roughnessFactor;
+		cached.emissiveFactor = material.emissiveFactor;
+		cached.textures[0] = textureIndex(textures, material.baseColorTexture);
+		cached.textures[1] = textureIndex(textures, material.normalTexture);
+		cached.textures[2] = textureIndex(textures, material.metallicRoughnessTexture);
+		cached.textures[3] = textureIndex(textures, material.emissiveTexture);
+		cached.texCoordSets[0] = material.texCoordSets.baseColor;
+		cached.texCoordSets[1] = material.texCoordSets.normal;
+		cached.texCoordSets[2] = material.texCoordSets.metallicRoughness;
+		cached.texCoordSets[3] = material.texCoordSets.emissive;
+		cachedMaterials.push_back(cached);
+	}
+	writer.array(cachedMaterials);
+
+	writer.array(vertexBuffer);
+	writer.array(indexBuffer);
+
+	std::map<const Node*, int32_t> linearIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		linearIndices[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	writer.pod(static_cast<uint32_t>(linearNodes.size()));
+	for (const Node* node : linearNodes) {
+		writer.pod(node->parent ? linearIndices[node->parent] : -1);
+		writer.pod(node->index);
+		writer.string(node->name);
+		writer.pod(transforms.matrices[node->transform]);
+		writer.pod(transforms.translations[node->transform]);
+		writer.pod(transforms.scales[node->transform]);
+		writer.pod(transforms.rotations[node->transform]);
+		writer.pod(node->skinIndex);
+		writer.pod(static_cast<uint8_t>(node->mesh ? 1 : 0));
+		if (node->mesh) {
+			writer.string(node->mesh->name);
+			std::vector<CachedPrimitive> primitives;
+			for (const Primitive* primitive : node->mesh->primitives) {
+				CachedPrimitive cached{};
+				cached.firstIndex = primitive->firstIndex;
+				cached.indexCount = primitive->indexCount;
+				cached.firstVertex = primitive->firstVertex;
+				cached.vertexCount = primitive->vertexCount;
+				cached.material = static_cast<uint32_t>(&primitive->material - materials.data());
+				cached.min = primitive->dimensions.min;
+				cached.max = primitive->dimensions.max;
+				primitives.push_back(cached);
+			}
+			writer.array(primitives);
+		}
+	}
+
+	writer.pod(static_cast<uint32_t>(skins.size()));
+	for (const Skin* skin : skins) {
+		writer.string(skin->name);
+		writer.pod(skin->skeletonRoot ? static_cast<int32_t>(skin->skeletonRoot->index) : -1);
+		writer.array(skin->inverseBindMatrices);
+		std::vector<uint32_t> joints;
+		for (const Node* joint : skin->joints) {
+			joints.push_back(joint->index);
+		}
+		writer.array(joints);
+	}
+
+	writer.pod(static_cast<uint32_t>(animations.size()));
+	for (const Animation& animation : animations) {
+		writer.string(animation.name);
+		writer.pod(animation.start);
+		writer.pod(animation.end);
+		writer.pod(static_cast<uint32_t>(animation.samplers.size()));
+		for (const AnimationSampler& sampler : animation.samplers) {
+			writer.pod(static_cast<uint32_t>(sampler.interpolation));
+			writer.array(sampler.inputs);
+			writer.array(sampler.outputsVec4);
+			writer.array(sampler.inTangents);
+			writer.array(sampler.outTangents);
+		}
+		std::vector<CachedChannel> channels;
+		for (const AnimationChannel& channel : animation.channels) {
+			channels.push_back({ static_cast<uint32_t>(channel.path), channel.node->index, channel.samplerIndex });
+		}
+		writer.array(channels);
+	}
+
+	writer.pod(static_cast<uint8_t>(metallicRoughnessWorkflow ? 1 : 0));
+
+	// Written under a temporary name, so an interrupted write never leaves a truncated cache behind
+	const std::string tempFile = cacheFile + ".tmp";
+	{
+		std::ofstream os(tempFile, std::ios::binary | std::ios::trunc);
+		if (!os.is_open()) {
+			std::cout << "Could not write model cache \"" << cacheFile << "\"" << std::endl;
+			return;
+		}
+		os.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+		if (os.fail()) {
+			os.close();
+			std::remove(tempFile.c_str());
+			return;
+		}
+	}
+	std::remove(cacheFile.c_str());
+	std::rename(tempFile.c_str(), cacheFile.c_str());
+}
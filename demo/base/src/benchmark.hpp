@@ -31,6 +31,9 @@ namespace vks
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		// Sample specific sections appended to the console output and the result file
+		std::vector<std::function<void(std::ostream&)>> reports;
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -67,6 +70,10 @@ namespace vks
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				for (auto& report : reports) {
+					std::cout << "\n";
+					report(std::cout);
+				}
 			}
 		}
 
@@ -92,6 +99,11 @@ namespace vks
 					std::cout << "\n";
 				}
 
+				for (auto& report : reports) {
+					result << "\n";
+					report(result);
+				}
+
 				result.flush();
 #if defined(_WIN32)
 				FreeConsole();
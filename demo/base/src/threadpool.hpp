@@ -6,6 +6,11 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <queue>
@@ -98,11 +103,24 @@ namespace vks
 	public:
 		std::vector<std::unique_ptr<Thread>> threads;
 
+		ThreadPool() = default;
+		explicit ThreadPool(uint32_t count)
+		{
+			setThreadCount(count);
+		}
+
+		// Pool shared by the CPU paths of the samples, one thread per core besides the calling thread
+		static ThreadPool& shared()
+		{
+			static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+			return pool;
+		}
+
 		// Sets the number of threads to be allocated in this pool
 		void setThreadCount(uint32_t count)
 		{
 			threads.clear();
-			for (auto i = 0; i < count; i++)
+			for (uint32_t i = 0; i < count; i++)
 			{
 				threads.push_back(make_unique<Thread>());
 			}
@@ -116,6 +134,29 @@ namespace vks
 				thread->wait();
 			}
 		}
+
+		// Runs func(i) for i in [0, count) on the pool threads and the calling thread, items are handed out one at a time
+		// Must not be called from a job running on this pool
+		void parallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+		{
+			std::atomic<uint32_t> next(0);
+			auto worker = [&]() {
+				for (uint32_t i = next++; i < count; i = next++)
+				{
+					func(i);
+				}
+			};
+			const uint32_t helpers = std::min(static_cast<uint32_t>(threads.size()), count > 0 ? count - 1 : 0u);
+			for (uint32_t i = 0; i < helpers; i++)
+			{
+				threads[i]->addJob(worker);
+			}
+			worker();
+			for (uint32_t i = 0; i < helpers; i++)
+			{
+				threads[i]->wait();
+			}
+		}
 	};
 
 }
@@ -82,6 +82,15 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 		}
 	}
 
+	// Memory budget queries (VK_EXT_memory_budget) go through vkGetPhysicalDeviceMemoryProperties2
+	if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end())
+	{
+		if (std::find_if(instanceExtensions.begin(), instanceExtensions.end(), [](const char* ext) { return strcmp(ext, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0; }) == instanceExtensions.end())
+		{
+			instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+	}
+
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceCreateInfo.pNext = NULL;
@@ -192,6 +201,7 @@ void VulkanExampleBase::prepare()
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
+		UIOverlay.setFrameCount(static_cast<uint32_t>(drawCmdBuffers.size()));
 		UIOverlay.shaders = {
 			loadShader(getShadersPath() + "base/uioverlay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
@@ -265,6 +275,10 @@ void VulkanExampleBase::nextFrame()
 void VulkanExampleBase::renderLoop()
 {
 	if (benchmark.active) {
+		benchmark.reports.push_back([this](std::ostream& os) {
+			vulkanDevice->memoryTracker.updateBudget();
+			vulkanDevice->memoryTracker.report(os);
+		});
 		benchmark.run([=] { render(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
 		if (benchmark.filename != "") {
@@ -622,6 +636,24 @@ void VulkanExampleBase::updateOverlay()
 #endif
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
+	if (ImGui::CollapsingHeader("Device memory")) {
+		vks::MemoryTracker& tracker = vulkanDevice->memoryTracker;
+		tracker.updateBudget();
+		const float MiB = 1.0f / (1024.0f * 1024.0f);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(vks::MemoryCategory::Count); i++) {
+			vks::MemoryCategory category = static_cast<vks::MemoryCategory>(i);
+			vks::MemoryTracker::Usage usage = tracker.getUsage(category);
+			ImGui::Text("%-14s %8.2f MiB (peak %.2f)", vks::MemoryTracker::categoryName(category), usage.live * MiB, usage.peak * MiB);
+		}
+		std::vector<vks::MemoryTracker::Heap> heaps = tracker.getHeaps();
+		for (uint32_t i = 0; i < heaps.size(); i++) {
+			if (tracker.budgetAvailable()) {
+				ImGui::Text("Heap %d: %.2f / %.2f MiB budget", i, heaps[i].usage * MiB, heaps[i].budget * MiB);
+			} else {
+				ImGui::Text("Heap %d: %.2f / %.2f MiB", i, heaps[i].tracked.live * MiB, heaps[i].size * MiB);
+			}
+		}
+	}
 	ImGui::PopItemWidth();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
@@ -643,7 +675,7 @@ void VulkanExampleBase::updateOverlay()
 #endif
 }
 
-void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
+void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer, uint32_t frame)
 {
 	if (settings.overlay) {
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -651,7 +683,7 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		UIOverlay.draw(commandBuffer);
+		UIOverlay.draw(commandBuffer, frame);
 	}
 }
 
@@ -666,6 +698,10 @@ void VulkanExampleBase::prepareFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	// The command buffer of this image is no longer in use, so its region of the overlay geometry can be rewritten
+	if (settings.overlay) {
+		UIOverlay.upload(currentBuffer);
+	}
 }
 
 void VulkanExampleBase::submitFrame()
@@ -796,7 +832,7 @@ VulkanExampleBase::~VulkanExampleBase()
 	}
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	vulkanDevice->freeMemory(depthStencil.mem);
 
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
@@ -945,6 +981,10 @@ bool VulkanExampleBase::initVulkan()
 	}
 	device = vulkanDevice->logicalDevice;
 
+	if (vulkanDevice->enableMemoryBudget) {
+		vulkanDevice->memoryTracker.enableBudget(reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR")));
+	}
+
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
 
@@ -2475,7 +2515,7 @@ void VulkanExampleBase::setupDepthStencil()
 	memAllloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	memAllloc.allocationSize = memReqs.size;
 	memAllloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &memAllloc, nullptr, &depthStencil.mem));
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(&memAllloc, &depthStencil.mem, vks::MemoryCategory::RenderTarget));
 	VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
 
 	VkImageViewCreateInfo imageViewCI{};
@@ -2615,7 +2655,7 @@ void VulkanExampleBase::windowResize()
 	// Recreate the frame buffers
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	vulkanDevice->freeMemory(depthStencil.mem);
 	setupDepthStencil();
 	for (uint32_t i = 0; i < frameBuffers.size(); i++) {
 		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
@@ -2634,6 +2674,9 @@ void VulkanExampleBase::windowResize()
 	// references to the recreated frame buffer
 	destroyCommandBuffers();
 	createCommandBuffers();
+	if (settings.overlay) {
+		UIOverlay.setFrameCount(static_cast<uint32_t>(drawCmdBuffers.size()));
+	}
 	buildCommandBuffers();
 
 	vkDeviceWaitIdle(device);
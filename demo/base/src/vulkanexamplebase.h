@@ -390,8 +390,8 @@ public:
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
 
-	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
-	void drawUI(const VkCommandBuffer commandBuffer);
+	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer, frame is the index of the command buffer */
+	void drawUI(const VkCommandBuffer commandBuffer, uint32_t frame);
 
 	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
 	void prepareFrame();
@@ -1,10 +1,11 @@
 #include "Bloom.h"
 
-void Bloom::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, vks::FramebufferAttachment* hdrScene, uint32_t width, uint32_t height)
+void Bloom::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, VkImage hdrScene, VkImageView hdrSceneView, uint32_t width, uint32_t height)
 {
 	m_vkDevice = vkDevice;
 	m_example = example;
 	m_hdrScene = hdrScene;
+	m_hdrSceneView = hdrSceneView;
 	m_width = width;
 	m_height = height;
 
@@ -34,16 +35,13 @@ void Bloom::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, vks::F
 		info.maxLod = 1000;
 		info.maxAnisotropy = 1.0f;
 		VK_CHECK_RESULT(vkCreateSampler(m_vkDevice->logicalDevice, &info, nullptr, &m_linearSampler));
-
-		info.magFilter = VK_FILTER_NEAREST;
-		info.minFilter = VK_FILTER_NEAREST;
-		VK_CHECK_RESULT(vkCreateSampler(m_vkDevice->logicalDevice, &info, nullptr, &m_nearestSampler));
 	}
 
 	prepareMipmap();
 
 	preparePrefilter();
 	prepareDownsample();
+	prepareBlur();
 	prepareUpsample();
 	prepareComposite();
 	updateDescriptorSets();
@@ -57,10 +55,10 @@ void Bloom::draw(VkCommandBuffer cb)
 		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, prefilter.pipeline);
 		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, prefilter.pLayout, 0, 1, &prefilter.descriptorSet, 0, nullptr);
 
-		Downsample::PushConstant data;
+		Prefilter::PushConstant data;
 		data.outputTextureSize = glm::vec2(m_width >> 1, m_height >> 1);
 		data.inputInvTextureSize = glm::vec2(1.0f / m_width, 1.0f / m_height);
-		vkCmdPushConstants(cb, downsample.pLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Downsample::PushConstant), (void*)&data);
+		vkCmdPushConstants(cb, prefilter.pLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Prefilter::PushConstant), (void*)&data);
 
 		uint32_t dispatchX = ((m_width >> 1) + 7) / 8;
 		uint32_t dispatchY = ((m_height >> 1) + 7) / 8;
@@ -69,61 +67,60 @@ void Bloom::draw(VkCommandBuffer cb)
 		vkCmdDispatch(cb, dispatchX, dispatchY, dispatchZ);
 	}
 
+	// The mip chain stays in VK_IMAGE_LAYOUT_GENERAL, passes only wait for the writes of the previous pass
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
 	// Downsample
-	//
+	// m_mipmap[1 ~ m_mipLevel - 1]: average of the level above, all levels in one dispatch
 	{
-		uint32_t dispatchX;
-		uint32_t dispatchY;
-		uint32_t dispatchZ = 1;
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-		for (uint32_t i = 0; i < m_mipLevel - 1; ++i) {
-			// First: Downsample + Horizontal Gaussian Blur
-			//
-
-			// m_mipmap[i]: VK_IMAGE_LAYOUT_GENERAL -> VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			VkImageMemoryBarrier imageMemoryBarrier = {};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
-			imageMemoryBarrier.image = m_mipmap;
+		m_downsampler->record(cb);
+	}
 
-			vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	// Blur
+	// m_mipmap[1 ~ m_mipLevel - 1]: horizontal pass into m_mipmapIntermediate, vertical pass back into m_mipmap
+	{
+		uint32_t dispatchZ = 1;
 
-			vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, downsample.pipelines.horizontal);
-			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, downsample.pLayout, 0, 1, &downsample.descriptorSets.horizontal[i], 0, nullptr);
-			
-			Downsample::PushConstant data;
-			data.outputTextureSize = glm::vec2(m_width >> (i + 2), m_height >> (i + 2));
-			data.inputInvTextureSize = glm::vec2(1.0f / (m_width >> (i + 1)), 1.0f / (m_height >> (i + 1)));
-			vkCmdPushConstants(cb, downsample.pLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Downsample::PushConstant), (void*)&data);
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-			dispatchX = ((m_width >> (i + 2)) + 7) / 8;
-			dispatchY = ((m_height >> (i + 2)) + 7) / 8;
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, blur.pipelines.horizontal);
+		for (uint32_t i = 1; i < m_mipLevel; ++i) {
+			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, blur.pLayout, 0, 1, &blur.descriptorSets.horizontal[i - 1], 0, nullptr);
 
-			vkCmdDispatch(cb, dispatchX, dispatchY, dispatchZ);
+			uint32_t width = (std::max)(m_width >> (i + 1), 1u);
+			uint32_t height = (std::max)(m_height >> (i + 1), 1u);
+
+			Blur::PushConstant data;
+			data.textureSize = glm::vec2(width, height);
+			data.invTextureSize = glm::vec2(1.0f / width, 1.0f / height);
+			vkCmdPushConstants(cb, blur.pLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Blur::PushConstant), (void*)&data);
 
-			// Second: Vertical Gaussian Blur
-			//
+			vkCmdDispatch(cb, (width + 7) / 8, (height + 7) / 8, dispatchZ);
+		}
 
-			// m_mipmapIntermediate[i]: VK_IMAGE_LAYOUT_GENERAL -> VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			imageMemoryBarrier.image = m_mipmapIntermediate;
+		// m_mipmapIntermediate: written by the horizontal pass
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-			vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, blur.pipelines.vertical);
+		for (uint32_t i = 1; i < m_mipLevel; ++i) {
+			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, blur.pLayout, 0, 1, &blur.descriptorSets.vertical[i - 1], 0, nullptr);
 
-			vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, downsample.pipelines.vertical);
-			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, downsample.pLayout, 0, 1, &downsample.descriptorSets.vertical[i], 0, nullptr);
+			uint32_t width = (std::max)(m_width >> (i + 1), 1u);
+			uint32_t height = (std::max)(m_height >> (i + 1), 1u);
 
-			data.inputInvTextureSize = glm::vec2(1.0f / (m_width >> (i + 2)), 1.0f / (m_height >> (i + 2)));
-			vkCmdPushConstants(cb, downsample.pLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Downsample::PushConstant), (void*)&data);
+			Blur::PushConstant data;
+			data.textureSize = glm::vec2(width, height);
+			data.invTextureSize = glm::vec2(1.0f / width, 1.0f / height);
+			vkCmdPushConstants(cb, blur.pLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Blur::PushConstant), (void*)&data);
 
-			vkCmdDispatch(cb, dispatchX, dispatchY, dispatchZ);
+			vkCmdDispatch(cb, (width + 7) / 8, (height + 7) / 8, dispatchZ);
 		}
 	}
 
@@ -136,20 +133,9 @@ void Bloom::draw(VkCommandBuffer cb)
 		uint32_t dispatchY;
 		uint32_t dispatchZ = 1;
 		for (uint32_t i = m_mipLevel - 1; i > 0; --i) {
-			// m_mipmap[i - 1]: VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL -> VK_IMAGE_LAYOUT_GENERAL
-			VkImageMemoryBarrier imageMemoryBarrier = {};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1, 0, 1 };
-			imageMemoryBarrier.image = m_mipmap;
-
+			// m_mipmap[i]: written by the vertical blur or the previous upsample
 			vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, upsample.pLayout, 0, 1, &upsample.descriptorSets[(m_mipLevel - 1) - i], 0, nullptr);
 
@@ -180,10 +166,11 @@ void Bloom::draw(VkCommandBuffer cb)
 		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		imageMemoryBarrier.image = m_hdrScene->image;
+		imageMemoryBarrier.image = m_hdrScene;
 
+		// m_mipmap[0]: written by the last upsample
 		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			0, 1, &memoryBarrier, 0, nullptr, 1, &imageMemoryBarrier);
 
 		Upsample::PushConstant data;
 		data.outputTextureSize = glm::vec2(m_width, m_height);
@@ -203,25 +190,12 @@ void Bloom::draw(VkCommandBuffer cb)
 			0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 	}
 
-	// m_mipmapIntermediate[0 ~ m_mipLevel - 2]: VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL -> VK_IMAGE_LAYOUT_GENERAL
-	VkImageMemoryBarrier imageMemoryBarrier = {};
-	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipLevel - 1, 0, 1 };
-	imageMemoryBarrier.image = m_mipmapIntermediate;
-
-	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 }
 
-void Bloom::onResized(vks::FramebufferAttachment* hdrScene, uint32_t width, uint32_t height)
+void Bloom::onResized(VkImage hdrScene, VkImageView hdrSceneView, uint32_t width, uint32_t height)
 {
 	m_hdrScene = hdrScene;
+	m_hdrSceneView = hdrSceneView;
 	m_width = width;
 	m_height = height;
 
@@ -236,7 +210,6 @@ void Bloom::destroy()
 	destroyMipmap();
 
 	vkDestroySampler(m_vkDevice->logicalDevice, m_linearSampler, nullptr);
-	vkDestroySampler(m_vkDevice->logicalDevice, m_nearestSampler, nullptr);
 
 	vkDestroyDescriptorPool(m_vkDevice->logicalDevice, m_descriptorPool, nullptr);
 
@@ -247,10 +220,13 @@ void Bloom::destroy()
 	vkDestroyPipeline(m_vkDevice->logicalDevice, prefilter.pipeline, nullptr);
 
 	// Downsample
-	vkDestroyDescriptorSetLayout(m_vkDevice->logicalDevice, downsample.dsLayout, nullptr);
-	vkDestroyPipelineLayout(m_vkDevice->logicalDevice, downsample.pLayout, nullptr);
-	vkDestroyPipeline(m_vkDevice->logicalDevice, downsample.pipelines.horizontal, nullptr);
-	vkDestroyPipeline(m_vkDevice->logicalDevice, downsample.pipelines.vertical, nullptr);
+	m_downsampler.reset();
+
+	// Blur
+	vkDestroyDescriptorSetLayout(m_vkDevice->logicalDevice, blur.dsLayout, nullptr);
+	vkDestroyPipelineLayout(m_vkDevice->logicalDevice, blur.pLayout, nullptr);
+	vkDestroyPipeline(m_vkDevice->logicalDevice, blur.pipelines.horizontal, nullptr);
+	vkDestroyPipeline(m_vkDevice->logicalDevice, blur.pipelines.vertical, nullptr);
 
 	// Upsample
 	vkDestroyDescriptorSetLayout(m_vkDevice->logicalDevice, upsample.dsLayout, nullptr);
@@ -285,7 +261,7 @@ void Bloom::prepareMipmap()
 		alloc_info.allocationSize = 0;
 		alloc_info.allocationSize = mem_reqs.size;
 		alloc_info.memoryTypeIndex = m_vkDevice->getMemoryType(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(m_vkDevice->logicalDevice, &alloc_info, nullptr, &m_mipmapMem));
+		VK_CHECK_RESULT(m_vkDevice->allocateMemory(&alloc_info, &m_mipmapMem, vks::MemoryCategory::RenderTarget));
 		VK_CHECK_RESULT(vkBindImageMemory(m_vkDevice->logicalDevice, m_mipmap, m_mipmapMem, 0));
 
 		VkImageViewCreateInfo info = {};
@@ -303,8 +279,8 @@ void Bloom::prepareMipmap()
 		}
 	}
 
-	// Mipmap intermediate 
-	// Use to store intermediate result
+	// Mipmap intermediate
+	// Use to store the horizontally blurred levels
 	{
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -327,7 +303,7 @@ void Bloom::prepareMipmap()
 		alloc_info.allocationSize = 0;
 		alloc_info.allocationSize = mem_reqs.size;
 		alloc_info.memoryTypeIndex = m_vkDevice->getMemoryType(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(m_vkDevice->logicalDevice, &alloc_info, nullptr, &m_mipmapIntermediateMem));
+		VK_CHECK_RESULT(m_vkDevice->allocateMemory(&alloc_info, &m_mipmapIntermediateMem, vks::MemoryCategory::RenderTarget));
 		VK_CHECK_RESULT(vkBindImageMemory(m_vkDevice->logicalDevice, m_mipmapIntermediate, m_mipmapIntermediateMem, 0));
 
 		VkImageViewCreateInfo info = {};
@@ -377,22 +353,22 @@ void Bloom::prepareMipmap()
 void Bloom::destroyMipmap()
 {
 	vkDestroyImage(m_vkDevice->logicalDevice, m_mipmap, nullptr);
-	for (int i = 0; i < MAX_MIP_LEVEL; ++i) {
+	for (uint32_t i = 0; i < MAX_MIP_LEVEL; ++i) {
 		if (m_mipmapViews[i] != VK_NULL_HANDLE) {
 			vkDestroyImageView(m_vkDevice->logicalDevice, m_mipmapViews[i], nullptr);
 			m_mipmapViews[i] = VK_NULL_HANDLE;
 		}
 	}
-	vkFreeMemory(m_vkDevice->logicalDevice, m_mipmapMem, nullptr);
+	m_vkDevice->freeMemory(m_mipmapMem);
 
 	vkDestroyImage(m_vkDevice->logicalDevice, m_mipmapIntermediate, nullptr);
-	for (int i = 0; i < MAX_MIP_LEVEL - 1; ++i) {
+	for (uint32_t i = 0; i < MAX_MIP_LEVEL - 1; ++i) {
 		if (m_mipmapIntermediateViews[i] != VK_NULL_HANDLE) {
 			vkDestroyImageView(m_vkDevice->logicalDevice, m_mipmapIntermediateViews[i], nullptr);
 			m_mipmapIntermediateViews[i] = VK_NULL_HANDLE;
 		}
 	}
-	vkFreeMemory(m_vkDevice->logicalDevice, m_mipmapIntermediateMem, nullptr);
+	m_vkDevice->freeMemory(m_mipmapIntermediateMem);
 }
 
 void Bloom::preparePrefilter()
@@ -421,7 +397,7 @@ void Bloom::preparePrefilter()
 
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&prefilter.dsLayout, 1);
-		VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Downsample::PushConstant) };
+		VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Prefilter::PushConstant) };
 		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -448,6 +424,12 @@ void Bloom::preparePrefilter()
 }
 
 void Bloom::prepareDownsample()
+{
+	m_downsampler.reset(new vks::Downsampler(m_vkDevice, m_example->queue, m_example->pipelineCache, m_example->getShadersPath(),
+		VK_FORMAT_R16G16B16A16_SFLOAT, vks::Downsampler::Reduction::Average));
+}
+
+void Bloom::prepareBlur()
 {
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
@@ -455,39 +437,39 @@ void Bloom::prepareDownsample()
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vkDevice->logicalDevice, &descriptorLayout, nullptr, &downsample.dsLayout));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vkDevice->logicalDevice, &descriptorLayout, nullptr, &blur.dsLayout));
 
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&downsample.dsLayout, 1);
-		VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Downsample::PushConstant) };
+		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&blur.dsLayout, 1);
+		VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Blur::PushConstant) };
 		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(m_vkDevice->logicalDevice, &pPipelineLayoutCreateInfo, nullptr, &downsample.pLayout));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(m_vkDevice->logicalDevice, &pPipelineLayoutCreateInfo, nullptr, &blur.pLayout));
 	}
 
 	{
-		VkPipelineShaderStageCreateInfo shader = m_example->loadShader(m_example->getShadersPath() + "final/spirv/bloomDownsampleHorizontal.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VkPipelineShaderStageCreateInfo shader = m_example->loadShader(m_example->getShadersPath() + "final/spirv/bloomBlurHorizontal.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 
 		VkComputePipelineCreateInfo pipeline = {};
 		pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-		pipeline.layout = downsample.pLayout;
+		pipeline.layout = blur.pLayout;
 		pipeline.stage = shader;
 		pipeline.basePipelineHandle = VK_NULL_HANDLE;
 		pipeline.basePipelineIndex = 0;
 
-		VK_CHECK_RESULT(vkCreateComputePipelines(m_vkDevice->logicalDevice, m_example->pipelineCache, 1, &pipeline, nullptr, &downsample.pipelines.horizontal));
+		VK_CHECK_RESULT(vkCreateComputePipelines(m_vkDevice->logicalDevice, m_example->pipelineCache, 1, &pipeline, nullptr, &blur.pipelines.horizontal));
 
-		shader = m_example->loadShader(m_example->getShadersPath() + "final/spirv/bloomDownsampleVertical.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		shader = m_example->loadShader(m_example->getShadersPath() + "final/spirv/bloomBlurVertical.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		pipeline.stage = shader;
 
-		VK_CHECK_RESULT(vkCreateComputePipelines(m_vkDevice->logicalDevice, m_example->pipelineCache, 1, &pipeline, nullptr, &downsample.pipelines.vertical));
+		VK_CHECK_RESULT(vkCreateComputePipelines(m_vkDevice->logicalDevice, m_example->pipelineCache, 1, &pipeline, nullptr, &blur.pipelines.vertical));
 	}
 
 	{
-		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &downsample.dsLayout, 1);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &blur.dsLayout, 1);
 		for (uint32_t i = 0; i < MAX_MIP_LEVEL - 1; ++i) {
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &downsample.descriptorSets.horizontal[i]));
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &downsample.descriptorSets.vertical[i]));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &blur.descriptorSets.horizontal[i]));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &blur.descriptorSets.vertical[i]));
 		}
 	}
 }
@@ -545,7 +527,7 @@ void Bloom::updateDescriptorSets()
 	{
 		VkDescriptorImageInfo descriptorInputTexture = vks::initializers::descriptorImageInfo(
 			m_linearSampler,
-			m_hdrScene->view,
+			m_hdrSceneView,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo descriptorOutputTexture = vks::initializers::descriptorImageInfo(
@@ -562,39 +544,44 @@ void Bloom::updateDescriptorSets()
 	}
 
 	// Downsample
-	for (uint32_t i = 0; i < m_mipLevel - 1; ++i) {
+	// The chain starts at the prefiltered level 0, sampled and written in VK_IMAGE_LAYOUT_GENERAL
+	m_downsampler->setChain(m_mipmapViews[0], m_linearSampler, VK_IMAGE_LAYOUT_GENERAL, m_mipmapViews, m_mipLevel, m_width >> 1, m_height >> 1);
+
+	// Blur
+	// Samples are taken at texel centers, so the linear sampler reads single texels
+	for (uint32_t i = 1; i < m_mipLevel; ++i) {
 		{
 			VkDescriptorImageInfo descriptorInputTexture = vks::initializers::descriptorImageInfo(
 				m_linearSampler,
 				m_mipmapViews[i],
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				VK_IMAGE_LAYOUT_GENERAL);
 
 			VkDescriptorImageInfo descriptorOutputTexture = vks::initializers::descriptorImageInfo(
 				VK_NULL_HANDLE,
-				m_mipmapIntermediateViews[i],
+				m_mipmapIntermediateViews[i - 1],
 				VK_IMAGE_LAYOUT_GENERAL);
 
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(downsample.descriptorSets.horizontal[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &descriptorInputTexture),
-				vks::initializers::writeDescriptorSet(downsample.descriptorSets.horizontal[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &descriptorOutputTexture)
+				vks::initializers::writeDescriptorSet(blur.descriptorSets.horizontal[i - 1], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &descriptorInputTexture),
+				vks::initializers::writeDescriptorSet(blur.descriptorSets.horizontal[i - 1], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &descriptorOutputTexture)
 			};
 			vkUpdateDescriptorSets(m_vkDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
 
 		{
 			VkDescriptorImageInfo descriptorInputTexture = vks::initializers::descriptorImageInfo(
-				m_nearestSampler,
-				m_mipmapIntermediateViews[i],
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				m_linearSampler,
+				m_mipmapIntermediateViews[i - 1],
+				VK_IMAGE_LAYOUT_GENERAL);
 
 			VkDescriptorImageInfo descriptorOutputTexture = vks::initializers::descriptorImageInfo(
 				VK_NULL_HANDLE,
-				m_mipmapViews[i + 1],
+				m_mipmapViews[i],
 				VK_IMAGE_LAYOUT_GENERAL);
 
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(downsample.descriptorSets.vertical[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &descriptorInputTexture),
-				vks::initializers::writeDescriptorSet(downsample.descriptorSets.vertical[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &descriptorOutputTexture)
+				vks::initializers::writeDescriptorSet(blur.descriptorSets.vertical[i - 1], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &descriptorInputTexture),
+				vks::initializers::writeDescriptorSet(blur.descriptorSets.vertical[i - 1], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &descriptorOutputTexture)
 			};
 			vkUpdateDescriptorSets(m_vkDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
@@ -625,7 +612,7 @@ void Bloom::updateDescriptorSets()
 	{
 		VkDescriptorImageInfo descriptorOriginalTexture = vks::initializers::descriptorImageInfo(
 			VK_NULL_HANDLE,
-			m_hdrScene->view,
+			m_hdrSceneView,
 			VK_IMAGE_LAYOUT_GENERAL);
 
 		VkDescriptorImageInfo descriptorBloomTexture = vks::initializers::descriptorImageInfo(
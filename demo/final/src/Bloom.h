@@ -1,15 +1,16 @@
+#include <memory>
+
 #include <vulkan/vulkan.h>
 
 #include "vulkanexamplebase.h"
-
-#include "VulkanFrameBuffer.hpp"
+#include "VulkanDownsampler.h"
 
 class Bloom {
 	static constexpr uint32_t MAX_MIP_LEVEL = 7;
 public:
-	void init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, vks::FramebufferAttachment* hdrScene, uint32_t width, uint32_t height);
+	void init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, VkImage hdrScene, VkImageView hdrSceneView, uint32_t width, uint32_t height);
 	void draw(VkCommandBuffer cb);
-	void onResized(vks::FramebufferAttachment* hdrScene, uint32_t width, uint32_t height);
+	void onResized(VkImage hdrScene, VkImageView hdrSceneView, uint32_t width, uint32_t height);
 	void destroy();
 private:
 	void prepareMipmap();
@@ -17,6 +18,7 @@ private:
 
 	void preparePrefilter();
 	void prepareDownsample();
+	void prepareBlur();
 	void prepareUpsample();
 	void prepareComposite();
 	void updateDescriptorSets();
@@ -24,7 +26,8 @@ private:
 	vks::VulkanDevice* m_vkDevice;
 	VulkanExampleBase* m_example;
 
-	vks::FramebufferAttachment* m_hdrScene;
+	VkImage m_hdrScene;
+	VkImageView m_hdrSceneView;
 
 	uint32_t m_width;
 	uint32_t m_height;
@@ -34,16 +37,20 @@ private:
 	VkDeviceMemory m_mipmapMem;
 	VkImageView m_mipmapViews[MAX_MIP_LEVEL] = {};
 
+	// Horizontally blurred m_mipmap[1 ~ m_mipLevel - 1]
 	VkImage m_mipmapIntermediate;
 	VkDeviceMemory m_mipmapIntermediateMem;
 	VkImageView m_mipmapIntermediateViews[MAX_MIP_LEVEL - 1] = {};
 
 	VkSampler m_linearSampler;
-	VkSampler m_nearestSampler;
 
 	VkDescriptorPool m_descriptorPool;
 
 	struct Prefilter {
+		struct PushConstant {
+			glm::vec2 outputTextureSize;
+			glm::vec2 inputInvTextureSize;
+		};
 		struct {
 			float threshold;
 		} uniforms;
@@ -55,10 +62,14 @@ private:
 		VkDescriptorSet descriptorSet;
 	} prefilter;
 
-	struct Downsample {
+	// Averages m_mipmap[0] into the other levels in one dispatch
+	std::unique_ptr<vks::Downsampler> m_downsampler;
+
+	// Separable Gaussian blur of the downsampled levels, through m_mipmapIntermediate
+	struct Blur {
 		struct PushConstant {
-			glm::vec2 outputTextureSize;
-			glm::vec2 inputInvTextureSize;
+			glm::vec2 textureSize;
+			glm::vec2 invTextureSize;
 		};
 
 		VkDescriptorSetLayout dsLayout;
@@ -71,7 +82,7 @@ private:
 			VkDescriptorSet horizontal[MAX_MIP_LEVEL - 1];
 			VkDescriptorSet vertical[MAX_MIP_LEVEL - 1];
 		} descriptorSets;
-	} downsample;
+	} blur;
 
 	struct Upsample {
 		struct PushConstant {
@@ -9,11 +9,12 @@ ParticleEffect::ParticleEffect()
 
 }
 
-void ParticleEffect::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, VkRenderPass renderPass)
+void ParticleEffect::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, VkRenderPass renderPass, vks::UniformArena* uniformArena)
 {
 	m_vkDevice = vkDevice;
 	m_example = example;
 	m_renderPass = renderPass;
+	m_uniformArena = uniformArena;
 
 	prepareDescriptorSetLayout();
 	preparePipelineLayout();
@@ -38,11 +39,14 @@ void ParticleEffect::update()
 	}
 
 	// Particle update
+}
 
-	updateUniformBuffer();
+void ParticleEffect::writeUniforms()
+{
+	m_uniformOffset = m_uniformArena->push(uniforms);
 }
 
-void ParticleEffect::draw(VkCommandBuffer cb)
+void ParticleEffect::draw(VkCommandBuffer cb, uint32_t frame)
 {
 	VkDeviceSize offsets[1] = { 0 };
 	// Binding point 0 : Mesh vertex buffer
@@ -52,7 +56,8 @@ void ParticleEffect::draw(VkCommandBuffer cb)
 	// Bind index buffer
 	vkCmdBindIndexBuffer(cb, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pLayout, 0, 1, &m_descriptorSet, 0, NULL);
+	const uint32_t dynamicOffset = m_uniformArena->frameOffset(frame) + m_uniformOffset;
+	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pLayout, 0, 1, &m_descriptorSet, 1, &dynamicOffset);
 
 	m_pointDrawable.draw(cb, m_pLayout);
 	m_lineDrawable.draw(cb, m_pLayout);
@@ -74,7 +79,6 @@ void ParticleEffect::destroy()
 	m_instanceBuffer.destroy();
 	m_indexBuffer.destroy();
 
-	m_uniformBuffer.destroy();
 	m_texRaindrop.destroy();
 }
 
@@ -107,8 +111,6 @@ void ParticleEffect::rain(float intensity)
 	uniforms.particleColor = m_particleColor;
 	uniforms.particleSize = m_particleSize;
 	uniforms.inversePeriod = 1.0f / m_period;
-
-	updateUniformBuffer();
 }
 
 void ParticleEffect::snow(float intensity)
@@ -140,8 +142,6 @@ void ParticleEffect::snow(float intensity)
 	uniforms.particleColor = m_particleColor;
 	uniforms.particleSize = m_particleSize;
 	uniforms.inversePeriod = 1.0f / m_period;
-
-	updateUniformBuffer();
 }
 
 void ParticleEffect::cull()
@@ -347,16 +347,6 @@ void ParticleEffect::createGeometry(uint32_t numParticles)
 
 void ParticleEffect::prepareUniforms()
 {
-	// Uniform Buffer
-	//
-	VK_CHECK_RESULT(m_vkDevice->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&m_uniformBuffer,
-		sizeof(uniforms)));
-
-	VK_CHECK_RESULT(m_uniformBuffer.map());
-
 	// Time
 	uniforms.time = m_simuTime;
 
@@ -364,18 +354,13 @@ void ParticleEffect::prepareUniforms()
 	uniforms.projection = m_example->camera.matrices.perspective;
 
 	// Particle
-	rain(0.2f); // Update uniform happens here
+	rain(0.2f);
 
 	// Uniform Texture
 	//
 	createSpotLightImage(glm::vec4(1.0f), glm::vec4(glm::vec3(1.0f), 0.0f), 32, 1.0f);
 }
 
-void ParticleEffect::updateUniformBuffer()
-{
-	memcpy(m_uniformBuffer.mapped, &uniforms, sizeof(uniforms));
-}
-
 void ParticleEffect::createSpotLightImage(glm::vec4& centerColor, glm::vec4& backgroundColor, uint32_t size, float power)
 {
 	std::vector<unsigned char> imageData(size * size * 4);
@@ -419,7 +404,7 @@ void ParticleEffect::fillSpotLightImage(unsigned char* ptr, glm::vec4& centerCol
 void ParticleEffect::prepareDescriptorSetLayout()
 {
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
 	};
 
@@ -441,7 +426,7 @@ void ParticleEffect::preparePipelineLayout()
 void ParticleEffect::prepareDescriptorSet()
 {
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
 	};
 
@@ -450,8 +435,9 @@ void ParticleEffect::prepareDescriptorSet()
 
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_dsLayout, 1);
 	VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &m_descriptorSet));
+	VkDescriptorBufferInfo uniformDescriptor = m_uniformArena->descriptor(sizeof(uniforms));
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &m_uniformBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &uniformDescriptor),
 		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &m_texRaindrop.descriptor)
 	};
 	vkUpdateDescriptorSets(m_vkDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
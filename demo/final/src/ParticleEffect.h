@@ -12,6 +12,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanUniformArena.h"
 
 #include "osg/PolyTope.h"
 
@@ -38,9 +39,11 @@ class ParticleEffect {
 public:
 	ParticleEffect();
 
-	void init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, VkRenderPass renderPass);
+	void init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, VkRenderPass renderPass, vks::UniformArena* uniformArena);
 	void update();
-	void draw(VkCommandBuffer cb);
+	// Pushes the uniforms into the current frame of the arena, the offset has to be the same every frame
+	void writeUniforms();
+	void draw(VkCommandBuffer cb, uint32_t frame);
 	void destroy();
 
 	void rain(float intensity);
@@ -51,7 +54,6 @@ private:
 
 	void createGeometry(uint32_t numParticles);
 	void prepareUniforms();
-	void updateUniformBuffer();
 	void createSpotLightImage(glm::vec4& centerColor, glm::vec4& backgroundColor, uint32_t size, float power);
 	void fillSpotLightImage(unsigned char* ptr, glm::vec4& centerColor, glm::vec4& backgroundColor, uint32_t size, float power);
 
@@ -81,7 +83,8 @@ private:
 
 		float time;
 	}uniforms;
-	vks::Buffer m_uniformBuffer;
+	vks::UniformArena* m_uniformArena;
+	uint32_t m_uniformOffset = 0;
 	vks::Texture2D m_texRaindrop;
 
 	VkRenderPass m_renderPass;
@@ -7,7 +7,8 @@
 */
 
 #include "vulkanexamplebase.h"
-#include "VulkanFrameBuffer.hpp"
+#include "VulkanRenderGraph.h"
+#include "VulkanUniformArena.h"
 #include "VulkanglTFModel.h"
 
 #include "GPUTimestamps.h"
@@ -67,17 +68,20 @@ public:
 	/*
 		UNIFORM BUFFER
 	*/
+	// All constants are written again every frame into the arena region of the submitted command buffer,
+	// always in the same order so their offsets in the region don't change and the command buffers stay valid
+	std::unique_ptr<vks::UniformArena> uniformArena;
 	struct {
-		vks::Buffer shadowGeometryShader;
-		vks::Buffer geometry;
-		vks::Buffer ssao;
-		vks::Buffer ssaoBlur;
-		vks::Buffer lighting;
-		vks::Buffer ssr;
-		vks::Buffer ssrBlur;
-		vks::Buffer composition;
-		vks::Buffer tonemapping;
-	} uniformBuffers;
+		uint32_t shadow;
+		uint32_t geometry;
+		uint32_t ssao;
+		uint32_t ssaoBlur;
+		uint32_t lighting;
+		uint32_t ssr;
+		uint32_t ssrBlur;
+		uint32_t composition;
+		uint32_t tonemapping;
+	} uniformOffsets = {};
 
 	// This UBO stores the shadow matrices for all of the light sources
 	// The matrices are indexed using geometry shader instancing
@@ -189,17 +193,42 @@ public:
 	} descriptorSets;
 	VkDescriptorSet descriptorSet; // tonemapping
 
+	// Render targets and passes up to tonemapping, the graph places barriers and aliases the target memory
+	std::unique_ptr<vks::RenderGraph> renderGraph;
+
+	struct {
+		vks::RenderGraph::ResourceHandle shadowMap;
+		vks::RenderGraph::ResourceHandle position;
+		vks::RenderGraph::ResourceHandle normal;
+		vks::RenderGraph::ResourceHandle albedo;
+		vks::RenderGraph::ResourceHandle emissive;
+		vks::RenderGraph::ResourceHandle depth;
+		vks::RenderGraph::ResourceHandle ssao;
+		vks::RenderGraph::ResourceHandle ssaoBlur;
+		vks::RenderGraph::ResourceHandle lighting;
+		vks::RenderGraph::ResourceHandle ssr;
+		vks::RenderGraph::ResourceHandle ssrBlur;
+		vks::RenderGraph::ResourceHandle composition;
+	} targets;
+
 	struct {
-		std::unique_ptr<vks::Framebuffer> shadow;
-		std::unique_ptr<vks::Framebuffer> geometry;
-		std::unique_ptr<vks::Framebuffer> ssao;
-		std::unique_ptr<vks::Framebuffer> ssaoBlur;
-		std::unique_ptr<vks::Framebuffer> lighting;
-		std::unique_ptr<vks::Framebuffer> ssr;
-		std::unique_ptr<vks::Framebuffer> ssrBlur;
-		std::unique_ptr<vks::Framebuffer> composition;
+		vks::RenderGraph::PassHandle shadow;
+		vks::RenderGraph::PassHandle geometry;
+		vks::RenderGraph::PassHandle ssao;
+		vks::RenderGraph::PassHandle ssaoBlur;
+		vks::RenderGraph::PassHandle lighting;
+		vks::RenderGraph::PassHandle ssr;
+		vks::RenderGraph::PassHandle ssrBlur;
+		vks::RenderGraph::PassHandle composition;
+		vks::RenderGraph::PassHandle bloom;
+		vks::RenderGraph::PassHandle tonemapping;
 	} passes;
 
+	struct {
+		VkSampler nearest;
+		VkSampler shadow;
+	} samplers;
+
 	GPUTimestamps GPUTimer;
 	std::vector<TimeStamp> timeStamps;
 
@@ -254,16 +283,11 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		vkDestroySampler(device, samplers.nearest, nullptr);
+		vkDestroySampler(device, samplers.shadow, nullptr);
+
 		// Uniform buffers
-		uniformBuffers.shadowGeometryShader.destroy();
-		uniformBuffers.geometry.destroy();
-		uniformBuffers.ssao.destroy();
-		uniformBuffers.ssaoBlur.destroy();
-		uniformBuffers.lighting.destroy();
-		uniformBuffers.ssr.destroy();
-		uniformBuffers.ssrBlur.destroy();
-		uniformBuffers.composition.destroy();
-		uniformBuffers.tonemapping.destroy();
+		uniformArena.reset();
 
 		// Textures
 		textures.model.colorMap.destroy();
@@ -315,86 +339,231 @@ public:
 	}
 
 	void prepareGraphicsPasses() {
+		renderGraph = std::make_unique<vks::RenderGraph>(vulkanDevice, width, height);
+
+		// Render targets
+		// Their usage is derived from the passes, targets that are not alive at the same time share memory
+		//
+		vks::RenderGraph::ImageDesc desc;
+		desc.width = SHADOWMAP_DIM;
+		desc.height = SHADOWMAP_DIM;
+		desc.layerCount = LIGHT_COUNT;
+		desc.format = SHADOWMAP_FORMAT;
+		targets.shadowMap = renderGraph->createImage("shadow map", desc);
+
+		desc = vks::RenderGraph::ImageDesc();
+		desc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		targets.position = renderGraph->createImage("position", desc);
+		targets.normal = renderGraph->createImage("normal", desc);
+		targets.emissive = renderGraph->createImage("emissive", desc);
+		targets.lighting = renderGraph->createImage("direct lighting", desc);
+		targets.ssr = renderGraph->createImage("ssr", desc);
+		targets.ssrBlur = renderGraph->createImage("ssr blur", desc);
+		// Bloom composites into the scene color with image stores
+		desc.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		targets.composition = renderGraph->createImage("composition", desc);
+
+		desc = vks::RenderGraph::ImageDesc();
+		desc.format = VK_FORMAT_R8G8B8A8_UNORM;
+		targets.albedo = renderGraph->createImage("albedo", desc);
+		targets.ssao = renderGraph->createImage("ssao", desc);
+		targets.ssaoBlur = renderGraph->createImage("ssao blur", desc);
+
+		desc = vks::RenderGraph::ImageDesc();
+		desc.format = depthFormat;
+		targets.depth = renderGraph->importImage("depth", desc, depthStencil.image, depthStencil.view);
+
+		VkClearValue clearColor = {};
+		clearColor.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		VkClearValue clearDepth = {};
+		clearDepth.depthStencil = { 1.0f, 0 };
+
 		// Shadow
 		//
-		passes.shadow = std::make_unique<vks::Framebuffer>(vulkanDevice, SHADOWMAP_DIM, SHADOWMAP_DIM);
-		passes.shadow->addAttachment(SHADOWMAP_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, LIGHT_COUNT);
-		VK_CHECK_RESULT(passes.shadow->createSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.shadow->createRenderPass());
+		passes.shadow = renderGraph->addPass("Shadow Map", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			// Set depth bias (aka "Polygon offset")
+			vkCmdSetDepthBias(
+				cmdBuffer,
+				depthBiasConstant,
+				0.0f,
+				depthBiasSlope);
+
+			statistics.begin(cmdBuffer, "Shadow Map", i);
+
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadowpass);
+			renderScene(cmdBuffer, i, true);
+
+			statistics.end(cmdBuffer);
+
+			GPUTimer.NextTimeStamp(cmdBuffer);
+		});
+		renderGraph->depthAttachment(passes.shadow, targets.shadowMap, &clearDepth);
 
 		// Geometry
 		//
-		passes.geometry = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.geometry->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // position
-		passes.geometry->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // normal
-		passes.geometry->addAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // albedo
-		passes.geometry->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // emissive
-
-		// depth
-		vks::FramebufferAttachment depth;
-		depth.image = depthStencil.image;
-		depth.memory = depthStencil.mem;
-		depth.view = depthStencil.view;
-		depth.format = depthFormat;
-		depth.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
-		depth.description = {
-			0,
-			depth.format,
-			VK_SAMPLE_COUNT_1_BIT,
-			VK_ATTACHMENT_LOAD_OP_CLEAR,
-			VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-		};
-		depth.weakRef = true;
-		passes.geometry->attachments.push_back(depth);
+		passes.geometry = renderGraph->addPass("Geometry", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			statistics.begin(cmdBuffer, "Geometry", i);
+
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
+			renderScene(cmdBuffer, i, false);
 
-		VK_CHECK_RESULT(passes.geometry->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.geometry->createRenderPass());
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryLightSphere);
+			bindDescriptorSet(cmdBuffer, i, descriptorSets.lightSphere, uniformOffsets.geometry, 0);
+
+			vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstModel), &pcLightSphere);
+
+			models.lightSphere.draw(cmdBuffer);
+
+			statistics.end(cmdBuffer);
+
+			GPUTimer.NextTimeStamp(cmdBuffer);
+		});
+		renderGraph->colorAttachment(passes.geometry, targets.position, &clearColor);
+		renderGraph->colorAttachment(passes.geometry, targets.normal, &clearColor);
+		renderGraph->colorAttachment(passes.geometry, targets.albedo, &clearColor);
+		renderGraph->colorAttachment(passes.geometry, targets.emissive, &clearColor);
+		renderGraph->depthAttachment(passes.geometry, targets.depth, &clearDepth);
 
 		// SSAO
 		//
-		passes.ssao = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.ssao->addAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		VK_CHECK_RESULT(passes.ssao->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.ssao->createRenderPass());
+		passes.ssao = renderGraph->addPass("SSAO", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			drawFullscreen(cmdBuffer, i, "SSAO", pipelines.ssao, descriptorSets.ssao, uniformOffsets.ssao);
+		});
+		renderGraph->sampledRead(passes.ssao, targets.position);
+		renderGraph->sampledRead(passes.ssao, targets.normal);
+		renderGraph->colorAttachment(passes.ssao, targets.ssao, &clearColor);
 
 		// SSAO Blur
 		//
-		passes.ssaoBlur = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.ssaoBlur->addAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		VK_CHECK_RESULT(passes.ssaoBlur->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.ssaoBlur->createRenderPass());
+		passes.ssaoBlur = renderGraph->addPass("SSAO Blur", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			drawFullscreen(cmdBuffer, i, "SSAO Blur", pipelines.ssaoBlur, descriptorSets.ssaoBlur, uniformOffsets.ssaoBlur);
+		});
+		renderGraph->sampledRead(passes.ssaoBlur, targets.ssao);
+		renderGraph->colorAttachment(passes.ssaoBlur, targets.ssaoBlur, &clearColor);
 
 		// Direct Lighting
 		//
-		passes.lighting = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.lighting->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		VK_CHECK_RESULT(passes.lighting->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.lighting->createRenderPass());
+		passes.lighting = renderGraph->addPass("Lighting", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			drawFullscreen(cmdBuffer, i, "Lighting", pipelines.lighting, descriptorSets.lighting, uniformOffsets.lighting);
+		});
+		renderGraph->sampledRead(passes.lighting, targets.position);
+		renderGraph->sampledRead(passes.lighting, targets.normal);
+		renderGraph->sampledRead(passes.lighting, targets.albedo);
+		renderGraph->sampledRead(passes.lighting, targets.emissive);
+		renderGraph->sampledRead(passes.lighting, targets.shadowMap);
+		renderGraph->sampledRead(passes.lighting, targets.ssaoBlur);
+		renderGraph->colorAttachment(passes.lighting, targets.lighting, &clearColor);
 
 		// SSR
 		//
-		passes.ssr = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.ssr->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		VK_CHECK_RESULT(passes.ssr->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.ssr->createRenderPass());
+		passes.ssr = renderGraph->addPass("SSR", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			drawFullscreen(cmdBuffer, i, "SSR", pipelines.ssr, descriptorSets.ssr, uniformOffsets.ssr);
+		});
+		renderGraph->sampledRead(passes.ssr, targets.position);
+		renderGraph->sampledRead(passes.ssr, targets.normal);
+		renderGraph->sampledRead(passes.ssr, targets.lighting);
+		renderGraph->colorAttachment(passes.ssr, targets.ssr, &clearColor);
 
 		// SSR Blur
 		//
-		passes.ssrBlur = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.ssrBlur->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		VK_CHECK_RESULT(passes.ssrBlur->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.ssrBlur->createRenderPass());
+		passes.ssrBlur = renderGraph->addPass("SSR Blur", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			drawFullscreen(cmdBuffer, i, "SSR Blur", pipelines.ssrBlur, descriptorSets.ssrBlur, uniformOffsets.ssrBlur);
+		});
+		renderGraph->sampledRead(passes.ssrBlur, targets.ssr);
+		renderGraph->colorAttachment(passes.ssrBlur, targets.ssrBlur, &clearColor);
 
 		// Composition
 		//
-		passes.composition = std::make_unique<vks::Framebuffer>(vulkanDevice, width, height);
-		passes.composition->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
-		VK_CHECK_RESULT(passes.composition->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
-		VK_CHECK_RESULT(passes.composition->createRenderPass());
+		passes.composition = renderGraph->addPass("Composition", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			drawFullscreen(cmdBuffer, i, "Composition", pipelines.composition, descriptorSets.composition, uniformOffsets.composition);
+
+			// Particles
+			//
+			statistics.begin(cmdBuffer, "Particles", i);
+			particles.draw(cmdBuffer, i);
+			statistics.end(cmdBuffer);
+
+			GPUTimer.NextTimeStamp(cmdBuffer);
+		});
+		renderGraph->sampledRead(passes.composition, targets.lighting);
+		renderGraph->sampledRead(passes.composition, targets.ssrBlur);
+		renderGraph->colorAttachment(passes.composition, targets.composition, &clearColor);
+
+		// Bloom
+		// Takes the scene color as shader read only and leaves it that way, the transitions to general inside are its own
+		// Stays on the graphics queue: it needs the composition output and tonemapping reads its result right after,
+		// so on a compute queue it would only add two queue ownership transfers and semaphores without any overlap
+		//
+		passes.bloom = renderGraph->addPass("Bloom", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			statistics.begin(cmdBuffer, "Bloom", i);
+			bloom.draw(cmdBuffer);
+			statistics.end(cmdBuffer);
+
+			GPUTimer.NextTimeStamp(cmdBuffer);
+		});
+		renderGraph->access(passes.bloom, targets.composition, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		// Tonemapping
+		// Renders to the swapchain in the example's render pass
+		//
+		passes.tonemapping = renderGraph->addPass("Tonemapping", [this](VkCommandBuffer cmdBuffer, uint32_t i) {
+			VkClearValue clearValues[1];
+			clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+			bindDescriptorSet(cmdBuffer, i, descriptorSet, 0, uniformOffsets.tonemapping);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.tonemapping);
+
+			statistics.begin(cmdBuffer, "Tonemapping", i);
+			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+			statistics.end(cmdBuffer);
+
+			GPUTimer.NextTimeStamp(cmdBuffer);
+
+			drawUI(cmdBuffer, i);
+
+			vkCmdEndRenderPass(cmdBuffer);
+
+			GPUTimer.NextTimeStamp(cmdBuffer);
+		});
+		renderGraph->sampledRead(passes.tonemapping, targets.composition);
+		renderGraph->setSideEffect(passes.tonemapping);
+
+		renderGraph->compile();
+
+		// Samplers for the render targets
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.mipLodBias = 0.0f;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = 1.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &samplers.nearest));
+
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &samplers.shadow));
 	}
 
 	virtual void setupRenderPass() override {
@@ -473,277 +642,57 @@ public:
 		}
 	}
 
+	// Binds a set of the shared layout, the dynamic offsets of binding 0 (vertex) and 5 (fragment) select the
+	// constants in the arena region of command buffer i, 0 for a binding the set doesn't use
+	void bindDescriptorSet(VkCommandBuffer cmdBuffer, uint32_t i, VkDescriptorSet set, uint32_t vertexOffset, uint32_t fragmentOffset)
+	{
+		const uint32_t frameOffset = uniformArena->frameOffset(i);
+		const uint32_t dynamicOffsets[2] = { frameOffset + vertexOffset, frameOffset + fragmentOffset };
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 2, dynamicOffsets);
+	}
+
 	// Put render commands for the scene into the given command buffer
-	void renderScene(VkCommandBuffer cmdBuffer, bool shadow)
+	void renderScene(VkCommandBuffer cmdBuffer, uint32_t i, bool shadow)
 	{
 		VkDeviceSize offsets[1] = { 0 };
+		const uint32_t uniformOffset = shadow ? uniformOffsets.shadow : uniformOffsets.geometry;
 
 		// Background
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, shadow ? &descriptorSets.shadow : &descriptorSets.background, 0, NULL);
+		bindDescriptorSet(cmdBuffer, i, shadow ? descriptorSets.shadow : descriptorSets.background, uniformOffset, 0);
 		models.background.draw(cmdBuffer);
 
 		// Objects
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, shadow ? &descriptorSets.shadow : &descriptorSets.model, 0, NULL);
+		bindDescriptorSet(cmdBuffer, i, shadow ? descriptorSets.shadow : descriptorSets.model, uniformOffset, 0);
 		models.model.bindBuffers(cmdBuffer);
 		vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
 	}
 
-	void buildCommandBuffers()
+	// Fullscreen triangle of one of the post processing passes
+	void drawFullscreen(VkCommandBuffer cmdBuffer, uint32_t i, const char* scope, VkPipeline pipeline, VkDescriptorSet descriptorSet, uint32_t uniformOffset)
 	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		statistics.begin(cmdBuffer, scope, i);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		bindDescriptorSet(cmdBuffer, i, descriptorSet, 0, uniformOffset);
+		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
 
-		VkClearValue clearValues[5];
+		statistics.end(cmdBuffer);
+
+		GPUTimer.NextTimeStamp(cmdBuffer);
+	}
 
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		renderPassBeginInfo.renderArea.offset.x = 0;
-		renderPassBeginInfo.renderArea.offset.y = 0;
-		renderPassBeginInfo.pClearValues = clearValues;
+	void buildCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			GPUTimer.OnBeginFrame(drawCmdBuffers[i]);
+			statistics.reset(drawCmdBuffers[i], i);
 
-			VkViewport viewport = vks::initializers::viewport((float)passes.shadow->width, (float)passes.shadow->height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(passes.shadow->width, passes.shadow->height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			renderPassBeginInfo.renderArea.extent.width = passes.shadow->width;
-			renderPassBeginInfo.renderArea.extent.height = passes.shadow->height;
-
-			// Shadow
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.shadow->renderPass;
-				renderPassBeginInfo.framebuffer = passes.shadow->framebuffer;
-				
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].depthStencil = { 1.0f, 0 };
-
-				// Set depth bias (aka "Polygon offset")
-				vkCmdSetDepthBias(
-					drawCmdBuffers[i],
-					depthBiasConstant,
-					0.0f,
-					depthBiasSlope);
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadowpass);
-				renderScene(drawCmdBuffers[i], true);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-
-			// Geometry (Do Pipeline Statistics)
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.geometry->renderPass;
-				renderPassBeginInfo.framebuffer = passes.geometry->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 5;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-				clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-				clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-				clearValues[3].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-				clearValues[4].depthStencil = { 1.0f, 0 };
-
-				statistics.reset(drawCmdBuffers[i]);
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				statistics.begin(drawCmdBuffers[i]);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
-				renderScene(drawCmdBuffers[i], false);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryLightSphere);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.lightSphere, 0, NULL);
-
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstModel), &pcLightSphere);
-
-				models.lightSphere.draw(drawCmdBuffers[i]);
-
-				statistics.end(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// SSAO
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.ssao->renderPass;
-				renderPassBeginInfo.framebuffer = passes.ssao->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// SSAO Blur
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.ssaoBlur->renderPass;
-				renderPassBeginInfo.framebuffer = passes.ssaoBlur->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// Direct Lighting
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.lighting->renderPass;
-				renderPassBeginInfo.framebuffer = passes.lighting->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lighting);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.lighting, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// SSR
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.ssr->renderPass;
-				renderPassBeginInfo.framebuffer = passes.ssr->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssr);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.ssr, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// SSR Blur
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.ssrBlur->renderPass;
-				renderPassBeginInfo.framebuffer = passes.ssrBlur->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssrBlur);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.ssrBlur, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// Composition
-			//
-			{
-				renderPassBeginInfo.renderPass = passes.composition->renderPass;
-				renderPassBeginInfo.framebuffer = passes.composition->framebuffer;
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.composition, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-
-				// Particles
-				//
-				particles.draw(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-
-			// Bloom
-			//
-			{
-				bloom.draw(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
-			
-			// Tonemapping
-			//
-			{
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-				renderPassBeginInfo.clearValueCount = 1;
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkDeviceSize offsets[1] = { 0 };
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.tonemapping);
-
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-
-				drawUI(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-			}
+			renderGraph->execute(drawCmdBuffers[i], i);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -780,7 +729,7 @@ public:
 
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptorSetCount * 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, descriptorSetCount * 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptorSetCount * 6)
 		};
 
@@ -798,7 +747,7 @@ public:
 		// Deferred shading layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0),
 			// Binding 1: Position texture
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 			// Binding 2: Normals texture
@@ -808,7 +757,7 @@ public:
 			// Binding 4: Emissive texture
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
 			// Binding 5: Fragment shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
 			// Binding 6: Shadow map
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
 			// Binding 7: Blured ao
@@ -830,13 +779,36 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 
+		// Arena ranges, the offsets are passed when binding
+		struct {
+			VkDescriptorBufferInfo shadow;
+			VkDescriptorBufferInfo geometry;
+			VkDescriptorBufferInfo ssao;
+			VkDescriptorBufferInfo ssaoBlur;
+			VkDescriptorBufferInfo lighting;
+			VkDescriptorBufferInfo ssr;
+			VkDescriptorBufferInfo ssrBlur;
+			VkDescriptorBufferInfo composition;
+			VkDescriptorBufferInfo tonemapping;
+		} uniformDescriptors = {
+			uniformArena->descriptor(sizeof(uboShadow)),
+			uniformArena->descriptor(sizeof(uboGeometry)),
+			uniformArena->descriptor(sizeof(uboSsao)),
+			uniformArena->descriptor(sizeof(uboSsaoBlur)),
+			uniformArena->descriptor(sizeof(uboDirectLighting)),
+			uniformArena->descriptor(sizeof(uboSsr)),
+			uniformArena->descriptor(sizeof(uboSsrBlur)),
+			uniformArena->descriptor(sizeof(uboComposition)),
+			uniformArena->descriptor(sizeof(uboTonemapping))
+		};
+
 		/*
 			SHADOW
 		*/
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.shadow));
 		writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.shadow, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.shadowGeometryShader.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.shadow, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &uniformDescriptors.shadow),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
@@ -847,7 +819,7 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.model));
 		writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.model, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.geometry.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.model, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &uniformDescriptors.geometry),
 			// Binding 1: Color map
 			vks::initializers::writeDescriptorSet(descriptorSets.model, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.model.colorMap.descriptor),
 			// Binding 2: Normal map
@@ -859,7 +831,7 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.background));
 		writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.background, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.geometry.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.background, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &uniformDescriptors.geometry),
 			// Binding 1: Color map
 			vks::initializers::writeDescriptorSet(descriptorSets.background, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.background.colorMap.descriptor),
 			// Binding 2: Normal map
@@ -871,7 +843,7 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.lightSphere));
 		writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.lightSphere, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.geometry.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSets.lightSphere, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &uniformDescriptors.geometry)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
@@ -880,14 +852,14 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorPosition =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.position),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorNormal =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[1].view,
+				samplers.nearest,
+				renderGraph->view(targets.normal),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.ssao));
@@ -899,7 +871,7 @@ public:
 			// Binding 3: SSAO noise texture
 			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &textures.ssaoNoise.descriptor),
 			// Binding 5: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssao.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.ssao)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -908,14 +880,14 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorSsao =
 			vks::initializers::descriptorImageInfo(
-				passes.ssao->sampler,
-				passes.ssao->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssao),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.ssaoBlur));
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorSsao),
-			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoBlur.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.ssaoBlur)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -924,26 +896,26 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorAlbedo =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[2].view,
+				samplers.nearest,
+				renderGraph->view(targets.albedo),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorEmissive =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[3].view,
+				samplers.nearest,
+				renderGraph->view(targets.emissive),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorShadowMap =
 			vks::initializers::descriptorImageInfo(
-				passes.shadow->sampler,
-				passes.shadow->attachments[0].view,
+				samplers.shadow,
+				renderGraph->view(targets.shadowMap),
 				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorSsaoBlur =
 			vks::initializers::descriptorImageInfo(
-				passes.ssaoBlur->sampler,
-				passes.ssaoBlur->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssaoBlur),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.lighting));
@@ -957,7 +929,7 @@ public:
 			// Binding 4: Emissive texture
 			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &texDescriptorEmissive),
 			// Binding 5: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.lighting.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.lighting),
 			// Binding 6: Shadow map
 			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &texDescriptorShadowMap),
 			// Binding 7: Blured ao
@@ -970,8 +942,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorDirectColor =
 			vks::initializers::descriptorImageInfo(
-				passes.lighting->sampler,
-				passes.lighting->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.lighting),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.ssr));
@@ -983,7 +955,7 @@ public:
 			// Binding 3: Direct lighting color texture
 			vks::initializers::writeDescriptorSet(descriptorSets.ssr, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorDirectColor),
 			// Binding 5: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.ssr, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssr.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSets.ssr, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.ssr)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -992,14 +964,14 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorReflectColor =
 			vks::initializers::descriptorImageInfo(
-				passes.ssr->sampler,
-				passes.ssr->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssr),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.ssrBlur));
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.ssrBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorReflectColor),
-			vks::initializers::writeDescriptorSet(descriptorSets.ssrBlur, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssrBlur.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSets.ssrBlur, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.ssrBlur)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -1008,8 +980,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorReflectColorBlur =
 			vks::initializers::descriptorImageInfo(
-				passes.ssrBlur->sampler,
-				passes.ssrBlur->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssrBlur),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.composition));
@@ -1019,7 +991,7 @@ public:
 			// Binding 2: Reflect color blur texture
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorReflectColorBlur),
 			// Binding 5: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.composition.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.composition)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -1028,14 +1000,14 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorComposition =
 			vks::initializers::descriptorImageInfo(
-				passes.composition->sampler,
-				passes.composition->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.composition),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorComposition),
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.tonemapping.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5, &uniformDescriptors.tonemapping)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
@@ -1068,7 +1040,7 @@ public:
 		/*
 			GEOMETRY
 		*/
-		pipelineCI.renderPass = passes.geometry->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.geometry);
 
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent });
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -1095,7 +1067,7 @@ public:
 		/*
 			SSAO
 		*/
-		pipelineCI.renderPass = passes.ssao->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.ssao);
 
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
@@ -1112,7 +1084,7 @@ public:
 		/*
 			SSAO BLUR
 		*/
-		pipelineCI.renderPass = passes.ssaoBlur->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.ssaoBlur);
 
 		shaderStages[1] = loadShader(getShadersPath() + "final/spirv/blur.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -1131,7 +1103,7 @@ public:
 		/*
 			LIGHTING
 		*/
-		pipelineCI.renderPass = passes.lighting->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.lighting);
 
 		shaderStages[1] = loadShader(getShadersPath() + "final/spirv/lighting.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -1140,7 +1112,7 @@ public:
 		/*
 			SSR
 		*/
-		pipelineCI.renderPass = passes.ssr->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.ssr);
 
 		shaderStages[1] = loadShader(getShadersPath() + "final/spirv/ssr_world.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -1149,7 +1121,7 @@ public:
 		/*
 			SSR BLUR
 		*/
-		pipelineCI.renderPass = passes.ssrBlur->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.ssrBlur);
 
 		shaderStages[1] = loadShader(getShadersPath() + "final/spirv/blur.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -1168,7 +1140,7 @@ public:
 		/*
 			Composition
 		*/
-		pipelineCI.renderPass = passes.composition->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.composition);
 
 		shaderStages[1] = loadShader(getShadersPath() + "final/spirv/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -1186,7 +1158,7 @@ public:
 		/*
 			SHADOW
 		*/
-		pipelineCI.renderPass = passes.shadow->renderPass;
+		pipelineCI.renderPass = renderGraph->renderPass(passes.shadow);
 
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position });
 		// Shadow pass doesn't use any color attachments
@@ -1214,80 +1186,6 @@ public:
 
 	void prepareUniformBuffers()
 	{
-		// Shadow map vertex shader (matrices from shadow's pov)
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.shadowGeometryShader,
-			sizeof(uboShadow)));
-
-		// Geometry vertex shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.geometry,
-			sizeof(uboGeometry)));
-
-		// SSAO fragment shader
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.ssao,
-			sizeof(uboSsao));
-
-		// SSAO blur fragment shader
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.ssaoBlur,
-			sizeof(uboSsaoBlur));
-
-		// Direct lighting fragment shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.lighting,
-			sizeof(uboDirectLighting)));
-
-		// SSR fragment shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.ssr,
-			sizeof(uboSsr)));
-
-		// SSR blur fragment shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.ssrBlur,
-			sizeof(uboSsrBlur)));
-
-		// Composition fragment shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.composition,
-			sizeof(uboComposition)));
-
-		// Tonemapping fragment shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.tonemapping,
-			sizeof(uboTonemapping)));
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBuffers.shadowGeometryShader.map());
-		VK_CHECK_RESULT(uniformBuffers.geometry.map());
-		VK_CHECK_RESULT(uniformBuffers.ssao.map());
-		VK_CHECK_RESULT(uniformBuffers.ssaoBlur.map());
-		VK_CHECK_RESULT(uniformBuffers.lighting.map());
-		VK_CHECK_RESULT(uniformBuffers.ssr.map());
-		VK_CHECK_RESULT(uniformBuffers.ssrBlur.map());
-		VK_CHECK_RESULT(uniformBuffers.composition.map());
-		VK_CHECK_RESULT(uniformBuffers.tonemapping.map());
-
 		// Init some values
 		uboGeometry.instancePos[0] = glm::vec4(0.0f);
 		uboGeometry.instancePos[1] = glm::vec4(-7.0f, 0.0, -4.0f, 0.0f);
@@ -1310,34 +1208,29 @@ public:
 		}
 
 		// Update
-		updateUniformBufferGeometry();
-		updateUniformBufferSsao();
-		updateUniformBufferSsaoBlur();
-		updateUniformBufferLighting();
-		updateUniformBufferSsr();
-		updateUniformBufferSsrBlur();
-		updateUniformBufferComposition();
-		updateUniformBufferTonemapping();
+		updateUniformsCamera();
+		updateUniformsLighting();
+
+		// Every region starts out valid, this also sets the offsets the command buffers are recorded with
+		for (uint32_t i = 0; i < uniformArena->frameCount(); i++) {
+			writeUniforms(i);
+		}
 	}
 
-	void updateUniformBufferGeometry()
+	void updateUniformsCamera()
 	{
 		uboGeometry.projection = camera.matrices.perspective;
 		uboGeometry.view = camera.matrices.view;
-		memcpy(uniformBuffers.geometry.mapped, &uboGeometry, sizeof(uboGeometry));
-	}
 
-	void updateUniformBufferSsao() {
 		uboSsao.projection = camera.matrices.perspective;
 		uboSsao.view = camera.matrices.view;
-		memcpy(uniformBuffers.ssao.mapped, &uboSsao, sizeof(uboSsao));
-	}
 
-	void updateUniformBufferSsaoBlur() {
-		memcpy(uniformBuffers.ssaoBlur.mapped, &uboSsaoBlur, sizeof(uboSsaoBlur));
+		uboSsr.projection = camera.matrices.perspective;
+		uboSsr.view = camera.matrices.view;
+		uboSsr.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
 	}
 
-	void updateUniformBufferLighting()
+	void updateUniformsLighting()
 	{
 		// Animate
 		uboDirectLighting.lights[0].position.x = -14.0f + std::abs(sin(glm::radians(timer * 360.0f)) * 20.0f);
@@ -1361,30 +1254,24 @@ public:
 		}
 
 		memcpy(uboShadow.instancePos, uboGeometry.instancePos, sizeof(uboGeometry.instancePos));
-		memcpy(uniformBuffers.shadowGeometryShader.mapped, &uboShadow, sizeof(uboShadow));
 
 		uboDirectLighting.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
-
-		memcpy(uniformBuffers.lighting.mapped, &uboDirectLighting, sizeof(uboDirectLighting));
 	}
 
-	void updateUniformBufferSsr() {
-		uboSsr.projection = camera.matrices.perspective;
-		uboSsr.view = camera.matrices.view;
-		uboSsr.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
-		memcpy(uniformBuffers.ssr.mapped, &uboSsr, sizeof(uboSsr));
-	}
-
-	void updateUniformBufferSsrBlur() {
-		memcpy(uniformBuffers.ssrBlur.mapped, &uboSsrBlur, sizeof(uboSsrBlur));
-	}
-
-	void updateUniformBufferComposition() {
-		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
-	}
-
-	void updateUniformBufferTonemapping() {
-		memcpy(uniformBuffers.tonemapping.mapped, &uboTonemapping, sizeof(uboTonemapping));
+	// Copies all constants into the arena region of command buffer i
+	void writeUniforms(uint32_t i)
+	{
+		uniformArena->beginFrame(i);
+		uniformOffsets.shadow = uniformArena->push(uboShadow);
+		uniformOffsets.geometry = uniformArena->push(uboGeometry);
+		uniformOffsets.ssao = uniformArena->push(uboSsao);
+		uniformOffsets.ssaoBlur = uniformArena->push(uboSsaoBlur);
+		uniformOffsets.lighting = uniformArena->push(uboDirectLighting);
+		uniformOffsets.ssr = uniformArena->push(uboSsr);
+		uniformOffsets.ssrBlur = uniformArena->push(uboSsrBlur);
+		uniformOffsets.composition = uniformArena->push(uboComposition);
+		uniformOffsets.tonemapping = uniformArena->push(uboTonemapping);
+		particles.writeUniforms();
 	}
 
 	Light initLight(glm::vec3 pos, glm::vec3 target, glm::vec3 color)
@@ -1407,6 +1294,9 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// The last submit of this command buffer is done, submitFrame waits for the queue
+		writeUniforms(currentBuffer);
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -1414,7 +1304,7 @@ public:
 		VulkanExampleBase::submitFrame();
 
 		GPUTimer.GetQueryResult(&timeStamps);
-		statistics.getResult();
+		statistics.getResult(currentBuffer);
 	}
 
 	void prepare()
@@ -1438,10 +1328,33 @@ public:
 			"ImGUI"
 		};
 		GPUTimer.OnCreate(vulkanDevice, std::move(labels));
-		statistics.init(vulkanDevice);
+
+		std::vector<std::string> scopes = {
+			"Shadow Map",
+			"Geometry",
+			"SSAO",
+			"SSAO Blur",
+			"Lighting",
+			"SSR",
+			"SSR Blur",
+			"Composition",
+			"Particles",
+			"Bloom",
+			"Tonemapping"
+		};
+		statistics.init(vulkanDevice, std::move(scopes), static_cast<uint32_t>(drawCmdBuffers.size()));
+		statistics.setTargetExtent("Shadow Map", SHADOWMAP_DIM, SHADOWMAP_DIM, LIGHT_COUNT);
+		updateStatisticsExtent();
+		benchmark.reports.push_back([this](std::ostream& os) { statistics.report(os); });
+		// Bloom's mip chain and the SSR depth hierarchy are built by the single pass downsampler
+		benchmark.reports.push_back([this](std::ostream& os) { vks::Downsampler::validate(os, vulkanDevice, queue, pipelineCache, getShadersPath()); });
+
 		prepareGraphicsPasses();
-		particles.init(vulkanDevice, this, passes.composition->renderPass);
-		bloom.init(vulkanDevice, this, &passes.composition->attachments[0], width, height);
+		// One region per command buffer, room for all constants of a frame
+		uniformArena = std::make_unique<vks::UniformArena>(vulkanDevice, 16 * 1024, static_cast<uint32_t>(drawCmdBuffers.size()));
+
+		particles.init(vulkanDevice, this, renderGraph->renderPass(passes.composition), uniformArena.get());
+		bloom.init(vulkanDevice, this, renderGraph->image(targets.composition), renderGraph->view(targets.composition), width, height);
 
 		initLights();
 		prepareUniformBuffers();
@@ -1461,13 +1374,20 @@ public:
 		if (!prepared)
 			return;
 		particles.update();
-		draw();
-		updateUniformBufferLighting();
+		updateUniformsLighting();
 		if (camera.updated) 
 		{
-			updateUniformBufferGeometry();
-			updateUniformBufferSsao();
-			updateUniformBufferSsr();
+			updateUniformsCamera();
+		}
+		draw();
+	}
+
+	void updateStatisticsExtent()
+	{
+		// Bloom is compute only, its overdraw stays 0
+		const char* fullscreenScopes[] = { "Geometry", "SSAO", "SSAO Blur", "Lighting", "SSR", "SSR Blur", "Composition", "Particles", "Tonemapping" };
+		for (auto scope : fullscreenScopes) {
+			statistics.setTargetExtent(scope, width, height);
 		}
 	}
 
@@ -1481,78 +1401,15 @@ public:
 		// descriptor set related with those rendertarget
 		updateDescriptorSetOnResize();
 
-		bloom.onResized(&passes.composition->attachments[0], width, height);
+		bloom.onResized(renderGraph->image(targets.composition), renderGraph->view(targets.composition), width, height);
+
+		updateStatisticsExtent();
 	}
 
 	void recreateIntermediateFramebuffer() {
-		// Since Fixed-size Shadow map, no need to recreate
-
-		// Geometry
-		//
-		passes.geometry->clearBeforeRecreate(width, height);
-		passes.geometry->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // position
-		passes.geometry->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // normal
-		passes.geometry->addAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // albedo
-		passes.geometry->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT); // emissive
-
-		// depth
-		vks::FramebufferAttachment depth;
-		depth.image = depthStencil.image;
-		depth.memory = depthStencil.mem;
-		depth.view = depthStencil.view;
-		depth.format = depthFormat;
-		depth.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
-		depth.description = {
-			0,
-			depth.format,
-			VK_SAMPLE_COUNT_1_BIT,
-			VK_ATTACHMENT_LOAD_OP_CLEAR,
-			VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-		};
-		depth.weakRef = true;
-		passes.geometry->attachments.push_back(depth);
-
-		passes.geometry->createFrameBuffer();
-
-		// SSAO
-		//
-		passes.ssao->clearBeforeRecreate(width, height);
-		passes.ssao->addAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		passes.ssao->createFrameBuffer();
-
-		// SSAO Blur
-		//
-		passes.ssaoBlur->clearBeforeRecreate(width, height);
-		passes.ssaoBlur->addAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		passes.ssaoBlur->createFrameBuffer();
-
-		// Direct Lighting
-		//
-		passes.lighting->clearBeforeRecreate(width, height);
-		passes.lighting->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		passes.lighting->createFrameBuffer();
-
-		// SSR
-		//
-		passes.ssr->clearBeforeRecreate(width, height);
-		passes.ssr->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		passes.ssr->createFrameBuffer();
-
-		// SSR Blur
-		//
-		passes.ssrBlur->clearBeforeRecreate(width, height);
-		passes.ssrBlur->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		passes.ssrBlur->createFrameBuffer();
-
-		// Composition
-		//
-		passes.composition->clearBeforeRecreate(width, height);
-		passes.composition->addAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
-		passes.composition->createFrameBuffer();
+		// All render targets are placed again, the shadow map may now share memory with other targets
+		renderGraph->updateImport(targets.depth, depthStencil.image, depthStencil.view);
+		renderGraph->resize(width, height);
 	}
 
 	void updateDescriptorSetOnResize() {
@@ -1563,14 +1420,14 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorPosition =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.position),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorNormal =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[1].view,
+				samplers.nearest,
+				renderGraph->view(targets.normal),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1586,8 +1443,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorSsao =
 			vks::initializers::descriptorImageInfo(
-				passes.ssao->sampler,
-				passes.ssao->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssao),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1600,20 +1457,26 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorAlbedo =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[2].view,
+				samplers.nearest,
+				renderGraph->view(targets.albedo),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorEmissive =
 			vks::initializers::descriptorImageInfo(
-				passes.geometry->sampler,
-				passes.geometry->attachments[3].view,
+				samplers.nearest,
+				renderGraph->view(targets.emissive),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+		VkDescriptorImageInfo texDescriptorShadowMap =
+			vks::initializers::descriptorImageInfo(
+				samplers.shadow,
+				renderGraph->view(targets.shadowMap),
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
 		VkDescriptorImageInfo texDescriptorSsaoBlur =
 			vks::initializers::descriptorImageInfo(
-				passes.ssaoBlur->sampler,
-				passes.ssaoBlur->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssaoBlur),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1625,7 +1488,9 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
 			// Binding 4: Emissive texture
 			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &texDescriptorEmissive),
-			// Binding 6: Blured ao
+			// Binding 6: Shadow map
+			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &texDescriptorShadowMap),
+			// Binding 7: Blured ao
 			vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &texDescriptorSsaoBlur)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -1635,8 +1500,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorDirectColor =
 			vks::initializers::descriptorImageInfo(
-				passes.lighting->sampler,
-				passes.lighting->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.lighting),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1654,8 +1519,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorReflectColor =
 			vks::initializers::descriptorImageInfo(
-				passes.ssr->sampler,
-				passes.ssr->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssr),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1668,8 +1533,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorReflectColorBlur =
 			vks::initializers::descriptorImageInfo(
-				passes.ssrBlur->sampler,
-				passes.ssrBlur->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.ssrBlur),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1685,8 +1550,8 @@ public:
 		*/
 		VkDescriptorImageInfo texDescriptorComposition =
 			vks::initializers::descriptorImageInfo(
-				passes.composition->sampler,
-				passes.composition->attachments[0].view,
+				samplers.nearest,
+				renderGraph->view(targets.composition),
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		writeDescriptorSets = {
@@ -1697,54 +1562,37 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		// The settings are part of the constants written every frame
 		if (overlay->header("Light Sphere")) {
 			if (ImGui::SliderFloat3("Transform", &lightSphereTrans.x, -10.0, 10.0)) {
 				pcLightSphere.model = glm::translate(glm::mat4(1.0), lightSphereTrans);
 			}
 		}
 		if (overlay->header("SSAO Settings")) {
-			if (overlay->sliderFloat("Radius", &uboSsao.radius, 0.0f, 2.0f)) {
-				updateUniformBufferSsao();
-			}
-			if (overlay->sliderFloat("Bias", &uboSsao.bias, 0.0f, 0.2f)) {
-				updateUniformBufferSsao();
-			}
-			if (overlay->sliderInt("SSAO Blur Size", &uboSsaoBlur.size, 0, 3)) {
-				updateUniformBufferSsaoBlur();
-			}
+			overlay->sliderFloat("Radius", &uboSsao.radius, 0.0f, 2.0f);
+			overlay->sliderFloat("Bias", &uboSsao.bias, 0.0f, 0.2f);
+			overlay->sliderInt("SSAO Blur Size", &uboSsaoBlur.size, 0, 3);
 		}
 		if (overlay->header("Direct Lighting Settings")) {
-			if (overlay->checkBox("Shadow", &uboDirectLighting.useShadow)) {
-				updateUniformBufferLighting();
-			}
-			if (overlay->checkBox("AO", &uboDirectLighting.useSsao)) {
-				updateUniformBufferLighting();
-			}
+			overlay->checkBox("Shadow", &uboDirectLighting.useShadow);
+			overlay->checkBox("AO", &uboDirectLighting.useSsao);
 		}
 		if (overlay->header("SSR Settings")) {
 			// ray marching
-			if (overlay->sliderFloat("Max Distance", &uboSsr.maxDistance, 0.0f, 5.0f)) {
-				updateUniformBufferSsr();
-			}
-			if (overlay->sliderFloat("Resolution", &uboSsr.resolution, 0.0f, 1.0f)) {
-				updateUniformBufferSsr();
-			}
-			if (overlay->sliderFloat("Thickness", &uboSsr.thickness, 0.0f, 2.0f)) {
-				updateUniformBufferSsr();
-			}
+			overlay->sliderFloat("Max Distance", &uboSsr.maxDistance, 0.0f, 5.0f);
+			overlay->sliderFloat("Resolution", &uboSsr.resolution, 0.0f, 1.0f);
+			overlay->sliderFloat("Thickness", &uboSsr.thickness, 0.0f, 2.0f);
 			// blur
-			if (overlay->sliderInt("Blur Size", &uboSsrBlur.size, 0, 10)) {
-				updateUniformBufferSsrBlur();
-			}
+			overlay->sliderInt("Blur Size", &uboSsrBlur.size, 0, 10);
 			// blend
-			if (overlay->sliderFloat("Blend Factor", &uboComposition.blendFactor, 0.0f, 1.0f)) {
-				updateUniformBufferComposition();
-			}
+			overlay->sliderFloat("Blend Factor", &uboComposition.blendFactor, 0.0f, 1.0f);
 		}
 		if (overlay->header("HDR Settings")) {
-			if (overlay->sliderFloat("Exposure", &uboTonemapping.exposure, 0.0f, 5.0f)) {
-				updateUniformBufferTonemapping();
-			}
+			overlay->sliderFloat("Exposure", &uboTonemapping.exposure, 0.0f, 5.0f);
+		}
+		if (overlay->header("Render graph")) {
+			overlay->text("Render targets: %.1f MB (%.1f MB without aliasing)", renderGraph->allocatedBytes() / (1024.0f * 1024.0f), renderGraph->requestedBytes() / (1024.0f * 1024.0f));
+			overlay->text("Barriers: %u", renderGraph->barrierCount());
 		}
 		if (overlay->header("GPU Profile")) {
 			for (auto& timeStamp : timeStamps) {
@@ -1757,6 +1605,16 @@ public:
 				overlay->text(caption.c_str(), statistics.pipelineStats[i]);
 			}
 		}
+		if (overlay->header("Pass statistics")) {
+			ImGui::Text("%-12s %9s %9s %9s %6s %6s", "pass", "vs inv", "fs inv", "cs inv", "ovrdr", "clip");
+			for (auto& pass : statistics.passStats) {
+				ImGui::Text("%-12s %9llu %9llu %9llu %6.2f %5.0f%%", pass.m_label.c_str(),
+					(unsigned long long)pass.m_counters[PIPELINE_STAT_VS_INVOCATIONS],
+					(unsigned long long)pass.m_counters[PIPELINE_STAT_FS_INVOCATIONS],
+					(unsigned long long)pass.m_counters[PIPELINE_STAT_CS_INVOCATIONS],
+					pass.m_overdraw, pass.m_clippingRejection * 100.0f);
+			}
+		}
 	}
 };
 
@@ -22,14 +22,14 @@ VulkanglTFScene::~VulkanglTFScene()
 {
 	// Release all Vulkan resources allocated for the model
 	vkDestroyBuffer(vulkanDevice->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(vulkanDevice->logicalDevice, vertices.memory, nullptr);
+	vulkanDevice->freeMemory(vertices.memory);
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
+	vulkanDevice->freeMemory(indices.memory);
 	for (Image image : images) {
 		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
 		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		vulkanDevice->freeMemory(image.texture.deviceMemory);
 	}
 	for (Material material : materials) {
 		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
@@ -420,7 +420,7 @@ void VulkanExample::buildCommandBuffers()
 		// POI: Draw the glTF scene
 		glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
 
-		drawUI(drawCmdBuffers[i]);
+		drawUI(drawCmdBuffers[i], i);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
@@ -534,9 +534,9 @@ void VulkanExample::loadglTFFile(std::string filename)
 
 	// Free staging resources
 	vkDestroyBuffer(device, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device, vertexStaging.memory, nullptr);
+	vulkanDevice->freeMemory(vertexStaging.memory);
 	vkDestroyBuffer(device, indexStaging.buffer, nullptr);
-	vkFreeMemory(device, indexStaging.memory, nullptr);
+	vulkanDevice->freeMemory(indexStaging.memory);
 }
 
 void VulkanExample::loadAssets()
@@ -553,7 +553,7 @@ void VulkanExample::setupDescriptors()
 	// One ubo to pass dynamic data to the shader
 	// Two combined image samplers per material as each material uses color and normal maps
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFScene.materials.size()) * 2 + 1),
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
@@ -567,7 +567,8 @@ void VulkanExample::setupDescriptors()
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
-		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3)
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4)
 	};
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 
@@ -609,11 +610,12 @@ void VulkanExample::setupDescriptors()
 
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &clusterDSLayout, 1);
 	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &clusterDS));
-	std::array<VkWriteDescriptorSet, 4> writeClusterSets = {
+	std::array<VkWriteDescriptorSet, 5> writeClusterSets = {
 		vks::initializers::writeDescriptorSet(clusterDS, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &clusterImage.descriptor),
 		vks::initializers::writeDescriptorSet(clusterDS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &clusterDataBuffer.descriptor),
 		vks::initializers::writeDescriptorSet(clusterDS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &lightBuffer.descriptor),
-		vks::initializers::writeDescriptorSet(clusterDS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &frustumBuffer.descriptor)
+		vks::initializers::writeDescriptorSet(clusterDS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &frustumBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(clusterDS, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &shaderData.buffer.descriptor)
 	};
 	vkUpdateDescriptorSets(device, writeClusterSets.size(), writeClusterSets.data(), 0, nullptr);
 
@@ -859,12 +861,12 @@ void VulkanExample::prepareClusterBuffers()
 
 	vulkanDevice->copyBuffer(&stagingBuffer, &lightBuffer, queue);
 
-	// Frustum Buffer
+	// Frustum Buffer, one view space frustum per screen tile
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		&frustumBuffer,
-		frustums.size() * sizeof(Frustum)));
+		CLUSTER_X * CLUSTER_Y * sizeof(Frustum)));
 
 	frustumBuffer.map();
 	updateClusterFrustum();
@@ -1009,6 +1011,7 @@ void VulkanExample::render()
 	VulkanExampleBase::submitFrame();
 
 
+	// The culling reads the view matrix from the scene uniforms, the frustums only change with the projection
 	if (camera.updated) {
 		updateUniformBuffers();
 		updateClusterFrustum();
@@ -1028,60 +1031,74 @@ VULKAN_EXAMPLE_MAIN()
 
 void VulkanExample::updateClusterFrustum()
 {
-	glm::mat4 invVP = glm::inverse(camera.matrices.perspective * camera.matrices.view);
-	for (int i = 0; i < CLUSTER_SIZE; ++i) {
-		int clusterZ = i / (CLUSTER_X * CLUSTER_Y);
-		int clusterY = i % (CLUSTER_X * CLUSTER_Y) / CLUSTER_X;
-		int clusterX = i % (CLUSTER_X * CLUSTER_Y) % CLUSTER_X;
-
-		glm::vec2 uvBottomLeft = glm::vec2((float)clusterX / CLUSTER_X, (float)clusterY / CLUSTER_Y) * 2.0f - 1.0f;
-		glm::vec2 uvTopRight = glm::vec2((float)(clusterX + 1) / CLUSTER_X, (float)(clusterY + 1) / CLUSTER_Y) * 2.0f - 1.0f;
-
-		// Top
-		frustums[i].planes[0] = 
-			calPlane(
-				mul(invVP, glm::vec4(-1, uvTopRight.y, 0, 1)),
-				mul(invVP, glm::vec4(-1, uvTopRight.y, 1, 1)),
-				mul(invVP, glm::vec4(1, uvTopRight.y, 0, 1))
-			);
-		// Bottom
-		frustums[i].planes[1] =
-			calPlane(
-				mul(invVP, glm::vec4(-1, uvBottomLeft.y, 0, 1)),
-				mul(invVP, glm::vec4(1, uvBottomLeft.y, 0, 1)),
-				mul(invVP, glm::vec4(-1, uvBottomLeft.y, 1, 1))
-			);
-		// Left
-		frustums[i].planes[2] =
+	if (clusterProjection == camera.matrices.perspective) {
+		return;
+	}
+	clusterProjection = camera.matrices.perspective;
+	glm::mat4 invP = glm::inverse(camera.matrices.perspective);
+
+	// View space planes, shared by every cluster of a row / column
+	glm::vec4 top[CLUSTER_Y], bottom[CLUSTER_Y];
+	for (int y = 0; y < CLUSTER_Y; ++y) {
+		float bottomY = (float)y / CLUSTER_Y * 2.0f - 1.0f;
+		float topY = (float)(y + 1) / CLUSTER_Y * 2.0f - 1.0f;
+		top[y] =
 			calPlane(
-				mul(invVP, glm::vec4(uvBottomLeft.x, -1, 0, 1)),
-				mul(invVP, glm::vec4(uvBottomLeft.x, -1, 1, 1)),
-				mul(invVP, glm::vec4(uvBottomLeft.x, 1, 0, 1))
+				mul(invP, glm::vec4(-1, topY, 0, 1)),
+				mul(invP, glm::vec4(-1, topY, 1, 1)),
+				mul(invP, glm::vec4(1, topY, 0, 1))
 			);
-		// Right
-		frustums[i].planes[3] =
+		bottom[y] =
 			calPlane(
-				mul(invVP, glm::vec4(uvTopRight.x, -1, 0, 1)),
-				mul(invVP, glm::vec4(uvTopRight.x, 1, 0, 1)),
-				mul(invVP, glm::vec4(uvTopRight.x, -1, 1, 1))
+				mul(invP, glm::vec4(-1, bottomY, 0, 1)),
+				mul(invP, glm::vec4(1, bottomY, 0, 1)),
+				mul(invP, glm::vec4(-1, bottomY, 1, 1))
 			);
-		
-		// Front
-		frustums[i].planes[4] =
+	}
+	glm::vec4 left[CLUSTER_X], right[CLUSTER_X];
+	for (int x = 0; x < CLUSTER_X; ++x) {
+		float leftX = (float)x / CLUSTER_X * 2.0f - 1.0f;
+		float rightX = (float)(x + 1) / CLUSTER_X * 2.0f - 1.0f;
+		left[x] =
 			calPlane(
-				mul(invVP, glm::vec4(-1, -1, 0, 1)),
-				mul(invVP, glm::vec4(-1, 1, 0, 1)),
-				mul(invVP, glm::vec4(1, -1, 0, 1))
+				mul(invP, glm::vec4(leftX, -1, 0, 1)),
+				mul(invP, glm::vec4(leftX, -1, 1, 1)),
+				mul(invP, glm::vec4(leftX, 1, 0, 1))
 			);
-		// Back
-		frustums[i].planes[5] =
+		right[x] =
 			calPlane(
-				mul(invVP, glm::vec4(-1, -1, 1, 1)),
-				mul(invVP, glm::vec4(1, -1, 1, 1)),
-				mul(invVP, glm::vec4(-1, 1, 1, 1))
+				mul(invP, glm::vec4(rightX, -1, 0, 1)),
+				mul(invP, glm::vec4(rightX, 1, 0, 1)),
+				mul(invP, glm::vec4(rightX, -1, 1, 1))
 			);
 	}
-	frustumBuffer.copyTo(frustums.data(), frustums.size() * sizeof(Frustum));
+	glm::vec4 front =
+		calPlane(
+			mul(invP, glm::vec4(-1, -1, 0, 1)),
+			mul(invP, glm::vec4(-1, 1, 0, 1)),
+			mul(invP, glm::vec4(1, -1, 0, 1))
+		);
+	glm::vec4 back =
+		calPlane(
+			mul(invP, glm::vec4(-1, -1, 1, 1)),
+			mul(invP, glm::vec4(1, -1, 1, 1)),
+			mul(invP, glm::vec4(-1, 1, 1, 1))
+		);
+
+	// The grid only splits the screen, cluster.comp indexes this table by the xy of a cluster for every depth slice
+	// and moves the light spheres into view space, so camera moves don't touch it
+	Frustum* frustums = static_cast<Frustum*>(frustumBuffer.mapped);
+	for (int y = 0; y < CLUSTER_Y; ++y) {
+		for (int x = 0; x < CLUSTER_X; ++x) {
+			Frustum& frustum = frustums[y * CLUSTER_X + x];
+			frustum.planes[0] = top[y];
+			frustum.planes[1] = bottom[y];
+			frustum.planes[2] = left[x];
+			frustum.planes[3] = right[x];
+			frustum.planes[4] = front;
+			frustum.planes[5] = back;
+		}
+	}
 }
 
 void VulkanExample::updateClusterCamera(bool showCluster)
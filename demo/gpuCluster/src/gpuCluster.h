@@ -193,7 +193,8 @@ public:
 	struct Frustum {
 		glm::vec4 planes[6];
 	};
-	std::array<Frustum, CLUSTER_SIZE> frustums;
+	// Projection the view space frustums in frustumBuffer were built for
+	glm::mat4 clusterProjection = glm::mat4(0.0f);
 
 	vks::Texture clusterImage; // 3D = clusterIndex, VK_FORMAT_R32_UINT -> r = size
 	vks::Buffer clusterDataBuffer;
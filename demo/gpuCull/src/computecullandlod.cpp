@@ -244,7 +244,7 @@ public:
 			
 			//vkCmdDrawIndexed(drawCmdBuffers[i], indices.size(), objectCount, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
+			drawUI(drawCmdBuffers[i], i);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -316,9 +316,9 @@ public:
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		vkDestroyBuffer(vulkanDevice->logicalDevice, vertexStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, vertexStaging.memory, nullptr);
+		vulkanDevice->freeMemory(vertexStaging.memory);
 		vkDestroyBuffer(vulkanDevice->logicalDevice, indexStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, indexStaging.memory, nullptr);
+		vulkanDevice->freeMemory(indexStaging.memory);
 	}
 
 	void buildComputeCommandBuffer()
@@ -0,0 +1,278 @@
+#include "IndirectDrawCulling.h"
+
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+IndirectDrawCulling::Support IndirectDrawCulling::enableDeviceSupport(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& deviceFeatures, VkPhysicalDeviceFeatures& enabledFeatures, std::vector<const char*>& deviceExtensions)
+{
+	// Every record is drawn as one instance starting at its own firstInstance
+	if (!deviceFeatures.multiDrawIndirect || !deviceFeatures.drawIndirectFirstInstance)
+		return Support::None;
+	enabledFeatures.multiDrawIndirect = VK_TRUE;
+	enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+	uint32_t extCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, extensions.data());
+	bool hasDrawIndirectCount = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& ext) {
+		return strcmp(ext.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+	});
+	if (!hasDrawIndirectCount)
+		return Support::Indirect;
+
+	deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	return Support::IndirectCount;
+}
+
+IndirectDrawCulling::IndirectDrawCulling()
+{
+
+}
+
+void IndirectDrawCulling::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, Support support)
+{
+	m_vkDevice = vkDevice;
+	m_example = example;
+	m_deviceSupport = support;
+
+	if (m_deviceSupport == Support::IndirectCount) {
+		m_cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(m_vkDevice->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+		if (!m_cmdDrawIndexedIndirectCount) {
+			m_deviceSupport = Support::Indirect;
+		}
+	}
+	m_support = m_deviceSupport;
+
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&m_uniformBuffer,
+		sizeof(m_uniformCulling)));
+	VK_CHECK_RESULT(m_uniformBuffer.map());
+	m_uniformCulling = {};
+	memcpy(m_uniformBuffer.mapped, &m_uniformCulling, sizeof(m_uniformCulling));
+
+	prepareDescriptorSetLayout();
+	preparePipelineLayout();
+	preparePipeline();
+
+	prepareDescriptorPool();
+	prepareDescriptorSet();
+}
+
+void IndirectDrawCulling::setDraws(const std::vector<DrawRecord>& draws)
+{
+	vkQueueWaitIdle(m_example->queue);
+	m_recordBuffer.destroy();
+	m_commandBuffer.destroy();
+	m_countBuffer.destroy();
+	m_recordBuffer = vks::Buffer();
+	m_commandBuffer = vks::Buffer();
+	m_countBuffer = vks::Buffer();
+
+	m_drawCount = static_cast<uint32_t>(draws.size());
+	m_uniformCulling.drawCount = m_drawCount;
+	memcpy(m_uniformBuffer.mapped, &m_uniformCulling, sizeof(m_uniformCulling));
+	if (m_drawCount == 0)
+		return;
+
+	// The count of a single indirect count draw can't be split, larger sets are drawn in chunks without it
+	// Decided again for every set, so a smaller one goes back to the count draw
+	m_support = m_deviceSupport;
+	if (m_support == Support::IndirectCount && m_drawCount > m_vkDevice->properties.limits.maxDrawIndirectCount) {
+		m_support = Support::Indirect;
+	}
+
+	vks::Buffer stagingBuffer;
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer,
+		draws.size() * sizeof(DrawRecord),
+		(void*)draws.data()));
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&m_recordBuffer,
+		stagingBuffer.size));
+	m_vkDevice->copyBuffer(&stagingBuffer, &m_recordBuffer, m_example->queue);
+	stagingBuffer.destroy();
+
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&m_commandBuffer,
+		draws.size() * sizeof(VkDrawIndexedIndirectCommand)));
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&m_countBuffer,
+		sizeof(uint32_t)));
+
+	updateDescriptorSet();
+}
+
+void IndirectDrawCulling::updateFrustum(const glm::mat4& viewProjection)
+{
+	vks::Frustum frustum;
+	frustum.update(viewProjection);
+	for (uint32_t i = 0; i < 6; ++i) {
+		m_uniformCulling.frustumPlanes[i] = frustum.planes[i];
+	}
+	memcpy(m_uniformBuffer.mapped, &m_uniformCulling, sizeof(m_uniformCulling));
+}
+
+void IndirectDrawCulling::cull(VkCommandBuffer cb)
+{
+	if (m_drawCount == 0)
+		return;
+
+	// The draws of the previous frame have consumed the commands before they are reset and rewritten
+	std::array<VkBufferMemoryBarrier, 2> bufferBarriersBefore{};
+	bufferBarriersBefore[0] = vks::initializers::bufferMemoryBarrier();
+	bufferBarriersBefore[0].srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	bufferBarriersBefore[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarriersBefore[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarriersBefore[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarriersBefore[0].buffer = m_commandBuffer.buffer;
+	bufferBarriersBefore[0].size = m_commandBuffer.size;
+	bufferBarriersBefore[1] = bufferBarriersBefore[0];
+	bufferBarriersBefore[1].buffer = m_countBuffer.buffer;
+	bufferBarriersBefore[1].size = m_countBuffer.size;
+
+	vkCmdPipelineBarrier(
+		cb,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_FLAGS_NONE,
+		0, nullptr,
+		bufferBarriersBefore.size(), bufferBarriersBefore.data(),
+		0, nullptr);
+
+	vkCmdFillBuffer(cb, m_countBuffer.buffer, 0, m_countBuffer.size, 0);
+	if (m_support != Support::IndirectCount) {
+		// All records are drawn, the ones behind the visible count have to be empty draws
+		vkCmdFillBuffer(cb, m_commandBuffer.buffer, 0, m_commandBuffer.size, 0);
+	}
+
+	std::array<VkBufferMemoryBarrier, 2> bufferBarriersReset = bufferBarriersBefore;
+	for (VkBufferMemoryBarrier& barrier : bufferBarriersReset) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		cb,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_FLAGS_NONE,
+		0, nullptr,
+		bufferBarriersReset.size(), bufferBarriersReset.data(),
+		0, nullptr);
+
+	vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pLayout, 0, 1, &m_descriptorSet, 0, 0);
+	vkCmdDispatch(cb, (m_drawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	std::array<VkBufferMemoryBarrier, 2> bufferBarriersAfter = bufferBarriersBefore;
+	for (VkBufferMemoryBarrier& barrier : bufferBarriersAfter) {
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		cb,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_FLAGS_NONE,
+		0, nullptr,
+		bufferBarriersAfter.size(), bufferBarriersAfter.data(),
+		0, nullptr);
+}
+
+void IndirectDrawCulling::draw(VkCommandBuffer cb)
+{
+	if (m_drawCount == 0)
+		return;
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (m_support == Support::IndirectCount) {
+		m_cmdDrawIndexedIndirectCount(cb, m_commandBuffer.buffer, 0, m_countBuffer.buffer, 0, m_drawCount, stride);
+		return;
+	}
+
+	const uint32_t maxDrawCount = m_vkDevice->properties.limits.maxDrawIndirectCount;
+	for (uint32_t first = 0; first < m_drawCount; first += maxDrawCount) {
+		vkCmdDrawIndexedIndirect(cb, m_commandBuffer.buffer, (VkDeviceSize)first * stride, std::min(maxDrawCount, m_drawCount - first), stride);
+	}
+}
+
+void IndirectDrawCulling::destroy()
+{
+	vkDestroyDescriptorPool(m_vkDevice->logicalDevice, m_descriptorPool, nullptr);
+	vkDestroyPipeline(m_vkDevice->logicalDevice, m_pipeline, nullptr);
+	vkDestroyPipelineLayout(m_vkDevice->logicalDevice, m_pLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_vkDevice->logicalDevice, m_dsLayout, nullptr);
+
+	m_recordBuffer.destroy();
+	m_commandBuffer.destroy();
+	m_countBuffer.destroy();
+	m_uniformBuffer.destroy();
+}
+
+void IndirectDrawCulling::prepareDescriptorSetLayout()
+{
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3)
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vkDevice->logicalDevice, &descriptorSetLayoutCI, nullptr, &m_dsLayout));
+}
+
+void IndirectDrawCulling::preparePipelineLayout()
+{
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&m_dsLayout, 1);
+	VK_CHECK_RESULT(vkCreatePipelineLayout(m_vkDevice->logicalDevice, &pipelineLayoutCI, nullptr, &m_pLayout));
+}
+
+void IndirectDrawCulling::preparePipeline()
+{
+	VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(m_pLayout);
+	computePipelineCreateInfo.stage = m_example->loadShader(m_example->getShadersPath() + "loadPackage/spirv/drawCulling.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+	VK_CHECK_RESULT(vkCreateComputePipelines(m_vkDevice->logicalDevice, m_example->pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_pipeline));
+}
+
+void IndirectDrawCulling::prepareDescriptorPool()
+{
+	std::vector<VkDescriptorPoolSize> typeCounts = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3)
+	};
+
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(typeCounts, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(m_vkDevice->logicalDevice, &descriptorPoolInfo, nullptr, &m_descriptorPool));
+}
+
+void IndirectDrawCulling::prepareDescriptorSet()
+{
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_dsLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &m_descriptorSet));
+}
+
+void IndirectDrawCulling::updateDescriptorSet()
+{
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &m_uniformBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &m_recordBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &m_commandBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &m_countBuffer.descriptor)
+	};
+	vkUpdateDescriptorSets(m_vkDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vulkanexamplebase.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+/*
+	GPU driven drawing of many indexed draws that share one pipeline, vertex and index buffer.
+	The draw arguments and world space bounding spheres of all draws are uploaded once, every frame a compute
+	pass (drawCulling.comp) tests them against the view frustum and compacts the visible ones into an indirect
+	buffer that is drawn with a single vkCmdDrawIndexedIndirectCount. The recorded commands don't depend on the
+	view or the number of visible draws, so the command buffers are not rebuilt when the camera moves.
+*/
+class IndirectDrawCulling {
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+public:
+	// Must match DrawRecord of drawCulling.comp
+	struct DrawRecord {
+		glm::vec4 sphere; // world space center and radius
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t firstInstance;
+	};
+
+	enum class Support {
+		None,
+		// Without draw indirect count all records are drawn, culled ones as empty draws
+		Indirect,
+		IndirectCount
+	};
+public:
+	/**
+	* Enables the device features and extension the stage needs, call from getEnabledFeatures
+	*
+	* @return Level of support, with Support::None the draws have to be issued from the CPU
+	*/
+	static Support enableDeviceSupport(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& deviceFeatures, VkPhysicalDeviceFeatures& enabledFeatures, std::vector<const char*>& deviceExtensions);
+
+	IndirectDrawCulling();
+	void init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, Support support);
+	// Replaces all draw records, waits for the queue to be idle
+	void setDraws(const std::vector<DrawRecord>& draws);
+	// Frustum the next cull dispatches test against, the buffer is host visible so no command buffer rebuild is needed
+	void updateFrustum(const glm::mat4& viewProjection);
+	// Records the culling dispatch, outside of a render pass before the draws
+	void cull(VkCommandBuffer cb);
+	// Draws the visible records, the pipeline and the vertex / index buffers the records refer to must be bound
+	void draw(VkCommandBuffer cb);
+	void destroy();
+
+	uint32_t drawCount() const { return m_drawCount; }
+private:
+	void prepareDescriptorSetLayout();
+	void preparePipelineLayout();
+	void preparePipeline();
+	void prepareDescriptorPool();
+	void prepareDescriptorSet();
+	// The record, command and count buffers are recreated by setDraws
+	void updateDescriptorSet();
+private:
+	vks::VulkanDevice* m_vkDevice;
+	VulkanExampleBase* m_example;
+	// What the device offers, and what the current draws use: setDraws falls back to Indirect for sets that are too large
+	Support m_deviceSupport = Support::None;
+	Support m_support = Support::None;
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_cmdDrawIndexedIndirectCount = nullptr;
+
+	VkDescriptorSetLayout m_dsLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_pLayout = VK_NULL_HANDLE;
+	VkPipeline m_pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+	uint32_t m_drawCount = 0;
+	vks::Buffer m_recordBuffer;
+	vks::Buffer m_commandBuffer;
+	vks::Buffer m_countBuffer;
+	vks::Buffer m_uniformBuffer;
+	struct {
+		glm::vec4 frustumPlanes[6];
+		uint32_t drawCount;
+	}m_uniformCulling;
+};
@@ -1,5 +1,12 @@
 #include "LightSystem.h"
 
+#include <iomanip>
+#include <xmmintrin.h>
+
+#include <glm/gtc/packing.hpp>
+
+#include "threadpool.hpp"
+
 LightSystem::LightSystem()
 {
 
@@ -19,6 +26,8 @@ void LightSystem::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example,
 
 	prepareDescriptorPool();
 	prepareDescriptorSet();
+
+	initAsyncCompute();
 }
 
 void LightSystem::calculateFrustum(VkCommandBuffer cb)
@@ -39,74 +48,53 @@ void LightSystem::calculateFrustum(VkCommandBuffer cb)
 void LightSystem::doLightCulling(VkCommandBuffer cb)
 {
 	// Add memory barrier to ensure that the clusterImage and clusterDataBuffer have been consumed before the compute shader updates them
-	std::array<VkImageMemoryBarrier, 1> imageBarriersBefore{};
-	imageBarriersBefore[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageBarriersBefore[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	imageBarriersBefore[0].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-	imageBarriersBefore[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL; // todo: using general image layout for simplicity
-	imageBarriersBefore[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
-	imageBarriersBefore[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageBarriersBefore[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageBarriersBefore[0].image = m_clusterDataImage.image;
-	imageBarriersBefore[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-	std::array<VkBufferMemoryBarrier, 1> bufferBarriersBefore{};
-	bufferBarriersBefore[0] = vks::initializers::bufferMemoryBarrier();
-	bufferBarriersBefore[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	bufferBarriersBefore[0].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-	bufferBarriersBefore[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	bufferBarriersBefore[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	bufferBarriersBefore[0].buffer = m_lightListBuffer.buffer;
-	bufferBarriersBefore[0].size = m_lightListBuffer.size;
-
 	// since light is static, no barrier is needed for light buffer
+	lightListBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
 
-	// the frustum calculation is doing on CPU side, we'll use fence to make sure it accessible before execute compute shader
+	dispatchLightCulling(cb);
 
-	vkCmdPipelineBarrier(
-		cb,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_FLAGS_NONE,
-		0, nullptr,
-		bufferBarriersBefore.size(), bufferBarriersBefore.data(),
-		imageBarriersBefore.size(), imageBarriersBefore.data());
+	// Add memory barrier to ensure that the compute shader has finished writing the clusterImage and clusterDataBuffer before it's consumed
+	lightListBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+}
 
+void LightSystem::dispatchLightCulling(VkCommandBuffer cb)
+{
 	vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_lightCulling.pipeline);
 	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_lightCulling.pLayout, 0, 1, &m_lightCulling.descriptorSet, 0, 0);
 
 	vkCmdDispatch(cb, (CLUSTER_X + 7) / 8, (CLUSTER_Y + 7) / 8, CLUSTER_Z);
+}
 
-	// Add memory barrier to ensure that the compute shader has finished writing the clusterImage and clusterDataBuffer before it's consumed
-	std::array<VkImageMemoryBarrier, 1> imageBarriersAfter{};
-	imageBarriersAfter[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageBarriersAfter[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-	imageBarriersAfter[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	imageBarriersAfter[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL; // todo: using general image layout for simplicity
-	imageBarriersAfter[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
-	imageBarriersAfter[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageBarriersAfter[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imageBarriersAfter[0].image = m_clusterDataImage.image;
-	imageBarriersAfter[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-	std::array<VkBufferMemoryBarrier, 1> bufferBarriersAfter{};
-	bufferBarriersAfter[0] = vks::initializers::bufferMemoryBarrier();
-	bufferBarriersAfter[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-	bufferBarriersAfter[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	bufferBarriersAfter[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	bufferBarriersAfter[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	bufferBarriersAfter[0].buffer = m_lightListBuffer.buffer;
-	bufferBarriersAfter[0].size = m_lightListBuffer.size;
+void LightSystem::lightListBarrier(VkCommandBuffer cb, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily)
+{
+	std::array<VkImageMemoryBarrier, 1> imageBarriers{};
+	imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarriers[0].srcAccessMask = srcAccess;
+	imageBarriers[0].dstAccessMask = dstAccess;
+	imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL; // todo: using general image layout for simplicity
+	imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarriers[0].srcQueueFamilyIndex = srcFamily;
+	imageBarriers[0].dstQueueFamilyIndex = dstFamily;
+	imageBarriers[0].image = m_clusterDataImage.image;
+	imageBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	std::array<VkBufferMemoryBarrier, 1> bufferBarriers{};
+	bufferBarriers[0] = vks::initializers::bufferMemoryBarrier();
+	bufferBarriers[0].srcAccessMask = srcAccess;
+	bufferBarriers[0].dstAccessMask = dstAccess;
+	bufferBarriers[0].srcQueueFamilyIndex = srcFamily;
+	bufferBarriers[0].dstQueueFamilyIndex = dstFamily;
+	bufferBarriers[0].buffer = m_lightListBuffer.buffer;
+	bufferBarriers[0].size = m_lightListBuffer.size;
 
 	vkCmdPipelineBarrier(
 		cb,
-		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		srcStage,
+		dstStage,
 		VK_FLAGS_NONE,
 		0, nullptr,
-		bufferBarriersAfter.size(), bufferBarriersAfter.data(),
-		imageBarriersAfter.size(), imageBarriersAfter.data()
-	);
+		bufferBarriers.size(), bufferBarriers.data(),
+		imageBarriers.size(), imageBarriers.data());
 }
 
 void LightSystem::destroy()
@@ -131,9 +119,22 @@ void LightSystem::destroy()
 	m_cameraBuffer.destroy();
 	m_frustumXYImage.destroy();
 	m_frustumZImage.destroy();
+	m_cpuCullingStaging.destroy();
+	if (m_cpuUploadCommandBuffer != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(m_vkDevice->logicalDevice, m_vkDevice->commandPool, 1, &m_cpuUploadCommandBuffer);
+	}
+
+	if (m_computeCommandPool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(m_vkDevice->logicalDevice, m_computeCommandPool, nullptr);
+		vkDestroySemaphore(m_vkDevice->logicalDevice, m_cullingComplete, nullptr);
+		vkDestroySemaphore(m_vkDevice->logicalDevice, m_listsReleased, nullptr);
+	}
+	if (m_computeTimestamps != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(m_vkDevice->logicalDevice, m_computeTimestamps, nullptr);
+	}
 }
 
-void LightSystem::initLights(glm::vec3 position, float range, uint32_t lightCount)
+void LightSystem::generateLights(glm::vec3 position, glm::vec3 extent, uint32_t lightCount, std::vector<PointLight>& pointLights, std::vector<SpotLight>& spotLights)
 {
 	std::default_random_engine e;
 	std::uniform_real_distribution<float> d(0.0f, 1.0f);
@@ -142,9 +143,10 @@ void LightSystem::initLights(glm::vec3 position, float range, uint32_t lightCoun
 	float maxIntensity = 10.0f;
 
 	uint32_t pointLightCount = lightCount / 2;
-	m_pointLights.reserve(pointLightCount);
+	pointLights.clear();
+	pointLights.reserve(pointLightCount);
 	for (int i = 0; i < pointLightCount; ++i) {
-		glm::vec3 pos = position + glm::vec3(d(e), d(e), d(e));
+		glm::vec3 pos = position + glm::vec3(d(e), d(e), d(e)) * extent;
 		glm::vec3 color = glm::vec3(1.0f);
 		//glm::vec3 color = glm::vec3(d(e), d(e), d(e));
 		float range = d(e) * maxRange;
@@ -153,13 +155,14 @@ void LightSystem::initLights(glm::vec3 position, float range, uint32_t lightCoun
 		PointLight l;
 		l.positionRange = glm::vec4(pos, range);
 		l.colorIntensity = glm::vec4(color, intensity);
-		m_pointLights.push_back(l);
+		pointLights.push_back(l);
 	}
 
 	uint32_t spotLightCount = lightCount - pointLightCount;
-	m_spotLights.reserve(spotLightCount);
+	spotLights.clear();
+	spotLights.reserve(spotLightCount);
 	for (int i = 0; i < spotLightCount; ++i) {
-		glm::vec3 pos = position + glm::vec3(d(e), d(e), d(e));
+		glm::vec3 pos = position + glm::vec3(d(e), d(e), d(e)) * extent;
 		glm::vec3 color = glm::vec3(1.0f);
 		//glm::vec3 color = glm::vec3(d(e), d(e), d(e));
 		glm::vec3 dir = glm::normalize(glm::vec3(d(e) * 2.0f - 1.0f, d(e) * 2.0f - 1.0f, d(e) * 2.0f - 1.0f));
@@ -171,8 +174,57 @@ void LightSystem::initLights(glm::vec3 position, float range, uint32_t lightCoun
 		l.positionRange = glm::vec4(pos, range);
 		l.colorIntensity = glm::vec4(color, intensity);
 		l.directionCutoff = glm::vec4(dir, innerCutoff);
-		m_spotLights.push_back(l);
+		spotLights.push_back(l);
+	}
+
+	// Morton order (10 bits per axis inside the light bounds)
+	auto expandBits = [](uint32_t v) {
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	};
+	auto mortonOrder = [&](const std::vector<glm::vec3>& positions) {
+		std::vector<std::pair<uint32_t, uint32_t>> codes(positions.size());
+		for (uint32_t i = 0; i < positions.size(); ++i) {
+			glm::vec3 n = glm::clamp((positions[i] - position) / glm::max(extent, glm::vec3(1e-6f)), 0.0f, 1.0f);
+			glm::uvec3 q = glm::uvec3(n * 1023.0f);
+			codes[i] = { (expandBits(q.x) << 2) | (expandBits(q.y) << 1) | expandBits(q.z), i };
+		}
+		std::sort(codes.begin(), codes.end());
+		return codes;
+	};
+
+	std::vector<glm::vec3> positions(pointLights.size());
+	for (uint32_t i = 0; i < pointLights.size(); ++i) {
+		positions[i] = glm::vec3(pointLights[i].positionRange);
+	}
+	std::vector<PointLight> sortedPointLights;
+	sortedPointLights.reserve(pointLights.size());
+	for (auto& code : mortonOrder(positions)) {
+		sortedPointLights.push_back(pointLights[code.second]);
+	}
+	pointLights.swap(sortedPointLights);
+
+	positions.resize(spotLights.size());
+	for (uint32_t i = 0; i < spotLights.size(); ++i) {
+		positions[i] = glm::vec3(spotLights[i].positionRange);
+	}
+	std::vector<SpotLight> sortedSpotLights;
+	sortedSpotLights.reserve(spotLights.size());
+	for (auto& code : mortonOrder(positions)) {
+		sortedSpotLights.push_back(spotLights[code.second]);
 	}
+	spotLights.swap(sortedSpotLights);
+}
+
+void LightSystem::initLights(glm::vec3 position, float range, uint32_t lightCount)
+{
+	m_lightPosition = position;
+
+	generateLights(position, glm::vec3(1.0f), lightCount, m_pointLights, m_spotLights);
+	buildCpuLights(m_pointLights, m_spotLights, m_cpuLights);
 }
 
 void LightSystem::createResources()
@@ -197,7 +249,7 @@ void LightSystem::createResources()
 		imageInfo.arrayLayers = 1;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		VK_CHECK_RESULT(vkCreateImage(m_vkDevice->logicalDevice, &imageInfo, nullptr, &m_clusterDataImage.image));
 
@@ -248,12 +300,16 @@ void LightSystem::createResources()
 	// Light List
 	//
 	VK_CHECK_RESULT(m_vkDevice->createBuffer(
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		&m_lightListBuffer,
 		CLUSTER_SIZE * MAX_LIST_LENGTH * sizeof(uint32_t)
 	));
 
+	// The light and camera buffers are read by the culling on the compute queue and the lighting on the graphics queue,
+	// they are shared concurrently instead of being transferred like the light lists
+	const std::vector<uint32_t> sharedFamilies = { m_vkDevice->queueFamilyIndices.graphics, m_vkDevice->queueFamilyIndices.compute };
+
 	// Light Data
 	//
 	VK_CHECK_RESULT(m_vkDevice->createBuffer(
@@ -261,14 +317,16 @@ void LightSystem::createResources()
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		&m_pointLightBuffer,
 		m_pointLights.size() * sizeof(PointLight),
-		m_pointLights.data()));
+		m_pointLights.data(),
+		sharedFamilies));
 
 	VK_CHECK_RESULT(m_vkDevice->createBuffer(
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		&m_spotLightBuffer,
 		m_spotLights.size() * sizeof(SpotLight),
-		m_spotLights.data()));
+		m_spotLights.data(),
+		sharedFamilies));
 
 	// Camera
 	//
@@ -276,7 +334,9 @@ void LightSystem::createResources()
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		&m_cameraBuffer,
-		sizeof(m_uniformCamera)));
+		sizeof(m_uniformCamera),
+		nullptr,
+		sharedFamilies));
 	m_cameraBuffer.map();
 	updateCamera();
 
@@ -470,4 +530,920 @@ void LightSystem::updateCamera()
 	m_uniformCamera.viewInv = glm::inverse(m_example->camera.matrices.view);
 
 	memcpy(m_cameraBuffer.mapped, &m_uniformCamera, sizeof(m_uniformCamera));
+
+	if (m_cpuCulling) {
+		updateLightCullingCPU();
+	}
+}
+
+// Async Compute
+//
+
+void LightSystem::initAsyncCompute()
+{
+	if (!asyncComputeSupported())
+		return;
+
+	vkGetDeviceQueue(m_vkDevice->logicalDevice, m_vkDevice->queueFamilyIndices.compute, 0, &m_computeQueue);
+	m_computeCommandPool = m_vkDevice->createCommandPool(m_vkDevice->queueFamilyIndices.compute);
+	m_computeCommandBuffer = m_vkDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_computeCommandPool);
+
+	VkSemaphoreCreateInfo semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+	VK_CHECK_RESULT(vkCreateSemaphore(m_vkDevice->logicalDevice, &semaphoreInfo, nullptr, &m_cullingComplete));
+	VK_CHECK_RESULT(vkCreateSemaphore(m_vkDevice->logicalDevice, &semaphoreInfo, nullptr, &m_listsReleased));
+
+	// Begin and end of the culling on the compute queue
+	if (m_vkDevice->queueFamilyProperties[m_vkDevice->queueFamilyIndices.compute].timestampValidBits > 0) {
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		VK_CHECK_RESULT(vkCreateQueryPool(m_vkDevice->logicalDevice, &queryPoolInfo, nullptr, &m_computeTimestamps));
+	}
+
+	// The camera is read from a host coherent buffer, so the same commands are submitted every frame
+	recordAsyncCulling();
+}
+
+void LightSystem::recordAsyncCulling()
+{
+	const uint32_t graphicsFamily = m_vkDevice->queueFamilyIndices.graphics;
+	const uint32_t computeFamily = m_vkDevice->queueFamilyIndices.compute;
+	VkCommandBuffer cb = m_computeCommandBuffer;
+
+	VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+	VK_CHECK_RESULT(vkBeginCommandBuffer(cb, &beginInfo));
+
+	if (m_computeTimestamps != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(cb, m_computeTimestamps, 0, 2);
+		vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_computeTimestamps, 0);
+	}
+
+	// Acquire the light lists released by the graphics queue after the lighting pass of the previous frame,
+	// in the compute stage that m_listsReleased is waited on
+	lightListBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, graphicsFamily, computeFamily);
+
+	calculateFrustum(cb);
+
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	dispatchLightCulling(cb);
+
+	// Release them to the graphics queue, the lighting pass acquires them in recordCulling
+	lightListBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, computeFamily, graphicsFamily);
+
+	if (m_computeTimestamps != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_computeTimestamps, 1);
+	}
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(cb));
+}
+
+bool LightSystem::asyncComputeSupported() const
+{
+	// With a single queue family there is no second queue to overlap with, the culling stays in the graphics command buffer
+	return m_vkDevice->queueFamilyIndices.compute != m_vkDevice->queueFamilyIndices.graphics;
+}
+
+void LightSystem::setAsyncCompute(bool enabled)
+{
+	m_asyncCompute = enabled && asyncComputeSupported();
+	setQueueOwner(asyncCulling());
+}
+
+void LightSystem::setQueueOwner(bool compute)
+{
+	if (compute == m_computeOwned)
+		return;
+
+	const uint32_t graphicsFamily = m_vkDevice->queueFamilyIndices.graphics;
+	const uint32_t computeFamily = m_vkDevice->queueFamilyIndices.compute;
+
+	if (compute) {
+		// The first async frame acquires the light lists on the compute queue
+		VkCommandBuffer cb = m_vkDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		lightListBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, graphicsFamily, computeFamily);
+		m_vkDevice->flushCommandBuffer(cb, m_example->queue, true);
+	}
+	else {
+		// The last async frame released them to the compute queue, acquire them there and hand them back to graphics
+		VkCommandBuffer cb = m_vkDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_computeCommandPool, true);
+		lightListBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, graphicsFamily, computeFamily);
+		lightListBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, computeFamily, graphicsFamily);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cb));
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cb;
+		if (m_releaseSignaled) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &m_listsReleased;
+			submitInfo.pWaitDstStageMask = &waitStage;
+			m_releaseSignaled = false;
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(m_computeQueue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueWaitIdle(m_computeQueue));
+		vkFreeCommandBuffers(m_vkDevice->logicalDevice, m_computeCommandPool, 1, &cb);
+
+		cb = m_vkDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		lightListBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, computeFamily, graphicsFamily);
+		m_vkDevice->flushCommandBuffer(cb, m_example->queue, true);
+	}
+	m_computeOwned = compute;
+}
+
+void LightSystem::recordCulling(VkCommandBuffer cb)
+{
+	if (m_cpuCulling)
+		return;
+
+	if (asyncCulling()) {
+		// Acquire the light lists released by the compute queue, the submit waits for its semaphore at the fragment stage
+		lightListBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+			m_vkDevice->queueFamilyIndices.compute, m_vkDevice->queueFamilyIndices.graphics);
+		return;
+	}
+
+	calculateFrustum(cb);
+
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	doLightCulling(cb);
+}
+
+void LightSystem::recordLightingDone(VkCommandBuffer cb)
+{
+	if (!asyncCulling())
+		return;
+
+	// Release the light lists to the compute queue, the culling of the next frame waits for m_listsReleased
+	lightListBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		m_vkDevice->queueFamilyIndices.graphics, m_vkDevice->queueFamilyIndices.compute);
+}
+
+void LightSystem::submitAsyncCulling(std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages, std::vector<VkSemaphore>& signalSemaphores)
+{
+	if (!asyncCulling())
+		return;
+
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_computeCommandBuffer;
+	if (m_releaseSignaled) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &m_listsReleased;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_cullingComplete;
+	VK_CHECK_RESULT(vkQueueSubmit(m_computeQueue, 1, &submitInfo, VK_NULL_HANDLE));
+	m_computeTimestampsWritten = m_computeTimestamps != VK_NULL_HANDLE;
+
+	// Only the lighting pass reads the light lists, the geometry before it keeps running while the culling does
+	waitSemaphores.push_back(m_cullingComplete);
+	waitStages.push_back(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	signalSemaphores.push_back(m_listsReleased);
+	m_releaseSignaled = true;
+}
+
+bool LightSystem::asyncCullingTime(uint64_t frameBeginTicks, float& beginUs, float& endUs) const
+{
+	if (!m_computeTimestampsWritten)
+		return false;
+
+	uint64_t ticks[2] = {};
+	if (vkGetQueryPoolResults(m_vkDevice->logicalDevice, m_computeTimestamps, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	// Timestamps of all queues count the same device clock, so both are placed on the graphics frame
+	const double microsecondsPerTick = 1e-3 * m_vkDevice->properties.limits.timestampPeriod;
+	beginUs = float(microsecondsPerTick * ((double)ticks[0] - (double)frameBeginTicks));
+	endUs = float(microsecondsPerTick * ((double)ticks[1] - (double)frameBeginTicks));
+	return true;
+}
+
+// CPU Light Culling
+//
+
+void LightSystem::SphereSet::resize(uint32_t size)
+{
+	uint32_t padded = (size + 3) & ~3u;
+	x.resize(padded, 0.0f);
+	y.resize(padded, 0.0f);
+	z.resize(padded, 0.0f);
+	radius.resize(padded, 0.0f);
+	index.resize(padded, 0);
+}
+
+void LightSystem::ConeSet::resize(uint32_t size)
+{
+	uint32_t padded = (size + 3) & ~3u;
+	x.resize(padded, 0.0f);
+	y.resize(padded, 0.0f);
+	z.resize(padded, 0.0f);
+	dirX.resize(padded, 0.0f);
+	dirY.resize(padded, 0.0f);
+	dirZ.resize(padded, 0.0f);
+	height.resize(padded, 0.0f);
+	baseRadius.resize(padded, 0.0f);
+	index.resize(padded, 0);
+}
+
+void LightSystem::setCpuCulling(bool enabled)
+{
+	m_cpuCulling = enabled;
+	// The uploads of the CPU path run on the graphics queue
+	setQueueOwner(asyncCulling());
+	if (m_cpuCulling) {
+		updateLightCullingCPU();
+	}
+}
+
+// Keeps the lights that are not fully outside any of the planes, in their original order
+void LightSystem::filterSpheres(const SphereSet& in, const glm::vec4* planes, uint32_t planeCount, SphereSet& out)
+{
+	if (out.x.size() < in.x.size()) {
+		out.resize(static_cast<uint32_t>(in.x.size()));
+	}
+	out.count = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t i = 0; i < in.count; i += 4) {
+		__m128 x = _mm_loadu_ps(&in.x[i]);
+		__m128 y = _mm_loadu_ps(&in.y[i]);
+		__m128 z = _mm_loadu_ps(&in.z[i]);
+		__m128 r = _mm_loadu_ps(&in.radius[i]);
+
+		__m128 outside = zero;
+		for (uint32_t p = 0; p < planeCount; ++p) {
+			// dot(vec4(sphere.xyz, 1.0), plane) + sphere.w < 0.0
+			__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(planes[p].y)));
+			d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(planes[p].z)));
+			d = _mm_add_ps(_mm_add_ps(d, _mm_set1_ps(planes[p].w)), r);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+		}
+
+		uint32_t lanes = std::min(in.count - i, 4u);
+		uint32_t inside = ~_mm_movemask_ps(outside) & ((1u << lanes) - 1);
+		for (uint32_t lane = 0; lane < lanes; ++lane) {
+			if (inside & (1u << lane)) {
+				uint32_t src = i + lane;
+				out.x[out.count] = in.x[src];
+				out.y[out.count] = in.y[src];
+				out.z[out.count] = in.z[src];
+				out.radius[out.count] = in.radius[src];
+				out.index[out.count] = in.index[src];
+				out.count++;
+			}
+		}
+	}
+}
+
+// Same as coneOutsidePlane of lightCulling.comp: a cone is outside when both its tip and the base point closest to the plane are
+void LightSystem::filterCones(const ConeSet& in, const glm::vec4* planes, uint32_t planeCount, ConeSet& out)
+{
+	if (out.x.size() < in.x.size()) {
+		out.resize(static_cast<uint32_t>(in.x.size()));
+	}
+	out.count = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t i = 0; i < in.count; i += 4) {
+		__m128 x = _mm_loadu_ps(&in.x[i]);
+		__m128 y = _mm_loadu_ps(&in.y[i]);
+		__m128 z = _mm_loadu_ps(&in.z[i]);
+		__m128 dx = _mm_loadu_ps(&in.dirX[i]);
+		__m128 dy = _mm_loadu_ps(&in.dirY[i]);
+		__m128 dz = _mm_loadu_ps(&in.dirZ[i]);
+		__m128 h = _mm_loadu_ps(&in.height[i]);
+		__m128 br = _mm_loadu_ps(&in.baseRadius[i]);
+
+		__m128 outside = zero;
+		for (uint32_t p = 0; p < planeCount; ++p) {
+			__m128 nx = _mm_set1_ps(planes[p].x);
+			__m128 ny = _mm_set1_ps(planes[p].y);
+			__m128 nz = _mm_set1_ps(planes[p].z);
+			__m128 nw = _mm_set1_ps(planes[p].w);
+
+			// m = cross(cross(plane.xyz, dir), dir)
+			__m128 cx = _mm_sub_ps(_mm_mul_ps(ny, dz), _mm_mul_ps(nz, dy));
+			__m128 cy = _mm_sub_ps(_mm_mul_ps(nz, dx), _mm_mul_ps(nx, dz));
+			__m128 cz = _mm_sub_ps(_mm_mul_ps(nx, dy), _mm_mul_ps(ny, dx));
+			__m128 mx = _mm_sub_ps(_mm_mul_ps(cy, dz), _mm_mul_ps(cz, dy));
+			__m128 my = _mm_sub_ps(_mm_mul_ps(cz, dx), _mm_mul_ps(cx, dz));
+			__m128 mz = _mm_sub_ps(_mm_mul_ps(cx, dy), _mm_mul_ps(cy, dx));
+
+			// q = tip + dir * height - m * baseRadius
+			__m128 qx = _mm_sub_ps(_mm_add_ps(x, _mm_mul_ps(dx, h)), _mm_mul_ps(mx, br));
+			__m128 qy = _mm_sub_ps(_mm_add_ps(y, _mm_mul_ps(dy, h)), _mm_mul_ps(my, br));
+			__m128 qz = _mm_sub_ps(_mm_add_ps(z, _mm_mul_ps(dz, h)), _mm_mul_ps(mz, br));
+
+			__m128 tipDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, nx), _mm_mul_ps(y, ny)), _mm_add_ps(_mm_mul_ps(z, nz), nw));
+			__m128 qDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, nx), _mm_mul_ps(qy, ny)), _mm_add_ps(_mm_mul_ps(qz, nz), nw));
+			outside = _mm_or_ps(outside, _mm_and_ps(_mm_cmplt_ps(tipDist, zero), _mm_cmplt_ps(qDist, zero)));
+		}
+
+		uint32_t lanes = std::min(in.count - i, 4u);
+		uint32_t inside = ~_mm_movemask_ps(outside) & ((1u << lanes) - 1);
+		for (uint32_t lane = 0; lane < lanes; ++lane) {
+			if (inside & (1u << lane)) {
+				uint32_t src = i + lane;
+				out.x[out.count] = in.x[src];
+				out.y[out.count] = in.y[src];
+				out.z[out.count] = in.z[src];
+				out.dirX[out.count] = in.dirX[src];
+				out.dirY[out.count] = in.dirY[src];
+				out.dirZ[out.count] = in.dirZ[src];
+				out.height[out.count] = in.height[src];
+				out.baseRadius[out.count] = in.baseRadius[src];
+				out.index[out.count] = in.index[src];
+				out.count++;
+			}
+		}
+	}
+}
+
+void LightSystem::buildCpuLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights, CpuLights& lights)
+{
+	std::vector<glm::vec3> boundsMin, boundsMax;
+
+	// Point lights, bounded by their sphere
+	SphereSet& points = lights.points;
+	points.resize(static_cast<uint32_t>(pointLights.size()));
+	boundsMin.resize(pointLights.size());
+	boundsMax.resize(pointLights.size());
+	for (uint32_t i = 0; i < pointLights.size(); ++i) {
+		const PointLight& l = pointLights[i];
+		points.x[i] = l.positionRange.x;
+		points.y[i] = l.positionRange.y;
+		points.z[i] = l.positionRange.z;
+		points.radius[i] = l.positionRange.w;
+		points.index[i] = i;
+		boundsMin[i] = glm::vec3(l.positionRange) - l.positionRange.w;
+		boundsMax[i] = glm::vec3(l.positionRange) + l.positionRange.w;
+	}
+	points.count = static_cast<uint32_t>(pointLights.size());
+	lights.pointBVH.build(boundsMin, boundsMax);
+
+	// Spot lights, bounded by their tip and base disc
+	ConeSet& spots = lights.spots;
+	spots.resize(static_cast<uint32_t>(spotLights.size()));
+	boundsMin.resize(spotLights.size());
+	boundsMax.resize(spotLights.size());
+	for (uint32_t i = 0; i < spotLights.size(); ++i) {
+		const SpotLight& l = spotLights[i];
+		glm::vec3 tip = glm::vec3(l.positionRange);
+		glm::vec3 dir = glm::vec3(l.directionCutoff);
+		float height = l.positionRange.w;
+		float baseRadius = glm::tan(glm::acos(l.directionCutoff.w)) * height;
+
+		spots.x[i] = tip.x;
+		spots.y[i] = tip.y;
+		spots.z[i] = tip.z;
+		spots.dirX[i] = dir.x;
+		spots.dirY[i] = dir.y;
+		spots.dirZ[i] = dir.z;
+		spots.height[i] = height;
+		spots.baseRadius[i] = baseRadius;
+		spots.index[i] = i;
+
+		glm::vec3 base = tip + dir * height;
+		glm::vec3 discExtent = baseRadius * glm::sqrt(glm::max(glm::vec3(1.0f) - dir * dir, glm::vec3(0.0f)));
+		boundsMin[i] = glm::min(tip, base - discExtent);
+		boundsMax[i] = glm::max(tip, base + discExtent);
+	}
+	spots.count = static_cast<uint32_t>(spotLights.size());
+	lights.spotBVH.build(boundsMin, boundsMax);
+}
+
+void LightSystem::LightBVH::build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+	nodes.clear();
+	if (boundsMin.empty())
+		return;
+	nodes.reserve(2 * (boundsMin.size() / LEAF_SIZE + 1));
+	buildNode(boundsMin, boundsMax, 0, static_cast<uint32_t>(boundsMin.size()));
+}
+
+uint32_t LightSystem::LightBVH::buildNode(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax, uint32_t begin, uint32_t end)
+{
+	glm::vec3 nodeMin = boundsMin[begin];
+	glm::vec3 nodeMax = boundsMax[begin];
+	for (uint32_t i = begin + 1; i < end; ++i) {
+		nodeMin = glm::min(nodeMin, boundsMin[i]);
+		nodeMax = glm::max(nodeMax, boundsMax[i]);
+	}
+
+	uint32_t index = static_cast<uint32_t>(nodes.size());
+	Node node;
+	node.center = (nodeMin + nodeMax) * 0.5f;
+	node.extent = (nodeMax - nodeMin) * 0.5f;
+	node.begin = begin;
+	node.end = end;
+	node.right = 0;
+	nodes.push_back(node);
+
+	// The lights are Morton ordered, so splitting the range in half splits them spatially
+	if (end - begin > LEAF_SIZE) {
+		uint32_t mid = begin + (end - begin) / 2;
+		buildNode(boundsMin, boundsMax, begin, mid);
+		uint32_t right = buildNode(boundsMin, boundsMax, mid, end);
+		nodes[index].right = right;
+	}
+	return index;
+}
+
+void LightSystem::LightBVH::query(const glm::vec4* planes, uint32_t planeCount, std::vector<glm::uvec2>& ranges) const
+{
+	if (nodes.empty())
+		return;
+
+	uint32_t stack[64];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+
+		bool outside = false;
+		bool inside = true;
+		for (uint32_t p = 0; p < planeCount; ++p) {
+			glm::vec3 normal = glm::vec3(planes[p]);
+			float distance = glm::dot(normal, node.center) + planes[p].w;
+			float radius = glm::dot(glm::abs(normal), node.extent);
+			if (distance + radius < 0.0f) {
+				outside = true;
+				break;
+			}
+			inside = inside && distance - radius >= 0.0f;
+		}
+		if (outside)
+			continue;
+
+		if (inside || node.right == 0) {
+			// Merge with the previous range when contiguous, ranges come in ascending order
+			if (!ranges.empty() && ranges.back().y == node.begin) {
+				ranges.back().y = node.end;
+			} else {
+				ranges.push_back(glm::uvec2(node.begin, node.end));
+			}
+			continue;
+		}
+
+		// Right first so the left child is visited first
+		stack[stackSize++] = node.right;
+		stack[stackSize++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+	}
+}
+
+void LightSystem::gatherSpheres(const SphereSet& in, const std::vector<glm::uvec2>& ranges, SphereSet& out)
+{
+	uint32_t count = 0;
+	for (auto& range : ranges) {
+		count += range.y - range.x;
+	}
+	if (out.x.size() < count) {
+		out.resize(count);
+	}
+	out.count = 0;
+	for (auto& range : ranges) {
+		std::copy(in.x.begin() + range.x, in.x.begin() + range.y, out.x.begin() + out.count);
+		std::copy(in.y.begin() + range.x, in.y.begin() + range.y, out.y.begin() + out.count);
+		std::copy(in.z.begin() + range.x, in.z.begin() + range.y, out.z.begin() + out.count);
+		std::copy(in.radius.begin() + range.x, in.radius.begin() + range.y, out.radius.begin() + out.count);
+		std::copy(in.index.begin() + range.x, in.index.begin() + range.y, out.index.begin() + out.count);
+		out.count += range.y - range.x;
+	}
+}
+
+void LightSystem::gatherCones(const ConeSet& in, const std::vector<glm::uvec2>& ranges, ConeSet& out)
+{
+	uint32_t count = 0;
+	for (auto& range : ranges) {
+		count += range.y - range.x;
+	}
+	if (out.x.size() < count) {
+		out.resize(count);
+	}
+	out.count = 0;
+	for (auto& range : ranges) {
+		std::copy(in.x.begin() + range.x, in.x.begin() + range.y, out.x.begin() + out.count);
+		std::copy(in.y.begin() + range.x, in.y.begin() + range.y, out.y.begin() + out.count);
+		std::copy(in.z.begin() + range.x, in.z.begin() + range.y, out.z.begin() + out.count);
+		std::copy(in.dirX.begin() + range.x, in.dirX.begin() + range.y, out.dirX.begin() + out.count);
+		std::copy(in.dirY.begin() + range.x, in.dirY.begin() + range.y, out.dirY.begin() + out.count);
+		std::copy(in.dirZ.begin() + range.x, in.dirZ.begin() + range.y, out.dirZ.begin() + out.count);
+		std::copy(in.height.begin() + range.x, in.height.begin() + range.y, out.height.begin() + out.count);
+		std::copy(in.baseRadius.begin() + range.x, in.baseRadius.begin() + range.y, out.baseRadius.begin() + out.count);
+		std::copy(in.index.begin() + range.x, in.index.begin() + range.y, out.index.begin() + out.count);
+		out.count += range.y - range.x;
+	}
+}
+
+// Same planes as frustumXY.comp / frustumZ.comp. The compute path stores them in rgba16f images,
+// they are rounded to half precision here as well so both paths classify lights the same way
+void LightSystem::calculateFrustumCPU(ClusterPlanes& planes) const
+{
+	auto mul = [](const glm::mat4& m, const glm::vec4& v) {
+		glm::vec4 ret = m * v;
+		ret /= ret.w;
+		return glm::vec3(ret);
+	};
+	auto calPlane = [](const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3) {
+		glm::vec3 normal = glm::normalize(glm::cross(v3 - v1, v2 - v1));
+		glm::vec4 plane = glm::vec4(normal, -glm::dot(normal, v1));
+		return glm::unpackHalf4x16(glm::packHalf4x16(plane));
+	};
+
+	const glm::mat4& viewProjInv = m_uniformCamera.viewProjInv;
+	const glm::mat4& viewInv = m_uniformCamera.viewInv;
+
+	planes.eye = glm::vec3(viewInv[3]);
+	planes.forward = -glm::normalize(glm::vec3(viewInv[2]));
+
+	planes.x.resize(CLUSTER_X * 2);
+	for (uint32_t x = 0; x < CLUSTER_X; ++x) {
+		float left = 2.0f * ((float)x / CLUSTER_X) - 1.0f;
+		float right = 2.0f * ((float)x / CLUSTER_X + 1.0f / CLUSTER_X) - 1.0f;
+		planes.x[x * 2 + 0] = calPlane(
+			mul(viewProjInv, glm::vec4(left, -1, 0, 1)),
+			mul(viewProjInv, glm::vec4(left, -1, 1, 1)),
+			mul(viewProjInv, glm::vec4(left, 1, 0, 1)));
+		planes.x[x * 2 + 1] = calPlane(
+			mul(viewProjInv, glm::vec4(right, -1, 0, 1)),
+			mul(viewProjInv, glm::vec4(right, 1, 0, 1)),
+			mul(viewProjInv, glm::vec4(right, -1, 1, 1)));
+	}
+
+	planes.y.resize(CLUSTER_Y * 2);
+	for (uint32_t y = 0; y < CLUSTER_Y; ++y) {
+		float top = 2.0f * ((float)y / CLUSTER_Y) - 1.0f;
+		float bottom = 2.0f * ((float)y / CLUSTER_Y + 1.0f / CLUSTER_Y) - 1.0f;
+		planes.y[y * 2 + 0] = calPlane(
+			mul(viewProjInv, glm::vec4(-1, bottom, 0, 1)),
+			mul(viewProjInv, glm::vec4(-1, bottom, 1, 1)),
+			mul(viewProjInv, glm::vec4(1, bottom, 0, 1)));
+		planes.y[y * 2 + 1] = calPlane(
+			mul(viewProjInv, glm::vec4(-1, top, 0, 1)),
+			mul(viewProjInv, glm::vec4(1, top, 0, 1)),
+			mul(viewProjInv, glm::vec4(-1, top, 1, 1)));
+	}
+
+	planes.z.resize(CLUSTER_Z * 2);
+	for (uint32_t z = 0; z < CLUSTER_Z; ++z) {
+		float front = glm::mix(CLUSTER_NEAR, CLUSTER_FAR, z / float(CLUSTER_Z));
+		float back = glm::mix(CLUSTER_NEAR, CLUSTER_FAR, (z + 1.0f) / CLUSTER_Z);
+		planes.z[z * 2 + 0] = calPlane(
+			mul(viewInv, glm::vec4(-1, -1, front, 1)),
+			mul(viewInv, glm::vec4(-1, 1, front, 1)),
+			mul(viewInv, glm::vec4(1, -1, front, 1)));
+		planes.z[z * 2 + 1] = calPlane(
+			mul(viewInv, glm::vec4(-1, -1, back, 1)),
+			mul(viewInv, glm::vec4(1, -1, back, 1)),
+			mul(viewInv, glm::vec4(-1, 1, back, 1)));
+	}
+}
+
+// Scalar versions of the tests of lightCulling.comp
+static bool sphereOutsidePlane(const glm::vec4& sphere, const glm::vec4& plane)
+{
+	return glm::dot(glm::vec4(glm::vec3(sphere), 1.0f), plane) + sphere.w < 0.0f;
+}
+
+static bool coneOutsidePlane(const glm::vec3& tip, float height, const glm::vec3& dir, float baseRadius, const glm::vec4& plane)
+{
+	glm::vec3 m = glm::cross(glm::cross(glm::vec3(plane), dir), dir);
+	glm::vec3 q = tip + dir * height - m * baseRadius;
+	return glm::dot(glm::vec4(tip, 1.0f), plane) < 0.0f && glm::dot(glm::vec4(q, 1.0f), plane) < 0.0f;
+}
+
+// Calls append for every column of a row that a light is not outside of, in ascending order.
+// All column planes contain the vertical axis through the eye. For a light entirely in front of the eye, rejection by the
+// left plane only goes from false to true towards larger x and rejection by the right plane from true to false (the other
+// way around behind the eye), so the columns form a range whose ends are found with binary searches.
+// Lights crossing the eye plane (side 0) are tested against every column
+template<typename OutsideFunc, typename AppendFunc>
+static void binColumns(const std::vector<glm::vec4>& columnPlanes, int side, OutsideFunc outside, AppendFunc append)
+{
+	const uint32_t columnCount = static_cast<uint32_t>(columnPlanes.size() / 2);
+
+	if (side == 0) {
+		for (uint32_t x = 0; x < columnCount; ++x) {
+			if (!outside(columnPlanes[x * 2]) && !outside(columnPlanes[x * 2 + 1])) {
+				append(x);
+			}
+		}
+		return;
+	}
+
+	// First column in [begin, columnCount) for which pred turns true
+	auto firstTrue = [&](uint32_t begin, uint32_t plane, bool expected) {
+		uint32_t lo = begin, hi = columnCount;
+		while (lo < hi) {
+			uint32_t mid = (lo + hi) / 2;
+			if (outside(columnPlanes[mid * 2 + plane]) == expected) {
+				hi = mid;
+			} else {
+				lo = mid + 1;
+			}
+		}
+		return lo;
+	};
+
+	// Plane 0 is the left, plane 1 the right plane of a column
+	uint32_t begin = side > 0 ? firstTrue(0, 1, false) : firstTrue(0, 0, false);
+	uint32_t end = side > 0 ? firstTrue(begin, 0, true) : firstTrue(begin, 1, true);
+	for (uint32_t x = begin; x < end; ++x) {
+		append(x);
+	}
+}
+
+// Lights are culled hierarchically: against the slice (through the BVH when enabled) and row planes, then binned into the columns of the row
+void LightSystem::cullSliceCPU(const CpuLights& lights, bool useBVH, uint32_t z, const ClusterPlanes& planes, uint32_t* lightLists, uint16_t* clusterData, uint16_t* listLengths) const
+{
+	SphereSet slicePoints, rowPoints;
+	ConeSet sliceSpots, rowSpots;
+
+	if (useBVH) {
+		// The BVH only skips whole groups of lights outside the slice, the exact tests still run on what is left
+		SphereSet candidatePoints;
+		ConeSet candidateSpots;
+		std::vector<glm::uvec2> ranges;
+
+		lights.pointBVH.query(&planes.z[z * 2], 2, ranges);
+		gatherSpheres(lights.points, ranges, candidatePoints);
+		filterSpheres(candidatePoints, &planes.z[z * 2], 2, slicePoints);
+
+		ranges.clear();
+		lights.spotBVH.query(&planes.z[z * 2], 2, ranges);
+		gatherCones(lights.spots, ranges, candidateSpots);
+		filterCones(candidateSpots, &planes.z[z * 2], 2, sliceSpots);
+	} else {
+		filterSpheres(lights.points, &planes.z[z * 2], 2, slicePoints);
+		filterCones(lights.spots, &planes.z[z * 2], 2, sliceSpots);
+	}
+
+	for (uint32_t y = 0; y < CLUSTER_Y; ++y) {
+		filterSpheres(slicePoints, &planes.y[y * 2], 2, rowPoints);
+		filterCones(sliceSpots, &planes.y[y * 2], 2, rowSpots);
+
+		// Column planes fan out from the camera, so the columns a light touches in a row are contiguous:
+		// bin every light into its column range instead of testing it against each column
+		uint32_t rowIndex = z * CLUSTER_Y * CLUSTER_X + y * CLUSTER_X;
+		uint32_t* rowLists = lightLists + (size_t)rowIndex * MAX_LIST_LENGTH;
+		uint32_t pointLightCount[CLUSTER_X] = {};
+		uint32_t spotLightCount[CLUSTER_X] = {};
+
+		for (uint32_t i = 0; i < rowPoints.count; ++i) {
+			glm::vec4 sphere = glm::vec4(rowPoints.x[i], rowPoints.y[i], rowPoints.z[i], rowPoints.radius[i]);
+			float distance = glm::dot(glm::vec3(sphere) - planes.eye, planes.forward);
+			int side = distance > sphere.w ? 1 : (distance < -sphere.w ? -1 : 0);
+			binColumns(planes.x, side,
+				[&](const glm::vec4& plane) { return sphereOutsidePlane(sphere, plane); },
+				[&](uint32_t x) {
+					if (pointLightCount[x] < MAX_LIST_LENGTH) {
+						rowLists[x * MAX_LIST_LENGTH + pointLightCount[x]++] = rowPoints.index[i];
+					}
+				});
+		}
+		for (uint32_t i = 0; i < rowSpots.count; ++i) {
+			glm::vec3 tip = glm::vec3(rowSpots.x[i], rowSpots.y[i], rowSpots.z[i]);
+			glm::vec3 dir = glm::vec3(rowSpots.dirX[i], rowSpots.dirY[i], rowSpots.dirZ[i]);
+			float height = rowSpots.height[i];
+			float baseRadius = rowSpots.baseRadius[i];
+			float baseOffset = baseRadius * glm::sqrt(glm::max(1.0f - glm::dot(dir, planes.forward) * glm::dot(dir, planes.forward), 0.0f));
+			float tipDistance = glm::dot(tip - planes.eye, planes.forward);
+			float baseDistance = glm::dot(tip + dir * height - planes.eye, planes.forward);
+			int side = 0;
+			if (tipDistance > 0.0f && baseDistance - baseOffset > 0.0f) {
+				side = 1;
+			} else if (tipDistance < 0.0f && baseDistance + baseOffset < 0.0f) {
+				side = -1;
+			}
+			binColumns(planes.x, side,
+				[&](const glm::vec4& plane) { return coneOutsidePlane(tip, height, dir, baseRadius, plane); },
+				[&](uint32_t x) {
+					uint32_t offset = pointLightCount[x] + spotLightCount[x];
+					if (offset < MAX_LIST_LENGTH) {
+						rowLists[x * MAX_LIST_LENGTH + offset] = rowSpots.index[i];
+						spotLightCount[x]++;
+					}
+				});
+		}
+
+		for (uint32_t x = 0; x < CLUSTER_X; ++x) {
+			clusterData[rowIndex + x] = static_cast<uint16_t>((pointLightCount[x] << 8) + spotLightCount[x]);
+			listLengths[rowIndex + x] = static_cast<uint16_t>(pointLightCount[x] + spotLightCount[x]);
+		}
+	}
+}
+
+void LightSystem::createCpuCullingResources()
+{
+	if (m_cpuCullingStaging.buffer != VK_NULL_HANDLE)
+		return;
+
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&m_cpuCullingStaging,
+		CLUSTER_SIZE * MAX_LIST_LENGTH * sizeof(uint32_t) + CLUSTER_SIZE * sizeof(uint16_t)));
+	VK_CHECK_RESULT(m_cpuCullingStaging.map());
+
+	m_cpuUploadCommandBuffer = m_vkDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+
+	m_cpuListLengths.resize(CLUSTER_SIZE, 0);
+}
+
+float LightSystem::cullLightsCPU(const CpuLights& lights, bool useBVH)
+{
+	createCpuCullingResources();
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	ClusterPlanes planes;
+	calculateFrustumCPU(planes);
+
+	const VkDeviceSize listsSize = CLUSTER_SIZE * MAX_LIST_LENGTH * sizeof(uint32_t);
+	uint32_t* lightLists = static_cast<uint32_t*>(m_cpuCullingStaging.mapped);
+	uint16_t* clusterData = reinterpret_cast<uint16_t*>(static_cast<uint8_t*>(m_cpuCullingStaging.mapped) + listsSize);
+	uint16_t* listLengths = m_cpuListLengths.data();
+
+	// Z slices are independent, spread them over the shared pool
+	vks::ThreadPool::shared().parallelFor(CLUSTER_Z, [&](uint32_t z) {
+		cullSliceCPU(lights, useBVH, z, planes, lightLists, clusterData, listLengths);
+	});
+
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<float, std::milli>(tEnd - tStart).count();
+}
+
+void LightSystem::updateLightCullingCPU()
+{
+	m_cpuCullingTime = cullLightsCPU(m_cpuLights, m_useLightBVH);
+
+	const VkDeviceSize listsSize = CLUSTER_SIZE * MAX_LIST_LENGTH * sizeof(uint32_t);
+	const uint16_t* listLengths = m_cpuListLengths.data();
+
+	// Upload only the used part of every list, the lighting pass reads no further than the counts in the cluster data
+	std::vector<VkBufferCopy> regions;
+	for (uint32_t i = 0; i < CLUSTER_SIZE; ++i) {
+		if (listLengths[i] > 0) {
+			VkDeviceSize offset = (VkDeviceSize)i * MAX_LIST_LENGTH * sizeof(uint32_t);
+			regions.push_back({ offset, offset, listLengths[i] * sizeof(uint32_t) });
+		}
+	}
+
+	// Recorded here and submitted ahead of the next lighting pass by submitCpuCullingUpload, nothing waits for the GPU.
+	// The staging buffer is only rewritten between frames, submitFrame has waited for the queue by then
+	VkCommandBuffer cb = m_cpuUploadCommandBuffer;
+	VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+	VK_CHECK_RESULT(vkBeginCommandBuffer(cb, &beginInfo));
+
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	if (!regions.empty()) {
+		vkCmdCopyBuffer(cb, m_cpuCullingStaging.buffer, m_lightListBuffer.buffer, static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	VkBufferImageCopy imageCopy{};
+	imageCopy.bufferOffset = listsSize;
+	imageCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	imageCopy.imageExtent = { CLUSTER_X, CLUSTER_Y, CLUSTER_Z };
+	vkCmdCopyBufferToImage(cb, m_cpuCullingStaging.buffer, m_clusterDataImage.image, VK_IMAGE_LAYOUT_GENERAL, 1, &imageCopy);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(cb));
+	m_cpuUploadPending = true;
+}
+
+void LightSystem::submitCpuCullingUpload(std::vector<VkCommandBuffer>& commandBuffers)
+{
+	if (!m_cpuCulling || !m_cpuUploadPending)
+		return;
+
+	// The barriers in the upload also order the lighting command buffer that follows it in the same submit
+	commandBuffers.insert(commandBuffers.begin(), m_cpuUploadCommandBuffer);
+	m_cpuUploadPending = false;
+}
+
+void LightSystem::benchmarkCpuCulling(std::ostream& os)
+{
+	// Street light like distribution: a 2km x 2km area, 40m high
+	const glm::vec3 extent = glm::vec3(2000.0f, 40.0f, 2000.0f);
+	const glm::vec3 origin = m_lightPosition - glm::vec3(extent.x * 0.5f, 0.0f, extent.z * 0.5f);
+
+	std::ios::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+
+	os << "cpu light culling (" << CLUSTER_X << "x" << CLUSTER_Y << "x" << CLUSTER_Z << " clusters)" << "\n";
+	os << std::setw(8) << "lights" << std::setw(12) << "linear ms" << std::setw(12) << "bvh ms" << std::setw(14) << "lights/cluster" << "\n";
+	os << std::fixed << std::setprecision(2);
+
+	std::vector<PointLight> pointLights;
+	std::vector<SpotLight> spotLights;
+	CpuLights lights;
+	for (uint32_t lightCount = 256; lightCount <= 65536; lightCount *= 4) {
+		generateLights(origin, extent, lightCount, pointLights, spotLights);
+		buildCpuLights(pointLights, spotLights, lights);
+
+		float linearTime = cullLightsCPU(lights, false);
+		float bvhTime = cullLightsCPU(lights, true);
+
+		uint64_t assigned = 0;
+		for (uint16_t length : m_cpuListLengths) {
+			assigned += length;
+		}
+
+		os << std::setw(8) << lightCount << std::setw(12) << linearTime << std::setw(12) << bvhTime
+			<< std::setw(14) << (double)assigned / CLUSTER_SIZE << "\n";
+	}
+
+	os.flags(flags);
+	os.precision(precision);
+
+	// Restore the results of the scene lights
+	if (m_cpuCulling) {
+		updateLightCullingCPU();
+	}
+}
+
+uint32_t LightSystem::compareWithGpu()
+{
+	const VkDeviceSize listsSize = CLUSTER_SIZE * MAX_LIST_LENGTH * sizeof(uint32_t);
+
+	vks::Buffer readback;
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&readback,
+		listsSize + CLUSTER_SIZE * sizeof(uint16_t)));
+	VK_CHECK_RESULT(readback.map());
+
+	// The readback runs on the graphics queue
+	const bool computeOwned = m_computeOwned;
+	setQueueOwner(false);
+
+	VkCommandBuffer cb = m_vkDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+	calculateFrustum(cb);
+
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	doLightCulling(cb);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy bufferCopy = { 0, 0, listsSize };
+	vkCmdCopyBuffer(cb, m_lightListBuffer.buffer, readback.buffer, 1, &bufferCopy);
+
+	VkBufferImageCopy imageCopy{};
+	imageCopy.bufferOffset = listsSize;
+	imageCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	imageCopy.imageExtent = { CLUSTER_X, CLUSTER_Y, CLUSTER_Z };
+	vkCmdCopyImageToBuffer(cb, m_clusterDataImage.image, VK_IMAGE_LAYOUT_GENERAL, readback.buffer, 1, &imageCopy);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	m_vkDevice->flushCommandBuffer(cb, m_example->queue, true);
+
+	// Run the CPU path for the same camera, its results are uploaded again with the next frame
+	updateLightCullingCPU();
+
+	const uint32_t* gpuLists = static_cast<const uint32_t*>(readback.mapped);
+	const uint16_t* gpuData = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(readback.mapped) + listsSize);
+	const uint32_t* cpuLists = static_cast<const uint32_t*>(m_cpuCullingStaging.mapped);
+	const uint16_t* cpuData = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(m_cpuCullingStaging.mapped) + listsSize);
+
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < CLUSTER_SIZE; ++i) {
+		size_t offset = (size_t)i * MAX_LIST_LENGTH;
+		if (gpuData[i] != cpuData[i] || memcmp(gpuLists + offset, cpuLists + offset, m_cpuListLengths[i] * sizeof(uint32_t)) != 0) {
+			mismatches++;
+		}
+	}
+
+	readback.destroy();
+
+	setQueueOwner(computeOwned);
+
+	return mismatches;
 }
@@ -4,12 +4,17 @@
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
 class LightSystem {
 	static constexpr uint32_t CLUSTER_X = 36;
 	static constexpr uint32_t CLUSTER_Y = 20;
 	static constexpr uint32_t CLUSTER_Z = 64;
 	static constexpr uint32_t CLUSTER_SIZE = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
 	static constexpr uint32_t MAX_LIST_LENGTH = 256;
+	// Depth range of the Z slices, must match frustumZ.comp
+	static constexpr float CLUSTER_NEAR = 0.1f;
+	static constexpr float CLUSTER_FAR = 1500.0f;
 public:
 	struct PointLight {
 		glm::vec4 positionRange;
@@ -28,7 +33,36 @@ public:
 	void destroy();
 
 	void updateCamera();
+
+	// Async compute: with a dedicated compute queue family the culling is submitted to the compute queue and overlaps
+	// the graphics work before the lighting pass, the light lists change queue family ownership twice per frame
+	bool asyncComputeSupported() const;
+	void setAsyncCompute(bool enabled);
+	bool asyncCulling() const { return m_asyncCompute && !m_cpuCulling; }
+	// Graphics side of the GPU culling before the lighting pass: the dispatches, or with async compute the acquire of the light lists
+	void recordCulling(VkCommandBuffer cb);
+	// After the lighting pass, with async compute releases the light lists to the compute queue for the next frame
+	void recordLightingDone(VkCommandBuffer cb);
+	// Submits the async culling, adds the semaphores the graphics submit of the lighting pass has to wait on and signal
+	void submitAsyncCulling(std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages, std::vector<VkSemaphore>& signalSemaphores);
+	// Compute queue timestamps of the last async culling in microseconds after frameBeginTicks (a graphics queue timestamp)
+	bool asyncCullingTime(uint64_t frameBeginTicks, float& beginUs, float& endUs) const;
+
+	// CPU light assignment, fills m_lightListBuffer and the cluster data image with the same layout as lightCulling.comp
+	void setCpuCulling(bool enabled);
+	bool cpuCulling() const { return m_cpuCulling; }
+	// Puts the upload of the last CPU culling results in front of the lighting command buffer, if there is a new one
+	void submitCpuCullingUpload(std::vector<VkCommandBuffer>& commandBuffers);
+	float cpuCullingTime() const { return m_cpuCullingTime; }
+	// Runs the compute path for the current camera and returns the number of clusters whose light list differs from the CPU path
+	uint32_t compareWithGpu();
+	// Times the CPU path with and without the light BVH for 256 to 65536 lights spread over a city sized area
+	void benchmarkCpuCulling(std::ostream& os);
+
+	bool m_useLightBVH = true;
 private:
+	// Lights are sorted by the Morton code of their position, so lights close in space get close indices
+	static void generateLights(glm::vec3 position, glm::vec3 extent, uint32_t lightCount, std::vector<PointLight>& pointLights, std::vector<SpotLight>& spotLights);
 	void initLights(glm::vec3 position, float range, uint32_t lightCount);
 	void createResources();
 
@@ -37,6 +71,73 @@ private:
 	void preparePipeline();
 	void prepareDescriptorPool();
 	void prepareDescriptorSet();
+
+	void dispatchLightCulling(VkCommandBuffer cb);
+	// Barrier on the cluster data image and the light lists, different queue families make it an ownership release or acquire
+	void lightListBarrier(VkCommandBuffer cb, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily);
+	void initAsyncCompute();
+	void recordAsyncCulling();
+	// Moves the light lists between the graphics and the compute queue family outside of the frame loop
+	void setQueueOwner(bool compute);
+
+	// Lights of the CPU path in SoA layout (padded to a multiple of 4) so they can be tested 4 at a time
+	struct SphereSet {
+		std::vector<float> x, y, z, radius;
+		std::vector<uint32_t> index;
+		uint32_t count = 0;
+		void resize(uint32_t size);
+	};
+	struct ConeSet {
+		std::vector<float> x, y, z, dirX, dirY, dirZ, height, baseRadius;
+		std::vector<uint32_t> index;
+		uint32_t count = 0;
+		void resize(uint32_t size);
+	};
+	static void filterSpheres(const SphereSet& in, const glm::vec4* planes, uint32_t planeCount, SphereSet& out);
+	static void filterCones(const ConeSet& in, const glm::vec4* planes, uint32_t planeCount, ConeSet& out);
+
+	// BVH over the Morton ordered lights, every node covers a contiguous range of light indices
+	struct LightBVH {
+		static constexpr uint32_t LEAF_SIZE = 8;
+		struct Node {
+			glm::vec3 center;
+			uint32_t begin;
+			glm::vec3 extent;
+			uint32_t end;
+			uint32_t right; // left child is the next node, 0 for leaves
+		};
+		std::vector<Node> nodes;
+
+		void build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+		// Appends the index ranges of the nodes that are not fully outside of the planes, in ascending order
+		void query(const glm::vec4* planes, uint32_t planeCount, std::vector<glm::uvec2>& ranges) const;
+	private:
+		uint32_t buildNode(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax, uint32_t begin, uint32_t end);
+	};
+	static void gatherSpheres(const SphereSet& in, const std::vector<glm::uvec2>& ranges, SphereSet& out);
+	static void gatherCones(const ConeSet& in, const std::vector<glm::uvec2>& ranges, ConeSet& out);
+
+	struct CpuLights {
+		SphereSet points;
+		ConeSet spots;
+		LightBVH pointBVH;
+		LightBVH spotBVH;
+	};
+	static void buildCpuLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights, CpuLights& lights);
+
+	struct ClusterPlanes {
+		std::vector<glm::vec4> x; // 2 per column, plane 2 / 3 of frustumXY.comp
+		std::vector<glm::vec4> y; // 2 per row, plane 0 / 1 of frustumXY.comp
+		std::vector<glm::vec4> z; // 2 per slice, frustumZ.comp
+		glm::vec3 eye;
+		glm::vec3 forward;
+	};
+	void calculateFrustumCPU(ClusterPlanes& planes) const;
+	void cullSliceCPU(const CpuLights& lights, bool useBVH, uint32_t z, const ClusterPlanes& planes, uint32_t* lightLists, uint16_t* clusterData, uint16_t* listLengths) const;
+	void createCpuCullingResources();
+	// Fills the staging buffer, returns the time spent in milliseconds
+	float cullLightsCPU(const CpuLights& lights, bool useBVH);
+	void updateLightCullingCPU();
 public:
 	VkDescriptorSetLayout m_dsLayout;
 	VkDescriptorSet m_descriptorSet;
@@ -78,6 +179,33 @@ private:
 
 	std::vector<PointLight> m_pointLights;
 	std::vector<SpotLight> m_spotLights;
+
+	// CPU culling: light lists followed by the cluster data, uploaded to m_lightListBuffer / m_clusterDataImage
+	bool m_cpuCulling = false;
+	float m_cpuCullingTime = 0.0f;
+	CpuLights m_cpuLights;
+	glm::vec3 m_lightPosition;
+	vks::Buffer m_cpuCullingStaging;
+	// Copies of the staging buffer, recorded by updateLightCullingCPU and submitted with the next frame
+	VkCommandBuffer m_cpuUploadCommandBuffer = VK_NULL_HANDLE;
+	bool m_cpuUploadPending = false;
+	std::vector<uint16_t> m_cpuListLengths;
+
+	// Async compute, the light and camera buffers are written by the host and shared concurrently by the graphics and compute queue families
+	bool m_asyncCompute = false;
+	// The light lists are released to (or owned by) the compute queue family between frames
+	bool m_computeOwned = false;
+	// m_listsReleased was signaled by the last graphics submit and not waited on yet
+	bool m_releaseSignaled = false;
+	VkQueue m_computeQueue = VK_NULL_HANDLE;
+	VkCommandPool m_computeCommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer m_computeCommandBuffer = VK_NULL_HANDLE;
+	VkSemaphore m_cullingComplete = VK_NULL_HANDLE;
+	VkSemaphore m_listsReleased = VK_NULL_HANDLE;
+	VkQueryPool m_computeTimestamps = VK_NULL_HANDLE;
+	// The queries are reset inside the async culling commands, so they can only be read after its first submit
+	bool m_computeTimestampsWritten = false;
+
 	struct {
 		glm::mat4 viewProjInv;
 		glm::mat4 viewInv;
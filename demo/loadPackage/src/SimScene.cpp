@@ -1,5 +1,123 @@
 #include "SimScene.h"
 
+#include "ImageProcessing.h"
+#include "PixelConversion.h"
+#include "frustum.hpp"
+
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+	// FNV-1a
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	glm::vec3 toVec3(const SVec3& v)
+	{
+		return glm::vec3(v.x, v.y, v.z);
+	}
+
+	// Largest scale of the linear part, for bounding spheres
+	float maxScale(const glm::mat4& m)
+	{
+		return std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+	}
+
+	/*
+		Frame of the first usable triangle: origin at its first corner, x along its first edge, z along its normal,
+		scaled by the length of the first edge. Moved, rotated and uniformly scaled copies of a geometry have the same
+		positions in their frame, and frame(copy) * inverse(frame(original)) maps the original onto the copy.
+	*/
+	glm::mat4 canonicalFrame(const SGeodata& g)
+	{
+		for (size_t i = 0; i + 2 < g.indices.size(); i += 3) {
+			const glm::vec3 p0 = toVec3(g.vt[g.indices[i]]);
+			const glm::vec3 e1 = toVec3(g.vt[g.indices[i + 1]]) - p0;
+			const glm::vec3 e2 = toVec3(g.vt[g.indices[i + 2]]) - p0;
+			const glm::vec3 normal = glm::cross(e1, e2);
+			const float length = glm::length(e1);
+			// Slivers give unstable axes
+			if (length < 1e-6f || glm::length(normal) < 1e-3f * length * glm::length(e2))
+				continue;
+			const glm::vec3 x = e1 / length;
+			const glm::vec3 z = glm::normalize(normal);
+			const glm::vec3 y = glm::cross(z, x);
+			return glm::mat4(glm::vec4(x * length, 0.0f), glm::vec4(y * length, 0.0f), glm::vec4(z * length, 0.0f), glm::vec4(p0, 1.0f));
+		}
+		// Only translated copies are found without a usable triangle
+		return glm::translate(glm::mat4(1.0f), toVec3(g.vt[0]));
+	}
+
+	// Everything a copy has to match, positions and normals in the canonical frame on a grid so copies hash equally
+	uint64_t geometryHash(const SGeodata& g, const glm::mat4& frame)
+	{
+		const float gridSize = 1.0f / 256.0f;
+		uint64_t hash = 14695981039346656037ull;
+		const uint32_t vertexCount = static_cast<uint32_t>(g.vt.size());
+		hash = hashBytes(hash, &vertexCount, sizeof(vertexCount));
+		hash = hashBytes(hash, g.indices.data(), g.indices.size() * sizeof(uint32_t));
+		for (uint32_t channel = 0; channel < 4; ++channel) {
+			hash = hashBytes(hash, g.tx[channel].data(), g.tx[channel].size() * sizeof(SVec3));
+		}
+		hash = hashBytes(hash, g.color.data(), g.color.size() * sizeof(SVec4));
+		for (const auto& mode : g.ss.mode) {
+			hash = hashBytes(hash, &mode.first, sizeof(mode.first));
+			hash = hashBytes(hash, &mode.second, sizeof(mode.second));
+		}
+		auto hashCell = [&](const glm::vec3& v) {
+			const int32_t cell[3] = {
+				static_cast<int32_t>(floorf(v.x / gridSize + 0.5f)),
+				static_cast<int32_t>(floorf(v.y / gridSize + 0.5f)),
+				static_cast<int32_t>(floorf(v.z / gridSize + 0.5f))
+			};
+			hash = hashBytes(hash, cell, sizeof(cell));
+		};
+		const glm::mat4 toFrame = glm::inverse(frame);
+		const glm::mat3 rotation = glm::mat3(toFrame) * maxScale(frame);
+		for (const SVec3& v : g.vt) {
+			hashCell(glm::vec3(toFrame * glm::vec4(toVec3(v), 1.0f)));
+		}
+		for (const SVec3& n : g.nm) {
+			hashCell(rotation * toVec3(n));
+		}
+		return hash;
+	}
+
+	// Same indices, texture coordinates, colors and material, transform maps positions and normals of a onto b
+	bool isTransformedCopy(const SGeodata& a, const SGeodata& b, const glm::mat4& transform, float positionTolerance, float normalTolerance)
+	{
+		if (a.vt.size() != b.vt.size() || a.nm.size() != b.nm.size() || a.indices.size() != b.indices.size() || a.color.size() != b.color.size())
+			return false;
+		if (memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(uint32_t)) != 0 || memcmp(a.color.data(), b.color.data(), a.color.size() * sizeof(SVec4)) != 0)
+			return false;
+		for (uint32_t channel = 0; channel < 4; ++channel) {
+			if (a.tx[channel].size() != b.tx[channel].size() || memcmp(a.tx[channel].data(), b.tx[channel].data(), a.tx[channel].size() * sizeof(SVec3)) != 0)
+				return false;
+		}
+		if (a.ss.mode != b.ss.mode)
+			return false;
+		for (size_t i = 0; i < a.vt.size(); ++i) {
+			if (glm::length(glm::vec3(transform * glm::vec4(toVec3(a.vt[i]), 1.0f)) - toVec3(b.vt[i])) > positionTolerance)
+				return false;
+		}
+		const glm::mat3 rotation = glm::mat3(transform) / maxScale(transform);
+		for (size_t i = 0; i < a.nm.size(); ++i) {
+			if (glm::length(rotation * toVec3(a.nm[i]) - toVec3(b.nm[i])) > normalTolerance)
+				return false;
+		}
+		return true;
+	}
+}
+
 SimScene::SimScene()
 {
 
@@ -10,10 +128,13 @@ void SimScene::init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, con
 	m_vkDevice = vkDevice;
 	m_example = example;
 
+	m_streamer.init(vkDevice, example->queue, textureImport.streaming);
 	loadFromFile(filename);
+	if (gpuDriven()) {
+		m_drawCulling.init(vkDevice, example, indirectDraws);
+	}
 
-	prepareDescriptorSetLayout();
-	prepareDescriptor();
+	prepareTextureTable();
 }
 
 void SimScene::loadFromFile(const std::string& filename)
@@ -23,50 +144,191 @@ void SimScene::loadFromFile(const std::string& filename)
 	SDataOperation inputData;
 	archive(inputData);
 
-	textures.reserve(inputData.m_images.size());
-	for (const SImage& img : inputData.m_images) {
-		vks::Texture2D tex;
-		VkFormat format;
-		if (img.pixelFormat == 0x83F0/* GL_COMPRESSED_RGB_S3TC_DXT1_EXT */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
-			format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
-			tex.fromBuffer((void*)img.imageData.data(), img.imageData.size(), format, img.s, img.t, m_vkDevice, m_example->queue);
-		}
-		else if (img.pixelFormat == 0x83F3/* GL_COMPRESSED_RGBA_S3TC_DXT5_EXT */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
-			format = VK_FORMAT_BC3_UNORM_BLOCK;
-			tex.fromBuffer((void*)img.imageData.data(), img.imageData.size(), format, img.s, img.t, m_vkDevice, m_example->queue);
-		}
-		else if (img.pixelFormat == 0x1907/* GL_RGB */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
-			format = VK_FORMAT_R8G8B8A8_UNORM;
-
-			std::vector<uint8_t> temp(img.s * img.t * 4);
-			for (int i = 0; i < img.t; ++i) {
-				memcpy(temp.data() + i * img.s * 4, img.imageData.data() + i * img.s * 3, img.s * 3);
-				memset(temp.data() + i * img.s * 4 + img.s * 3, 255u, img.s);
+	// Images sampled only inside [0, 1] can share atlas pages, repeating ones keep their own image
+	const float uvEpsilon = 1e-3f;
+	std::vector<bool> repeats(inputData.m_images.size(), false);
+	for (const SGeodata& g : inputData.geo) {
+		for (uint32_t channel = 0; channel < 4; ++channel) {
+			for (const SVec3& uv : g.tx[channel]) {
+				uint32_t image = static_cast<uint32_t>(uv.z);
+				if (image < repeats.size() && (uv.x < -uvEpsilon || uv.x > 1.0f + uvEpsilon || uv.y < -uvEpsilon || uv.y > 1.0f + uvEpsilon)) {
+					repeats[image] = true;
+				}
+			}
+		}
+	}
+
+	// Images of the same size and format become the layers of array textures, pre-compressed ones also need the same data size
+	const uint32_t maxLayers = std::min(std::min(textureImport.arrays.maxLayers, m_vkDevice->properties.limits.maxImageArrayLayers), 1u << (24 - textureLayerShift));
+	std::vector<std::vector<uint32_t>> arrays;
+	std::vector<bool> arrayed(inputData.m_images.size(), false);
+	if (textureImport.arrays.enabled && maxLayers > 1) {
+		std::map<std::tuple<uint32_t, uint32_t, uint32_t, size_t>, std::vector<uint32_t>> groups;
+		for (uint32_t i = 0; i < inputData.m_images.size(); ++i) {
+			const SImage& img = inputData.m_images[i];
+			bool hasAlpha;
+			if (rgba8Writer(img, hasAlpha)) {
+				groups[std::make_tuple(hasAlpha ? 1u : 0u, img.s, img.t, size_t(0))].push_back(i);
+			}
+			else if (compressedFormat(img) != VK_FORMAT_UNDEFINED) {
+				groups[std::make_tuple(static_cast<uint32_t>(compressedFormat(img)), img.s, img.t, img.imageData.size())].push_back(i);
 			}
-			tex.fromBuffer((void*)temp.data(), temp.size(), format, img.s, img.t, m_vkDevice, m_example->queue);
+		}
+		for (auto& group : groups) {
+			// A single image left over keeps its own texture or goes to the atlas
+			for (size_t first = 0; first + 1 < group.second.size(); first += maxLayers) {
+				const size_t count = std::min<size_t>(maxLayers, group.second.size() - first);
+				arrays.push_back(std::vector<uint32_t>(group.second.begin() + first, group.second.begin() + first + count));
+				for (uint32_t image : arrays.back()) {
+					arrayed[image] = true;
+				}
+			}
+		}
+	}
 
-			/*		
-			VkImageFormatProperties prop;
-			vkGetPhysicalDeviceImageFormatProperties(m_vkDevice->physicalDevice, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, &prop);
-			*/
+	TextureAtlas atlas(textureImport.atlas);
+	for (uint32_t i = 0; i < inputData.m_images.size(); ++i) {
+		const SImage& img = inputData.m_images[i];
+		bool hasAlpha;
+		if (!repeats[i] && !arrayed[i] && rgba8Writer(img, hasAlpha)) {
+			atlas.add(i, img.s, img.t);
 		}
-		else if (img.pixelFormat == 0x1908/* GL_RGBA */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
-			format = VK_FORMAT_R8G8B8A8_UNORM;
-			tex.fromBuffer((void*)img.imageData.data(), img.imageData.size(), format, img.s, img.t, m_vkDevice, m_example->queue);
+	}
+	atlas.pack();
+
+	imageTextures.resize(inputData.m_images.size());
+	for (const std::vector<uint32_t>& images : arrays) {
+		const SImage& first = inputData.m_images[images[0]];
+		const uint32_t texture = m_streamer.textureCount();
+		const uint32_t layerCount = static_cast<uint32_t>(images.size());
+		const VkFormat format = compressedFormat(first);
+		if (format != VK_FORMAT_UNDEFINED) {
+			std::vector<uint8_t> data;
+			std::vector<VkDeviceSize> offsets;
+			data.reserve(first.imageData.size() * layerCount);
+			for (uint32_t image : images) {
+				offsets.push_back(data.size());
+				data.insert(data.end(), inputData.m_images[image].imageData.begin(), inputData.m_images[image].imageData.end());
+			}
+			vks::Texture2DArray tex{};
+			tex.fromMipLevels(data.data(), data.size(), offsets, layerCount, format, first.s, first.t, m_vkDevice, m_example->queue);
+			m_streamer.addStatic(tex, data.size());
 		}
 		else {
-			format = VK_FORMAT_R8G8B8A8_UNORM;
+			bool hasAlpha = false;
+			std::vector<std::function<void(uint8_t* rgba)>> writers;
+			for (uint32_t image : images) {
+				writers.push_back(rgba8Writer(inputData.m_images[image], hasAlpha));
+			}
+			addRGBA8(first.s, first.t, hasAlpha, writers);
+		}
+		for (uint32_t layer = 0; layer < layerCount; ++layer) {
+			imageTextures[images[layer]] = { texture, layer, glm::vec2(0.0f), glm::vec2(1.0f) };
 		}
-		
-		textures.push_back(tex);
+		m_arrayCount++;
+		m_arrayImageCount += layerCount;
 	}
 
+	std::vector<uint8_t> rgba;
+	for (uint32_t i = 0; i < inputData.m_images.size(); ++i) {
+		if (arrayed[i])
+			continue;
+
+		const SImage& img = inputData.m_images[i];
+		ImageTexture& imageTexture = imageTextures[i];
+		imageTexture.texture = m_streamer.textureCount();
+		imageTexture.layer = 0;
+		imageTexture.offset = glm::vec2(0.0f);
+		imageTexture.scale = glm::vec2(1.0f);
+
+		bool hasAlpha;
+		std::function<void(uint8_t* rgba)> writeRGBA = rgba8Writer(img, hasAlpha);
+		const VkFormat format = compressedFormat(img);
+		if (writeRGBA && atlas.contains(i)) {
+			// Page textures are added after all images, the texture index is patched below
+			rgba.resize((size_t)img.s * img.t * 4);
+			writeRGBA(rgba.data());
+			atlas.write(i, rgba.data(), hasAlpha);
+		}
+		else if (writeRGBA) {
+			addRGBA8(img.s, img.t, hasAlpha, { writeRGBA });
+		}
+		else if (format != VK_FORMAT_UNDEFINED) {
+			vks::Texture2DArray tex{};
+			tex.fromMipLevels((void*)img.imageData.data(), img.imageData.size(), { 0 }, 1, format, img.s, img.t, m_vkDevice, m_example->queue);
+			m_streamer.addStatic(tex, img.imageData.size());
+		}
+		else {
+			m_streamer.addStatic(vks::Texture2DArray{}, 0);
+		}
+	}
+	rgba.clear();
+	rgba.shrink_to_fit();
+
+	std::vector<uint32_t> pageTextures;
+	for (TextureAtlas::Page& page : atlas.pages()) {
+		pageTextures.push_back(m_streamer.textureCount());
+		const std::vector<uint8_t>& texels = page.rgba;
+		addRGBA8(page.width, page.height, page.hasAlpha, { [&](uint8_t* dst) { memcpy(dst, texels.data(), texels.size()); } }, atlas.mipLevelCount());
+		// The streamer keeps its own copy
+		std::vector<uint8_t>().swap(page.rgba);
+	}
+	for (uint32_t i = 0; i < imageTextures.size(); ++i) {
+		if (atlas.contains(i)) {
+			const TextureAtlas::Placement& placement = atlas.placement(i);
+			imageTextures[i].texture = pageTextures[placement.page];
+			imageTextures[i].offset = placement.offset;
+			imageTextures[i].scale = placement.scale;
+			m_atlasImageCount++;
+		}
+	}
+	m_atlasPageCount = static_cast<uint32_t>(pageTextures.size());
+
+	// Vertices store the package image index, remapped to the texture, its layer and the area of the image inside it
+	auto textureCoordinate = [&](const SVec3& uv) {
+		uint32_t image = static_cast<uint32_t>(uv.z);
+		if (image >= imageTextures.size())
+			return glm::vec3(uv.x, uv.y, uv.z);
+		const ImageTexture& imageTexture = imageTextures[image];
+		return glm::vec3(imageTexture.offset + glm::vec2(uv.x, uv.y) * imageTexture.scale, static_cast<float>(imageTexture.texture | imageTexture.layer << textureLayerShift));
+	};
+
+	// Candidates for instancing by hash, the index of the geometry, the package geometry it was created from and its canonical frame
+	std::unordered_multimap<uint64_t, uint32_t> geometryHashes;
+	std::vector<uint32_t> geometrySources;
+	std::vector<glm::mat4> geometryFrames;
+
+	std::vector<Geometry::Vertex> sceneVertices;
+	std::vector<uint32_t> sceneIndices;
+
 	geometries.reserve(inputData.geo.size());
-	for (SGeodata& g : inputData.geo)
+	for (uint32_t source = 0; source < inputData.geo.size(); ++source)
 	{
+		SGeodata& g = inputData.geo[source];
 		if (g.vt.empty()) continue;
+		m_packageGeometryCount++;
+
+		uint64_t hash = 0;
+		glm::mat4 frame(1.0f);
+		if (geometryImport.instancing) {
+			// Copies keep no buffers of their own, they only add a placement to the geometry they repeat
+			frame = canonicalFrame(g);
+			hash = geometryHash(g, frame);
+			bool instanced = false;
+			auto candidates = geometryHashes.equal_range(hash);
+			for (auto it = candidates.first; it != candidates.second && !instanced; ++it) {
+				const SGeodata& original = inputData.geo[geometrySources[it->second]];
+				const glm::mat4 placement = frame * glm::inverse(geometryFrames[it->second]);
+				if (isTransformedCopy(original, g, placement, geometryImport.positionTolerance, geometryImport.normalTolerance)) {
+					geometries[it->second].placements.push_back(placement);
+					instanced = true;
+				}
+			}
+			if (instanced) continue;
+		}
 
 		Geometry geometry;
+		geometry.placements.push_back(glm::mat4(1.0f));
 
 		std::vector<Geometry::Vertex> vertices;
 		vertices.reserve(g.vt.size());
@@ -74,90 +336,350 @@ void SimScene::loadFromFile(const std::string& filename)
 			Geometry::Vertex vertex;
 			vertex.pos = glm::vec3(g.vt[i].x, g.vt[i].y, g.vt[i].z);
 			vertex.normal = glm::vec3(g.nm[i].x, g.nm[i].y, g.nm[i].z);
-			vertex.uv0 = glm::vec3(g.tx[0][i].x, g.tx[0][i].y, g.tx[0][i].z);
-			vertex.uv1 = glm::vec3(g.tx[1][i].x, g.tx[1][i].y, g.tx[1][i].z);
-			vertex.uv2 = glm::vec3(g.tx[2][i].x, g.tx[2][i].y, g.tx[2][i].z);
-			vertex.uv3 = glm::vec3(g.tx[3][i].x, g.tx[3][i].y, g.tx[3][i].z);
+			vertex.uv0 = textureCoordinate(g.tx[0][i]);
+			vertex.uv1 = textureCoordinate(g.tx[1][i]);
+			vertex.uv2 = textureCoordinate(g.tx[2][i]);
+			vertex.uv3 = textureCoordinate(g.tx[3][i]);
 			vertices.push_back(vertex);
 		}
 
+		geometry.firstIndex = static_cast<uint32_t>(sceneIndices.size());
 		geometry.indexCount = g.indices.size();
+		geometry.vertexOffset = static_cast<int32_t>(sceneVertices.size());
 
-		VK_CHECK_RESULT(m_vkDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&geometry.vertexBuffer,
-			vertices.size() * sizeof(Geometry::Vertex),
-			vertices.data()));
-		VK_CHECK_RESULT(m_vkDevice->createBuffer(
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&geometry.indexBuffer,
-			g.indices.size() * sizeof(uint32_t),
-			g.indices.data()));
+		glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+		for (const Geometry::Vertex& v : vertices) {
+			minPos = glm::min(minPos, v.pos);
+			maxPos = glm::max(maxPos, v.pos);
+		}
+		geometry.center = (minPos + maxPos) * 0.5f;
+		geometry.radius = glm::length(maxPos - minPos) * 0.5f;
 
+		// Average texture coordinate area per surface area of every texture sampled by the geometry
+		std::map<uint32_t, glm::vec2> areas;
+		for (size_t i = 0; i + 2 < g.indices.size(); i += 3) {
+			const Geometry::Vertex& v0 = vertices[g.indices[i]];
+			const Geometry::Vertex& v1 = vertices[g.indices[i + 1]];
+			const Geometry::Vertex& v2 = vertices[g.indices[i + 2]];
+			float area = glm::length(glm::cross(v1.pos - v0.pos, v2.pos - v0.pos));
+			const glm::vec3 Geometry::Vertex::* channels[] = { &Geometry::Vertex::uv0, &Geometry::Vertex::uv1, &Geometry::Vertex::uv2, &Geometry::Vertex::uv3 };
+			for (auto channel : channels) {
+				glm::vec2 d1 = glm::vec2(v1.*channel - v0.*channel);
+				glm::vec2 d2 = glm::vec2(v2.*channel - v0.*channel);
+				uint32_t texture = static_cast<uint32_t>((v0.*channel).z) & textureIndexMask;
+				areas[texture] += glm::vec2(fabsf(d1.x * d2.y - d1.y * d2.x), area);
+			}
+		}
+		for (auto& a : areas) {
+			if (a.first < m_streamer.textureCount() && a.second.y > 0.0f) {
+				geometry.textureUses.push_back({ a.first, sqrtf(a.second.x / a.second.y) });
+			}
+		}
+
+		// Indices stay relative to the first vertex of the geometry, draws add vertexOffset
+		sceneVertices.insert(sceneVertices.end(), vertices.begin(), vertices.end());
+		sceneIndices.insert(sceneIndices.end(), g.indices.begin(), g.indices.end());
+
+		if (geometryImport.instancing) {
+			geometryHashes.emplace(hash, static_cast<uint32_t>(geometries.size()));
+		}
+		geometrySources.push_back(source);
+		geometryFrames.push_back(frame);
 		geometries.push_back(geometry);
 	}
+
+	if (sceneVertices.empty())
+		return;
+
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&m_vertexBuffer,
+		sceneVertices.size() * sizeof(Geometry::Vertex),
+		sceneVertices.data()));
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&m_indexBuffer,
+		sceneIndices.size() * sizeof(uint32_t),
+		sceneIndices.data()));
 }
 
-void SimScene::draw(VkCommandBuffer cb, VkPipelineLayout pLayout, uint32_t instanceCount)
+void SimScene::setInstances(const glm::mat4& model, const std::vector<glm::vec3>& offsets)
 {
-	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pLayout, 1, 1, &m_descriptorSet, 0, NULL);
+	// Offsets are applied after the model matrix, placements before it in model space
+	std::vector<Instance> instances;
+	for (Geometry& geometry : geometries) {
+		geometry.firstInstance = static_cast<uint32_t>(instances.size());
+		geometry.instanceCount = static_cast<uint32_t>(offsets.size() * geometry.placements.size());
+		for (const glm::vec3& offset : offsets) {
+			const glm::mat4 copy = glm::translate(glm::mat4(1.0f), offset) * model;
+			for (const glm::mat4& placement : geometry.placements) {
+				instances.push_back({ copy * placement });
+			}
+		}
+	}
+	if (m_instanceBuffer.buffer != VK_NULL_HANDLE) {
+		m_instanceBuffer.destroy();
+		m_instanceBuffer = vks::Buffer();
+	}
+	m_instances = instances;
+	if (instances.empty()) {
+		if (gpuDriven()) {
+			m_drawCulling.setDraws({});
+		}
+		return;
+	}
 
-	for (auto& geometry : geometries) {
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(cb, 0, 1, &geometry.vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(cb, geometry.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	vks::Buffer stagingBuffer;
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer,
+		instances.size() * sizeof(Instance),
+		instances.data()));
+	VK_CHECK_RESULT(m_vkDevice->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&m_instanceBuffer,
+		stagingBuffer.size));
+	m_vkDevice->copyBuffer(&stagingBuffer, &m_instanceBuffer, m_example->queue);
+	stagingBuffer.destroy();
 
-		vkCmdDrawIndexed(cb, geometry.indexCount, instanceCount, 0, 0, 0);
+	if (!gpuDriven())
+		return;
+
+	// One record per instance, so the culling works on the bounds of every copy of every geometry
+	std::vector<IndirectDrawCulling::DrawRecord> records;
+	records.reserve(instances.size());
+	for (const Geometry& geometry : geometries) {
+		for (uint32_t i = 0; i < geometry.instanceCount; ++i) {
+			const glm::mat4& transform = instances[geometry.firstInstance + i].transform;
+			IndirectDrawCulling::DrawRecord record;
+			record.sphere = glm::vec4(glm::vec3(transform * glm::vec4(geometry.center, 1.0f)), geometry.radius * maxScale(transform));
+			record.indexCount = geometry.indexCount;
+			record.firstIndex = geometry.firstIndex;
+			record.vertexOffset = geometry.vertexOffset;
+			record.firstInstance = geometry.firstInstance + i;
+			records.push_back(record);
+		}
 	}
+	m_drawCulling.setDraws(records);
 }
 
-void SimScene::destroy()
+void SimScene::updateCulling(const glm::mat4& view, const glm::mat4& projection)
 {
-	for (auto& texture : textures) {
-		texture.destroy();
+	if (gpuDriven()) {
+		m_drawCulling.updateFrustum(projection * view);
 	}
-	for (auto& geometry : geometries) {
-		geometry.vertexBuffer.destroy();
-		geometry.indexBuffer.destroy();
+}
+
+void SimScene::cull(VkCommandBuffer cb)
+{
+	if (gpuDriven()) {
+		m_drawCulling.cull(cb);
 	}
-	vkDestroyDescriptorPool(m_vkDevice->logicalDevice, m_descriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(m_vkDevice->logicalDevice, m_dsLayout, nullptr);
 }
 
-void SimScene::prepareDescriptorSetLayout()
+// Returns a function converting an uncompressed package image to RGBA8, empty for other formats
+std::function<void(uint8_t* rgba)> SimScene::rgba8Writer(const SImage& img, bool& hasAlpha)
 {
-	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, textures.size())
-	};
-	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vkDevice->logicalDevice, &descriptorLayout, nullptr, &m_dsLayout));
+	const size_t pixelCount = (size_t)img.s * img.t;
+	const uint8_t* src8 = img.imageData.data();
+	const uint16_t* src16 = reinterpret_cast<const uint16_t*>(img.imageData.data());
+	hasAlpha = false;
+	if (img.pixelFormat == 0x1907/* GL_RGB */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
+		// Three channel formats are rarely supported for optimal tiling, expand to RGBA
+		return [=](uint8_t* rgba) { vks::pixel::rgb8ToRgba8(src8, rgba, pixelCount); };
+	}
+	if (img.pixelFormat == 0x80E0/* GL_BGR */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
+		return [=](uint8_t* rgba) { vks::pixel::bgr8ToRgba8(src8, rgba, pixelCount); };
+	}
+	if (img.pixelFormat == 0x1907/* GL_RGB */ && img.type == 0x1403/* GL_UNSIGNED_SHORT */) {
+		return [=](uint8_t* rgba) { vks::pixel::rgb16ToRgba8(src16, rgba, pixelCount); };
+	}
+	hasAlpha = true;
+	if (img.pixelFormat == 0x80E1/* GL_BGRA */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
+		return [=](uint8_t* rgba) { vks::pixel::swizzleRB(src8, rgba, pixelCount); };
+	}
+	if (img.pixelFormat == 0x1908/* GL_RGBA */ && img.type == 0x1403/* GL_UNSIGNED_SHORT */) {
+		return [=](uint8_t* rgba) { vks::pixel::unorm16ToUnorm8(src16, rgba, pixelCount * 4); };
+	}
+	if (img.pixelFormat == 0x1908/* GL_RGBA */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
+		return [=](uint8_t* rgba) { memcpy(rgba, src8, pixelCount * 4); };
+	}
+	hasAlpha = false;
+	return nullptr;
 }
 
-void SimScene::prepareDescriptor()
+VkFormat SimScene::compressedFormat(const SImage& img)
 {
-	// Descriptor Pool
-	//
-	std::vector<VkDescriptorPoolSize> typeCounts = {
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.size())
+	if (img.pixelFormat == 0x83F0/* GL_COMPRESSED_RGB_S3TC_DXT1_EXT */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
+		return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+	if (img.pixelFormat == 0x83F3/* GL_COMPRESSED_RGBA_S3TC_DXT5_EXT */ && img.type == 0x1401/* GL_UNSIGNED_BYTE */) {
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+// Uncompressed images are converted to RGBA8 by the layer writers, then mipmapped, block compressed and streamed as configured in textureImport
+void SimScene::addRGBA8(uint32_t width, uint32_t height, bool hasAlpha, const std::vector<std::function<void(uint8_t* rgba)>>& layers, uint32_t maxMipLevels)
+{
+	const VkDeviceSize size = (VkDeviceSize)width * height * 4;
+	const uint32_t layerCount = static_cast<uint32_t>(layers.size());
+	if (!textureImport.generateMipmaps && !textureImport.compress && !textureImport.streaming.enabled) {
+		vks::Texture2DArray tex;
+		tex.fromStagingWriter([&](void* data) {
+			for (uint32_t layer = 0; layer < layerCount; ++layer) {
+				layers[layer](static_cast<uint8_t*>(data) + size * layer);
+			}
+		}, size * layerCount, layerCount, VK_FORMAT_R8G8B8A8_UNORM, width, height, m_vkDevice, m_example->queue);
+		m_streamer.addStatic(tex, size * layerCount);
+		return;
+	}
+
+	// Images whose alpha channel is fully opaque don't need the larger alpha formats, an array is opaque if all its layers are
+	bool opaque = true;
+	auto checkOpaque = [&](const uint8_t* rgba) {
+		for (VkDeviceSize i = 3; hasAlpha && opaque && i < size; i += 4) {
+			opaque = rgba[i] == 255;
+		}
 	};
 
-	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(typeCounts, 1);
-	VK_CHECK_RESULT(vkCreateDescriptorPool(m_vkDevice->logicalDevice, &descriptorPoolInfo, nullptr, &m_descriptorPool));
+	std::vector<vks::image::MipChain> chains(layerCount);
+	std::vector<uint8_t> rgba;
+	for (uint32_t layer = 0; layer < layerCount; ++layer) {
+		vks::image::MipChain& chain = chains[layer];
+		if (textureImport.generateMipmaps || textureImport.streaming.enabled) {
+			rgba.resize(size);
+			layers[layer](rgba.data());
+			checkOpaque(rgba.data());
+			// Package colors are sRGB encoded (and sampled as UNORM), so they are filtered in linear space
+			vks::image::buildMipChain(rgba.data(), width, height, true, textureImport.mipFilter, chain);
+			if (chain.levels.size() > maxMipLevels) {
+				chain.data.resize(chain.levels[maxMipLevels].offset);
+				chain.levels.resize(maxMipLevels);
+			}
+		}
+		else {
+			chain.format = VK_FORMAT_R8G8B8A8_UNORM;
+			chain.levels = { { width, height, 0, size } };
+			chain.data.resize(size);
+			layers[layer](chain.data.data());
+			checkOpaque(chain.data.data());
+		}
+	}
+	m_streamer.addStreamed(std::move(chains), textureImport.compress, opaque ? vks::image::BlockFormat::BC1 : textureImport.alphaFormat);
+}
 
-	// Descriptor Set
-	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_dsLayout, 1);
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vkDevice->logicalDevice, &allocInfo, &m_descriptorSet));
+vks::RenderQueue::Stats SimScene::draw(VkCommandBuffer cb, VkPipelineLayout pLayout, uint32_t instanceBinding, vks::RenderQueue& queue)
+{
+	if (m_instanceBuffer.buffer == VK_NULL_HANDLE)
+		return vks::RenderQueue::Stats();
+
+	VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(cb, instanceBinding, 1, &m_instanceBuffer.buffer, offsets);
 
-	std::vector<VkDescriptorImageInfo> texDescriptors;
-	texDescriptors.reserve(textures.size());
-	for (auto& tex : textures) {
-		texDescriptors.push_back(tex.descriptor);
+	if (gpuDriven()) {
+		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pLayout, 1, 1, &m_textureTable.descriptorSet, 0, NULL);
+		vkCmdBindVertexBuffers(cb, 0, 1, &m_vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(cb, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+		m_drawCulling.draw(cb);
+		return vks::RenderQueue::Stats();
 	}
 
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-		vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, texDescriptors.data(), texDescriptors.size())
-	};
-	vkUpdateDescriptorSets(m_vkDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	// All geometries share pipeline, textures and buffers, the order only decides how much the depth test rejects
+	queue.clear();
+	for (const Geometry& geometry : geometries) {
+		// The nearest instance decides
+		float depth = 1.0f;
+		for (uint32_t i = 0; i < geometry.instanceCount; ++i) {
+			depth = std::min(depth, queue.depth(glm::vec3(m_instances[geometry.firstInstance + i].transform * glm::vec4(geometry.center, 1.0f))));
+		}
+
+		vks::RenderQueue::Packet packet;
+		packet.pipelineLayout = pLayout;
+		packet.descriptorSet = m_textureTable.descriptorSet;
+		packet.descriptorSetIndex = 1;
+		packet.vertexBuffer = m_vertexBuffer.buffer;
+		packet.indexBuffer = m_indexBuffer.buffer;
+		packet.indexCount = geometry.indexCount;
+		packet.instanceCount = geometry.instanceCount;
+		packet.firstIndex = geometry.firstIndex;
+		packet.vertexOffset = geometry.vertexOffset;
+		packet.firstInstance = geometry.firstInstance;
+		queue.add(vks::RenderQueue::opaqueKey(0, 0, 0, depth), packet);
+	}
+	queue.sort();
+	return queue.submit(cb);
+}
+
+void SimScene::destroy()
+{
+	m_streamer.destroy();
+	m_vertexBuffer.destroy();
+	m_indexBuffer.destroy();
+	if (m_instanceBuffer.buffer != VK_NULL_HANDLE) {
+		m_instanceBuffer.destroy();
+	}
+	if (gpuDriven()) {
+		m_drawCulling.destroy();
+	}
+	m_textureTable.destroy();
+}
+
+void SimScene::prepareTextureTable()
+{
+	m_textureTable.create(m_vkDevice, m_streamer.textureCount(), VK_SHADER_STAGE_FRAGMENT_BIT, bindlessTextures);
+	for (uint32_t i = 0; i < m_streamer.textureCount(); ++i) {
+		uint32_t slot = m_textureTable.add(m_streamer.texture(i).descriptor);
+		assert(slot == i);
+	}
+}
+
+bool SimScene::updateStreaming(const glm::mat4& view, const glm::mat4& projection, uint32_t viewportHeight)
+{
+	if (!textureImport.streaming.enabled)
+		return false;
+
+	// The instance transforms already hold the model matrix, the copy offsets and the placements, so this is world space
+	vks::Frustum frustum;
+	frustum.update(projection * view);
+	glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+	float pixelsPerUnit = 0.5f * viewportHeight * fabsf(projection[1][1]);
+
+	for (const Geometry& geometry : geometries) {
+		// The nearest visible instance decides the level
+		float distance = FLT_MAX;
+		for (uint32_t i = 0; i < geometry.instanceCount; ++i) {
+			const glm::mat4& transform = m_instances[geometry.firstInstance + i].transform;
+			const glm::vec3 center = glm::vec3(transform * glm::vec4(geometry.center, 1.0f));
+			const float scale = maxScale(transform);
+			const float radius = geometry.radius * scale;
+			if (frustum.checkSphere(center, radius)) {
+				// A scaled copy stretches the same texture coordinates over more world space units
+				distance = std::min(distance, (glm::length(center - eye) - radius) / scale);
+			}
+		}
+		if (distance == FLT_MAX)
+			continue;
+
+		distance = std::max(distance, 1e-3f);
+		for (const Geometry::TextureUse& use : geometry.textureUses) {
+			float texelsPerPixel = use.uvDensity * m_streamer.textureSize(use.texture) * distance / pixelsPerUnit;
+			uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(log2f(texelsPerPixel)) : 0;
+			m_streamer.request(use.texture, level);
+		}
+	}
+
+	std::vector<uint32_t> changed = m_streamer.update();
+	if (changed.empty())
+		return false;
+
+	for (uint32_t index : changed) {
+		m_textureTable.update(index, m_streamer.texture(index).descriptor);
+	}
+	// With update after bind the recorded command buffers stay valid
+	return !m_textureTable.updateAfterBind();
 }
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "DataOperation.h"
+#include "ImageProcessing.h"
+#include "IndirectDrawCulling.h"
+#include "TextureAtlas.h"
+#include "TextureStreamer.h"
+#include "VulkanBindlessTextures.h"
+#include "VulkanRenderQueue.h"
 #include "VulkanTexture.h"
 #include "vulkanexamplebase.h"
 
@@ -12,12 +18,110 @@ public:
 
 	void init(vks::VulkanDevice* vkDevice, VulkanExampleBase* example, const std::string& filename);
 	void loadFromFile(const std::string& filename);
-	void draw(VkCommandBuffer cb, VkPipelineLayout pLayout, uint32_t instanceCount = 1);
+	/**
+	* Creates the instance buffer for the given copies of the whole scene, call after init and before drawing
+	*
+	* @param model Model matrix the scene is drawn with, it is baked into the instance transforms
+	* @param offsets World space offset of every copy of the scene
+	*/
+	void setInstances(const glm::mat4& model, const std::vector<glm::vec3>& offsets);
+	/** @brief Frustum the GPU driven path culls against, no command buffer rebuild needed */
+	void updateCulling(const glm::mat4& view, const glm::mat4& projection);
+	/** @brief Records the culling dispatch of the GPU driven path, outside of a render pass before draw */
+	void cull(VkCommandBuffer cb);
+	/**
+	* Draws every geometry with its instances, the instance buffer is bound to instanceBinding (per instance SimScene::Instance)
+	*
+	* @param queue Orders the draws of the CPU path front to back, its view has to be set. Cleared and submitted by draw
+	* @return Bind statistics of the CPU path, empty for the GPU driven path
+	*/
+	vks::RenderQueue::Stats draw(VkCommandBuffer cb, VkPipelineLayout pLayout, uint32_t instanceBinding, vks::RenderQueue& queue);
 	void destroy();
+
+	/**
+	* Requests the mip levels of visible geometry from its screen space texel density and applies them
+	* Every instance from setInstances counts, the nearest visible one decides the level of a geometry
+	*
+	* @return True if command buffers binding the scene descriptor set must be rebuilt (texture descriptors changed without update after bind)
+	*/
+	bool updateStreaming(const glm::mat4& view, const glm::mat4& projection, uint32_t viewportHeight);
+
+	VkDescriptorSetLayout descriptorSetLayout() const { return m_textureTable.layout; }
+
+	uint32_t textureCount() const { return m_streamer.textureCount(); }
+	TextureStreamer::Stats streamingStats() const { return m_streamer.stats(); }
+	uint32_t atlasPageCount() const { return m_atlasPageCount; }
+	uint32_t atlasImageCount() const { return m_atlasImageCount; }
+	uint32_t arrayCount() const { return m_arrayCount; }
+	uint32_t arrayImageCount() const { return m_arrayImageCount; }
+	// Geometries of the package, copies of the same geometry are drawn with one instanced draw
+	uint32_t packageGeometryCount() const { return m_packageGeometryCount; }
+	// Draw calls recorded per frame, one for the GPU driven path
+	uint32_t drawCount() const { return gpuDriven() ? 1 : static_cast<uint32_t>(geometries.size()); }
+	bool gpuDriven() const { return indirectDraws != IndirectDrawCulling::Support::None; }
+	// Instances of all geometries, culled one by one by the GPU driven path
+	uint32_t cullingRecordCount() const { return m_drawCulling.drawCount(); }
 private:
-	void prepareDescriptorSetLayout();
-	void prepareDescriptor();
+	void prepareTextureTable();
+	static std::function<void(uint8_t* rgba)> rgba8Writer(const SImage& img, bool& hasAlpha);
+	// Block format of pre-compressed package images, VK_FORMAT_UNDEFINED for all others
+	static VkFormat compressedFormat(const SImage& img);
+	// Adds one texture with a layer per writer, all layers have the given size
+	void addRGBA8(uint32_t width, uint32_t height, bool hasAlpha, const std::vector<std::function<void(uint8_t* rgba)>>& layers, uint32_t maxMipLevels = UINT32_MAX);
 public:
+	// The device enabled the vks::BindlessTextures features, set before init
+	bool bindlessTextures = false;
+	// The device enabled the IndirectDrawCulling features, draws are issued from the CPU without them, set before init
+	IndirectDrawCulling::Support indirectDraws = IndirectDrawCulling::Support::None;
+
+	// Applied to uncompressed package images, set before init
+	struct TextureImport {
+		bool generateMipmaps = true;
+		bool compress = true;
+		vks::image::MipFilter mipFilter = vks::image::MipFilter::Box;
+		// Used for images with transparency, opaque images are stored as BC1
+		vks::image::BlockFormat alphaFormat = vks::image::BlockFormat::BC3;
+		// Mip levels of imported images are made resident on demand, pre-compressed package images are always resident
+		TextureStreamer::Settings streaming;
+		// Images of the same size and format become the layers of one array texture
+		struct Arrays {
+			bool enabled = true;
+			// Further images of that size start another array, the vertex texture index has room for 256 layers
+			uint32_t maxLayers = 64;
+		} arrays;
+		// Small images sampled inside [0, 1] that are not part of an array are packed into shared pages
+		TextureAtlas::Settings atlas;
+	} textureImport;
+
+	// Applied to package geometry, set before init
+	struct GeometryImport {
+		// Geometries that are moved, rotated or uniformly scaled copies of an earlier one with the same material and
+		// colors share its buffers and become its instances
+		bool instancing = true;
+		// Largest distance (model space) of a vertex from the transformed original vertex that still counts as a copy
+		float positionTolerance = 1e-3f;
+		// Same for the length of the difference of the normals
+		float normalTolerance = 1e-3f;
+	} geometryImport;
+
+	// Per instance vertex data of the city pipeline, the model to world matrix of the copy (locations 6 to 9)
+	struct Instance {
+		glm::mat4 transform;
+	};
+
+	// Vertex texture indices hold the texture in the low bits and the array layer above, see deferredGeometryCity.frag
+	static const uint32_t textureLayerShift = 16;
+	static const uint32_t textureIndexMask = (1u << textureLayerShift) - 1;
+
+	// Where each package image ended up, vertex texture coordinates are already remapped
+	struct ImageTexture {
+		uint32_t texture;
+		uint32_t layer;
+		glm::vec2 offset;
+		glm::vec2 scale;
+	};
+	std::vector<ImageTexture> imageTextures;
+
 	struct Geometry {
 		struct Vertex {
 			glm::vec3 pos;
@@ -27,19 +131,48 @@ public:
 			glm::vec3 uv2;
 			glm::vec3 uv3;
 		};
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
+		// Range in the shared scene vertex and index buffers
+		uint32_t firstIndex;
 		uint32_t indexCount;
+		int32_t vertexOffset;
+
+		// Bounding sphere in model space
+		glm::vec3 center;
+		float radius;
+		struct TextureUse {
+			uint32_t texture;
+			// Texture coordinate units per model space unit
+			float uvDensity;
+		};
+		std::vector<TextureUse> textureUses;
+
+		// Model space transforms of the copies found in the package, the first one is the identity for the geometry itself
+		std::vector<glm::mat4> placements;
+		// Instances in the scene instance buffer, see setInstances
+		uint32_t firstInstance = 0;
+		uint32_t instanceCount = 0;
 	};
 
-	std::vector<vks::Texture2D> textures;
 	std::vector<Geometry> geometries;
-
-	VkDescriptorSetLayout m_dsLayout;
 private:
 	vks::VulkanDevice* m_vkDevice;
 	VulkanExampleBase* m_example;
 
-	VkDescriptorPool m_descriptorPool;
-	VkDescriptorSet m_descriptorSet;
+	TextureStreamer m_streamer;
+	uint32_t m_atlasPageCount = 0;
+	uint32_t m_atlasImageCount = 0;
+	uint32_t m_arrayCount = 0;
+	uint32_t m_arrayImageCount = 0;
+	uint32_t m_packageGeometryCount = 0;
+
+	// All geometries share one vertex and index buffer, so the whole scene is drawn with a single bind
+	vks::Buffer m_vertexBuffer;
+	vks::Buffer m_indexBuffer;
+	vks::Buffer m_instanceBuffer;
+	// CPU copy of the instance buffer, for the depth of the draws
+	std::vector<Instance> m_instances;
+	IndirectDrawCulling m_drawCulling;
+
+	// Slot i holds texture i of the streamer, the texture index stored in the vertices
+	vks::BindlessTextures m_textureTable;
 };
\ No newline at end of file
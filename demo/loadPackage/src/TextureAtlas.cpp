@@ -0,0 +1,153 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	uint32_t alignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+TextureAtlas::TextureAtlas(const Settings& settings)
+	: m_settings(settings)
+{
+	// Level k keeps padding >> k texels around every image
+	m_mipLevelCount = 1;
+	while ((2u << (m_mipLevelCount - 1)) <= m_settings.padding) {
+		m_mipLevelCount++;
+	}
+	// 4x4 compression blocks must not straddle two images on the last clean level either
+	m_alignment = 4u << (m_mipLevelCount - 1);
+}
+
+bool TextureAtlas::add(uint32_t id, uint32_t width, uint32_t height)
+{
+	if (!m_settings.enabled || width == 0 || height == 0 || std::max(width, height) > m_settings.maxImageSize)
+		return false;
+
+	Image image;
+	image.width = width;
+	image.height = height;
+	image.slotWidth = alignUp(width + 2 * m_settings.padding, m_alignment);
+	image.slotHeight = alignUp(height + 2 * m_settings.padding, m_alignment);
+	if (image.slotWidth > m_settings.pageSize || image.slotHeight > m_settings.pageSize)
+		return false;
+
+	image.packed = true;
+	if (id >= m_images.size()) {
+		m_images.resize(id + 1);
+	}
+	m_images[id] = image;
+	return true;
+}
+
+void TextureAtlas::pack()
+{
+	std::vector<uint32_t> order;
+	for (uint32_t id = 0; id < m_images.size(); ++id) {
+		if (m_images[id].packed) {
+			order.push_back(id);
+		}
+	}
+	// Tallest first keeps shelves full, equal sizes stay together
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		const Image& ia = m_images[a];
+		const Image& ib = m_images[b];
+		if (ia.slotHeight != ib.slotHeight)
+			return ia.slotHeight > ib.slotHeight;
+		if (ia.slotWidth != ib.slotWidth)
+			return ia.slotWidth > ib.slotWidth;
+		return a < b;
+	});
+
+	struct Shelf {
+		uint32_t y, height, width;
+	};
+	struct PageLayout {
+		std::vector<Shelf> shelves;
+		uint32_t width, height;
+	};
+	std::vector<PageLayout> layouts;
+
+	for (uint32_t id : order) {
+		Image& image = m_images[id];
+		bool placed = false;
+		for (uint32_t p = 0; p < layouts.size() && !placed; ++p) {
+			PageLayout& layout = layouts[p];
+			for (Shelf& shelf : layout.shelves) {
+				if (image.slotHeight <= shelf.height && shelf.width + image.slotWidth <= m_settings.pageSize) {
+					image.x = shelf.width;
+					image.y = shelf.y;
+					shelf.width += image.slotWidth;
+					placed = true;
+					break;
+				}
+			}
+			if (!placed && layout.height + image.slotHeight <= m_settings.pageSize) {
+				layout.shelves.push_back({ layout.height, image.slotHeight, image.slotWidth });
+				image.x = 0;
+				image.y = layout.height;
+				layout.height += image.slotHeight;
+				placed = true;
+			}
+			if (placed) {
+				image.placement.page = p;
+				layout.width = std::max(layout.width, image.x + image.slotWidth);
+			}
+		}
+		if (!placed) {
+			PageLayout layout;
+			layout.shelves.push_back({ 0, image.slotHeight, image.slotWidth });
+			layout.width = image.slotWidth;
+			layout.height = image.slotHeight;
+			layouts.push_back(layout);
+			image.x = 0;
+			image.y = 0;
+			image.placement.page = static_cast<uint32_t>(layouts.size() - 1);
+		}
+	}
+
+	// Pages are cropped to the used area, slot sizes keep their dimensions aligned
+	m_pages.resize(layouts.size());
+	for (uint32_t p = 0; p < layouts.size(); ++p) {
+		Page& page = m_pages[p];
+		page.width = layouts[p].width;
+		page.height = layouts[p].height;
+		page.rgba.assign((size_t)page.width * page.height * 4, 0);
+		page.hasAlpha = false;
+		page.imageCount = 0;
+	}
+	for (uint32_t id : order) {
+		Image& image = m_images[id];
+		Page& page = m_pages[image.placement.page];
+		image.placement.offset = glm::vec2(float(image.x + m_settings.padding) / page.width, float(image.y + m_settings.padding) / page.height);
+		image.placement.scale = glm::vec2(float(image.width) / page.width, float(image.height) / page.height);
+		page.imageCount++;
+	}
+}
+
+void TextureAtlas::write(uint32_t id, const uint8_t* rgba, bool hasAlpha)
+{
+	assert(contains(id));
+	const Image& image = m_images[id];
+	Page& page = m_pages[image.placement.page];
+	page.hasAlpha |= hasAlpha;
+
+	// The whole slot is written, texels outside the image repeat its nearest edge texel
+	const int32_t left = static_cast<int32_t>(image.x + m_settings.padding);
+	const int32_t top = static_cast<int32_t>(image.y + m_settings.padding);
+	for (uint32_t y = image.y; y < image.y + image.slotHeight; ++y) {
+		int32_t srcY = std::min(std::max(static_cast<int32_t>(y) - top, 0), static_cast<int32_t>(image.height) - 1);
+		const uint8_t* srcRow = rgba + (size_t)srcY * image.width * 4;
+		uint8_t* dst = page.rgba.data() + ((size_t)y * page.width + image.x) * 4;
+		for (uint32_t x = image.x; x < image.x + image.slotWidth; ++x) {
+			int32_t srcX = std::min(std::max(static_cast<int32_t>(x) - left, 0), static_cast<int32_t>(image.width) - 1);
+			memcpy(dst, srcRow + (size_t)srcX * 4, 4);
+			dst += 4;
+		}
+	}
+}
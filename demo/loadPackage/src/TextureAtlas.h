@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/*
+	Packs small RGBA8 images into shared atlas pages at import time, so a package with thousands of small
+	images needs a few images, allocations and descriptors instead of one per image.
+	Images are sorted by height and placed on shelves, same sized images end up next to each other in a grid.
+	Every image is surrounded by replicated edge texels and starts on a block aligned position, so the first
+	mipLevelCount() levels of a page can be filtered and block compressed without bleeding between images.
+	Only images that are sampled inside [0, 1] may be packed, texture coordinates are remapped with placement().
+*/
+class TextureAtlas {
+public:
+	struct Settings {
+		bool enabled = true;
+		uint32_t pageSize = 2048;
+		// Images up to this size (largest side) are packed, larger ones keep their own image
+		uint32_t maxImageSize = 256;
+		// Edge texels replicated around every image, levels down to a padding of one texel are free of bleeding
+		uint32_t padding = 4;
+	};
+
+	struct Placement {
+		uint32_t page;
+		// Page texture coordinate = offset + image texture coordinate * scale
+		glm::vec2 offset;
+		glm::vec2 scale;
+	};
+
+	struct Page {
+		uint32_t width, height;
+		std::vector<uint8_t> rgba;
+		bool hasAlpha;
+		uint32_t imageCount;
+	};
+public:
+	explicit TextureAtlas(const Settings& settings);
+
+	// Reserves space for an image, returns false if it is too large to be packed
+	bool add(uint32_t id, uint32_t width, uint32_t height);
+	// Places all added images on as few pages as the shelves allow, the pages are allocated afterwards
+	void pack();
+	// Copies the texels of a packed image into its page and fills the padding around it
+	void write(uint32_t id, const uint8_t* rgba, bool hasAlpha);
+
+	bool contains(uint32_t id) const { return id < m_images.size() && m_images[id].packed; }
+	const Placement& placement(uint32_t id) const { return m_images[id].placement; }
+	std::vector<Page>& pages() { return m_pages; }
+	// Levels of a page that don't mix texels of neighbouring images
+	uint32_t mipLevelCount() const { return m_mipLevelCount; }
+private:
+	struct Image {
+		bool packed = false;
+		uint32_t width, height;
+		// Slot including padding and alignment
+		uint32_t x, y, slotWidth, slotHeight;
+		Placement placement;
+	};
+private:
+	Settings m_settings;
+	uint32_t m_mipLevelCount;
+	uint32_t m_alignment;
+
+	// Indexed by id
+	std::vector<Image> m_images;
+	std::vector<Page> m_pages;
+};
@@ -0,0 +1,356 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void TextureStreamer::init(vks::VulkanDevice* vkDevice, VkQueue queue, const Settings& settings)
+{
+	m_vkDevice = vkDevice;
+	m_queue = queue;
+	m_settings = settings;
+
+	m_stopWorker = false;
+	m_worker = std::thread(&TextureStreamer::workerLoop, this);
+}
+
+void TextureStreamer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_stopWorker = true;
+	}
+	m_jobCondition.notify_one();
+	if (m_worker.joinable()) {
+		m_worker.join();
+	}
+	m_jobs.clear();
+	m_finishedJobs.clear();
+
+	for (auto& t : m_textures) {
+		if (t->texture.image != VK_NULL_HANDLE) {
+			t->texture.destroy();
+		}
+	}
+	m_textures.clear();
+	m_residentSize = 0;
+}
+
+uint32_t TextureStreamer::addStatic(const vks::Texture2DArray& texture, VkDeviceSize size)
+{
+	std::unique_ptr<StreamedTexture> t(new StreamedTexture());
+	t->texture = texture;
+	t->width = texture.width;
+	t->height = texture.height;
+	t->streamed = false;
+	t->staticSize = size;
+	m_residentSize += size;
+
+	m_textures.push_back(std::move(t));
+	return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+uint32_t TextureStreamer::addStreamed(std::vector<vks::image::MipChain>&& layers, bool compress, vks::image::BlockFormat compressFormat)
+{
+	assert(!layers.empty());
+
+	std::unique_ptr<StreamedTexture> t(new StreamedTexture());
+	t->texture = {};
+	t->width = layers[0].levels[0].width;
+	t->height = layers[0].levels[0].height;
+	t->streamed = true;
+	t->source = std::move(layers);
+	t->compress = compress;
+	t->compressFormat = compressFormat;
+	t->staticSize = 0;
+
+	const uint32_t count = levelCount(*t);
+	t->levels.resize(count);
+	t->levelPending.resize(count, false);
+
+	// The tail stays resident, with streaming disabled that is the whole chain
+	t->tailLevel = 0;
+	if (m_settings.enabled) {
+		while (t->tailLevel + 1 < count && std::max(t->source[0].levels[t->tailLevel].width, t->source[0].levels[t->tailLevel].height) > m_settings.tailSize) {
+			t->tailLevel++;
+		}
+	}
+	for (uint32_t level = t->tailLevel; level < count; ++level) {
+		encodeLevel(*t, level);
+	}
+	t->residentLevel = count;
+	t->requestedLevel = t->tailLevel;
+	t->lastRequestFrame = 0;
+
+	m_textures.push_back(std::move(t));
+	uint32_t index = static_cast<uint32_t>(m_textures.size() - 1);
+	setResidency(index, m_textures[index]->tailLevel);
+	return index;
+}
+
+bool TextureStreamer::levelReady(const StreamedTexture& t, uint32_t level) const
+{
+	return !t.compress || !t.levels[level].empty();
+}
+
+const uint8_t* TextureStreamer::layerData(const StreamedTexture& t, uint32_t level, uint32_t layer) const
+{
+	return t.compress ? t.levels[level].data() + layerSize(t, level) * layer : t.source[layer].data.data() + t.source[layer].levels[level].offset;
+}
+
+VkDeviceSize TextureStreamer::layerSize(const StreamedTexture& t, uint32_t level) const
+{
+	const vks::image::MipLevel& mip = t.source[0].levels[level];
+	return t.compress ? vks::image::compressedSize(mip.width, mip.height, t.compressFormat) : mip.size;
+}
+
+VkDeviceSize TextureStreamer::residentSize(const StreamedTexture& t, uint32_t level) const
+{
+	VkDeviceSize size = 0;
+	for (uint32_t i = level; i < levelCount(t); ++i) {
+		size += levelSize(t, i);
+	}
+	return size;
+}
+
+void TextureStreamer::encodeLevel(StreamedTexture& t, uint32_t level)
+{
+	if (levelReady(t, level))
+		return;
+
+	const VkDeviceSize size = layerSize(t, level);
+	t.levels[level].resize(levelSize(t, level));
+	for (uint32_t layer = 0; layer < layerCount(t); ++layer) {
+		const vks::image::MipLevel& mip = t.source[layer].levels[level];
+		vks::image::compressLevel(t.source[layer].data.data() + mip.offset, mip.width, mip.height, t.compressFormat, t.levels[level].data() + size * layer);
+	}
+}
+
+void TextureStreamer::queueLevel(uint32_t index, uint32_t level)
+{
+	StreamedTexture& t = *m_textures[index];
+	if (levelReady(t, level) || t.levelPending[level])
+		return;
+
+	t.levelPending[level] = true;
+	Job job;
+	job.texture = index;
+	job.level = level;
+	job.source = &t.source;
+	job.format = t.compressFormat;
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobCondition.notify_one();
+}
+
+void TextureStreamer::collectJobs()
+{
+	std::vector<Job> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		finished.swap(m_finishedJobs);
+	}
+	for (auto& job : finished) {
+		StreamedTexture& t = *m_textures[job.texture];
+		t.levels[job.level] = std::move(job.data);
+		t.levelPending[job.level] = false;
+	}
+}
+
+void TextureStreamer::workerLoop()
+{
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+			m_jobCondition.wait(lock, [this] { return m_stopWorker || !m_jobs.empty(); });
+			if (m_stopWorker)
+				return;
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		const std::vector<vks::image::MipChain>& layers = *job.source;
+		const VkDeviceSize size = vks::image::compressedSize(layers[0].levels[job.level].width, layers[0].levels[job.level].height, job.format);
+		job.data.resize(size * layers.size());
+		for (size_t layer = 0; layer < layers.size(); ++layer) {
+			const vks::image::MipLevel& mip = layers[layer].levels[job.level];
+			vks::image::compressLevel(layers[layer].data.data() + mip.offset, mip.width, mip.height, job.format, job.data.data() + size * layer);
+		}
+
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_finishedJobs.push_back(std::move(job));
+	}
+}
+
+// Recreates the texture with the levels [level, levelCount), all of them must be ready
+void TextureStreamer::setResidency(uint32_t index, uint32_t level)
+{
+	StreamedTexture& t = *m_textures[index];
+	const uint32_t count = levelCount(t);
+	const uint32_t layers = layerCount(t);
+
+	// One region per level and layer, level major
+	std::vector<VkDeviceSize> offsets;
+	VkDeviceSize size = 0;
+	for (uint32_t i = level; i < count; ++i) {
+		assert(levelReady(t, i));
+		for (uint32_t layer = 0; layer < layers; ++layer) {
+			offsets.push_back(size);
+			size += layerSize(t, i);
+		}
+	}
+	std::vector<uint8_t> data(size);
+	for (uint32_t i = level; i < count; ++i) {
+		for (uint32_t layer = 0; layer < layers; ++layer) {
+			memcpy(data.data() + offsets[(i - level) * layers + layer], layerData(t, i, layer), layerSize(t, i));
+		}
+	}
+
+	if (t.residentLevel < count) {
+		// The old image may still be referenced by a frame in flight
+		vkQueueWaitIdle(m_queue);
+		t.texture.destroy();
+		m_residentSize -= residentSize(t, t.residentLevel);
+	}
+
+	VkFormat format = t.compress ? vks::image::blockFormat(t.compressFormat) : t.source[0].format;
+	t.texture.fromMipLevels(data.data(), size, offsets, layers, format, t.source[0].levels[level].width, t.source[0].levels[level].height, m_vkDevice, m_queue);
+	t.residentLevel = level;
+	m_residentSize += size;
+	m_uploads++;
+}
+
+bool TextureStreamer::evict(VkDeviceSize size, uint32_t keep, std::vector<uint32_t>& changed)
+{
+	VkDeviceSize freed = 0;
+	auto drop = [&](uint32_t index, uint32_t level) {
+		StreamedTexture& t = *m_textures[index];
+		VkDeviceSize before = residentSize(t, t.residentLevel);
+		setResidency(index, level);
+		freed += before - residentSize(t, level);
+		changed.push_back(index);
+		m_evictions++;
+	};
+
+	// Textures not requested this frame, least recently requested first, fall back to their tail
+	std::vector<uint32_t> unused;
+	for (uint32_t i = 0; i < m_textures.size(); ++i) {
+		const StreamedTexture& t = *m_textures[i];
+		if (i != keep && t.streamed && t.residentLevel < t.tailLevel && t.lastRequestFrame < m_frame) {
+			unused.push_back(i);
+		}
+	}
+	std::sort(unused.begin(), unused.end(), [this](uint32_t a, uint32_t b) {
+		return m_textures[a]->lastRequestFrame < m_textures[b]->lastRequestFrame;
+	});
+	for (uint32_t i = 0; i < unused.size() && freed < size; ++i) {
+		drop(unused[i], m_textures[unused[i]]->tailLevel);
+	}
+
+	// Then textures holding finer levels than requested this frame
+	for (uint32_t i = 0; i < m_textures.size() && freed < size; ++i) {
+		const StreamedTexture& t = *m_textures[i];
+		if (i != keep && t.streamed && t.lastRequestFrame == m_frame && t.requestedLevel > t.residentLevel) {
+			drop(i, t.requestedLevel);
+		}
+	}
+	return freed >= size;
+}
+
+void TextureStreamer::request(uint32_t texture, uint32_t level)
+{
+	StreamedTexture& t = *m_textures[texture];
+	if (!t.streamed)
+		return;
+
+	level = std::min(level, t.tailLevel);
+	if (t.lastRequestFrame != m_frame) {
+		t.lastRequestFrame = m_frame;
+		t.requestedLevel = level;
+	}
+	else {
+		t.requestedLevel = std::min(t.requestedLevel, level);
+	}
+}
+
+std::vector<uint32_t> TextureStreamer::update()
+{
+	collectJobs();
+
+	std::vector<uint32_t> changed;
+	if (!m_settings.enabled) {
+		m_frame++;
+		return changed;
+	}
+
+	// Textures that want finer levels than resident, largest difference first
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < m_textures.size(); ++i) {
+		const StreamedTexture& t = *m_textures[i];
+		if (t.streamed && t.lastRequestFrame == m_frame && t.requestedLevel < t.residentLevel) {
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+		const StreamedTexture& ta = *m_textures[a];
+		const StreamedTexture& tb = *m_textures[b];
+		return ta.residentLevel - ta.requestedLevel > tb.residentLevel - tb.requestedLevel;
+	});
+
+	uint32_t changes = 0;
+	for (uint32_t index : candidates) {
+		if (changes >= m_settings.maxChangesPerUpdate)
+			break;
+
+		StreamedTexture& t = *m_textures[index];
+		// Coarser levels are queued first, so they arrive first
+		for (uint32_t level = t.residentLevel; level-- > t.requestedLevel;) {
+			queueLevel(index, level);
+		}
+
+		// Step as far towards the requested level as the encoded levels allow
+		uint32_t level = t.residentLevel;
+		while (level > t.requestedLevel && levelReady(t, level - 1)) {
+			level--;
+		}
+		if (level == t.residentLevel)
+			continue;
+
+		VkDeviceSize growth = residentSize(t, level) - residentSize(t, t.residentLevel);
+		if (m_residentSize + growth > m_settings.budget && !evict(m_residentSize + growth - m_settings.budget, index, changed))
+			continue;
+
+		setResidency(index, level);
+		changed.push_back(index);
+		changes++;
+	}
+
+	std::sort(changed.begin(), changed.end());
+	changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+	m_frame++;
+	return changed;
+}
+
+TextureStreamer::Stats TextureStreamer::stats() const
+{
+	Stats stats = {};
+	stats.residentSize = m_residentSize;
+	stats.uploads = m_uploads;
+	stats.evictions = m_evictions;
+	for (auto& t : m_textures) {
+		if (!t->streamed)
+			continue;
+		stats.streamedTextures++;
+		if (t->residentLevel <= t->requestedLevel) {
+			stats.texturesAtDesiredLevel++;
+		}
+		for (bool pending : t->levelPending) {
+			stats.pendingLevels += pending ? 1 : 0;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ImageProcessing.h"
+#include "VulkanTexture.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Keeps the mip levels of textures resident according to what is requested each frame, under a memory budget.
+	Textures are 2D arrays, all layers of a texture share their resident levels.
+	Every texture starts with its tail (the small levels) resident. Finer levels are encoded on a worker thread
+	when first requested and uploaded by recreating the texture with the new base level. When the budget is
+	exceeded the least recently requested textures fall back to their tail.
+	Recreated textures invalidate descriptors referencing them, update() returns which ones changed.
+*/
+class TextureStreamer {
+public:
+	struct Settings {
+		bool enabled = true;
+		VkDeviceSize budget = 256ull * 1024 * 1024;
+		// Levels up to this size (largest side) are uploaded at load time and never evicted
+		uint32_t tailSize = 128;
+		// Every residency change recreates a texture, limit them to keep frame times stable
+		uint32_t maxChangesPerUpdate = 8;
+	};
+
+	struct Stats {
+		VkDeviceSize residentSize;
+		uint32_t streamedTextures;
+		uint32_t texturesAtDesiredLevel;
+		uint32_t pendingLevels;
+		uint32_t uploads;
+		uint32_t evictions;
+	};
+public:
+	void init(vks::VulkanDevice* vkDevice, VkQueue queue, const Settings& settings);
+	void destroy();
+
+	// Texture uploaded by the caller that is never streamed (pre-compressed package images), size is accounted against the budget
+	uint32_t addStatic(const vks::Texture2DArray& texture, VkDeviceSize size);
+	// Texture streamed from the RGBA8 mip chains of its layers (all of the same size), levels are block compressed to compressFormat unless compress is false
+	uint32_t addStreamed(std::vector<vks::image::MipChain>&& layers, bool compress, vks::image::BlockFormat compressFormat);
+
+	// Requests level (0 = finest) of a texture for the current frame, the finest request of a frame wins
+	void request(uint32_t texture, uint32_t level);
+	// Applies the requests of the frame, returns the textures whose image changed
+	std::vector<uint32_t> update();
+
+	uint32_t textureCount() const { return static_cast<uint32_t>(m_textures.size()); }
+	const vks::Texture2DArray& texture(uint32_t index) const { return m_textures[index]->texture; }
+	// Size of the finest level, used to derive the requested level from the screen footprint
+	uint32_t textureSize(uint32_t index) const { return std::max(m_textures[index]->width, m_textures[index]->height); }
+	Stats stats() const;
+	const Settings& settings() const { return m_settings; }
+private:
+	struct StreamedTexture {
+		vks::Texture2DArray texture;
+		uint32_t width, height;
+		bool streamed;
+
+		// Streamed textures only, one source chain per layer
+		std::vector<vks::image::MipChain> source;
+		bool compress;
+		vks::image::BlockFormat compressFormat;
+		// Upload ready data per level with all layers back to back (block compressed levels, empty until encoded)
+		std::vector<std::vector<uint8_t>> levels;
+		std::vector<bool> levelPending;
+		uint32_t tailLevel;
+		uint32_t residentLevel;
+		uint32_t requestedLevel;
+		uint64_t lastRequestFrame;
+
+		VkDeviceSize staticSize;
+	};
+
+	struct Job {
+		uint32_t texture;
+		uint32_t level;
+		const std::vector<vks::image::MipChain>* source;
+		vks::image::BlockFormat format;
+		std::vector<uint8_t> data;
+	};
+
+	uint32_t levelCount(const StreamedTexture& t) const { return static_cast<uint32_t>(t.source[0].levels.size()); }
+	uint32_t layerCount(const StreamedTexture& t) const { return static_cast<uint32_t>(t.source.size()); }
+	bool levelReady(const StreamedTexture& t, uint32_t level) const;
+	const uint8_t* layerData(const StreamedTexture& t, uint32_t level, uint32_t layer) const;
+	// Upload size of one layer of a level
+	VkDeviceSize layerSize(const StreamedTexture& t, uint32_t level) const;
+	// Upload size of a level with all layers
+	VkDeviceSize levelSize(const StreamedTexture& t, uint32_t level) const { return layerSize(t, level) * layerCount(t); }
+	// Size of the levels [level, levelCount)
+	VkDeviceSize residentSize(const StreamedTexture& t, uint32_t level) const;
+
+	void encodeLevel(StreamedTexture& t, uint32_t level);
+	void queueLevel(uint32_t index, uint32_t level);
+	void collectJobs();
+	void setResidency(uint32_t index, uint32_t level);
+	// Drops the least recently requested textures to their tail until size bytes are free, returns false if that is not possible
+	bool evict(VkDeviceSize size, uint32_t keep, std::vector<uint32_t>& changed);
+
+	void workerLoop();
+private:
+	vks::VulkanDevice* m_vkDevice;
+	VkQueue m_queue;
+	Settings m_settings;
+
+	std::vector<std::unique_ptr<StreamedTexture>> m_textures;
+	VkDeviceSize m_residentSize = 0;
+	uint64_t m_frame = 0;
+	uint32_t m_uploads = 0;
+	uint32_t m_evictions = 0;
+
+	// Level encoding on a background thread
+	std::thread m_worker;
+	std::mutex m_jobMutex;
+	std::condition_variable m_jobCondition;
+	std::deque<Job> m_jobs;
+	std::vector<Job> m_finishedJobs;
+	bool m_stopWorker = false;
+};
@@ -1,6 +1,8 @@
 #include "vulkanexamplebase.h"
 #include "VulkanFrameBuffer.hpp"
+#include "VulkanUniformArena.h"
 #include "VulkanglTFModel.h"
+#include "PixelConversion.h"
 
 #include "SimScene.h"
 #include "LightSystem.h"
@@ -18,14 +20,10 @@
 
 class VulkanExample : public VulkanExampleBase {
 	SimScene scene; // City
+	glm::mat4 cityModel = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
 	vkglTF::Model model; // Car
 
-	struct Instance {
-		glm::vec3 pos;
-	};
-	vks::Buffer instanceBuffer;
-	uint32_t instanceCount;
-
 	struct {
 		glm::mat4 view;
 		glm::mat4 viewInv;
@@ -33,9 +31,14 @@ class VulkanExample : public VulkanExampleBase {
 		glm::mat4 projectionInv;
 		glm::vec3 position;
 	} uniformCamera;
-	vks::Buffer uboCamera;
+	// One region per draw command buffer, the camera is written into the region of the frame before its submit
+	std::unique_ptr<vks::UniformArena> uniformArena;
+	uint32_t uniformCameraOffset = 0;
 
 	LightSystem lightSystem;
+	bool cpuLightCulling = false;
+	bool asyncLightCulling = true;
+	int32_t lightCullingMismatches = -1;
 
 	struct PushConstantModel {
 		glm::mat4 model;
@@ -73,12 +76,18 @@ class VulkanExample : public VulkanExampleBase {
 	} descriptorSets;
 
 	std::unique_ptr<vks::Framebuffer> geometryPass;
+	// Lighting pass and UI, submitted after the geometry so only they wait for the async light culling
+	std::vector<VkCommandBuffer> lightingCmdBuffers;
 
 	GPUTimestamps GPUTimer;
 	std::vector<TimeStamp> timeStamps;
 
 	PipelineStatistics statistics;
 
+	// Orders the draws of the geometry pass, bind statistics of the last recorded command buffer
+	vks::RenderQueue renderQueue;
+	vks::RenderQueue::Stats renderQueueStats;
+
 public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -90,6 +99,9 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 1500.0f); // 256.0f
 		settings.overlay = true;
 
+		// Needed to query descriptor indexing support
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
 		vkglTF::descriptorBindingFlags |= 
 			vkglTF::DescriptorBindingFlags::ImageNormalMap | 
 			vkglTF::DescriptorBindingFlags::ImageMetallicRoughness |
@@ -108,8 +120,11 @@ public:
 
 		vkDestroyDescriptorSetLayout(device, dsLayout, nullptr);
 
-		uboCamera.destroy();
-		instanceBuffer.destroy();
+		if (!lightingCmdBuffers.empty()) {
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(lightingCmdBuffers.size()), lightingCmdBuffers.data());
+		}
+
+		uniformArena.reset();
 
 		scene.destroy();
 		lightSystem.destroy();
@@ -124,6 +139,23 @@ public:
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		};
 
+		// City textures are indexed from one bindless table, fully bound fallback without descriptor indexing
+		scene.bindlessTextures = vks::BindlessTextures::enableDeviceSupport(instance, physicalDevice, enabledDeviceExtensions, descriptorIndexingFeatures);
+		if (scene.bindlessTextures) {
+			deviceCreatepNextChain = &descriptorIndexingFeatures;
+		}
+
+		// Package textures are stored as BC1 / BC3, uncompressed ones are block compressed on import
+		if (deviceFeatures.textureCompressionBC) {
+			enabledFeatures.textureCompressionBC = VK_TRUE;
+		}
+		else {
+			scene.textureImport.compress = false;
+		}
+
+		// City draws are culled and issued on the GPU if multi draw indirect is supported
+		scene.indirectDraws = IndirectDrawCulling::enableDeviceSupport(physicalDevice, deviceFeatures, enabledFeatures, enabledDeviceExtensions);
+
 		// Support for pipeline statistics is optional
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
@@ -448,56 +480,40 @@ public:
 	}
 
 	void prepareInstanceBuffer() {
-		instanceCount = X_COUNT * Y_COUNT * Z_COUNT;
-
-		std::vector<Instance> instances;
-		instances.reserve(instanceCount);
+		// Copies of the whole city, the scene adds the instances of its repeated geometry
+		std::vector<glm::vec3> offsets;
+		offsets.reserve(X_COUNT * Y_COUNT * Z_COUNT);
 		float scale = 5.0f;
 		for (uint32_t x = 0; x < X_COUNT; x++) {
 			for (uint32_t y = 0; y < Y_COUNT; y++) {
 				for (uint32_t z = 0; z < Z_COUNT; z++) {
-					Instance ins;	
-					ins.pos = scale * glm::vec3(
+					offsets.push_back(scale * glm::vec3(
 						(float)x - (float)X_COUNT / 2.0f,
 						(float)y - (float)Y_COUNT / 2.0f,
 						(float)z - (float)Z_COUNT / 2.0f
-					);
-					instances.push_back(ins);
+					));
 				}
 			}
 		}
-
-		vks::Buffer stagingBuffer;
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			instances.size() * sizeof(Instance),
-			instances.data()));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&instanceBuffer,
-			stagingBuffer.size));
-
-		vulkanDevice->copyBuffer(&stagingBuffer, &instanceBuffer, queue);
-
-		stagingBuffer.destroy();
+		scene.setInstances(cityModel, offsets);
 	}
 
 	void prepareUniformBuffer() {
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uboCamera,
-			sizeof(uniformCamera),
-			&uniformCamera));
-		VK_CHECK_RESULT(uboCamera.map());
+		uniformArena = std::make_unique<vks::UniformArena>(vulkanDevice, sizeof(uniformCamera), static_cast<uint32_t>(drawCmdBuffers.size()));
 
 		updateCameraUniforms();
 		updateCarUniform();
+
+		// Every region starts out valid, this also sets the offset the command buffers are recorded with
+		for (uint32_t i = 0; i < uniformArena->frameCount(); i++) {
+			writeUniforms(i);
+		}
+	}
+
+	// Copies the camera into the arena region of command buffer i
+	void writeUniforms(uint32_t i) {
+		uniformArena->beginFrame(i);
+		uniformCameraOffset = uniformArena->push(uniformCamera);
 	}
 
 	void updateCameraUniforms(){
@@ -507,7 +523,7 @@ public:
 		uniformCamera.projectionInv = glm::inverse(camera.matrices.perspective);
 		uniformCamera.position = camera.viewPos;
 
-		memcpy(uboCamera.mapped, &uniformCamera, sizeof(uniformCamera));
+		scene.updateCulling(camera.matrices.view, camera.matrices.perspective);
 	}
 
 	void updateCarUniform() {
@@ -520,7 +536,7 @@ public:
 
 	void setupLayouts() {
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
@@ -532,14 +548,11 @@ public:
 
 		// City
 		{
-			std::array<VkDescriptorSetLayout, 2> setLayouts = { dsLayout, scene.m_dsLayout };
+			std::array<VkDescriptorSetLayout, 2> setLayouts = { dsLayout, scene.descriptorSetLayout() };
 			VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 				vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 
-			VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstantModel) };
-			pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-			pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-
+			// No push constants, the model matrix is part of the instance transforms
 			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pLayouts.city));
 		}
 
@@ -572,13 +585,16 @@ public:
 		// Descriptor pool
 		//
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 * 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * 2)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
+		// Both sets bind the camera at the offset of the frame region
+		VkDescriptorBufferInfo cameraDescriptor = uniformArena->descriptor(sizeof(uniformCamera));
+
 		// Allocate descriptor set
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &dsLayout, 1);
 
@@ -587,7 +603,7 @@ public:
 		{
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.geometry));
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSets.geometry, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uboCamera.descriptor)
+				vks::initializers::writeDescriptorSet(descriptorSets.geometry, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &cameraDescriptor)
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 		}
@@ -621,7 +637,7 @@ public:
 
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.lighting));
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uboCamera.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &cameraDescriptor),
 				vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorDepth),
 				vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorRT0),
 				vks::initializers::writeDescriptorSet(descriptorSets.lighting, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorRT1),
@@ -674,7 +690,7 @@ public:
 		// Binding description
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions = {
 			vks::initializers::vertexInputBindingDescription(0, sizeof(SimScene::Geometry::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
-			vks::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(Instance), VK_VERTEX_INPUT_RATE_INSTANCE)
+			vks::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(SimScene::Instance), VK_VERTEX_INPUT_RATE_INSTANCE)
 		};
 		// Attribute descriptions
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {
@@ -685,7 +701,11 @@ public:
 			vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SimScene::Geometry::Vertex, uv2)),
 			vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SimScene::Geometry::Vertex, uv3)),
 
-			vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 6, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Instance, pos))
+			// The instance mat4 takes one location per column
+			vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 6, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SimScene::Instance, transform)),
+			vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 7, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SimScene::Instance, transform) + sizeof(glm::vec4)),
+			vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 8, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SimScene::Instance, transform) + 2 * sizeof(glm::vec4)),
+			vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 9, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SimScene::Instance, transform) + 3 * sizeof(glm::vec4))
 		};
 
 		inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
@@ -714,7 +734,7 @@ public:
 		struct SpecData {
 			uint32_t texCount;
 		} specData;
-		specData.texCount = static_cast<uint32_t>(scene.textures.size());
+		specData.texCount = scene.textureCount();
 		std::array<VkSpecializationMapEntry, 1> specMapEntries = {
 			vks::initializers::specializationMapEntry(0, offsetof(SpecData, texCount), sizeof(SpecData::texCount))
 		};
@@ -783,11 +803,28 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// Draws are sorted for the camera at the time the command buffers are built
+		renderQueue.setView(camera.matrices.view, camera.getNearClip(), camera.getFarClip());
+
+		if (lightingCmdBuffers.size() != drawCmdBuffers.size()) {
+			if (!lightingCmdBuffers.empty()) {
+				vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(lightingCmdBuffers.size()), lightingCmdBuffers.data());
+			}
+			lightingCmdBuffers.resize(drawCmdBuffers.size());
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(lightingCmdBuffers.size()));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, lightingCmdBuffers.data()));
+		}
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
+			renderQueueStats = vks::RenderQueue::Stats();
+
+			// Camera constants in the arena region of this command buffer
+			const uint32_t cameraOffset = uniformArena->frameOffset(i) + uniformCameraOffset;
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			GPUTimer.OnBeginFrame(drawCmdBuffers[i]);
+			statistics.reset(drawCmdBuffers[i], i);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
@@ -795,6 +832,9 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
+			// City culling, fills the indirect draws of the geometry pass
+			scene.cull(drawCmdBuffers[i]);
+
 			// Geometry
 			//
 			{
@@ -807,66 +847,61 @@ public:
 				clearValues[2].color = { 0.0f, 0.0f, 0.0f, 0.0f };
 				clearValues[3].depthStencil = { 1.0f, 0 };
 
-				statistics.reset(drawCmdBuffers[i]);
-
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				statistics.begin(drawCmdBuffers[i]);
-
 				// City
 				{
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.city, 0, 1, &descriptorSets.geometry, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryCity);
+					statistics.begin(drawCmdBuffers[i], "Geometry City", i);
 
-					VkDeviceSize offsets[1] = { 0 };
-					vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.city, 0, 1, &descriptorSets.geometry, 1, &cameraOffset);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryCity);
 
-					PushConstantModel pc;
-					pc.model = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-					vkCmdPushConstants(drawCmdBuffers[i], pLayouts.city, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstantModel), &pc);
+					renderQueueStats += scene.draw(drawCmdBuffers[i], pLayouts.city, INSTANCE_BUFFER_BIND_ID, renderQueue);
 
-					scene.draw(drawCmdBuffers[i], pLayouts.city, instanceCount);
+					statistics.end(drawCmdBuffers[i]);
 
 					GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
 				}
 
 				// Car
 				{
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryCar);
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.car, 0, 1, &descriptorSets.geometry, 0, NULL);
-
-					VkDeviceSize offsets[1] = { 0 };
-					vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &model.vertices.buffer, offsets);
-					if (model.indices.buffer != VK_NULL_HANDLE) {
-						vkCmdBindIndexBuffer(drawCmdBuffers[i], model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-					}
+					statistics.begin(drawCmdBuffers[i], "Geometry Car", i);
 
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.car, 0, 1, &descriptorSets.geometry, 1, &cameraOffset);
 					vkCmdPushConstants(drawCmdBuffers[i], pLayouts.car, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantModel), &pcCar);
 
-					for (auto node : model.nodes) {
-						model.drawNode(
-							node, drawCmdBuffers[i],
-							vkglTF::RenderFlags::RenderOpaqueNodes | vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::BindPBRMaterial,
-							pLayouts.car, 1, sizeof(PushConstantModel)
-						);
-					}
+					// Primitives are grouped by material, the queue binds the pipeline, buffers and materials
+					renderQueue.clear();
+					model.enqueue(
+						renderQueue, 0, pipelines.geometryCar, 1, pcCar.model,
+						vkglTF::RenderFlags::RenderOpaqueNodes | vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::BindPBRMaterial,
+						pLayouts.car, 1, sizeof(PushConstantModel)
+					);
+					renderQueue.sort();
+					renderQueueStats += renderQueue.submit(drawCmdBuffers[i]);
+
+					statistics.end(drawCmdBuffers[i]);
 
 					GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
 				}
 
-				statistics.end(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+
+			VkCommandBuffer lightingCmdBuffer = lightingCmdBuffers[i];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(lightingCmdBuffer, &cmdBufInfo));
+
+			vkCmdSetViewport(lightingCmdBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(lightingCmdBuffer, 0, 1, &scissor);
+
 			// Light Culling
 			//
 			{
-				//lightSystem.calculateFrustum(drawCmdBuffers[i]);
-				//GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
-
-				//lightSystem.doLightCulling(drawCmdBuffers[i]);
-				//GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
+				// Dispatches on a single queue, with async compute only the acquire of the light lists
+				lightSystem.recordCulling(lightingCmdBuffer);
+				GPUTimer.NextTimeStamp(lightingCmdBuffer);
 			}
 
 			// Lighting
@@ -891,22 +926,24 @@ public:
 					imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 };
 					imageMemoryBarrier.image = depthStencil.image;
 
-					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					vkCmdPipelineBarrier(lightingCmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 						0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 				}
 
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBeginRenderPass(lightingCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lighting);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.lighting, 0, 1, &descriptorSets.lighting, 0, NULL);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.lighting, 1, 1, &lightSystem.m_descriptorSet, 0, NULL);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				vkCmdBindPipeline(lightingCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lighting);
+				vkCmdBindDescriptorSets(lightingCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.lighting, 0, 1, &descriptorSets.lighting, 1, &cameraOffset);
+				vkCmdBindDescriptorSets(lightingCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pLayouts.lighting, 1, 1, &lightSystem.m_descriptorSet, 0, NULL);
+				statistics.begin(lightingCmdBuffer, "Lighting", i);
+				vkCmdDraw(lightingCmdBuffer, 3, 1, 0, 0);
+				statistics.end(lightingCmdBuffer);
 
-				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
+				GPUTimer.NextTimeStamp(lightingCmdBuffer);
 
-				drawUI(drawCmdBuffers[i]);
+				drawUI(lightingCmdBuffer, i);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				vkCmdEndRenderPass(lightingCmdBuffer);
 			}
 
 			{
@@ -922,30 +959,53 @@ public:
 				imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 };
 				imageMemoryBarrier.image = depthStencil.image;
 
-				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				vkCmdPipelineBarrier(lightingCmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 					0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
 
-			GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
+			lightSystem.recordLightingDone(lightingCmdBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			GPUTimer.NextTimeStamp(lightingCmdBuffer);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(lightingCmdBuffer));
 		}
 	}
 
 	void draw(){
 		VulkanExampleBase::prepareFrame();
 
-		// Command buffer to be submitted to the queue
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		// The last submit of this command buffer is done, submitFrame waits for the queue
+		writeUniforms(currentBuffer);
 
-		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		// The async light culling is submitted first, the lighting pass waits for it
+		std::vector<VkSemaphore> waitSemaphores = { semaphores.presentComplete };
+		std::vector<VkPipelineStageFlags> waitStages = { submitPipelineStages };
+		std::vector<VkSemaphore> signalSemaphores = { semaphores.renderComplete };
+		lightSystem.submitAsyncCulling(waitSemaphores, waitStages, signalSemaphores);
+
+		// A camera change with CPU culling uploads the new light lists right before the lighting pass
+		std::vector<VkCommandBuffer> lightingCmdBuffer = { lightingCmdBuffers[currentBuffer] };
+		lightSystem.submitCpuCullingUpload(lightingCmdBuffer);
+
+		// Geometry doesn't touch the swapchain image or the light lists and starts right away
+		std::array<VkSubmitInfo, 2> submitInfos = { vks::initializers::submitInfo(), vks::initializers::submitInfo() };
+		submitInfos[0].commandBufferCount = 1;
+		submitInfos[0].pCommandBuffers = &drawCmdBuffers[currentBuffer];
+
+		submitInfos[1].waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfos[1].pWaitSemaphores = waitSemaphores.data();
+		submitInfos[1].pWaitDstStageMask = waitStages.data();
+		submitInfos[1].commandBufferCount = static_cast<uint32_t>(lightingCmdBuffer.size());
+		submitInfos[1].pCommandBuffers = lightingCmdBuffer.data();
+		submitInfos[1].signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfos[1].pSignalSemaphores = signalSemaphores.data();
+
+		VK_CHECK_RESULT(vkQueueSubmit(queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 
 		GPUTimer.GetQueryResult(&timeStamps);
-		statistics.getResult();
+		statistics.getResult(currentBuffer);
 	}
 
 	void prepare() {
@@ -955,15 +1015,29 @@ public:
 			"Begin Frame",
 			"Geometry City",
 			"Geometry Car",
-			//"Frustum Calculate",
-			//"Light Culling",
+			"Light Culling",
 			"Lighting",
 			"ImGUI"
 		};
 		GPUTimer.OnCreate(vulkanDevice, std::move(labels));
-		statistics.init(vulkanDevice);
+		std::vector<std::string> scopes = {
+			"Geometry City",
+			"Geometry Car",
+			"Lighting"
+		};
+		statistics.init(vulkanDevice, std::move(scopes), static_cast<uint32_t>(drawCmdBuffers.size()));
+		updateStatisticsExtent();
+		benchmark.reports.push_back([this](std::ostream& os) { statistics.report(os); });
+		benchmark.reports.push_back([this](std::ostream& os) {
+			os << "Car model load time: " << model.loadTime << " ms" << (model.loadedFromCache ? " (model cache)" : "") << "\n";
+		});
+		benchmark.reports.push_back([this](std::ostream& os) { model.benchmarkAnimationSampling(os); });
+		benchmark.reports.push_back([this](std::ostream& os) { model.benchmarkSkinning(os); });
+		benchmark.reports.push_back([](std::ostream& os) { vks::pixel::validate(os); });
 
 		lightSystem.init(vulkanDevice, this, glm::vec3(1500.0f, 20.0f, -4000.0f), 50.0f, 10);
+		lightSystem.setAsyncCompute(asyncLightCulling);
+		benchmark.reports.push_back([this](std::ostream& os) { lightSystem.benchmarkCpuCulling(os); });
 		loadAssets();
 		preparePasses();
 		prepareInstanceBuffer();
@@ -980,6 +1054,10 @@ public:
 	virtual void render(){
 		if (!prepared) return;
 
+		// Texture residency changes rewrite scene descriptors, the queue is idle here since submitFrame waits for it
+		if (scene.updateStreaming(camera.matrices.view, camera.matrices.perspective, height)) {
+			buildCommandBuffers();
+		}
 		draw();
 	}
 
@@ -988,6 +1066,12 @@ public:
 		lightSystem.updateCamera();
 	}
 
+	void updateStatisticsExtent() {
+		statistics.setTargetExtent("Geometry City", width, height);
+		statistics.setTargetExtent("Geometry Car", width, height);
+		statistics.setTargetExtent("Lighting", width, height);
+	}
+
 	virtual void windowResized() override {
 		// resource that have been recreated: depthStencil, swapchain image & its framebuffer
 
@@ -997,6 +1081,8 @@ public:
 
 		// descriptor set related with those rendertarget
 		updateDescriptorSetOnResize();
+
+		updateStatisticsExtent();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay){
@@ -1015,12 +1101,73 @@ public:
 				updateCarUniform();
 			}
 		}
+		if (overlay->header("Light culling")) {
+			if (overlay->checkBox("CPU light culling", &cpuLightCulling)) {
+				lightSystem.setCpuCulling(cpuLightCulling);
+			}
+			if (cpuLightCulling) {
+				if (overlay->checkBox("Light BVH", &lightSystem.m_useLightBVH)) {
+					lightSystem.setCpuCulling(cpuLightCulling);
+				}
+				overlay->text("CPU culling: %.2f ms", lightSystem.cpuCullingTime());
+			}
+			if (lightSystem.asyncComputeSupported()) {
+				if (overlay->checkBox("Async compute", &asyncLightCulling)) {
+					lightSystem.setAsyncCompute(asyncLightCulling);
+				}
+			} else {
+				overlay->text("No compute queue, culling on graphics");
+			}
+			float cullingBegin, cullingEnd;
+			if (lightSystem.asyncCulling() && lightSystem.asyncCullingTime(GPUTimer.GetFrameBeginTicks(), cullingBegin, cullingEnd)) {
+				// Both relative to the start of the frame on the graphics queue
+				float geometryEnd = 0.0f;
+				for (auto& timeStamp : timeStamps) {
+					geometryEnd += timeStamp.m_microseconds;
+					if (timeStamp.m_label == "Geometry Car")
+						break;
+				}
+				overlay->text("Compute queue: %.1f - %.1f us", cullingBegin, cullingEnd);
+				overlay->text("Geometry: 0.0 - %.1f us", geometryEnd);
+			}
+			if (overlay->button("Compare with compute")) {
+				lightCullingMismatches = static_cast<int32_t>(lightSystem.compareWithGpu());
+			}
+			if (lightCullingMismatches >= 0) {
+				overlay->text("Mismatching clusters: %d", lightCullingMismatches);
+			}
+		}
+		if (overlay->header("Texture streaming")) {
+			TextureStreamer::Stats stats = scene.streamingStats();
+			overlay->text("Resident: %.1f MiB", stats.residentSize / (1024.0 * 1024.0));
+			overlay->text("At desired level: %u / %u", stats.texturesAtDesiredLevel, stats.streamedTextures);
+			overlay->text("Pending levels: %u", stats.pendingLevels);
+			overlay->text("Uploads: %u, evictions: %u", stats.uploads, stats.evictions);
+			overlay->text("Arrays: %u images in %u textures", scene.arrayImageCount(), scene.arrayCount());
+			overlay->text("Atlas: %u images on %u pages", scene.atlasImageCount(), scene.atlasPageCount());
+		}
+		if (overlay->header("Geometry")) {
+			overlay->text("Draws: %u for %u package geometries", scene.drawCount(), scene.packageGeometryCount());
+			if (scene.gpuDriven()) {
+				overlay->text("GPU culled instances: %u", scene.cullingRecordCount());
+			}
+			overlay->text("Binds: %u, eliminated: %u", renderQueueStats.binds, renderQueueStats.eliminatedBinds);
+		}
 		if (overlay->header("Pipeline statistics")) {
 			for (auto i = 0; i < statistics.pipelineStats.size(); i++) {
 				std::string caption = statistics.pipelineStatNames[i] + ": %d";
 				overlay->text(caption.c_str(), statistics.pipelineStats[i]);
 			}
 		}
+		if (overlay->header("Pass statistics")) {
+			ImGui::Text("%-14s %9s %9s %6s %6s", "pass", "vs inv", "fs inv", "ovrdr", "clip");
+			for (auto& pass : statistics.passStats) {
+				ImGui::Text("%-14s %9llu %9llu %6.2f %5.0f%%", pass.m_label.c_str(),
+					(unsigned long long)pass.m_counters[PIPELINE_STAT_VS_INVOCATIONS],
+					(unsigned long long)pass.m_counters[PIPELINE_STAT_FS_INVOCATIONS],
+					pass.m_overdraw, pass.m_clippingRejection * 100.0f);
+			}
+		}
 		if (overlay->header("GPU Profile")) {
 			for (auto& timeStamp : timeStamps) {
 				ImGui::Text("%-22s: %7.1f", timeStamp.m_label.c_str(), timeStamp.m_microseconds);
@@ -517,7 +517,7 @@ public:
 					);
 				}
 
-				drawUI(drawCmdBuffers[i]);
+				drawUI(drawCmdBuffers[i], i);
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
@@ -928,7 +928,7 @@ public:
 
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-				drawUI(drawCmdBuffers[i]);
+				drawUI(drawCmdBuffers[i], i);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
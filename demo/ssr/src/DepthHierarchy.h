@@ -18,7 +18,6 @@ public:
 	VkImageView splitViews[MAX_MIP_LEVEL] = {};
 
 	VkSampler sampler = VK_NULL_HANDLE;
-	VkDescriptorSet descriptorSets[MAX_MIP_LEVEL];
 
 	uint32_t mipLevel = -1;
 };
\ No newline at end of file
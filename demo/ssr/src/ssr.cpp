@@ -9,6 +9,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "VulkanFrameBuffer.hpp"
+#include "VulkanDownsampler.h"
 
 #include "DepthHierarchy.h"
 #include "GPUTimestamps.h"
@@ -94,9 +95,7 @@ public:
 	} uniformBuffers;
 
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSetLayout dsLayoutDownsampleCS;
 	VkPipelineLayout pipelineLayout;
-	VkPipelineLayout ppLayoutDownsampleCS;
 
 	VkDescriptorSet dsPrez;
 	struct {
@@ -111,7 +110,6 @@ public:
 		VkPipeline lighting;
 		VkPipeline ssr;
 		VkPipeline composition;
-		VkPipeline downsampleCS;
 	} pipelines;
 
 	struct {
@@ -120,12 +118,9 @@ public:
 		std::unique_ptr<vks::Framebuffer> ssr;
 	}passes;
 
-	struct cbDownsample {
-		float outputSize[2];
-		float invInputSize[2];
-		uint32_t coverSize[2];
-	};
 	DepthHierarchy depthHierarchy;
+	// Min reduction of the depth buffer into all levels of the hierarchy in one dispatch
+	std::unique_ptr<vks::Downsampler> depthDownsampler;
 
 	GPUTimestamps GPUTimer;
 	std::vector<TimeStamp> timeStamps;
@@ -152,12 +147,9 @@ public:
 		vkDestroyPipeline(device, pipelines.lighting, nullptr);
 		vkDestroyPipeline(device, pipelines.ssr, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
-		vkDestroyPipeline(device, pipelines.downsampleCS, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyPipelineLayout(device, ppLayoutDownsampleCS, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		vkDestroyDescriptorSetLayout(device, dsLayoutDownsampleCS, nullptr);
 
 		// Uniform buffers
 		uniformBuffers.vs.destroy();
@@ -171,6 +163,7 @@ public:
 		textures.floor.normalMap.destroy();
 
 		screenQuad.destroy();
+		depthDownsampler.reset();
 		depthHierarchy.destroy(device);
 
 		GPUTimer.OnDestroy();
@@ -547,42 +540,6 @@ public:
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
-
-		// downsampler compute pipeline
-		// create the descriptor set layout
-		// the shader needs
-		// source image: texture + sampler
-		// destination image: storage image
-		// single pass: destination images count # of mips
-		// single pass: global atomic counter, storage buffer
-		{
-			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				// Binding 0 : 
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
-				// Binding 1 : 
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
-				// Binding 2 : 
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2)
-			};
-			VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &dsLayoutDownsampleCS));
-
-			VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
-			pPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-
-			// push constants: input size, inverse output size
-			VkPushConstantRange pushConstantRange = {};
-			pushConstantRange.offset = 0;
-			pushConstantRange.size = sizeof(cbDownsample);
-			pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-			pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-
-			pPipelineLayoutCreateInfo.setLayoutCount = 1;
-			pPipelineLayoutCreateInfo.pSetLayouts = &dsLayoutDownsampleCS;
-
-			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, NULL, &ppLayoutDownsampleCS));
-		}
 	}
 
 	void preparePipelines()
@@ -684,33 +641,18 @@ public:
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
 
-		// compute pipeline
-		// downsampler pipeline
-		{
-			VkPipelineShaderStageCreateInfo shader = loadShader(getShadersPath() + "ssr/spirv/downsamplerCS.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-
-			VkComputePipelineCreateInfo pipeline = {};
-			pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-			pipeline.layout = ppLayoutDownsampleCS;
-			pipeline.stage = shader;
-			pipeline.basePipelineHandle = VK_NULL_HANDLE;
-			pipeline.basePipelineIndex = 0;
-
-			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &pipeline, NULL, &pipelines.downsampleCS));
-		}
+		// Depth hierarchy, min reduction
+		depthDownsampler = std::make_unique<vks::Downsampler>(vulkanDevice, queue, pipelineCache, getShadersPath(), VK_FORMAT_R32_SFLOAT, vks::Downsampler::Reduction::Min);
 	}
 
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 7),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, DepthHierarchy::MAX_MIP_LEVEL),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, DepthHierarchy::MAX_MIP_LEVEL),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DepthHierarchy::MAX_MIP_LEVEL)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5 + DepthHierarchy::MAX_MIP_LEVEL);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -799,25 +741,14 @@ public:
 		/*
 			Downsample pass
 		*/
-		{
-			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &dsLayoutDownsampleCS, 1);
-			assert(depthHierarchy.mipLevel != -1);
-			for (int i = 0; i < depthHierarchy.mipLevel; ++i) {
-				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &depthHierarchy.descriptorSets[i]));
-
-				VkDescriptorImageInfo descriptorSrc = { VK_NULL_HANDLE, i == 0 ? depthStencil.view : depthHierarchy.splitViews[i - 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-				VkDescriptorImageInfo descriptorSampler;
-				descriptorSampler.sampler = depthHierarchy.sampler;
-				VkDescriptorImageInfo descriptorDst = { VK_NULL_HANDLE, depthHierarchy.splitViews[i], VK_IMAGE_LAYOUT_GENERAL };
-
-				writeDescriptorSets = {
-					vks::initializers::writeDescriptorSet(depthHierarchy.descriptorSets[i], VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0, &descriptorSrc),
-					vks::initializers::writeDescriptorSet(depthHierarchy.descriptorSets[i], VK_DESCRIPTOR_TYPE_SAMPLER, 1, &descriptorSampler),
-					vks::initializers::writeDescriptorSet(depthHierarchy.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &descriptorDst)
-				};
-				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
-			}
-		}
+		setDepthDownsampleChain();
+	}
+
+	// Level 0 of the hierarchy is a copy of the depth buffer, the sampler is ignored by the texel fetches
+	void setDepthDownsampleChain()
+	{
+		depthDownsampler->setChain(depthStencil.view, depthHierarchy.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			depthHierarchy.splitViews, depthHierarchy.mipLevel, width, height, true);
 	}
 
 	void buildCommandBuffers()
@@ -907,11 +838,9 @@ public:
 			}
 
 			/*
-				downsamplerCS
+				depth downsample
 			*/
 			{
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.downsampleCS);
-
 				// depthHierarchy[0 ~ mipLevel-1]: VK_IMAGE_LAYOUT_UNDEFINED -> VK_IMAGE_LAYOUT_GENERAL
 				VkImageMemoryBarrier imageMemoryBarrier = {};
 				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -924,62 +853,22 @@ public:
 				imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthHierarchy.mipLevel, 0, 1 };
 				imageMemoryBarrier.image = depthHierarchy.image;
 
-				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 					0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 
-				for (uint32_t j = 0; j < depthHierarchy.mipLevel; j++)
-				{
-					uint32_t outSize[2] = { width >> j, height >> j };
-					if (outSize[0] == 0) outSize[0] = 1;
-					if (outSize[1] == 0) outSize[1] = 1;
-
-					uint32_t dispatchX = (outSize[0] + 7) / 8;
-					uint32_t dispatchY = (outSize[1] + 7) / 8;
-					uint32_t dispatchZ = 1;
-
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, ppLayoutDownsampleCS, 0, 1, &depthHierarchy.descriptorSets[j], 0, nullptr);
-
-					// Bind push constants
-					//
-					cbDownsample data;
-					if (j == 0) {
-						data.outputSize[0] = (float)(width);
-						data.outputSize[1] = (float)(height);
-						data.invInputSize[0] = 1.0f / (float)(width);
-						data.invInputSize[1] = 1.0f / (float)(height);
-						data.coverSize[0] = 0;
-						data.coverSize[1] = 0;
-					}
-					else {
-						uint32_t inSize[2] = { width >> (j - 1), height >> (j - 1) };
-						if (inSize[0] == 0) inSize[0] = 1;
-						if (inSize[1] == 0) inSize[1] = 1;
-
-						data.invInputSize[0] = 1.0f / (float)(inSize[0]);
-						data.invInputSize[1] = 1.0f / (float)(inSize[1]);
-						data.outputSize[0] = (float)(outSize[0]);
-						data.outputSize[1] = (float)(outSize[1]);
-						data.coverSize[0] = inSize[0] == 1 ? 1 : ((inSize[0] % 2) ? 3 : 2);
-						data.coverSize[1] = inSize[1] == 1 ? 1 : ((inSize[1] % 2) ? 3 : 2);
-					}
-					vkCmdPushConstants(drawCmdBuffers[i], ppLayoutDownsampleCS, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(cbDownsample), (void*)&data);
-
-					// Draw
-					//
-					vkCmdDispatch(drawCmdBuffers[i], dispatchX, dispatchY, dispatchZ);
-
-					// depthHierarchy[0 ~ mipLevel-1]: VK_IMAGE_LAYOUT_GENERAL -> VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-					imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-					imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-					imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, j, 1, 0, 1 };
-					imageMemoryBarrier.image = depthHierarchy.image;
-
-					// transition general layout if destination image to shader read only for source image
-					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-						0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-				}
+				// All levels in one dispatch, no barriers between the levels
+				// Recorded on the graphics queue: it waits for the depth of the G-Buffer pass and the ssr pass samples it
+				// right away, the short dispatch has no independent graphics work to overlap with on a compute queue
+				depthDownsampler->record(drawCmdBuffers[i]);
+
+				// depthHierarchy[0 ~ mipLevel-1]: VK_IMAGE_LAYOUT_GENERAL -> VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for the ssr pass
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 
 				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
 			}
@@ -1041,7 +930,7 @@ public:
 
 				GPUTimer.NextTimeStamp(drawCmdBuffers[i]);
 
-				drawUI(drawCmdBuffers[i]);
+				drawUI(drawCmdBuffers[i], i);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -1184,19 +1073,7 @@ public:
 		/*
 			Downsample pass
 		*/
-		for (int i = 0; i < depthHierarchy.mipLevel; ++i) {
-			VkDescriptorImageInfo descriptorSrc = { VK_NULL_HANDLE, i == 0 ? depthStencil.view : depthHierarchy.splitViews[i - 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-			VkDescriptorImageInfo descriptorSampler;
-			descriptorSampler.sampler = depthHierarchy.sampler;
-			VkDescriptorImageInfo descriptorDst = { VK_NULL_HANDLE, depthHierarchy.splitViews[i], VK_IMAGE_LAYOUT_GENERAL };
-
-			writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(depthHierarchy.descriptorSets[i], VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0, &descriptorSrc),
-				vks::initializers::writeDescriptorSet(depthHierarchy.descriptorSets[i], VK_DESCRIPTOR_TYPE_SAMPLER, 1, &descriptorSampler),
-				vks::initializers::writeDescriptorSet(depthHierarchy.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &descriptorDst)
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
-		}
+		setDepthDownsampleChain();
 
 		/*
 			SSR pass
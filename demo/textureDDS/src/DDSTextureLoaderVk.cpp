@@ -11,16 +11,28 @@
 #include "DDSTextureLoaderVk.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <new>
 #include <fstream>
 #include <filesystem>
+#include <thread>
 
 #ifdef _WIN32
+#include <windows.h>
 #include <debugapi.h>
 #else
 #include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _In_
+#define _In_
 #endif
 
 #ifdef __clang__
@@ -30,7 +42,9 @@
 #pragma clang diagnostic ignored "-Wswitch-enum"
 #endif
 
+#ifdef _MSC_VER
 #pragma warning(disable : 4062)
+#endif
 
 namespace DDSTextureLoaderVk{
 
@@ -87,7 +101,7 @@ struct DDS_PIXELFORMAT
 #define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
 
 #ifndef UNREFERENCED_PARAMETER
-#define UNREFERENCED_PARAMETER(P) (P)
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
 #endif
 
 enum DDS_MISC_FLAGS2
@@ -271,14 +285,16 @@ namespace
             return DDS_LOADER_FAIL;
 
         std::streampos fileLen = inFile.tellg();
-        if (!inFile)
+        if (!inFile || fileLen < 0)
             return DDS_LOADER_FAIL;
 
+        size_t len = static_cast<size_t>(fileLen);
+
         // Need at least enough data to fill the header and magic number to be a valid DDS
-        if (fileLen < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+        if (len < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
             return DDS_LOADER_FAIL;
 
-        ddsData.reset(new (std::nothrow) uint8_t[size_t(fileLen)]);
+        ddsData.reset(new (std::nothrow) uint8_t[len]);
         if (!ddsData)
             return DDS_LOADER_FAIL;
 
@@ -298,8 +314,6 @@ namespace
 
        inFile.close();
 
-       size_t len = fileLen;
-
         // DDS files always start with the same magic number ("DDS ")
         auto dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData.get());
         if (dwMagicNumber != DDS_MAGIC)
@@ -2041,16 +2055,16 @@ namespace
         assert(!is2PlaneFormat || aspectPlane == VK_IMAGE_ASPECT_PLANE_0_BIT || aspectPlane == VK_IMAGE_ASPECT_PLANE_1_BIT);
         assert(!is3PlaneFormat || aspectPlane == VK_IMAGE_ASPECT_PLANE_0_BIT || aspectPlane == VK_IMAGE_ASPECT_PLANE_1_BIT || aspectPlane == VK_IMAGE_ASPECT_PLANE_2_BIT);
 
-        assert(is2PlaneFormat  || (aspectPlane != VK_IMAGE_ASPECT_PLANE_0_BIT && aspectPlane != VK_IMAGE_ASPECT_PLANE_1_BIT));
-        assert(is3PlaneFormat  || (aspectPlane != VK_IMAGE_ASPECT_PLANE_0_BIT && aspectPlane != VK_IMAGE_ASPECT_PLANE_1_BIT && aspectPlane != VK_IMAGE_ASPECT_PLANE_2_BIT));
+        assert(is2PlaneFormat || is3PlaneFormat || (aspectPlane != VK_IMAGE_ASPECT_PLANE_0_BIT && aspectPlane != VK_IMAGE_ASPECT_PLANE_1_BIT));
+        assert(is3PlaneFormat || aspectPlane != VK_IMAGE_ASPECT_PLANE_2_BIT);
 
 #elif (!defined(VK_VERSION_1_1) || !VK_VERSION_1_1) && defined(VK_KHR_sampler_ycbcr_conversion)
 
         assert(!is2PlaneFormat || aspectPlane == VK_IMAGE_ASPECT_PLANE_0_BIT_KHR || aspectPlane == VK_IMAGE_ASPECT_PLANE_1_BIT_KHR);
         assert(!is3PlaneFormat || aspectPlane == VK_IMAGE_ASPECT_PLANE_0_BIT_KHR || aspectPlane == VK_IMAGE_ASPECT_PLANE_1_BIT_KHR || aspectPlane == VK_IMAGE_ASPECT_PLANE_2_BIT_KHR);
 
-        assert(is2PlaneFormat  || (aspectPlane != VK_IMAGE_ASPECT_PLANE_0_BIT_KHR && aspectPlane != VK_IMAGE_ASPECT_PLANE_1_BIT_KHR));
-        assert(is3PlaneFormat  || (aspectPlane != VK_IMAGE_ASPECT_PLANE_0_BIT_KHR && aspectPlane != VK_IMAGE_ASPECT_PLANE_1_BIT_KHR && aspectPlane != VK_IMAGE_ASPECT_PLANE_2_BIT_KHR));
+        assert(is2PlaneFormat || is3PlaneFormat || (aspectPlane != VK_IMAGE_ASPECT_PLANE_0_BIT_KHR && aspectPlane != VK_IMAGE_ASPECT_PLANE_1_BIT_KHR));
+        assert(is3PlaneFormat || aspectPlane != VK_IMAGE_ASPECT_PLANE_2_BIT_KHR);
 
 #endif
 
@@ -2630,43 +2644,46 @@ namespace
 
         initData.clear();
 
-        for (size_t p = 0; p < numberOfPlanes; ++p)
+        // Planes are stored one after another within each mip level, like the subresources of a D3D12 planar texture
+        const uint8_t* pSrcBits = bitData;
+
+        for (size_t j = 0; j < arraySize; j++)
         {
-            VkImageAspectFlags aspectPlane = VK_IMAGE_ASPECT_FLAG_BITS_MAX_ENUM;
-            if(numberOfPlanes == 1 && !IsDepthStencil(format))
-            {
-                aspectPlane = VK_IMAGE_ASPECT_COLOR_BIT;
-            }
-            else if(numberOfPlanes == 1)
-            {
-                //No separate depth/stencil
-                aspectPlane = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-            }
-            else if(p == 0)
-            {
-                aspectPlane = VK_IMAGE_ASPECT_PLANE_0_BIT;
-            }
-            else if(p == 1)
-            {
-                aspectPlane = VK_IMAGE_ASPECT_PLANE_1_BIT;
-            }
-            else if(p == 2)
+            size_t w = width;
+            size_t h = height;
+            size_t d = depth;
+
+            for (size_t i = 0; i < mipCount; i++)
             {
-                aspectPlane = VK_IMAGE_ASPECT_PLANE_2_BIT;
-            }
+                bool keepMip = (mipCount <= 1) || !maxsize || (w <= maxsize && h <= maxsize && d <= maxsize);
 
-            assert(aspectPlane != VK_IMAGE_ASPECT_FLAG_BITS_MAX_ENUM);
+                for (size_t p = 0; p < numberOfPlanes; ++p)
+                {
+                    VkImageAspectFlags aspectPlane = VK_IMAGE_ASPECT_FLAG_BITS_MAX_ENUM;
+                    if(numberOfPlanes == 1 && !IsDepthStencil(format))
+                    {
+                        aspectPlane = VK_IMAGE_ASPECT_COLOR_BIT;
+                    }
+                    else if(numberOfPlanes == 1)
+                    {
+                        //No separate depth/stencil
+                        aspectPlane = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+                    }
+                    else if(p == 0)
+                    {
+                        aspectPlane = VK_IMAGE_ASPECT_PLANE_0_BIT;
+                    }
+                    else if(p == 1)
+                    {
+                        aspectPlane = VK_IMAGE_ASPECT_PLANE_1_BIT;
+                    }
+                    else if(p == 2)
+                    {
+                        aspectPlane = VK_IMAGE_ASPECT_PLANE_2_BIT;
+                    }
 
-            const uint8_t* pSrcBits = bitData;
+                    assert(aspectPlane != VK_IMAGE_ASPECT_FLAG_BITS_MAX_ENUM);
 
-            for (size_t j = 0; j < arraySize; j++)
-            {
-                size_t w = width;
-                size_t h = height;
-                size_t d = depth;
-                
-                for (size_t i = 0; i < mipCount; i++)
-                {
                     DDS_LOADER_RESULT surfInfoRes = GetSurfaceInfo(w, h, format, aspectPlane, &NumBytes, &RowBytes, nullptr);
                     if(surfInfoRes != DDS_LOADER_SUCCESS)
                     {
@@ -2680,7 +2697,7 @@ namespace
 
                     size_t dataSize = NumBytes * d;
 
-                    if ((mipCount <= 1) || !maxsize || (w <= maxsize && h <= maxsize && d <= maxsize))
+                    if (keepMip)
                     {
                         if (!twidth)
                         {
@@ -2701,34 +2718,35 @@ namespace
 
                         initData.emplace_back(res);
                     }
-                    else if (!j)
-                    {
-                        // Count number of skipped mipmaps (first item only)
-                        ++skipMip;
-                    }
 
-                    if(pSrcBits + (NumBytes*d) > pEndBits)
+                    if(pSrcBits + dataSize > pEndBits)
                     {
                         return DDS_LOADER_UNEXPECTED_EOF;
                     }
 
-                    pSrcBits += NumBytes * d;
+                    pSrcBits += dataSize;
+                }
 
-                    w = w >> 1;
-                    h = h >> 1;
-                    d = d >> 1;
-                    if (w == 0)
-                    {
-                        w = 1;
-                    }
-                    if (h == 0)
-                    {
-                        h = 1;
-                    }
-                    if (d == 0)
-                    {
-                        d = 1;
-                    }
+                if (!keepMip && !j)
+                {
+                    // Count number of skipped mipmaps (first item only)
+                    ++skipMip;
+                }
+
+                w = w >> 1;
+                h = h >> 1;
+                d = d >> 1;
+                if (w == 0)
+                {
+                    w = 1;
+                }
+                if (h == 0)
+                {
+                    h = 1;
+                }
+                if (d == 0)
+                {
+                    d = 1;
                 }
             }
         }
@@ -2738,8 +2756,7 @@ namespace
 
 
     //--------------------------------------------------------------------------------------
-    DDS_LOADER_RESULT CreateTextureResource(
-        VkDevice vkDevice,
+    void FillImageCreateInfo(
         VkImageType imgType,
         size_t width,
         size_t height,
@@ -2750,21 +2767,13 @@ namespace
         VkImageUsageFlags usageFlags,
         VkImageCreateFlags createFlags,
         unsigned int loadFlags,
-        const VkAllocationCallbacks* allocator,
-        VkImage* texture,
-        VkImageCreateInfo* outImageCreateInfo) noexcept
+        VkImageCreateInfo& imageCreateInfo) noexcept
     {
-        if (!vkDevice)
-            return DDS_LOADER_BAD_POINTER;
-
-        DDS_LOADER_RESULT result = DDS_LOADER_FAIL;
-
         if(loadFlags & DDS_LOADER_FORCE_SRGB)
         {
             format = MakeSRGB(format);
         }
 
-        VkImageCreateInfo imageCreateInfo;
         imageCreateInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageCreateInfo.pNext                 = nullptr;
         imageCreateInfo.flags                 = createFlags;
@@ -2782,35 +2791,41 @@ namespace
         imageCreateInfo.queueFamilyIndexCount = 0;
         imageCreateInfo.pQueueFamilyIndices   = nullptr;
         imageCreateInfo.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
 
-        if(outImageCreateInfo != nullptr)
+    //--------------------------------------------------------------------------------------
+    DDS_LOADER_RESULT CreateImage(
+        VkDevice vkDevice,
+        const VkImageCreateInfo& imageCreateInfo,
+        const VkAllocationCallbacks* allocator,
+        VkImage* texture) noexcept
+    {
+        DDS_LOADER_RESULT result = DDS_LOADER_FAIL;
+
+#ifdef VK_NO_PROTOTYPES
+        // Only the loader-supplied pointer can be missing; the prototype build links vkCreateImage directly
+        if(vkCreateImage == nullptr)
         {
-            *outImageCreateInfo = imageCreateInfo;
+            return DDS_LOADER_NO_FUNCTION;
         }
+#endif
 
-        if(vkCreateImage != nullptr)
-        {
-            VkResult vkRes = vkCreateImage(vkDevice, &imageCreateInfo, allocator, texture);
+        VkResult vkRes = vkCreateImage(vkDevice, &imageCreateInfo, allocator, texture);
 
-            //This function only returns VK_SUCCESS, VK_ERROR_OUT_OF_HOST_MEMORY, VK_ERROR_OUT_OF_DEVICE_MEMORY
-            switch(vkRes)
-            {
-            case VK_SUCCESS:
-                result = DDS_LOADER_SUCCESS;
-                break;
-            case VK_ERROR_OUT_OF_HOST_MEMORY:
-                result = DDS_LOADER_NO_HOST_MEMORY;
-                break;
-            case VK_ERROR_OUT_OF_DEVICE_MEMORY:
-                result = DDS_LOADER_NO_DEVICE_MEMORY;
-                break;
-            default:
-                break;
-            }
-        }
-        else
+        //This function only returns VK_SUCCESS, VK_ERROR_OUT_OF_HOST_MEMORY, VK_ERROR_OUT_OF_DEVICE_MEMORY
+        switch(vkRes)
         {
-            result = DDS_LOADER_NO_FUNCTION;
+        case VK_SUCCESS:
+            result = DDS_LOADER_SUCCESS;
+            break;
+        case VK_ERROR_OUT_OF_HOST_MEMORY:
+            result = DDS_LOADER_NO_HOST_MEMORY;
+            break;
+        case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+            result = DDS_LOADER_NO_DEVICE_MEMORY;
+            break;
+        default:
+            break;
         }
 
         if(result == DDS_LOADER_SUCCESS)
@@ -2824,22 +2839,61 @@ namespace
     }
 
     //--------------------------------------------------------------------------------------
-    DDS_LOADER_RESULT CreateTextureFromDDS(VkDevice vkDevice,
-        const DDS_HEADER* header,
-        const uint8_t* bitData,
-        size_t bitSize,
-        size_t maxsize,
-        const VkPhysicalDeviceLimits* deviceLimits,
+    DDS_LOADER_RESULT CreateTextureResource(
+        VkDevice vkDevice,
+        VkImageType imgType,
+        size_t width,
+        size_t height,
+        size_t depth,
+        size_t mipCount,
+        size_t arraySize,
+        VkFormat format,
         VkImageUsageFlags usageFlags,
         VkImageCreateFlags createFlags,
         unsigned int loadFlags,
-        VkAllocationCallbacks* allocationCallbacks,
+        const VkAllocationCallbacks* allocator,
         VkImage* texture,
-        std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
-        VkImageCreateInfo* outImageCreateInfo) noexcept(false)
+        VkImageCreateInfo* outImageCreateInfo) noexcept
     {
-        DDS_LOADER_RESULT errCode = DDS_LOADER_SUCCESS;
+        if (!vkDevice)
+            return DDS_LOADER_BAD_POINTER;
 
+        VkImageCreateInfo imageCreateInfo;
+        FillImageCreateInfo(imgType, width, height, depth, mipCount, arraySize,
+            format, usageFlags, createFlags, loadFlags, imageCreateInfo);
+
+        if(outImageCreateInfo != nullptr)
+        {
+            *outImageCreateInfo = imageCreateInfo;
+        }
+
+        return CreateImage(vkDevice, imageCreateInfo, allocator, texture);
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Image type, extent and format described by a DDS header, validated against the device limits
+    //--------------------------------------------------------------------------------------
+    struct TextureLayout
+    {
+        VkImageType        imgType;
+        uint32_t           width;
+        uint32_t           height;
+        uint32_t           depth;
+        size_t             mipCount;
+        uint32_t           arraySize;
+        VkFormat           format;
+        VkImageCreateFlags createFlags;
+        uint32_t           numberOfPlanes;
+        uint32_t           maxImageDimension2D;
+        uint32_t           maxImageDimension3D;
+    };
+
+    DDS_LOADER_RESULT GetTextureLayout(
+        const DDS_HEADER* header,
+        const VkPhysicalDeviceLimits* deviceLimits,
+        VkImageCreateFlags createFlags,
+        TextureLayout& layout) noexcept
+    {
         uint32_t width  = header->width;
         uint32_t height = header->height;
         uint32_t depth  = header->depth;
@@ -3037,6 +3091,53 @@ namespace
             return DDS_LOADER_UNSUPPORTED_FORMAT;
         }
 
+        layout.imgType             = imgType;
+        layout.width               = width;
+        layout.height              = height;
+        layout.depth               = depth;
+        layout.mipCount            = mipCount;
+        layout.arraySize           = arraySize;
+        layout.format              = format;
+        layout.createFlags         = imageCreateFlags;
+        layout.numberOfPlanes      = numberOfPlanes;
+        layout.maxImageDimension2D = maxImageDimension2D;
+        layout.maxImageDimension3D = maxImageDimension3D;
+        return DDS_LOADER_SUCCESS;
+    }
+
+    //--------------------------------------------------------------------------------------
+    DDS_LOADER_RESULT CreateTextureFromDDS(VkDevice vkDevice,
+        const DDS_HEADER* header,
+        const uint8_t* bitData,
+        size_t bitSize,
+        size_t maxsize,
+        const VkPhysicalDeviceLimits* deviceLimits,
+        VkImageUsageFlags usageFlags,
+        VkImageCreateFlags createFlags,
+        unsigned int loadFlags,
+        VkAllocationCallbacks* allocationCallbacks,
+        VkImage* texture,
+        std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
+        VkImageCreateInfo* outImageCreateInfo) noexcept(false)
+    {
+        TextureLayout layout;
+        DDS_LOADER_RESULT errCode = GetTextureLayout(header, deviceLimits, createFlags, layout);
+        if (errCode != DDS_LOADER_SUCCESS)
+        {
+            return errCode;
+        }
+
+        const VkImageType imgType = layout.imgType;
+        const uint32_t width = layout.width;
+        const uint32_t height = layout.height;
+        const uint32_t depth = layout.depth;
+        const size_t mipCount = layout.mipCount;
+        const uint32_t arraySize = layout.arraySize;
+        const VkFormat format = layout.format;
+        const VkImageCreateFlags imageCreateFlags = layout.createFlags;
+        const uint32_t numberOfPlanes = layout.numberOfPlanes;
+        constexpr uint32_t maxDirect3DMips = 15;
+
         // Create the texture
         size_t numberOfResources = (imgType == VK_IMAGE_TYPE_3D)
                                    ? 1 : arraySize;
@@ -3073,8 +3174,8 @@ namespace
 
                 maxsize = static_cast<size_t>(
                     (imgType == VK_IMAGE_TYPE_3D)
-                    ? maxImageDimension3D
-                    : maxImageDimension2D);
+                    ? layout.maxImageDimension3D
+                    : layout.maxImageDimension2D);
 
                 errCode = FillInitData(width, height, depth, mipCount, arraySize,
                     numberOfPlanes, format,
@@ -3169,12 +3270,12 @@ namespace
 
 #ifdef VK_NO_PROTOTYPES
 
-    void DDSTextureLoaderVk::SetVkCreateImageFuncPtr(PFN_vkCreateImage funcPtr)
+    void SetVkCreateImageFuncPtr(PFN_vkCreateImage funcPtr)
     {
         vkCreateImage = funcPtr;
     }
 
-    void DDSTextureLoaderVk::SetVkCreateImageFuncPtrWithUserPtr(DDSTextureLoaderVk::PFN_DdsLoader_vkCreateImageUserPtr funcPtr)
+    void SetVkCreateImageFuncPtrWithUserPtr(DDSTextureLoaderVk::PFN_DdsLoader_vkCreateImageUserPtr funcPtr)
     {
         vkCreateImageWithUserPtr = funcPtr;
 
@@ -3184,7 +3285,7 @@ namespace
         };
     }
 
-    void DDSTextureLoaderVk::SetVkCreateImageUserPtr(void* userPtr)
+    void SetVkCreateImageUserPtr(void* userPtr)
     {
         vkCreateImageUserPtr = userPtr;
     }
@@ -3193,12 +3294,12 @@ namespace
 
 #ifdef VK_EXT_debug_utils
 
-    void DDSTextureLoaderVk::SetVkSetDebugUtilsObjectNameFuncPtr(PFN_vkSetDebugUtilsObjectNameEXT funcPtr)
+    void SetVkSetDebugUtilsObjectNameFuncPtr(PFN_vkSetDebugUtilsObjectNameEXT funcPtr)
     {
         vkSetDebugUtilsObjectNameEXTFunc = funcPtr;
     }
 
-    void DDSTextureLoaderVk::SetVkSetDebugUtilsObjectNameFuncPtrWithUserPtr(DDSTextureLoaderVk::PFN_DdsLoader_vkSetDebugUtilsObjectNameUserPtr funcPtr)
+    void SetVkSetDebugUtilsObjectNameFuncPtrWithUserPtr(DDSTextureLoaderVk::PFN_DdsLoader_vkSetDebugUtilsObjectNameUserPtr funcPtr)
     {
         vkSetDebugUtilsObjectNameEXTWithUserPtr = funcPtr;
 
@@ -3208,7 +3309,7 @@ namespace
         };
     }
 
-    void DDSTextureLoaderVk::SetVkSetDebugUtilsObjectNameUserPtr(void* userPtr)
+    void SetVkSetDebugUtilsObjectNameUserPtr(void* userPtr)
     {
         vkSetDebugUtilsObjectNameEXTUserPtr = userPtr;
     }
@@ -3251,7 +3352,7 @@ std::string DDSLoaderResultToString(DDS_LOADER_RESULT errorCode)
 }
 
 //--------------------------------------------------------------------------------------
-DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromMemory(
+DDS_LOADER_RESULT LoadDDSTextureFromMemory(
     VkDevice vkDevice,
     const uint8_t* ddsData,
     size_t ddsDataSize,
@@ -3278,7 +3379,7 @@ DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromMemory(
 }
 
 
-DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromMemoryEx(
+DDS_LOADER_RESULT LoadDDSTextureFromMemoryEx(
     VkDevice vkDevice,
     const uint8_t* ddsData,
     size_t ddsDataSize,
@@ -3347,7 +3448,7 @@ DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromMemoryEx(
 
 
 //--------------------------------------------------------------------------------------
-DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromFile(
+DDS_LOADER_RESULT LoadDDSTextureFromFile(
     VkDevice vkDevice,
     const char_type* fileName,
     VkImage* texture,
@@ -3373,7 +3474,7 @@ DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromFile(
         outAlphaMode);
 }
 
-DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromFileEx(
+DDS_LOADER_RESULT LoadDDSTextureFromFileEx(
     VkDevice vkDevice,
     const char_type* fileName,
     size_t maxsize,
@@ -3448,4 +3549,405 @@ DDS_LOADER_RESULT DDSTextureLoaderVk::LoadDDSTextureFromFileEx(
     return errCode;
 }
 
+
+//--------------------------------------------------------------------------------------
+MappedDDSFile::~MappedDDSFile()
+{
+    Close();
+}
+
+MappedDDSFile::MappedDDSFile(MappedDDSFile&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+MappedDDSFile& MappedDDSFile::operator=(MappedDDSFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+DDS_LOADER_RESULT MappedDDSFile::Open(const char_type* fileName) noexcept
+{
+    Close();
+
+    if (!fileName)
+    {
+        return DDS_LOADER_INVALID_ARG;
+    }
+
+#ifdef _WIN32
+    #if defined(DDS_LOADER_PATH_WIDE_CHAR)
+        HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    #else
+        HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    #endif
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return DDS_LOADER_FAIL;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < sizeof(uint32_t) + sizeof(DDS_HEADER))
+    {
+        CloseHandle(file);
+        return DDS_LOADER_FAIL;
+    }
+
+    // The view keeps the mapping alive, neither handle is needed once it exists
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return DDS_LOADER_FAIL;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view)
+    {
+        return DDS_LOADER_NO_HOST_MEMORY;
+    }
+#else
+    int file = open(fileName, O_RDONLY);
+    if (file < 0)
+    {
+        return DDS_LOADER_FAIL;
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || static_cast<uint64_t>(fileStat.st_size) < sizeof(uint32_t) + sizeof(DDS_HEADER))
+    {
+        close(file);
+        return DDS_LOADER_FAIL;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (view == MAP_FAILED)
+    {
+        return DDS_LOADER_NO_HOST_MEMORY;
+    }
+    // Subresources are read front to back once, right after parsing
+    madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+#endif
+
+    m_data = static_cast<const uint8_t*>(view);
+#ifdef _WIN32
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+    return DDS_LOADER_SUCCESS;
+}
+
+void MappedDDSFile::Close() noexcept
+{
+    if (!m_data)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+//--------------------------------------------------------------------------------------
+DDS_LOADER_RESULT LoadDDSTextureFromFile(
+    VkDevice vkDevice,
+    const char_type* fileName,
+    VkImage* texture,
+    MappedDDSFile& ddsFile,
+    std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
+    size_t maxsize,
+    VkImageCreateInfo* outImageCreateInfo,
+    DDS_ALPHA_MODE* outAlphaMode)
+{
+    return LoadDDSTextureFromFileEx(
+        vkDevice,
+        fileName,
+        maxsize,
+        nullptr,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        0,
+        DDS_LOADER_DEFAULT,
+        nullptr,
+        texture,
+        ddsFile,
+        subresources,
+        outImageCreateInfo,
+        outAlphaMode);
+}
+
+DDS_LOADER_RESULT LoadDDSTextureFromFileEx(
+    VkDevice vkDevice,
+    const char_type* fileName,
+    size_t maxsize,
+    const VkPhysicalDeviceLimits* deviceLimits,
+    VkImageUsageFlags usageFlags,
+    VkImageCreateFlags createFlags,
+    unsigned int loadFlags,
+    VkAllocationCallbacks* allocator,
+    VkImage* texture,
+    MappedDDSFile& ddsFile,
+    std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
+    VkImageCreateInfo* outImageCreateInfo,
+    DDS_ALPHA_MODE* outAlphaMode)
+{
+    if (texture)
+    {
+        *texture = nullptr;
+    }
+    if (outAlphaMode)
+    {
+        *outAlphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    }
+    if (outImageCreateInfo)
+    {
+        memset(outImageCreateInfo, 0, sizeof(VkImageCreateInfo));
+    }
+
+    if (!vkDevice || !fileName || !texture)
+    {
+        return DDS_LOADER_INVALID_ARG;
+    }
+
+    DDS_LOADER_RESULT errCode = ddsFile.Open(fileName);
+    if (errCode != DDS_LOADER_SUCCESS)
+    {
+        return errCode;
+    }
+
+    const DDS_HEADER* header = nullptr;
+    const uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    errCode = LoadTextureDataFromMemory(ddsFile.Data(),
+        ddsFile.Size(),
+        &header,
+        &bitData,
+        &bitSize
+    );
+    if (errCode != DDS_LOADER_SUCCESS)
+    {
+        ddsFile.Close();
+        return errCode;
+    }
+
+    errCode = CreateTextureFromDDS(vkDevice,
+        header, bitData, bitSize, maxsize,
+        deviceLimits,
+        usageFlags, createFlags, loadFlags,
+        allocator, texture, subresources, outImageCreateInfo);
+
+    if (errCode == DDS_LOADER_SUCCESS)
+    {
+        #if defined(WIN32) && defined(DDS_LOADER_PATH_WIDE_CHAR)
+            int filenameSize = WideCharToMultiByte(CP_UTF8, 0, fileName, -1, nullptr, 0, nullptr, nullptr);
+
+            char* filenameU8 = (char*)_malloca(filenameSize + 1);
+            WideCharToMultiByte(CP_UTF8, 0, fileName, -1, filenameU8, filenameSize + 1, nullptr, nullptr);
+
+            SetDebugTextureInfo(vkDevice, filenameU8, *texture);
+        #else
+            SetDebugTextureInfo(vkDevice, fileName, *texture);
+        #endif // _WIN32
+
+        if (outAlphaMode)
+            *outAlphaMode = GetAlphaMode(header);
+    }
+    else
+    {
+        ddsFile.Close();
+    }
+
+    return errCode;
+}
+
+//--------------------------------------------------------------------------------------
+DDS_LOADER_RESULT ParseDDSTextureFromMemory(
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    size_t maxsize,
+    const VkPhysicalDeviceLimits* deviceLimits,
+    VkImageUsageFlags usageFlags,
+    VkImageCreateFlags createFlags,
+    unsigned int loadFlags,
+    ParsedDDSTexture& parsed)
+{
+    parsed.Result = DDS_LOADER_FAIL;
+    parsed.ImageCreateInfo = {};
+    parsed.AlphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    parsed.Subresources.clear();
+    parsed.DataByteSize = 0;
+
+    if (!ddsData)
+    {
+        return parsed.Result = DDS_LOADER_INVALID_ARG;
+    }
+
+    const DDS_HEADER* header = nullptr;
+    const uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    DDS_LOADER_RESULT errCode = LoadTextureDataFromMemory(ddsData, ddsDataSize, &header, &bitData, &bitSize);
+    if (errCode != DDS_LOADER_SUCCESS)
+    {
+        return parsed.Result = errCode;
+    }
+
+    TextureLayout layout;
+    errCode = GetTextureLayout(header, deviceLimits, createFlags, layout);
+    if (errCode != DDS_LOADER_SUCCESS)
+    {
+        return parsed.Result = errCode;
+    }
+
+    size_t skipMip = 0;
+    size_t twidth = 0;
+    size_t theight = 0;
+    size_t tdepth = 0;
+    errCode = FillInitData(layout.width, layout.height, layout.depth, layout.mipCount, layout.arraySize,
+        layout.numberOfPlanes, layout.format,
+        maxsize, bitSize, bitData,
+        twidth, theight, tdepth, skipMip, parsed.Subresources);
+    if (errCode != DDS_LOADER_SUCCESS)
+    {
+        parsed.Subresources.clear();
+        return parsed.Result = errCode;
+    }
+
+    size_t reservedMips = layout.mipCount;
+    if (loadFlags & DDS_LOADER_MIP_RESERVE)
+    {
+        reservedMips = std::min<size_t>(15 /*D3D12_REQ_MIP_LEVELS*/, CountMips(layout.width, layout.height));
+    }
+
+    FillImageCreateInfo(layout.imgType, twidth, theight, tdepth, reservedMips - skipMip, layout.arraySize,
+        layout.format, usageFlags, layout.createFlags, loadFlags, parsed.ImageCreateInfo);
+
+    for (const LoadedSubresourceData& subresource : parsed.Subresources)
+    {
+        parsed.DataByteSize += subresource.DataByteSize;
+    }
+    parsed.AlphaMode = GetAlphaMode(header);
+
+    return parsed.Result = DDS_LOADER_SUCCESS;
+}
+
+DDS_LOADER_RESULT ParseDDSTexturesFromFiles(
+    const char_type* const* fileNames,
+    size_t fileCount,
+    size_t maxsize,
+    const VkPhysicalDeviceLimits* deviceLimits,
+    VkImageUsageFlags usageFlags,
+    VkImageCreateFlags createFlags,
+    unsigned int loadFlags,
+    std::vector<MappedDDSFile>& ddsFiles,
+    std::vector<ParsedDDSTexture>& parsed,
+    unsigned int threadCount)
+{
+    if (!fileNames && fileCount > 0)
+    {
+        return DDS_LOADER_INVALID_ARG;
+    }
+
+    ddsFiles.clear();
+    ddsFiles.resize(fileCount);
+    parsed.clear();
+    parsed.resize(fileCount);
+
+    // Files are handed out one at a time, sizes vary too much for static ranges
+    std::atomic<size_t> nextFile(0);
+    auto worker = [&]()
+    {
+        for (size_t i = nextFile++; i < fileCount; i = nextFile++)
+        {
+            DDS_LOADER_RESULT errCode = ddsFiles[i].Open(fileNames[i]);
+            if (errCode != DDS_LOADER_SUCCESS)
+            {
+                parsed[i].Result = errCode;
+                continue;
+            }
+
+            try
+            {
+                errCode = ParseDDSTextureFromMemory(ddsFiles[i].Data(), ddsFiles[i].Size(), maxsize,
+                    deviceLimits, usageFlags, createFlags, loadFlags, parsed[i]);
+            }
+            catch (const std::bad_alloc&)
+            {
+                parsed[i].Subresources.clear();
+                errCode = parsed[i].Result = DDS_LOADER_NO_HOST_MEMORY;
+            }
+
+            if (errCode != DDS_LOADER_SUCCESS)
+            {
+                ddsFiles[i].Close();
+            }
+        }
+    };
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, fileCount));
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const ParsedDDSTexture& texture : parsed)
+    {
+        if (texture.Result != DDS_LOADER_SUCCESS)
+        {
+            return texture.Result;
+        }
+    }
+    return DDS_LOADER_SUCCESS;
+}
+
+DDS_LOADER_RESULT CreateDDSTexture(
+    VkDevice vkDevice,
+    const ParsedDDSTexture& parsed,
+    const VkAllocationCallbacks* allocator,
+    VkImage* texture)
+{
+    if (texture)
+    {
+        *texture = nullptr;
+    }
+
+    if (!vkDevice || !texture || parsed.Result != DDS_LOADER_SUCCESS)
+    {
+        return DDS_LOADER_INVALID_ARG;
+    }
+
+    return CreateImage(vkDevice, parsed.ImageCreateInfo, allocator, texture);
+}
+
 } // namespace DDSTextureLoaderVk
\ No newline at end of file
@@ -17,7 +17,10 @@
 #include <memory>
 #include <vector>
 #include <string>
-#include <windows.h>
+
+#if !defined(_WIN32) && !defined(__cdecl)
+#define __cdecl
+#endif
 
 #if defined(_WIN32) && defined(UNICODE)
 
@@ -106,6 +109,39 @@ void SetVkSetDebugUtilsObjectNameUserPtr(void* userPtr);
         VkExtent3D         Extent;           //The extent (width-height-depth) of the subresource
     };
 
+    //Read-only memory mapping of a DDS file, subresources returned by the loader point into it and stay valid while it is open
+    class MappedDDSFile
+    {
+    public:
+        MappedDDSFile() = default;
+        ~MappedDDSFile();
+
+        MappedDDSFile(MappedDDSFile&& other) noexcept;
+        MappedDDSFile& operator=(MappedDDSFile&& other) noexcept;
+        MappedDDSFile(const MappedDDSFile&) = delete;
+        MappedDDSFile& operator=(const MappedDDSFile&) = delete;
+
+        DDS_LOADER_RESULT Open(const char_type* fileName) noexcept;
+        void Close() noexcept;
+
+        const uint8_t* Data() const noexcept { return m_data; }
+        size_t Size() const noexcept { return m_size; }
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    //Result of parsing a DDS file without creating any Vulkan object
+    struct ParsedDDSTexture
+    {
+        DDS_LOADER_RESULT                  Result = DDS_LOADER_FAIL;
+        VkImageCreateInfo                  ImageCreateInfo = {}; //Ready to be passed to vkCreateImage()
+        DDS_ALPHA_MODE                     AlphaMode = DDS_ALPHA_MODE_UNKNOWN;
+        std::vector<LoadedSubresourceData> Subresources;         //Point into the parsed data, in file order
+        size_t                             DataByteSize = 0;     //Sum of the subresource sizes, e.g. to reserve staging memory
+    };
+
     // Standard version
     DDS_LOADER_RESULT __cdecl LoadDDSTextureFromMemory(
         VkDevice vkDevice,
@@ -157,4 +193,63 @@ void SetVkSetDebugUtilsObjectNameUserPtr(void* userPtr);
         std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
         VkImageCreateInfo* outImageCreateInfo = nullptr,
         DDS_ALPHA_MODE* alphaMode = nullptr);
+
+    // Memory mapped version, reads nothing up front, subresources point into the mapping
+    DDS_LOADER_RESULT __cdecl LoadDDSTextureFromFile(
+        VkDevice vkDevice,
+        const char_type* fileName,
+        VkImage* texture,
+        MappedDDSFile& ddsFile,
+        std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
+        size_t maxsize = 0,
+        VkImageCreateInfo* outImageCreateInfo = nullptr,
+        DDS_ALPHA_MODE* alphaMode = nullptr);
+
+    DDS_LOADER_RESULT __cdecl LoadDDSTextureFromFileEx(
+        VkDevice vkDevice,
+        const char_type* fileName,
+        size_t maxsize,
+        const VkPhysicalDeviceLimits* deviceLimits,
+        VkImageUsageFlags usageFlags,
+        VkImageCreateFlags createFlags,
+        unsigned int loadFlags,
+        VkAllocationCallbacks* allocationCallbacks,
+        VkImage* texture,
+        MappedDDSFile& ddsFile,
+        std::vector<DDSTextureLoaderVk::LoadedSubresourceData>& subresources,
+        VkImageCreateInfo* outImageCreateInfo = nullptr,
+        DDS_ALPHA_MODE* alphaMode = nullptr);
+
+    // Header only parsing, validates the file and computes the image create info and subresource layout
+    // (there is no vkCreateImage() failure to fall back from, so mips above maxsize are only skipped when maxsize is given)
+    DDS_LOADER_RESULT __cdecl ParseDDSTextureFromMemory(
+        const uint8_t* ddsData,
+        size_t ddsDataSize,
+        size_t maxsize,
+        const VkPhysicalDeviceLimits* deviceLimits,
+        VkImageUsageFlags usageFlags,
+        VkImageCreateFlags createFlags,
+        unsigned int loadFlags,
+        ParsedDDSTexture& parsed);
+
+    // Maps and parses many files in parallel (threadCount 0 uses all hardware threads), one entry of
+    // ddsFiles and parsed per file name. Returns DDS_LOADER_SUCCESS if every file parsed, otherwise see parsed[i].Result
+    DDS_LOADER_RESULT __cdecl ParseDDSTexturesFromFiles(
+        const char_type* const* fileNames,
+        size_t fileCount,
+        size_t maxsize,
+        const VkPhysicalDeviceLimits* deviceLimits,
+        VkImageUsageFlags usageFlags,
+        VkImageCreateFlags createFlags,
+        unsigned int loadFlags,
+        std::vector<MappedDDSFile>& ddsFiles,
+        std::vector<ParsedDDSTexture>& parsed,
+        unsigned int threadCount = 0);
+
+    // Creates the image of a parsed texture, through the same vkCreateImage() as the other entry points
+    DDS_LOADER_RESULT __cdecl CreateDDSTexture(
+        VkDevice vkDevice,
+        const ParsedDDSTexture& parsed,
+        const VkAllocationCallbacks* allocationCallbacks,
+        VkImage* texture);
 }
\ No newline at end of file
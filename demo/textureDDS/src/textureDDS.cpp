@@ -110,14 +110,15 @@ public:
 	void loadTexture() {
 		using namespace DDSTextureLoaderVk;
 
-		std::unique_ptr<uint8_t[]> ddsData;
+		// Subresources point into the mapped file, it stays mapped until the staging copy is done
+		MappedDDSFile ddsFile;
 		std::vector<LoadedSubresourceData> subresources;
 		VkImageCreateInfo imageInfo{};
 		DDS_LOADER_RESULT result = LoadDDSTextureFromFile(
 			device,
 			(getAssetPath() + "textures/dds/Action101_Background_0_0001.dds").c_str(),
 			&ddsImage,
-			ddsData,
+			ddsFile,
 			subresources,
 			0,
 			&imageInfo
@@ -411,7 +412,7 @@ public:
 
 			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
+			drawUI(drawCmdBuffers[i], i);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -441,6 +442,7 @@ public:
 		prepareDescriptorSet();
 		preparePipeline();
 		buildCommandBuffers();
+		benchmark.reports.push_back([this](std::ostream& os) { validateDDSLoading(os); });
 		prepared = true;
 	}
 
@@ -466,6 +468,115 @@ public:
 	// helper functions
 	//=======================================================================================
 
+	struct DDSLoad {
+		DDSTextureLoaderVk::DDS_LOADER_RESULT result;
+		VkImageCreateInfo imageInfo;
+		DDSTextureLoaderVk::DDS_ALPHA_MODE alphaMode;
+		const std::vector<DDSTextureLoaderVk::LoadedSubresourceData>* subresources;
+	};
+
+	// Appends the differences between two loads of the same file to errors
+	static void compareDDSLoads(const char* name, const DDSLoad& a, const DDSLoad& b, std::vector<std::string>& errors) {
+		if (a.result != b.result) {
+			errors.push_back(std::string(name) + " result");
+			return;
+		}
+		const VkImageCreateInfo& infoA = a.imageInfo;
+		const VkImageCreateInfo& infoB = b.imageInfo;
+		if ((infoA.imageType != infoB.imageType) || (infoA.format != infoB.format) || (infoA.flags != infoB.flags) || (infoA.usage != infoB.usage) ||
+			(infoA.extent.width != infoB.extent.width) || (infoA.extent.height != infoB.extent.height) || (infoA.extent.depth != infoB.extent.depth) ||
+			(infoA.mipLevels != infoB.mipLevels) || (infoA.arrayLayers != infoB.arrayLayers)) {
+			errors.push_back(std::string(name) + " image");
+		}
+		if (a.alphaMode != b.alphaMode) {
+			errors.push_back(std::string(name) + " alpha mode");
+		}
+		if (a.subresources->size() != b.subresources->size()) {
+			errors.push_back(std::string(name) + " subresource count");
+			return;
+		}
+		for (size_t i = 0; i < a.subresources->size(); i++) {
+			const DDSTextureLoaderVk::LoadedSubresourceData& sa = (*a.subresources)[i];
+			const DDSTextureLoaderVk::LoadedSubresourceData& sb = (*b.subresources)[i];
+			if ((sa.SubresourceSlice.aspectMask != sb.SubresourceSlice.aspectMask) || (sa.SubresourceSlice.mipLevel != sb.SubresourceSlice.mipLevel) ||
+				(sa.SubresourceSlice.arrayLayer != sb.SubresourceSlice.arrayLayer) ||
+				(sa.Extent.width != sb.Extent.width) || (sa.Extent.height != sb.Extent.height) || (sa.Extent.depth != sb.Extent.depth) ||
+				(sa.DataByteSize != sb.DataByteSize) || (memcmp(sa.PData, sb.PData, sa.DataByteSize) != 0)) {
+				errors.push_back(std::string(name) + " subresource " + std::to_string(i));
+			}
+		}
+	}
+
+	// Loads the shipped DDS assets through the memory mapped, the stream and the batch parse paths and checks that they
+	// agree on the image (format, extent, mips, layers) and on the layout and contents of every subresource
+	void validateDDSLoading(std::ostream& os) {
+		using namespace DDSTextureLoaderVk;
+
+		const std::vector<std::string> files = {
+			"Action101_Background_0_0000.dds",
+			"Action101_Background_0_0001.dds",
+		};
+		std::vector<std::string> paths;
+		std::vector<const char_type*> fileNames;
+		for (const std::string& file : files) {
+			paths.push_back(getAssetPath() + "textures/dds/" + file);
+		}
+		for (const std::string& path : paths) {
+			fileNames.push_back(path.c_str());
+		}
+
+		// Same usage and flags as the single file entry points, so the image create infos compare as a whole
+		std::vector<MappedDDSFile> batchFiles;
+		std::vector<ParsedDDSTexture> batch;
+		ParseDDSTexturesFromFiles(fileNames.data(), fileNames.size(), 0, nullptr,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0, DDS_LOADER_DEFAULT,
+			batchFiles, batch);
+
+		os << "dds loading (mapped vs stream vs batch parse)" << "\n";
+		uint32_t failures = 0;
+		for (size_t i = 0; i < files.size(); i++) {
+			MappedDDSFile mappedFile;
+			std::vector<LoadedSubresourceData> mappedSubresources;
+			VkImage mappedImage = VK_NULL_HANDLE;
+			DDSLoad mapped = { DDS_LOADER_FAIL, {}, DDS_ALPHA_MODE_UNKNOWN, &mappedSubresources };
+			mapped.result = LoadDDSTextureFromFile(device, fileNames[i], &mappedImage, mappedFile, mappedSubresources, 0, &mapped.imageInfo, &mapped.alphaMode);
+
+			std::unique_ptr<uint8_t[]> streamData;
+			std::vector<LoadedSubresourceData> streamSubresources;
+			VkImage streamImage = VK_NULL_HANDLE;
+			DDSLoad stream = { DDS_LOADER_FAIL, {}, DDS_ALPHA_MODE_UNKNOWN, &streamSubresources };
+			stream.result = LoadDDSTextureFromFile(device, fileNames[i], &streamImage, streamData, streamSubresources, 0, &stream.imageInfo, &stream.alphaMode);
+
+			// Only the parse results are compared, the images are never bound to memory
+			vkDestroyImage(device, mappedImage, nullptr);
+			vkDestroyImage(device, streamImage, nullptr);
+
+			DDSLoad parsed = { batch[i].Result, batch[i].ImageCreateInfo, batch[i].AlphaMode, &batch[i].Subresources };
+
+			std::vector<std::string> errors;
+			if (mapped.result != DDS_LOADER_SUCCESS) {
+				errors.push_back(DDSLoaderResultToString(mapped.result));
+			}
+			compareDDSLoads("stream", mapped, stream, errors);
+			compareDDSLoads("batch", mapped, parsed, errors);
+
+			os << files[i] << ": format " << mapped.imageInfo.format << ", " << mapped.imageInfo.extent.width << "x" << mapped.imageInfo.extent.height
+				<< ", " << mapped.imageInfo.mipLevels << " mips, " << mapped.imageInfo.arrayLayers << " layers, "
+				<< mappedSubresources.size() << " subresources: ";
+			if (errors.empty()) {
+				os << "match" << "\n";
+			} else {
+				failures++;
+				os << "MISMATCH";
+				for (const std::string& error : errors) {
+					os << " [" << error << "]";
+				}
+				os << "\n";
+			}
+		}
+		os << (failures == 0 ? "all loading paths agree" : "loading paths disagree") << "\n";
+	}
+
 	VkCommandBuffer beginSingleTimeCommands() {
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;